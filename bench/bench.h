@@ -0,0 +1,59 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// runs the measured code iterations times over whatever the benchmark was added with
+typedef void (*BenchFunc)(uint64_t iterations, void *user_data);
+
+// times func and keeps the result under "group/name", nothing runs if the name does not match --filter
+void benchRun(const char *group, const char *name, BenchFunc func, void *user_data);
+// macro benchmarks that run once per iteration use this to say they could not set up
+void benchSkip(const char *group, const char *name, const char *reason);
+
+// keeps the compiler from dropping work whose result is never read
+#if defined(__GNUC__) || defined(__clang__)
+#define BENCH_KEEP(value) __asm__ volatile("" : : "g"(&(value)) : "memory")
+#else
+void benchKeep(const void *data);
+#define BENCH_KEEP(value) benchKeep(&(value))
+#endif
+
+// deterministic inputs, the same every run so results compare across builds
+uint32_t benchRandom(uint32_t *state);
+float benchRandomFloat(uint32_t *state, float min, float max);
+
+/** ---------------- Groups ---------------- **/
+
+void benchContainers();
+void benchCollision();
+void benchLighting();
+void benchPng();
+// need the econst map from dgnRendererInitialize or dgnShaderInit_internal
+void benchShader();
+// need a current gl context
+void benchMesh();
+
+/** ---------------- Results ---------------- **/
+
+typedef struct
+{
+    char name[128];
+    uint64_t iterations;
+    uint32_t samples;
+    double median_ns;
+    double min_ns;
+    double max_ns;
+    // median absolute deviation of the samples, how noisy the median is
+    double mad_ns;
+}BenchResult;
+
+uint8_t benchWriteJson(const char *filepath, const BenchResult *results, uint32_t count);
+// returns the number of results read or 0xFFFFFFFF if the file could not be read, free *out_results after
+uint32_t benchReadJson(const char *filepath, BenchResult **out_results, uint8_t *out_debug);
+
+// prints baseline against current, returns the number of regressions
+uint32_t benchCompare(const char *baseline_path, const char *current_path, double threshold_percent);
+
+#endif // BENCH_H
@@ -0,0 +1,139 @@
+#include "../src/DGNEngine/DGNEngine.h"
+#include "bench.h"
+
+// a power of two so the inputs are picked with a mask, small enough to stay in cache
+#define INPUT_COUNT 256
+#define INPUT_MASK (INPUT_COUNT - 1)
+#define CLOUD_SIZE 64
+
+typedef struct
+{
+    Vec3 points[INPUT_COUNT];
+    DgnBoundingBox boxes[INPUT_COUNT];
+    DgnBoundingSphere spheres[INPUT_COUNT];
+    DgnPlane planes[INPUT_COUNT];
+    DgnLine lines[INPUT_COUNT];
+    DgnTriangle triangles[INPUT_COUNT];
+    // a frustum's corners are what the shadow fitting generates bounds from
+    Vec3 cloud[CLOUD_SIZE];
+}CollisionInputs;
+
+static CollisionInputs s_inputs;
+
+static Vec3 randomVec3Internal(uint32_t *random, float extent)
+{
+    return (Vec3){benchRandomFloat(random, -extent, extent), benchRandomFloat(random, -extent, extent),
+                  benchRandomFloat(random, -extent, extent)};
+}
+
+// runs expr once per iteration, i walks through the inputs so nothing is loop invariant
+#define COLLISION_BENCH(func_name, type, expr) \
+static void func_name(uint64_t iterations, void *user_data) \
+{ \
+    const CollisionInputs *in = user_data; \
+    for(uint64_t n = 0; n < iterations; n++) \
+    { \
+        uint32_t i = n & INPUT_MASK; \
+        (void)i; \
+        type res = expr; \
+        BENCH_KEEP(res); \
+    } \
+}
+
+#define NEXT ((i + 1) & INPUT_MASK)
+
+/** ---- Generation ---- **/
+
+COLLISION_BENCH(generateBox8Internal, DgnBoundingBox, dgnCollisionGenerateBox((Vec3*)in->points + (i & ~7u), 8))
+COLLISION_BENCH(generateBox64Internal, DgnBoundingBox, dgnCollisionGenerateBox((Vec3*)in->cloud, CLOUD_SIZE))
+COLLISION_BENCH(generateSphere8Internal, DgnBoundingSphere, dgnCollisionGenerateSphere((Vec3*)in->points + (i & ~7u), 8))
+COLLISION_BENCH(generateSphere64Internal, DgnBoundingSphere, dgnCollisionGenerateSphere((Vec3*)in->cloud, CLOUD_SIZE))
+COLLISION_BENCH(generatePlaneInternal, DgnPlane,
+                dgnCollisionGeneratePlane(in->triangles[i].p1, in->triangles[i].p2, in->triangles[i].p3))
+COLLISION_BENCH(sphereFromBoxInternal, DgnBoundingSphere, dgnCollisionSphereFromBox(in->boxes[i]))
+
+/** ---- Tests ---- **/
+
+COLLISION_BENCH(boxPointInternal, DgnCollisionData, dgnCollisionBoxPoint(in->boxes[i], in->points[NEXT]))
+COLLISION_BENCH(boxBoxInternal, DgnCollisionData, dgnCollisionBoxBox(in->boxes[i], in->boxes[NEXT]))
+COLLISION_BENCH(boxSphereInternal, DgnCollisionData, dgnCollisionBoxSphere(in->boxes[i], in->spheres[NEXT]))
+COLLISION_BENCH(sphereSphereInternal, DgnCollisionData, dgnCollisionSphereSphere(in->spheres[i], in->spheres[NEXT]))
+COLLISION_BENCH(spherePointInternal, DgnCollisionData, dgnCollisionSpherePoint(in->spheres[i], in->points[NEXT]))
+COLLISION_BENCH(planePointInternal, DgnCollisionData, dgnCollisionPlanePoint(in->planes[i], in->points[NEXT]))
+COLLISION_BENCH(linePointInternal, DgnCollisionData, dgnCollisionLinePoint(in->lines[i], in->points[NEXT]))
+COLLISION_BENCH(trianglePointInternal, DgnCollisionData, dgnCollisionTrianglePoint(in->triangles[i], in->points[NEXT]))
+COLLISION_BENCH(triangleSphereInternal, DgnCollisionData,
+                dgnCollisionTriangleSphere(in->triangles[i], in->spheres[NEXT]))
+
+/** ---- Queries ---- **/
+
+COLLISION_BENCH(distFromPlaneInternal, float, dgnCollisionDistFromPlane(in->points[i], in->planes[NEXT]))
+COLLISION_BENCH(nearestPointPlaneInternal, Vec3, dgnCollisionNearestPointPlane(in->points[i], in->planes[NEXT]))
+COLLISION_BENCH(nearestPointLineInternal, Vec3, dgnCollisionNearestPointLine(in->points[i], in->lines[NEXT]))
+COLLISION_BENCH(nearestPointTriangleInternal, Vec3,
+                dgnCollisionNearestPointTriangle(in->points[i], in->triangles[NEXT]))
+COLLISION_BENCH(boxGetCenterInternal, Vec3, dgnCollisionBoxGetCenter(in->boxes[i]))
+COLLISION_BENCH(boxGetModelInternal, Mat4x4, dgnCollisionBoxGetModel(in->boxes[i]))
+COLLISION_BENCH(sphereGetModelInternal, Mat4x4, dgnCollisionSphereGetModel(in->spheres[i]))
+
+void benchCollision()
+{
+    uint32_t random = 0x2545f491;
+    CollisionInputs *in = &s_inputs;
+
+    // sizes chosen so roughly half of the tests hit
+    for(uint32_t i = 0; i < INPUT_COUNT; i++)
+    {
+        in->points[i] = randomVec3Internal(&random, 10.0f);
+
+        Vec3 center = randomVec3Internal(&random, 8.0f);
+        Vec3 half = {benchRandomFloat(&random, 0.5f, 4.0f), benchRandomFloat(&random, 0.5f, 4.0f),
+                     benchRandomFloat(&random, 0.5f, 4.0f)};
+        in->boxes[i].min = m3dVec3SubVec3(center, half);
+        in->boxes[i].max = m3dVec3AddVec3(center, half);
+
+        in->spheres[i].center = randomVec3Internal(&random, 8.0f);
+        in->spheres[i].radius = benchRandomFloat(&random, 0.5f, 4.0f);
+
+        in->lines[i].p1 = randomVec3Internal(&random, 10.0f);
+        in->lines[i].p2 = randomVec3Internal(&random, 10.0f);
+
+        in->triangles[i].p1 = randomVec3Internal(&random, 10.0f);
+        in->triangles[i].p2 = randomVec3Internal(&random, 10.0f);
+        in->triangles[i].p3 = randomVec3Internal(&random, 10.0f);
+
+        in->planes[i] = dgnCollisionGeneratePlane(in->triangles[i].p1, in->triangles[i].p2, in->triangles[i].p3);
+    }
+
+    for(uint32_t i = 0; i < CLOUD_SIZE; i++)
+    {
+        in->cloud[i] = randomVec3Internal(&random, 50.0f);
+    }
+
+    benchRun("collision", "generate box 8", generateBox8Internal, in);
+    benchRun("collision", "generate box 64", generateBox64Internal, in);
+    benchRun("collision", "generate sphere 8", generateSphere8Internal, in);
+    benchRun("collision", "generate sphere 64", generateSphere64Internal, in);
+    benchRun("collision", "generate plane", generatePlaneInternal, in);
+    benchRun("collision", "sphere from box", sphereFromBoxInternal, in);
+
+    benchRun("collision", "box point", boxPointInternal, in);
+    benchRun("collision", "box box", boxBoxInternal, in);
+    benchRun("collision", "box sphere", boxSphereInternal, in);
+    benchRun("collision", "sphere sphere", sphereSphereInternal, in);
+    benchRun("collision", "sphere point", spherePointInternal, in);
+    benchRun("collision", "plane point", planePointInternal, in);
+    benchRun("collision", "line point", linePointInternal, in);
+    benchRun("collision", "triangle point", trianglePointInternal, in);
+    benchRun("collision", "triangle sphere", triangleSphereInternal, in);
+
+    benchRun("collision", "dist from plane", distFromPlaneInternal, in);
+    benchRun("collision", "nearest point plane", nearestPointPlaneInternal, in);
+    benchRun("collision", "nearest point line", nearestPointLineInternal, in);
+    benchRun("collision", "nearest point triangle", nearestPointTriangleInternal, in);
+    benchRun("collision", "box get center", boxGetCenterInternal, in);
+    benchRun("collision", "box get model", boxGetModelInternal, in);
+    benchRun("collision", "sphere get model", sphereGetModelInternal, in);
+
+    // dgnCollisionGenerateMesh is declared but has no definition yet
+}
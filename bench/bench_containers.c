@@ -0,0 +1,174 @@
+#include "../src/c_ordered_map.h"
+#include "../src/c_linked_list.h"
+#include "bench.h"
+
+#include <stdio.h>
+
+#define KEY_COUNT 1024
+#define KEY_LENGTH 16
+#define LIST_LENGTH 256
+
+// the map keeps key pointers instead of copies, so every key lives here for the whole run
+static char s_keys[KEY_COUNT][KEY_LENGTH];
+// insertion order, shuffled so the map sees keys the way a shader's uniforms would arrive
+static uint32_t s_order[KEY_COUNT];
+
+static void buildMapInternal(OrderedMapS *map)
+{
+    for(uint32_t i = 0; i < KEY_COUNT; i++)
+    {
+        orderedMapSInsert(map, s_keys[s_order[i]], &i, sizeof(i));
+    }
+}
+
+/** ---- Ordered Map ---- **/
+
+static void mapInsertInternal(uint64_t iterations, void *user_data)
+{
+    for(uint64_t i = 0; i < iterations; i++)
+    {
+        OrderedMapS *map = orderedMapSCreate();
+        buildMapInternal(map);
+        orderedMapSDestroy(map);
+    }
+}
+
+static void mapLookupInternal(uint64_t iterations, void *user_data)
+{
+    OrderedMapS *map = user_data;
+
+    for(uint64_t i = 0; i < iterations; i++)
+    {
+        void *value = orderedMapSAtKey(map, s_keys[s_order[i % KEY_COUNT]]);
+        BENCH_KEEP(value);
+    }
+}
+
+static void mapLookupMissInternal(uint64_t iterations, void *user_data)
+{
+    OrderedMapS *map = user_data;
+
+    for(uint64_t i = 0; i < iterations; i++)
+    {
+        void *value = orderedMapSAtKey(map, "not a key");
+        BENCH_KEEP(value);
+    }
+}
+
+static void mapReplaceInternal(uint64_t iterations, void *user_data)
+{
+    OrderedMapS *map = user_data;
+
+    for(uint64_t i = 0; i < iterations; i++)
+    {
+        orderedMapSInsertOrReplace(map, s_keys[s_order[i % KEY_COUNT]], &i, sizeof(i));
+    }
+}
+
+static void mapEraseInsertInternal(uint64_t iterations, void *user_data)
+{
+    OrderedMapS *map = user_data;
+
+    for(uint64_t i = 0; i < iterations; i++)
+    {
+        const char *key = s_keys[s_order[i % KEY_COUNT]];
+        orderedMapSEraseAtKey(map, key);
+        orderedMapSInsert(map, key, &i, sizeof(i));
+    }
+}
+
+static void mapIterateInternal(uint64_t iterations, void *user_data)
+{
+    OrderedMapS *map = user_data;
+
+    for(uint64_t i = 0; i < iterations; i++)
+    {
+        size_t count = orderedMapSGetCount(map);
+        for(size_t j = 0; j < count; j++)
+        {
+            void *value = orderedMapSAtIndex(map, j);
+            BENCH_KEEP(value);
+        }
+    }
+}
+
+/** ---- Linked List ---- **/
+
+static void listPushBackInternal(uint64_t iterations, void *user_data)
+{
+    for(uint64_t i = 0; i < iterations; i++)
+    {
+        LinkedList *list = linkedListCreate();
+        for(uint32_t j = 0; j < LIST_LENGTH; j++)
+        {
+            linkedListPushBack(list, &j, sizeof(j));
+        }
+        linkedListDestroy(list);
+    }
+}
+
+static void listPushFrontInternal(uint64_t iterations, void *user_data)
+{
+    for(uint64_t i = 0; i < iterations; i++)
+    {
+        LinkedList *list = linkedListCreate();
+        for(uint32_t j = 0; j < LIST_LENGTH; j++)
+        {
+            linkedListPushFront(list, &j, sizeof(j));
+        }
+        linkedListDestroy(list);
+    }
+}
+
+static void listAtInternal(uint64_t iterations, void *user_data)
+{
+    LinkedList *list = user_data;
+
+    for(uint64_t i = 0; i < iterations; i++)
+    {
+        void *value = linkedListAt(list, s_order[i % KEY_COUNT] % LIST_LENGTH);
+        BENCH_KEEP(value);
+    }
+}
+
+void benchContainers()
+{
+    uint32_t random = 0x9e3779b9;
+
+    for(uint32_t i = 0; i < KEY_COUNT; i++)
+    {
+        snprintf(s_keys[i], KEY_LENGTH, "uKey%u", i);
+        s_order[i] = i;
+    }
+    for(uint32_t i = KEY_COUNT - 1; i > 0; i--)
+    {
+        uint32_t j = benchRandom(&random) % (i + 1);
+        uint32_t swap = s_order[i];
+        s_order[i] = s_order[j];
+        s_order[j] = swap;
+    }
+
+    OrderedMapS *map = orderedMapSCreate();
+    buildMapInternal(map);
+
+    benchRun("containers", "map build 1024", mapInsertInternal, NULL);
+    benchRun("containers", "map lookup", mapLookupInternal, map);
+    benchRun("containers", "map lookup miss", mapLookupMissInternal, map);
+    benchRun("containers", "map replace", mapReplaceInternal, map);
+    benchRun("containers", "map erase insert", mapEraseInsertInternal, map);
+    benchRun("containers", "map iterate 1024", mapIterateInternal, map);
+
+    orderedMapSDestroy(map);
+
+    LinkedList *list = linkedListCreate();
+    for(uint32_t j = 0; j < LIST_LENGTH; j++)
+    {
+        linkedListPushBack(list, &j, sizeof(j));
+    }
+
+    benchRun("containers", "list push back 256", listPushBackInternal, NULL);
+    benchRun("containers", "list push front 256", listPushFrontInternal, NULL);
+    benchRun("containers", "list at 256", listAtInternal, list);
+
+    linkedListDestroy(list);
+}
@@ -0,0 +1,93 @@
+#include "../src/DGNEngine/DGNEngine.h"
+#include "bench.h"
+
+#define CAMERA_COUNT 64
+#define CASCADE_COUNT 3
+#define SHADOW_SIZE 512
+
+typedef struct
+{
+    // cameras are built ahead of time so only the fit itself is timed
+    DgnCamera cameras[CAMERA_COUNT];
+    DgnShadowMap shadow;
+    DgnFrustum cascades[CASCADE_COUNT];
+    DgnBoundingBox scene_bounds;
+}LightingInputs;
+
+static LightingInputs s_inputs;
+
+static void lightProjMatInternal(uint64_t iterations, void *user_data)
+{
+    LightingInputs *in = user_data;
+
+    for(uint64_t n = 0; n < iterations; n++)
+    {
+        Mat4x4 res = dgnLightingCreateLightProjMat(&in->cameras[n % CAMERA_COUNT], in->shadow,
+                                                   in->cascades[n % CASCADE_COUNT], 10.0f);
+        BENCH_KEEP(res);
+    }
+}
+
+static void fittedProjMatInternal(uint64_t iterations, void *user_data)
+{
+    LightingInputs *in = user_data;
+
+    for(uint64_t n = 0; n < iterations; n++)
+    {
+        Mat4x4 res = dgnLightingCreateFittedProjMat(&in->cameras[n % CAMERA_COUNT], in->shadow,
+                                                    in->cascades[n % CASCADE_COUNT],
+                                                    DGN_CASCADE_FIT_AABB | DGN_CASCADE_FIT_CLAMP_Z,
+                                                    in->scene_bounds, 10.0f);
+        BENCH_KEEP(res);
+    }
+}
+
+void benchLighting()
+{
+    uint32_t random = 0x68e31da4;
+    LightingInputs *in = &s_inputs;
+
+    // the game's camera and cascades, see main.c
+    DgnFrustum frustum;
+    frustum.fov = 90.0f * 3.14159265f / 180.0f;
+    frustum.near = 0.1f;
+    frustum.far = 100.0f;
+    frustum.width = 1000.0f;
+    frustum.height = 680.0f;
+
+    for(uint32_t i = 0; i < CAMERA_COUNT; i++)
+    {
+        DgnCamera *cam = &in->cameras[i];
+        dgnCameraInit(cam);
+        cam->frustum = frustum;
+        cam->pos = (Vec3){benchRandomFloat(&random, -20.0f, 20.0f), benchRandomFloat(&random, 0.0f, 5.0f),
+                          benchRandomFloat(&random, -20.0f, 20.0f)};
+        cam->rot = m3dQuatMulQuat(m3dQuatAngleAxis(benchRandomFloat(&random, -3.14f, 3.14f), (Vec3){0.0f, 1.0f, 0.0f}),
+                                  m3dQuatAngleAxis(benchRandomFloat(&random, -0.8f, 0.8f), (Vec3){1.0f, 0.0f, 0.0f}));
+        dgnCameraUpdate(cam);
+    }
+
+    float depths[CASCADE_COUNT + 1];
+    dgnLightingComputeCascadeSplits(depths, CASCADE_COUNT, 0.1f, 33.0f, 0.5f);
+
+    for(uint32_t i = 0; i < CASCADE_COUNT; i++)
+    {
+        in->cascades[i] = frustum;
+        in->cascades[i].near = depths[i];
+        in->cascades[i].far = depths[i + 1];
+    }
+
+    // a size without a texture keeps the benchmark free of gl
+    in->shadow.x = 0;
+    in->shadow.y = 0;
+    in->shadow.width = SHADOW_SIZE;
+    in->shadow.height = SHADOW_SIZE;
+    in->shadow.view_mat = dgnLightingCreateDirViewMat(m3dVec3Normalized((Vec3){-1.0f, -3.0f, -1.0f}));
+    in->shadow.proj_mat = m3dMat4x4InitIdentity();
+
+    in->scene_bounds.min = (Vec3){-30.0f, -5.0f, -30.0f};
+    in->scene_bounds.max = (Vec3){30.0f, 15.0f, 30.0f};
+
+    benchRun("lighting", "light proj mat", lightProjMatInternal, in);
+    benchRun("lighting", "fitted proj mat aabb clamp", fittedProjMatInternal, in);
+}
@@ -0,0 +1,294 @@
+// Headless engine benchmarks.
+//
+// Built like the game, from the engine sources in src/ with the files here in place of main.c, and
+// run from the repository root so res/ is found. Compare against a baseline saved from an earlier
+// run of the same build type on the same machine:
+//
+//     bench --out baseline.json
+//     bench --out current.json
+//     bench --compare baseline.json current.json --threshold 5
+//
+// The comparison exits with 1 if anything got slower by more than the threshold and its noise.
+
+#include "../src/d_internal.h"
+#include "../src/DGNEngine/DGNEngine.h"
+#include "bench.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define DEFAULT_MIN_TIME 0.25
+#define DEFAULT_SAMPLES 11
+#define DEFAULT_THRESHOLD 5.0
+#define MAX_BATCH_ITERATIONS (1ull << 40)
+
+// the econsts the game's shaders expect, see main.c
+#define CASCADE_COUNT 3
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+
+static const char *s_filter;
+static double s_min_time = DEFAULT_MIN_TIME;
+static uint32_t s_samples = DEFAULT_SAMPLES;
+
+static BenchResult *s_results;
+static uint32_t s_result_count;
+static uint32_t s_result_capacity;
+
+/** ---- Timing ---- **/
+
+static double timeBatchInternal(BenchFunc func, void *user_data, uint64_t iterations)
+{
+    double start = dgnEngineGetSeconds();
+    func(iterations, user_data);
+    return dgnEngineGetSeconds() - start;
+}
+
+static int compareDoubleInternal(const void *a, const void *b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// sorts values
+static double medianInternal(double *values, uint32_t count)
+{
+    qsort(values, count, sizeof(*values), compareDoubleInternal);
+
+    if(count % 2 == 1)
+    {
+        return values[count / 2];
+    }
+    return (values[count / 2 - 1] + values[count / 2]) * 0.5;
+}
+
+static void pushResultInternal(const BenchResult *result)
+{
+    if(s_result_count == s_result_capacity)
+    {
+        s_result_capacity = s_result_capacity ? s_result_capacity * 2 : 64;
+        s_results = realloc(s_results, sizeof(*s_results) * s_result_capacity);
+    }
+
+    s_results[s_result_count++] = *result;
+}
+
+void benchRun(const char *group, const char *name, BenchFunc func, void *user_data)
+{
+    BenchResult result = {0};
+    snprintf(result.name, sizeof(result.name), "%s/%s", group, name);
+
+    if(s_filter != NULL && strstr(result.name, s_filter) == NULL) return;
+
+    // the first batch also warms caches and lazy setup, it is never kept
+    double batch_time = s_min_time / s_samples;
+    uint64_t iterations = 1;
+    double time = timeBatchInternal(func, user_data, iterations);
+
+    while(time < batch_time && iterations < MAX_BATCH_ITERATIONS)
+    {
+        // aim a little past the batch time, without trusting a single tiny measurement too far
+        uint64_t next = iterations * 16;
+        if(time > 0.0 && iterations * (batch_time * 1.2 / time) < next)
+        {
+            next = (uint64_t)(iterations * (batch_time * 1.2 / time));
+        }
+        iterations = next > iterations ? next : iterations * 2;
+
+        time = timeBatchInternal(func, user_data, iterations);
+    }
+
+    double *samples = malloc(sizeof(*samples) * s_samples);
+
+    for(uint32_t i = 0; i < s_samples; i++)
+    {
+        samples[i] = timeBatchInternal(func, user_data, iterations) * 1e9 / iterations;
+    }
+
+    result.iterations = iterations;
+    result.samples = s_samples;
+    result.median_ns = medianInternal(samples, s_samples);
+    result.min_ns = samples[0];
+    result.max_ns = samples[s_samples - 1];
+
+    for(uint32_t i = 0; i < s_samples; i++)
+    {
+        samples[i] = samples[i] > result.median_ns ? samples[i] - result.median_ns : result.median_ns - samples[i];
+    }
+    result.mad_ns = medianInternal(samples, s_samples);
+
+    free(samples);
+
+    printf("%-48s %14.1f ns  +-%-10.1f %llu x %u\n", result.name, result.median_ns, result.mad_ns,
+           (unsigned long long)result.iterations, result.samples);
+    fflush(stdout);
+
+    pushResultInternal(&result);
+}
+
+void benchSkip(const char *group, const char *name, const char *reason)
+{
+    char full[128];
+    snprintf(full, sizeof(full), "%s/%s", group, name);
+
+    printf("%-48s skipped, %s\n", full, reason);
+}
+
+#if !defined(__GNUC__) && !defined(__clang__)
+volatile const void *s_keep;
+
+void benchKeep(const void *data)
+{
+    s_keep = data;
+}
+#endif
+
+uint32_t benchRandom(uint32_t *state)
+{
+    // xorshift32
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+float benchRandomFloat(uint32_t *state, float min, float max)
+{
+    return min + (max - min) * (float)(benchRandom(state) >> 8) / (float)(1 << 24);
+}
+
+/** ---- Main ---- **/
+
+static void printUsageInternal()
+{
+    printf("usage: bench [--out results.json] [--filter text] [--min-time seconds] [--samples n] [--no-gl]\n"
+           "       bench --compare baseline.json current.json [--threshold percent]\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *out_path = NULL;
+    const char *baseline_path = NULL;
+    const char *current_path = NULL;
+    double threshold = DEFAULT_THRESHOLD;
+    uint8_t use_gl = DGN_TRUE;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+        {
+            out_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+        {
+            s_filter = argv[++i];
+        }
+        else if(strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+        {
+            s_min_time = strtod(argv[++i], NULL);
+        }
+        else if(strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+        {
+            s_samples = (uint32_t)strtoul(argv[++i], NULL, 10);
+        }
+        else if(strcmp(argv[i], "--no-gl") == 0)
+        {
+            use_gl = DGN_FALSE;
+        }
+        else if(strcmp(argv[i], "--compare") == 0 && i + 2 < argc)
+        {
+            baseline_path = argv[++i];
+            current_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+        {
+            threshold = strtod(argv[++i], NULL);
+        }
+        else
+        {
+            printUsageInternal();
+            return 2;
+        }
+    }
+
+    if(baseline_path != NULL)
+    {
+        uint32_t regressions = benchCompare(baseline_path, current_path, threshold);
+        return regressions == 0xFFFFFFFF ? 2 : regressions > 0;
+    }
+
+    if(s_samples < 1 || s_min_time <= 0.0)
+    {
+        printUsageInternal();
+        return 2;
+    }
+
+#ifdef __DEBUG
+    printf("debug build, results only compare against other debug builds\n");
+#endif // __DEBUG
+
+    // the mesh benchmarks upload to a real context, everything else runs without one
+    DgnWindow *window = NULL;
+    uint8_t has_gl = DGN_FALSE;
+
+    if(use_gl && dgnWindowCreateHeadless(&window, 64, 64, "bench"))
+    {
+        dgnWindowMakeCurrent(window);
+        has_gl = dgnRendererInitialize();
+    }
+
+    if(!has_gl)
+    {
+        dgnShaderInit_internal();
+    }
+
+    dgnShaderSetEconstI("NUM_CASCADES", CASCADE_COUNT);
+    dgnShaderSetEconstI("CLUSTER_X", CLUSTER_X);
+    dgnShaderSetEconstI("CLUSTER_Y", CLUSTER_Y);
+    dgnShaderSetEconstI("CLUSTER_Z", CLUSTER_Z);
+
+    benchContainers();
+    benchCollision();
+    benchLighting();
+    benchPng();
+    benchShader();
+
+    if(has_gl)
+    {
+        benchMesh();
+    }
+    else
+    {
+        benchSkip("mesh", "*", "no gl context");
+    }
+
+    uint8_t ok = DGN_TRUE;
+    if(out_path != NULL)
+    {
+        ok = benchWriteJson(out_path, s_results, s_result_count);
+    }
+
+    free(s_results);
+
+    if(has_gl)
+    {
+        dgnRendererTerminate();
+    }
+    else
+    {
+        dgnShaderTerm_internal();
+    }
+
+    if(window != NULL)
+    {
+        dgnWindowDestroy(window);
+    }
+    dgnEngineTerminate();
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,72 @@
+#include "../src/d_internal.h"
+#include "../src/DGNEngine/DGNEngine.h"
+#include "bench.h"
+
+#include <assimp/cimport.h>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <stdio.h>
+
+// the flags dgnMeshLoad imports with
+#define IMPORT_FLAGS (aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_FlipUVs | aiProcess_CalcTangentSpace)
+
+static const char *s_models[] =
+{
+    "cube",
+    "ball",
+    "person",
+    "test_level_1"
+};
+
+// converts every mesh of an already imported scene, uploads included
+static void convertInternal(uint64_t iterations, void *user_data)
+{
+    const struct aiScene *scene = user_data;
+
+    for(uint64_t n = 0; n < iterations; n++)
+    {
+        for(uint32_t i = 0; i < scene->mNumMeshes; i++)
+        {
+            DgnMesh *mesh = aiMeshConvert(scene->mMeshes[i], NULL);
+            dgnMeshDestroy(mesh);
+        }
+    }
+}
+
+// the whole dgnMeshLoad, with assimp reading and processing the file
+static void loadInternal(uint64_t iterations, void *user_data)
+{
+    const char *filepath = user_data;
+
+    for(uint64_t n = 0; n < iterations; n++)
+    {
+        uint16_t count;
+        DgnMesh **meshes = dgnMeshLoad(filepath, &count);
+        dgnMeshDestroyArr(meshes, count);
+    }
+}
+
+void benchMesh()
+{
+    for(uint32_t i = 0; i < sizeof(s_models) / sizeof(*s_models); i++)
+    {
+        char path[128];
+        snprintf(path, sizeof(path), "res/Game/%s.obj", s_models[i]);
+
+        const struct aiScene *scene = aiImportFile(path, IMPORT_FLAGS);
+        if(scene == NULL)
+        {
+            benchSkip("mesh", s_models[i], "could not import, run from the repository root");
+            continue;
+        }
+
+        char name[64];
+        snprintf(name, sizeof(name), "convert %s", s_models[i]);
+        benchRun("mesh", name, convertInternal, (void*)scene);
+
+        snprintf(name, sizeof(name), "load %s", s_models[i]);
+        benchRun("mesh", name, loadInternal, path);
+
+        aiReleaseImport(scene);
+    }
+}
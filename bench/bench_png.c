@@ -0,0 +1,60 @@
+#include "../src/lodepng.h"
+#include "bench.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+static const char *s_textures[] =
+{
+    "checker1",
+    "checker2",
+    "checker3",
+    "checker4",
+    "checker5",
+    "toonMap1",
+    "toonMap2"
+};
+
+typedef struct
+{
+    unsigned char *file;
+    size_t file_size;
+}PngInput;
+
+// decodes from memory so the disk is not part of the timing
+static void decodeInternal(uint64_t iterations, void *user_data)
+{
+    PngInput *in = user_data;
+
+    for(uint64_t n = 0; n < iterations; n++)
+    {
+        unsigned char *image = NULL;
+        unsigned width, height;
+
+        lodepng_decode32(&image, &width, &height, in->file, in->file_size);
+        BENCH_KEEP(image);
+        free(image);
+    }
+}
+
+void benchPng()
+{
+    for(uint32_t i = 0; i < sizeof(s_textures) / sizeof(*s_textures); i++)
+    {
+        char path[128];
+        snprintf(path, sizeof(path), "res/Game/%s.png", s_textures[i]);
+
+        PngInput in = {NULL, 0};
+        if(lodepng_load_file(&in.file, &in.file_size, path) != 0)
+        {
+            benchSkip("png", s_textures[i], "could not read the file, run from the repository root");
+            continue;
+        }
+
+        char name[64];
+        snprintf(name, sizeof(name), "decode %s", s_textures[i]);
+        benchRun("png", name, decodeInternal, &in);
+
+        free(in.file);
+    }
+}
@@ -0,0 +1,213 @@
+#include "bench.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define LINE_LENGTH 512
+
+// a change is only trusted once it is this many deviations of both runs past the baseline
+#define NOISE_DEVIATIONS 3.0
+
+/** ---- Json ---- **/
+
+// one benchmark per line, so the reader below never needs a real json parser
+uint8_t benchWriteJson(const char *filepath, const BenchResult *results, uint32_t count)
+{
+    FILE *file = fopen(filepath, "w");
+
+    if(file == NULL)
+    {
+        printf("could not write %s\n", filepath);
+        return 0;
+    }
+
+#ifdef __DEBUG
+    fprintf(file, "{\n\"debug\": true,\n\"benchmarks\": [\n");
+#else
+    fprintf(file, "{\n\"debug\": false,\n\"benchmarks\": [\n");
+#endif // __DEBUG
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        const BenchResult *r = &results[i];
+        fprintf(file, "{\"name\": \"%s\", \"iterations\": %llu, \"samples\": %u, \"median_ns\": %.3f, "
+                      "\"min_ns\": %.3f, \"max_ns\": %.3f, \"mad_ns\": %.3f}%s\n",
+                r->name, (unsigned long long)r->iterations, r->samples, r->median_ns,
+                r->min_ns, r->max_ns, r->mad_ns, i + 1 < count ? "," : "");
+    }
+
+    fprintf(file, "]\n}\n");
+
+    uint8_t ok = !ferror(file);
+    fclose(file);
+
+    return ok;
+}
+
+static uint8_t readNumberInternal(const char *line, const char *key, double *out_value)
+{
+    const char *found = strstr(line, key);
+
+    if(found == NULL) return 0;
+
+    *out_value = strtod(found + strlen(key), NULL);
+    return 1;
+}
+
+uint32_t benchReadJson(const char *filepath, BenchResult **out_results, uint8_t *out_debug)
+{
+    FILE *file = fopen(filepath, "r");
+
+    if(file == NULL)
+    {
+        printf("could not read %s\n", filepath);
+        return 0xFFFFFFFF;
+    }
+
+    char line[LINE_LENGTH];
+    BenchResult *results = NULL;
+    uint32_t count = 0;
+    uint32_t capacity = 0;
+
+    *out_debug = 0;
+
+    while(fgets(line, LINE_LENGTH, file) != NULL)
+    {
+        if(strstr(line, "\"debug\": true") != NULL)
+        {
+            *out_debug = 1;
+        }
+
+        const char *name = strstr(line, "\"name\": \"");
+        if(name == NULL) continue;
+
+        name += strlen("\"name\": \"");
+        const char *name_end = strchr(name, '"');
+        if(name_end == NULL) continue;
+
+        if(count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+            results = realloc(results, sizeof(*results) * capacity);
+        }
+
+        BenchResult *r = &results[count];
+        memset(r, 0, sizeof(*r));
+
+        size_t name_length = name_end - name;
+        if(name_length >= sizeof(r->name))
+        {
+            name_length = sizeof(r->name) - 1;
+        }
+        memcpy(r->name, name, name_length);
+
+        double iterations = 0.0;
+        double samples = 0.0;
+        readNumberInternal(line, "\"iterations\": ", &iterations);
+        readNumberInternal(line, "\"samples\": ", &samples);
+        r->iterations = (uint64_t)iterations;
+        r->samples = (uint32_t)samples;
+
+        if(!readNumberInternal(line, "\"median_ns\": ", &r->median_ns)) continue;
+        readNumberInternal(line, "\"min_ns\": ", &r->min_ns);
+        readNumberInternal(line, "\"max_ns\": ", &r->max_ns);
+        readNumberInternal(line, "\"mad_ns\": ", &r->mad_ns);
+
+        count++;
+    }
+
+    fclose(file);
+
+    *out_results = results;
+    return count;
+}
+
+/** ---- Compare ---- **/
+
+static const BenchResult *findResultInternal(const BenchResult *results, uint32_t count, const char *name)
+{
+    for(uint32_t i = 0; i < count; i++)
+    {
+        if(strcmp(results[i].name, name) == 0)
+        {
+            return &results[i];
+        }
+    }
+
+    return NULL;
+}
+
+uint32_t benchCompare(const char *baseline_path, const char *current_path, double threshold_percent)
+{
+    BenchResult *baseline = NULL;
+    BenchResult *current = NULL;
+    uint8_t baseline_debug;
+    uint8_t current_debug;
+
+    uint32_t baseline_count = benchReadJson(baseline_path, &baseline, &baseline_debug);
+    uint32_t current_count = benchReadJson(current_path, &current, &current_debug);
+
+    if(baseline_count == 0xFFFFFFFF || current_count == 0xFFFFFFFF)
+    {
+        free(baseline);
+        free(current);
+        return 0xFFFFFFFF;
+    }
+
+    if(baseline_debug != current_debug)
+    {
+        printf("warning: comparing a debug build against a release build\n");
+    }
+
+    uint32_t regressions = 0;
+    uint32_t improvements = 0;
+    double limit = 1.0 + threshold_percent / 100.0;
+
+    printf("%-48s %14s %14s %9s\n", "benchmark", "baseline ns", "current ns", "change");
+
+    for(uint32_t i = 0; i < current_count; i++)
+    {
+        const BenchResult *cur = &current[i];
+        const BenchResult *base = findResultInternal(baseline, baseline_count, cur->name);
+
+        if(base == NULL)
+        {
+            printf("%-48s %14s %14.1f %9s  new\n", cur->name, "-", cur->median_ns, "");
+            continue;
+        }
+
+        double change = base->median_ns > 0.0 ? (cur->median_ns / base->median_ns - 1.0) * 100.0 : 0.0;
+        double noise = NOISE_DEVIATIONS * (base->mad_ns + cur->mad_ns);
+        const char *status = "";
+
+        // both the relative threshold and the noise of the two runs have to be exceeded
+        if(cur->median_ns > base->median_ns * limit && cur->median_ns - base->median_ns > noise)
+        {
+            status = "  REGRESSION";
+            regressions++;
+        }
+        else if(base->median_ns > cur->median_ns * limit && base->median_ns - cur->median_ns > noise)
+        {
+            status = "  faster";
+            improvements++;
+        }
+
+        printf("%-48s %14.1f %14.1f %+8.1f%%%s\n", cur->name, base->median_ns, cur->median_ns, change, status);
+    }
+
+    for(uint32_t i = 0; i < baseline_count; i++)
+    {
+        if(findResultInternal(current, current_count, baseline[i].name) == NULL)
+        {
+            printf("%-48s %14.1f %14s %9s  missing\n", baseline[i].name, baseline[i].median_ns, "-", "");
+        }
+    }
+
+    printf("%u regressions, %u improvements past %.1f%%\n", regressions, improvements, threshold_percent);
+
+    free(baseline);
+    free(current);
+
+    return regressions;
+}
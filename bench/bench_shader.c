@@ -0,0 +1,53 @@
+#include "../src/d_internal.h"
+#include "../src/DGNEngine/DGNEngine.h"
+#include "bench.h"
+
+#include <MemLeaker/malloc.h>
+#include <stdio.h>
+#include <string.h>
+
+// lit.frag pulls in the std includes, the others are single files of different sizes
+static const char *s_shaders[] =
+{
+    "res/Game/lit.vert",
+    "res/Game/lit.frag",
+    "res/Game/shadow.vert",
+    "res/Game/skybox.frag",
+    "res/Game/water.frag"
+};
+
+static void preprocessInternal(uint64_t iterations, void *user_data)
+{
+    const char *filepath = user_data;
+
+    for(uint64_t n = 0; n < iterations; n++)
+    {
+        char *source = NULL;
+        uint32_t length = fileToString(&source, filepath);
+        BENCH_KEEP(length);
+        free(source);
+    }
+}
+
+void benchShader()
+{
+    for(uint32_t i = 0; i < sizeof(s_shaders) / sizeof(*s_shaders); i++)
+    {
+        const char *filepath = s_shaders[i];
+        const char *name = strrchr(filepath, '/') + 1;
+
+        // a file that fails would only time the error path
+        char *source = NULL;
+        if(fileToString(&source, filepath) == 0xFFFFFFFF)
+        {
+            free(source);
+            benchSkip("shader", name, "could not preprocess, run from the repository root");
+            continue;
+        }
+        free(source);
+
+        char bench_name[64];
+        snprintf(bench_name, sizeof(bench_name), "preprocess %s", name);
+        benchRun("shader", bench_name, preprocessInternal, (void*)filepath);
+    }
+}
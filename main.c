@@ -4,42 +4,317 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <float.h>
 
 #define ASSERT_RETURN(x) if(!(x)) return 1
 
-#define GAMEPAD_CONTROLS DGN_TRUE
-
 #define WINDOW_WIDTH 1000
 #define WINDOW_HEIGHT 680
 
 #define CASCADE_COUNT 3
-#define SHADOW_SIZE 1024
+#define SHADOW_SIZE 512
+#define SHADOW_ATLAS_SIZE 2048
+#define SHADOW_ATLAS_MIN_TILE 128
+#define SHADOW_EVSM DGN_TRUE
+#define EVSM_BLUR_RADIUS 3
 #define SHADOW_FAR 33.0f
 #define SHADOW_NEAR 0.1f
 #define CASCADE_SPLIT_BLEND 0.5f
+#define CASCADE_FIT (DGN_CASCADE_FIT_AABB | DGN_CASCADE_FIT_CLAMP_Z)
+
+#define TARGET_SCENE_TIME (1.0 / 60.0)
+#define MIN_RENDER_SCALE 0.5f
+
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define MAX_POINT_LIGHTS 1024
+#define POINT_LIGHT_COUNT 64
+#define LIGHT_TEX_SLOT 24
+
+#define MAX_SCENE_TRANSFORMS 256
+
+#define TICK_DELTA (1.0 / 120.0)
+#define MAX_SUBSTEPS 8
+#define FRAME_LIMIT (1.0 / 240.0)
+
+#define REVERSED_Z DGN_TRUE
+
+// double buffered, the next update runs while the last one is drawn
+#define RENDER_PACKETS 2
+#define RENDER_PACKET_BYTES (64 * 1024)
+// keeps the debug mode the renderer picked
+#define GL_DEBUG_DEFAULT 0xFF
+
+// textures decode off the main thread and upload at most this much per frame
+#define TEXTURE_DECODE_THREADS 2
+#define TEXTURE_UPLOAD_BUDGET (2 * 1024 * 1024)
+#define TEXTURE_USE_PBO DGN_TRUE
+
+// replays step every frame by this, so timings of the same recording compare
+#define REPLAY_DELTA (1.0 / 60.0)
 
 #include "src/c_ordered_map.h"
 #include "src/c_linked_list.h"
 
-void updateCamera(DgnCamera *camera, DgnWindow *window, uint8_t controller);
+typedef struct
+{
+    DgnInputMap *map;
+    uint16_t move_x;
+    uint16_t move_z;
+    uint16_t look_x;
+    uint16_t look_y;
+    uint16_t mouse_look_x;
+    uint16_t mouse_look_y;
+    uint16_t toggle_cursor;
+    uint16_t jump;
+}Controls;
+
+// everything one update hands to the renderer, copied into a packet so the next update can run alongside the draw
+typedef struct
+{
+    DgnCamera camera;
+    Vec3 sun_dir;
+
+    Mat4x4 ball_transform;
+    Vec3 ball_pos;
+    float ball_radius;
+    // where the ball was and is drawn, when it moved
+    uint8_t ball_moved;
+    DgnBoundingBox ball_boxes[2];
+
+    DgnLight point_lights[POINT_LIGHT_COUNT];
+
+    uint8_t show_frame_stats;
+    uint8_t reload_lit_shader;
+}FrameState;
+
+// gl resources and the state kept between frames, only the render thread touches these while the game runs
+typedef struct
+{
+    DgnWindow *window;
+    uint8_t reversed_z;
+    uint16_t scene_depth_test;
+
+    DgnShadowAtlas *shadow_atlas;
+    DgnEvsm *shadow_evsm;
+    DgnShadowMap shadow_cascades[CASCADE_COUNT];
+    uint8_t cascade_placed[CASCADE_COUNT];
+    DgnShadowCache *shadow_cache;
+    float cascade_depths[CASCADE_COUNT + 1];
+
+    DgnTexture *screen_texture;
+    DgnFramebuffer *screen_framebuffer;
+    DgnDynamicResolution *dyn_res;
+    DgnLightClusters *light_clusters;
+
+    uint16_t level_mesh_count;
+    DgnMesh **level_mesh;
+    DgnMesh **ball_mesh;
+    DgnBoundingBox level_bounds;
+    // the level's meshes then the ball, what the cascade splits are fitted to
+    DgnBoundingSphere *shadow_receivers;
+    uint16_t shadow_receiver_count;
+
+    DgnTextureStreamer *texture_streamer;
+    DgnTexture *skybox_texture;
+    DgnTexture *checker_textures[4];
+    DgnTexture *ball_texture;
+
+    DgnShader *skybox_shader;
+    DgnShader *lit_shader;
+    DgnShader *screen_shader;
+    DgnShader *shadow_shader;
+    DgnShader *evsm_shader;
+    DgnShader *color_shader;
+    DgnShader *line_shader;
+
+    int skybox_u_vp;
+    int skybox_u_sun_dir;
+    int skybox_u_far_depth;
+
+    int lit_u_texture;
+    int lit_u_has_texture;
+    int lit_u_skybox;
+    int lit_u_light_dir;
+    int lit_u_cam_pos;
+    int lit_u_specular;
+    int lit_u_refl_shine;
+    int lit_u_metalness;
+    int lit_u_shadow_atlas;
+    int lit_u_shadow_moments;
+    int lit_u_use_evsm;
+    int lit_u_cluster_grid;
+    int lit_u_cluster_indices;
+    int lit_u_cluster_lights;
+    int lit_u_cluster_screen;
+    int lit_u_cluster_depth;
+    int lit_u_light_mat[CASCADE_COUNT];
+    int lit_u_shadow_rect[CASCADE_COUNT];
+    int lit_u_cascade_ends[CASCADE_COUNT];
+
+    int screen_u_scale;
+    int screen_u_offset;
+    int screen_u_single;
+    int screen_u_tex_scale;
+
+    int shadow_u_model;
+    int shadow_u_light;
+
+    int evsm_u_model;
+    int evsm_u_light;
+
+    int color_u_color;
+    int color_u_mvp;
+
+    int line_u_color;
+    int line_u_vp;
+    int line_u_pos1;
+    int line_u_pos2;
+}Scene;
+
+void renderFrame(void *data, void *user_data);
+void updateCamera(DgnCamera *camera, DgnWindow *window, Controls *controls);
+void growBounds(DgnBoundingBox *box, Vec3 center, float radius);
+void printUsage(const char *program);
 
 int main(int argc, char* argv[])
 {
+    // --headless renders offscreen, --frames <n> closes after n frames
+    // --no-render-thread runs every packet on submit, for comparing against the overlapped frame
+    // --profile <file> times scopes from the start and writes them as a Chrome trace on exit
+    // --gl-debug <get-error|sampled|sync|async|off> picks how debug builds catch gl errors
+    // --load-report times every asset load stage until the streamed textures are resident and prints where startup went
+    uint8_t headless = DGN_FALSE;
+    uint8_t load_report = DGN_FALSE;
+    uint64_t max_frames = 0;
+    uint8_t render_packets = RENDER_PACKETS;
+    const char *profile_path = NULL;
+    uint8_t gl_debug = GL_DEBUG_DEFAULT;
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--headless") == 0)
+        {
+            headless = DGN_TRUE;
+        }
+        else if(strcmp(argv[i], "--no-render-thread") == 0)
+        {
+            render_packets = 1;
+        }
+        else if(strcmp(argv[i], "--load-report") == 0)
+        {
+            load_report = DGN_TRUE;
+        }
+        else if(strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+            max_frames = strtoull(argv[++i], NULL, 10);
+        }
+        else if(strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+        {
+            profile_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "--gl-debug") == 0 && i + 1 < argc)
+        {
+            const char *names[] = {"get-error", "sampled", "sync", "async", "off"};
+            const uint8_t modes[] = {DGN_GL_DEBUG_GET_ERROR, DGN_GL_DEBUG_SAMPLED, DGN_GL_DEBUG_CALLBACK_SYNC,
+                                     DGN_GL_DEBUG_CALLBACK_ASYNC, DGN_GL_DEBUG_OFF};
+            const char *name = argv[++i];
+
+            gl_debug = GL_DEBUG_DEFAULT;
+            for(int m = 0; m < 5; m++)
+            {
+                if(strcmp(name, names[m]) == 0)
+                {
+                    gl_debug = modes[m];
+                }
+            }
+
+            if(gl_debug == GL_DEBUG_DEFAULT)
+            {
+                printf("Unknown gl debug mode: %s\n", name);
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+    }
+
+    dgnProfileSetThreadName("main");
+    dgnProfileSetEnabled(profile_path != NULL);
+
+    if(load_report)
+    {
+        dgnLoadTimelineStart();
+    }
+
     DgnWindow *window = NULL;
-    dgnWindowCreate(&window, WINDOW_WIDTH, WINDOW_HEIGHT, "Platformer");
+    if(headless)
+    {
+        dgnWindowCreateHeadless(&window, WINDOW_WIDTH, WINDOW_HEIGHT, "Platformer");
+    }
+    else
+    {
+        dgnWindowCreate(&window, WINDOW_WIDTH, WINDOW_HEIGHT, "Platformer");
+    }
     ASSERT_RETURN(window != NULL);
     dgnWindowMakeCurrent(window);
 
     dgnRendererInitialize();
+
+    if(gl_debug != GL_DEBUG_DEFAULT)
+    {
+        dgnRendererSetDebugMode(gl_debug, DGN_GL_DEBUG_SAMPLE_INTERVAL);
+    }
     dgnRendererEnableFlag(DGN_RENDER_FLAG_DEPTH_TEST);
     dgnRendererEnableFlag(DGN_RENDER_FLAG_CULL_FACE);
     dgnRendererEnableFlag(DGN_RENDER_FLAG_SEAMLESS_CUBEMAP);
 
+    Scene scene = {0};
+    scene.window = window;
+
     /** ---------------- GAME SETUP ---------------- **/
 
+    /** -------- CONTROLS -------- **/
+
+    Controls controls;
+    ASSERT_RETURN(controls.map = dgnInputMapLoad("res/Game/controls.bind"));
+    controls.move_x        = dgnInputMapGetAction(controls.map, "move_x");
+    controls.move_z        = dgnInputMapGetAction(controls.map, "move_z");
+    controls.look_x        = dgnInputMapGetAction(controls.map, "look_x");
+    controls.look_y        = dgnInputMapGetAction(controls.map, "look_y");
+    controls.mouse_look_x  = dgnInputMapGetAction(controls.map, "mouse_look_x");
+    controls.mouse_look_y  = dgnInputMapGetAction(controls.map, "mouse_look_y");
+    controls.toggle_cursor = dgnInputMapGetAction(controls.map, "toggle_cursor");
+    controls.jump          = dgnInputMapGetAction(controls.map, "jump");
+
+    // --record <file> saves this session, --replay <file> plays one back instead of live input
+    // --frame-stats <file> writes the frame time history as json on exit
+    uint8_t replaying = DGN_FALSE;
+    const char *frame_stats_path = NULL;
+    for(int i = 1; i + 1 < argc; i++)
+    {
+        if(strcmp(argv[i], "--record") == 0)
+        {
+            dgnInputRecordStart(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--replay") == 0)
+        {
+            replaying = dgnInputReplayStart(argv[++i], REPLAY_DELTA);
+        }
+        else if(strcmp(argv[i], "--frame-stats") == 0)
+        {
+            frame_stats_path = argv[++i];
+        }
+    }
+
+    /** -------- FRAME STATS -------- **/
+
+    // F3 shows the frame time graph, frames over twice the budget count as hitches
+    dgnWindowSetFrameBudget(window, TARGET_SCENE_TIME);
+
     /** -------- CAMERA -------- **/
 
     DgnCamera camera;
+    dgnCameraInit(&camera);
     camera.frustum.far    = 100;
     camera.frustum.near   = 0.1;
     camera.frustum.fov          = 90 * TO_RADS;
@@ -48,39 +323,75 @@ int main(int argc, char* argv[])
     camera.pos                  = (Vec3){0.0f, 1.0f, 3.0f};
     camera.rot                  = (Quat){0.0f, 0.0f, 0.0f, 1.0f};
 
+    // falls back to the standard projection when clip control is missing
+    scene.reversed_z = REVERSED_Z && dgnRendererSetReversedZ(DGN_FALSE);
+    camera.projection = scene.reversed_z ? DGN_PROJECTION_REVERSED_Z_INFINITE : DGN_PROJECTION_STANDARD;
+    scene.scene_depth_test = scene.reversed_z ? DGN_DEPTH_PASS_GREATER : DGN_DEPTH_PASS_LESS;
+
     /** -------- SHADOW CASCADES -------- **/
 
-    DgnShadowMap shadow_cascades[CASCADE_COUNT];
+    // every cascade draws into its own area of one shared depth texture
+    scene.shadow_atlas = dgnShadowAtlasCreate(SHADOW_ATLAS_SIZE, SHADOW_ATLAS_MIN_TILE);
+    ASSERT_RETURN(scene.shadow_atlas != NULL);
 
-    for(int i = 0; i < CASCADE_COUNT; i++)
+    // filterable moments in the same layout as the atlas, sampled once per cascade
+    if(SHADOW_EVSM)
     {
-        uint8_t att = DGN_FRAMEBUFFER_DEPTH;
-        DgnTexture *map = dgnLightingCreateShadowMap(SHADOW_SIZE, SHADOW_SIZE, DGN_LIGHT_TYPE_DIR);
-        shadow_cascades[i].texture = map;
-        shadow_cascades[i].framebuffer = dgnFramebufferCreate(&map, &att, 1, DGN_FRAMEBUFFER_DEPTH);
-        shadow_cascades[i].proj_mat = m3dMat4x4InitIdentity();
-        shadow_cascades[i].view_mat = m3dMat4x4InitIdentity();
+        ASSERT_RETURN(scene.shadow_evsm = dgnEvsmCreate(SHADOW_ATLAS_SIZE));
     }
 
-    int cascade_depths_count = CASCADE_COUNT + 1;
-    float cascade_depths[cascade_depths_count];
-
-    for(int i = 0; i < cascade_depths_count; i++)
+    for(int i = 0; i < CASCADE_COUNT; i++)
     {
-        float ioverm = (float)i / (float)CASCADE_COUNT;
-        float dist_uni = SHADOW_NEAR + (SHADOW_FAR - SHADOW_NEAR) * ioverm;
-        float dist_log = SHADOW_NEAR * pow(SHADOW_FAR / SHADOW_NEAR, ioverm);
-
-        cascade_depths[i] = m3d1DLerp(dist_log, dist_uni, CASCADE_SPLIT_BLEND);
+        scene.shadow_cascades[i].texture = dgnShadowAtlasGetTexture(scene.shadow_atlas);
+        scene.shadow_cascades[i].framebuffer = NULL;
+        scene.shadow_cascades[i].x = 0;
+        scene.shadow_cascades[i].y = 0;
+        scene.shadow_cascades[i].width = 0;
+        scene.shadow_cascades[i].height = 0;
+        scene.shadow_cascades[i].proj_mat = m3dMat4x4InitIdentity();
+        scene.shadow_cascades[i].view_mat = m3dMat4x4InitIdentity();
+        scene.cascade_placed[i] = DGN_FALSE;
     }
 
+    // cascades are only redrawn when their snapped matrix changes or a caster inside them moves
+    scene.shadow_cache = dgnShadowCacheCreate(CASCADE_COUNT);
+    ASSERT_RETURN(scene.shadow_cache != NULL);
+    dgnShadowCacheSetInterval(scene.shadow_cache, CASCADE_COUNT - 1, 2);
+
+    dgnLightingComputeCascadeSplits(scene.cascade_depths, CASCADE_COUNT, SHADOW_NEAR, SHADOW_FAR, CASCADE_SPLIT_BLEND);
+
     /** -------- SCREEN FRAMEBUFFER -------- **/
 
     uint8_t screen_attachement = DGN_FRAMEBUFFER_COLOR;
-    DgnTexture *screen_texture = dgnTextureCreate(NULL, WINDOW_WIDTH, WINDOW_HEIGHT, DGN_TEX_WRAP_CLAMP_TO_EDGE,
+    scene.screen_texture = dgnTextureCreate(NULL, WINDOW_WIDTH, WINDOW_HEIGHT, DGN_TEX_WRAP_CLAMP_TO_EDGE,
                                                   DGN_TEX_FILTER_BILINEAR, DGN_FALSE, DGN_TEX_STORAGE_RGBA, DGN_TEX_STORAGE_RGBA16F,
                                                   DGN_DATA_TYPE_FLOAT);
-    DgnFramebuffer *screen_framebuffer = dgnFramebufferCreate(&screen_texture, &screen_attachement, 1, DGN_FRAMEBUFFER_DEPTH);
+    scene.screen_framebuffer = dgnFramebufferCreate(&scene.screen_texture, &screen_attachement, 1,
+                                                              DGN_FRAMEBUFFER_DEPTH | (scene.reversed_z ? DGN_FRAMEBUFFER_DEPTH_FLOAT : 0));
+
+    // the scene is drawn into the corner of screen_texture, scaled to hold the frame time
+    scene.dyn_res = dgnDynamicResolutionCreate(WINDOW_WIDTH, WINDOW_HEIGHT, TARGET_SCENE_TIME, MIN_RENDER_SCALE, 1.0f);
+
+    /** -------- POINT LIGHTS -------- **/
+
+    scene.light_clusters = dgnLightClustersCreate(CLUSTER_X, CLUSTER_Y, CLUSTER_Z, MAX_POINT_LIGHTS);
+    ASSERT_RETURN(scene.light_clusters != NULL);
+
+    DgnLight point_lights[POINT_LIGHT_COUNT];
+
+    for(int i = 0; i < POINT_LIGHT_COUNT; i++)
+    {
+        float t = (float)i / POINT_LIGHT_COUNT;
+
+        point_lights[i].type = DGN_LIGHT_TYPE_POINT;
+        point_lights[i].color = (Vec3){0.5f + 0.5f * cosf(t * 2 * PI),
+                                       0.5f + 0.5f * cosf((t + 0.33f) * 2 * PI),
+                                       0.5f + 0.5f * cosf((t + 0.67f) * 2 * PI)};
+        point_lights[i].direction = (Vec3){0.0f, -1.0f, 0.0f};
+        point_lights[i].range = 2.5f;
+        point_lights[i].inner_angle = 0.0f;
+        point_lights[i].outer_angle = 0.0f;
+    }
 
     /** -------- ASSETS -------- **/
 
@@ -94,60 +405,54 @@ int main(int argc, char* argv[])
         "res/game/skyboxday/front.png"
     };
 
-    uint16_t level_mesh_count = 0;
-    DgnMesh **level_mesh = NULL;
-    DgnMesh **ball_mesh = NULL;
-
-    DgnTexture *skybox_texture = NULL;
-    DgnTexture *checker_textures[4] = {NULL, NULL, NULL, NULL};
-    DgnTexture *ball_texture = NULL;
-
-    DgnShader *skybox_shader = NULL;
-    DgnShader *lit_shader = NULL;
-    DgnShader *screen_shader = NULL;
-    DgnShader *shadow_shader = NULL;
-    DgnShader *color_shader = NULL;
-    DgnShader *line_shader = NULL;
-
     dgnShaderSetEconstI("NUM_CASCADES", CASCADE_COUNT);
-
-    ASSERT_RETURN(level_mesh = dgnMeshLoad("res/game/test_level_1.obj", &level_mesh_count));
-    ASSERT_RETURN(ball_mesh = dgnMeshLoad("res/game/ball.obj", NULL));
-    //ASSERT_RETURN(ball_mesh = dgnMeshLoad("res/monkey.obj", NULL));
-
-    ASSERT_RETURN(skybox_texture = dgnCubemapLoad(skybox_locations, DGN_TEX_WRAP_REPEAT, DGN_TEX_FILTER_TRILINEAR, DGN_TEX_STORAGE_SRGB));
-    ASSERT_RETURN(checker_textures[0] = dgnTextureLoad("res/game/checker1.png", DGN_TEX_WRAP_REPEAT, DGN_TEX_FILTER_TRILINEAR, DGN_TRUE, DGN_TEX_STORAGE_SRGB));
-    ASSERT_RETURN(checker_textures[1] = dgnTextureLoad("res/game/checker2.png", DGN_TEX_WRAP_REPEAT, DGN_TEX_FILTER_TRILINEAR, DGN_TRUE, DGN_TEX_STORAGE_SRGB));
-    ASSERT_RETURN(checker_textures[2] = dgnTextureLoad("res/game/checker3.png", DGN_TEX_WRAP_REPEAT, DGN_TEX_FILTER_TRILINEAR, DGN_TRUE, DGN_TEX_STORAGE_SRGB));
-    ASSERT_RETURN(checker_textures[3] = dgnTextureLoad("res/game/checker4.png", DGN_TEX_WRAP_REPEAT, DGN_TEX_FILTER_TRILINEAR, DGN_TRUE, DGN_TEX_STORAGE_SRGB));
-    ASSERT_RETURN(ball_texture = dgnTextureLoad("res/game/checker5.png", DGN_TEX_WRAP_REPEAT, DGN_TEX_FILTER_TRILINEAR, DGN_TRUE, DGN_TEX_STORAGE_SRGB));
-
-    ASSERT_RETURN(skybox_shader = dgnShaderLoad("res/game/skybox.vert", 0, "res/game/skybox.frag"));
-    //ASSERT_RETURN(lit_shader = dgnShaderLoad("res/game/shadow_viewer.vert", 0, "res/game/shadow_viewer.frag"));
-    ASSERT_RETURN(lit_shader = dgnShaderLoad("res/game/lit.vert", 0, "res/game/lit.frag"));
-    ASSERT_RETURN(screen_shader = dgnShaderLoad("res/game/screen.vert", 0, "res/game/screen.frag"));
-    ASSERT_RETURN(shadow_shader = dgnShaderLoad("res/game/shadow.vert", 0, 0));
-    ASSERT_RETURN(color_shader = dgnShaderLoad("res/game/wireframe.vert", 0, "res/game/wireframe.frag"));
-    ASSERT_RETURN(line_shader = dgnShaderLoad("res/game/line.vert", 0, "res/game/wireframe.frag"));
-
-    int skybox_u_vp = dgnShaderGetUniformLoc(skybox_shader, "uVP");
-    int skybox_u_sun_dir = dgnShaderGetUniformLoc(skybox_shader, "uSunDir");
-
-    int lit_u_model = dgnShaderGetUniformLoc(lit_shader, "uModel");
-    int lit_u_view = dgnShaderGetUniformLoc(lit_shader, "uView");
-    int lit_u_projection = dgnShaderGetUniformLoc(lit_shader, "uProjection");
-    int lit_u_texture = dgnShaderGetUniformLoc(lit_shader, "uTexture");
-    int lit_u_has_texture = dgnShaderGetUniformLoc(lit_shader, "uHasTexture");
-    int lit_u_skybox = dgnShaderGetUniformLoc(lit_shader, "uSkybox");
-    int lit_u_light_dir = dgnShaderGetUniformLoc(lit_shader, "uLightDir");
-    int lit_u_cam_pos = dgnShaderGetUniformLoc(lit_shader, "uCamPos");
-    int lit_u_specular = dgnShaderGetUniformLoc(lit_shader, "uShininess");
-    int lit_u_refl_shine = dgnShaderGetUniformLoc(lit_shader, "uReflectShininess");
-    int lit_u_metalness = dgnShaderGetUniformLoc(lit_shader, "uMetalness");
-
-    int lit_u_light_mat[CASCADE_COUNT];
-    int lit_u_shadow_map[CASCADE_COUNT];
-    int lit_u_cascade_ends[CASCADE_COUNT];
+    dgnShaderSetEconstI("CLUSTER_X", CLUSTER_X);
+    dgnShaderSetEconstI("CLUSTER_Y", CLUSTER_Y);
+    dgnShaderSetEconstI("CLUSTER_Z", CLUSTER_Z);
+
+    ASSERT_RETURN(scene.level_mesh = dgnMeshLoad("res/game/test_level_1.obj", &scene.level_mesh_count));
+    ASSERT_RETURN(scene.ball_mesh = dgnMeshLoad("res/game/ball.obj", NULL));
+    //ASSERT_RETURN(scene.ball_mesh = dgnMeshLoad("res/monkey.obj", NULL));
+
+    // the textures show placeholders until the render thread has uploaded them
+    DgnTextureStreamer *streamer;
+    ASSERT_RETURN(streamer = scene.texture_streamer = dgnTextureStreamerCreate(TEXTURE_DECODE_THREADS, TEXTURE_UPLOAD_BUDGET, TEXTURE_USE_PBO));
+    ASSERT_RETURN(scene.skybox_texture = dgnTextureStreamerLoadCubemap(streamer, skybox_locations, DGN_TEX_WRAP_REPEAT, DGN_TEX_FILTER_TRILINEAR, DGN_TEX_STORAGE_SRGB));
+    ASSERT_RETURN(scene.checker_textures[0] = dgnTextureStreamerLoad(streamer, "res/game/checker1.png", DGN_TEX_WRAP_REPEAT, DGN_TEX_FILTER_TRILINEAR, DGN_TRUE, DGN_TEX_STORAGE_SRGB));
+    ASSERT_RETURN(scene.checker_textures[1] = dgnTextureStreamerLoad(streamer, "res/game/checker2.png", DGN_TEX_WRAP_REPEAT, DGN_TEX_FILTER_TRILINEAR, DGN_TRUE, DGN_TEX_STORAGE_SRGB));
+    ASSERT_RETURN(scene.checker_textures[2] = dgnTextureStreamerLoad(streamer, "res/game/checker3.png", DGN_TEX_WRAP_REPEAT, DGN_TEX_FILTER_TRILINEAR, DGN_TRUE, DGN_TEX_STORAGE_SRGB));
+    ASSERT_RETURN(scene.checker_textures[3] = dgnTextureStreamerLoad(streamer, "res/game/checker4.png", DGN_TEX_WRAP_REPEAT, DGN_TEX_FILTER_TRILINEAR, DGN_TRUE, DGN_TEX_STORAGE_SRGB));
+    ASSERT_RETURN(scene.ball_texture = dgnTextureStreamerLoad(streamer, "res/game/checker5.png", DGN_TEX_WRAP_REPEAT, DGN_TEX_FILTER_TRILINEAR, DGN_TRUE, DGN_TEX_STORAGE_SRGB));
+
+    ASSERT_RETURN(scene.skybox_shader = dgnShaderLoad("res/game/skybox.vert", 0, "res/game/skybox.frag"));
+    //ASSERT_RETURN(scene.lit_shader = dgnShaderLoad("res/game/shadow_viewer.vert", 0, "res/game/shadow_viewer.frag"));
+    ASSERT_RETURN(scene.lit_shader = dgnShaderLoad("res/game/lit.vert", 0, "res/game/lit.frag"));
+    ASSERT_RETURN(scene.screen_shader = dgnShaderLoad("res/game/screen.vert", 0, "res/game/screen.frag"));
+    ASSERT_RETURN(scene.shadow_shader = dgnShaderLoad("res/game/shadow.vert", 0, 0));
+    ASSERT_RETURN(scene.evsm_shader = dgnShaderLoad("res/game/shadow.vert", 0, "res/std/evsm_moments.frag"));
+    ASSERT_RETURN(scene.color_shader = dgnShaderLoad("res/game/wireframe.vert", 0, "res/game/wireframe.frag"));
+    ASSERT_RETURN(scene.line_shader = dgnShaderLoad("res/game/line.vert", 0, "res/game/wireframe.frag"));
+
+    scene.skybox_u_vp = dgnShaderGetUniformLoc(scene.skybox_shader, "uVP");
+    scene.skybox_u_sun_dir = dgnShaderGetUniformLoc(scene.skybox_shader, "uSunDir");
+    scene.skybox_u_far_depth = dgnShaderGetUniformLoc(scene.skybox_shader, "uFarDepth");
+
+    scene.lit_u_texture = dgnShaderGetUniformLoc(scene.lit_shader, "uTexture");
+    scene.lit_u_has_texture = dgnShaderGetUniformLoc(scene.lit_shader, "uHasTexture");
+    scene.lit_u_skybox = dgnShaderGetUniformLoc(scene.lit_shader, "uSkybox");
+    scene.lit_u_light_dir = dgnShaderGetUniformLoc(scene.lit_shader, "uLightDir");
+    scene.lit_u_cam_pos = dgnShaderGetUniformLoc(scene.lit_shader, "uCamPos");
+    scene.lit_u_specular = dgnShaderGetUniformLoc(scene.lit_shader, "uShininess");
+    scene.lit_u_refl_shine = dgnShaderGetUniformLoc(scene.lit_shader, "uReflectShininess");
+    scene.lit_u_metalness = dgnShaderGetUniformLoc(scene.lit_shader, "uMetalness");
+    scene.lit_u_shadow_atlas = dgnShaderGetUniformLoc(scene.lit_shader, "uShadowAtlas");
+    scene.lit_u_shadow_moments = dgnShaderGetUniformLoc(scene.lit_shader, "uShadowMoments");
+    scene.lit_u_use_evsm = dgnShaderGetUniformLoc(scene.lit_shader, "uUseEvsm");
+    scene.lit_u_cluster_grid = dgnShaderGetUniformLoc(scene.lit_shader, "uClusterGrid");
+    scene.lit_u_cluster_indices = dgnShaderGetUniformLoc(scene.lit_shader, "uClusterIndices");
+    scene.lit_u_cluster_lights = dgnShaderGetUniformLoc(scene.lit_shader, "uClusterLights");
+    scene.lit_u_cluster_screen = dgnShaderGetUniformLoc(scene.lit_shader, "uClusterScreenSize");
+    scene.lit_u_cluster_depth = dgnShaderGetUniformLoc(scene.lit_shader, "uClusterDepth");
 
     for(int i = 0; i < CASCADE_COUNT; i++)
     {
@@ -156,30 +461,46 @@ int main(int argc, char* argv[])
         itoa(i, j, 10);
 
         strcat(strcat(strcpy(buff, "uLightMat["), j), "]");
-        lit_u_light_mat[i] = dgnShaderGetUniformLoc(lit_shader, buff);
+        scene.lit_u_light_mat[i] = dgnShaderGetUniformLoc(scene.lit_shader, buff);
 
-        strcat(strcat(strcpy(buff, "uShadowMap["), j), "]");
-        lit_u_shadow_map[i] = dgnShaderGetUniformLoc(lit_shader, buff);
+        strcat(strcat(strcpy(buff, "uShadowRect["), j), "]");
+        scene.lit_u_shadow_rect[i] = dgnShaderGetUniformLoc(scene.lit_shader, buff);
 
         strcat(strcat(strcpy(buff, "uCascadeEnd["), j), "]");
-        lit_u_cascade_ends[i] = dgnShaderGetUniformLoc(lit_shader, buff);
+        scene.lit_u_cascade_ends[i] = dgnShaderGetUniformLoc(scene.lit_shader, buff);
     }
 
-    int screen_u_scale = dgnShaderGetUniformLoc(screen_shader, "uScale");
-    int screen_u_offset = dgnShaderGetUniformLoc(screen_shader, "uOffset");
-    int screen_u_texture = dgnShaderGetUniformLoc(screen_shader, "uTexture");
-    int screen_u_single = dgnShaderGetUniformLoc(screen_shader, "uSingle");
+    scene.screen_u_scale = dgnShaderGetUniformLoc(scene.screen_shader, "uScale");
+    scene.screen_u_offset = dgnShaderGetUniformLoc(scene.screen_shader, "uOffset");
+    scene.screen_u_single = dgnShaderGetUniformLoc(scene.screen_shader, "uSingle");
+    scene.screen_u_tex_scale = dgnShaderGetUniformLoc(scene.screen_shader, "uTexScale");
+
+    scene.shadow_u_model = dgnShaderGetUniformLoc(scene.shadow_shader, "uModel");
+    scene.shadow_u_light = dgnShaderGetUniformLoc(scene.shadow_shader, "uLight");
 
-    int shadow_u_model = dgnShaderGetUniformLoc(shadow_shader, "uModel");
-    int shadow_u_light = dgnShaderGetUniformLoc(shadow_shader, "uLight");
+    scene.evsm_u_model = dgnShaderGetUniformLoc(scene.evsm_shader, "uModel");
+    scene.evsm_u_light = dgnShaderGetUniformLoc(scene.evsm_shader, "uLight");
 
-    int color_u_color = dgnShaderGetUniformLoc(color_shader, "uColor");
-    int color_u_mvp = dgnShaderGetUniformLoc(color_shader, "uMVP");
+    scene.color_u_color = dgnShaderGetUniformLoc(scene.color_shader, "uColor");
+    scene.color_u_mvp = dgnShaderGetUniformLoc(scene.color_shader, "uMVP");
 
-    int line_u_color = dgnShaderGetUniformLoc(line_shader, "uColor");
-    int line_u_vp = dgnShaderGetUniformLoc(line_shader, "uVP");
-    int line_u_pos1 = dgnShaderGetUniformLoc(line_shader, "uPositions[0]");
-    int line_u_pos2 = dgnShaderGetUniformLoc(line_shader, "uPositions[1]");
+    scene.line_u_color = dgnShaderGetUniformLoc(scene.line_shader, "uColor");
+    scene.line_u_vp = dgnShaderGetUniformLoc(scene.line_shader, "uVP");
+    scene.line_u_pos1 = dgnShaderGetUniformLoc(scene.line_shader, "uPositions[0]");
+    scene.line_u_pos2 = dgnShaderGetUniformLoc(scene.line_shader, "uPositions[1]");
+
+    // the level never moves, so its bounds are found once
+    scene.level_bounds = (DgnBoundingBox){{-FLT_MAX, -FLT_MAX, -FLT_MAX}, {FLT_MAX, FLT_MAX, FLT_MAX}};
+
+    scene.shadow_receiver_count = scene.level_mesh_count + 1;
+    ASSERT_RETURN(scene.shadow_receivers = malloc(sizeof(*scene.shadow_receivers) * scene.shadow_receiver_count));
+
+    for(int i = 0; i < scene.level_mesh_count; i++)
+    {
+        DgnBoundingSphere s = dgnMeshGetBoundingSphere(scene.level_mesh[i]);
+        growBounds(&scene.level_bounds, s.center, s.radius);
+        scene.shadow_receivers[i] = s;
+    }
 
     uint8_t grounded = DGN_FALSE;
     Vec3 gravity_vector = {0.0f, -9.81f, 0.0f};
@@ -187,28 +508,97 @@ int main(int argc, char* argv[])
     Vec3 ball_pos = {0.0f, 1.0f, 0.0f};
     Vec3 ball_velo = {0.0f, 10.0f, 0.0f};
 
+    DgnTransforms *scene_transforms;
+    ASSERT_RETURN(scene_transforms = dgnTransformsCreate(MAX_SCENE_TRANSFORMS));
+    uint32_t ball_node = dgnTransformsAdd(scene_transforms, DGN_TRANSFORM_NONE);
+
+    // the ball moves in fixed ticks and is drawn between the last two
+    Vec3 ball_prev_pos = ball_pos;
+    Vec3 ball_draw_pos = ball_pos;
+    uint8_t jump_queued = DGN_FALSE;
+
+    DgnLoop *loop;
+    ASSERT_RETURN(loop = dgnLoopCreate(TICK_DELTA, MAX_SUBSTEPS));
+    dgnLoopSetFrameLimit(loop, FRAME_LIMIT);
+
+    FrameState frame;
+    frame.ball_radius = 0.5f;
+    frame.show_frame_stats = DGN_FALSE;
+
+    for(int i = 0; i < POINT_LIGHT_COUNT; i++)
+    {
+        frame.point_lights[i] = point_lights[i];
+    }
+
+    // the context belongs to the render thread until it is destroyed
+    DgnRenderThread *render_thread;
+    ASSERT_RETURN(render_thread = dgnRenderThreadCreate(window, render_packets, RENDER_PACKET_BYTES));
+
     while(!dgnWindowShouldClose(window))
     {
+        dgnLoopWaitFrame(loop);
+        dgnProfileFrameMark();
+
+        // everything that was not an asset stage shows up as "other" on the critical path
+        if(load_report && dgnLoadTimelineIsRecording() && dgnTextureStreamerGetPending(scene.texture_streamer) == 0)
+        {
+            dgnLoadTimelineStop();
+            dgnLoadTimelinePrint();
+        }
+
+        uint32_t update_scope = dgnProfileBegin("update");
+
         dgnInputPollEvents();
+        if(replaying && !dgnInputIsReplaying())
+        {
+            dgnProfileEnd(update_scope);
+            break;
+        }
+        dgnInputMapUpdate(controls.map);
 
         /** ---------------- UPDATE ---------------- **/
 
-        if(dgnInputGetKeyDown(DGN_KEY_R))
+        if(dgnInputGetKeyDown(DGN_KEY_F3))
+        {
+            frame.show_frame_stats = !frame.show_frame_stats;
+        }
+
+        // F4 starts profiling, after that it prints the main thread's last frame
+        if(dgnInputGetKeyDown(DGN_KEY_F4))
         {
-            dgnShaderDestroy(lit_shader);
-            lit_shader = dgnShaderLoad("res/game/lit.vert", 0, "res/game/lit.frag");
+            if(dgnProfileIsEnabled())
+            {
+                dgnProfilePrintFrame();
+            }
+            dgnProfileSetEnabled(DGN_TRUE);
+        }
+
+        // F5 prints the gl calls of the last drawn frame next to the recent average
+        if(dgnInputGetKeyDown(DGN_KEY_F5))
+        {
+            DgnRendererStats stats;
+            dgnRendererGetStats(&stats);
+
+            printf("%-18s %12s %12s\n", "renderer", "last frame", "average");
+            for(uint8_t i = 0; i < DGN_RENDER_STAT_COUNT; i++)
+            {
+                printf("%-18s %12llu %12.1f\n", dgnRendererGetStatName(i),
+                       (unsigned long long)stats.last_frame[i], stats.average[i]);
+            }
         }
 
+        frame.reload_lit_shader = dgnInputGetKeyDown(DGN_KEY_R);
+
 
         //Vec3 sun_dir = m3dVec3Normalized(m3dQuatRotateVec3(m3dQuatAngleAxis(dgnEngineGetSeconds() / 200.0f, (Vec3){0.0f, 1.0f, 0.0f}),
         //                                 (Vec3){-1.0f, -1.0f, -1.0f}));
-        Vec3 sun_dir = m3dVec3Normalized((Vec3){-1.0f, -3.0f, -1.0f});
+        frame.sun_dir = m3dVec3Normalized((Vec3){-1.0f, -3.0f, -1.0f});
         //Vec3 sun_dir = m3dVec3Normalized((Vec3){0.0f, 0.0f, -1.0f});
 
         /** -------- Ball -------- **/
 
         DgnBoundingSphere ball_bounds;
-        ball_bounds.radius = 0.5f;
+        ball_bounds.radius = frame.ball_radius;
         DgnBoundingBox floor_bounds;
         floor_bounds.max = (Vec3){3.0f, 0.0f, 3.0f};
         floor_bounds.min = (Vec3){-3.0f, -1.0f, -3.0f};
@@ -218,335 +608,554 @@ int main(int argc, char* argv[])
         tri.p2 = (Vec3){0.0f, 0.0f, -1.0f};
         tri.p3 = (Vec3){1.0f, 0.0f, 1.0f};
 
-        if((dgnInputGetGamepadButton(DGN_GAMEPAD_1, DGN_GAMEPAD_BUTTON_CROSS) ||
-            dgnInputGetKeyDown(DGN_KEY_SPACE)) && grounded)
-        {
-            ball_velo.y = 10;
-            grounded = DGN_FALSE;
-        }
+        // a press on a frame without a tick waits for the next one
+        jump_queued |= dgnInputMapGetButtonDown(controls.map, controls.jump);
 
-        Mat4x4 ball_transform = m3dMat4x4InitIdentity();
+        uint32_t simulation_scope = dgnProfileBegin("simulation");
 
-        ball_velo = m3dVec3AddVec3(ball_velo, m3dVec3MulValue(gravity_vector, dgnWindowGetDelta(window)));
-        if(ball_velo.y < -31.0f)
+        dgnLoopBeginFrame(loop, dgnWindowGetDelta(window));
+        while(dgnLoopStep(loop))
         {
-            ball_velo.y = -31.0f;
+            float tick = (float)dgnLoopGetTickDelta(loop);
+            ball_prev_pos = ball_pos;
+
+            if(jump_queued && grounded)
+            {
+                ball_velo.y = 10;
+                grounded = DGN_FALSE;
+            }
+            jump_queued = DGN_FALSE;
+
+            ball_velo = m3dVec3AddVec3(ball_velo, m3dVec3MulValue(gravity_vector, tick));
+            if(ball_velo.y < -31.0f)
+            {
+                ball_velo.y = -31.0f;
+            }
+
+            Vec3 ball_t_pos = m3dVec3AddVec3(ball_pos, m3dVec3MulValue(ball_velo, tick));
+            ball_bounds.center = ball_t_pos;
+
+            //if(dgnCollisionBoxSphere(floor_bounds, ball_bounds).hit)
+            if(dgnCollisionTriangleSphere(tri, ball_bounds).hit)
+            {
+                ball_t_pos = ball_pos;
+                ball_velo.y = 0.0f;
+                grounded = DGN_TRUE;
+            }
+
+            ball_pos = ball_t_pos;
         }
 
-        Vec3 ball_t_pos = m3dVec3AddVec3(ball_pos, m3dVec3MulValue(ball_velo, dgnWindowGetDelta(window)));
-        ball_bounds.center = ball_t_pos;
+        dgnProfileEnd(simulation_scope);
 
-        //if(dgnCollisionBoxSphere(floor_bounds, ball_bounds).hit)
-        if(dgnCollisionTriangleSphere(tri, ball_bounds).hit)
+        Vec3 ball_lerp_pos = m3dVec3AddVec3(ball_prev_pos,
+                             m3dVec3MulValue(m3dVec3SubVec3(ball_pos, ball_prev_pos), dgnLoopGetAlpha(loop)));
+
+        // the shadow cache lives on the render side, so the boxes to invalidate travel with the frame
+        frame.ball_moved = ball_lerp_pos.x != ball_draw_pos.x || ball_lerp_pos.y != ball_draw_pos.y || ball_lerp_pos.z != ball_draw_pos.z;
+        if(frame.ball_moved)
         {
-            ball_t_pos = ball_pos;
-            ball_velo.y = 0.0f;
-            grounded = DGN_TRUE;
+            Vec3 ball_extent = {ball_bounds.radius, ball_bounds.radius, ball_bounds.radius};
+            frame.ball_boxes[0] = (DgnBoundingBox){m3dVec3AddVec3(ball_draw_pos, ball_extent), m3dVec3SubVec3(ball_draw_pos, ball_extent)};
+            frame.ball_boxes[1] = (DgnBoundingBox){m3dVec3AddVec3(ball_lerp_pos, ball_extent), m3dVec3SubVec3(ball_lerp_pos, ball_extent)};
         }
 
-        ball_pos = ball_t_pos;
+        ball_draw_pos = ball_lerp_pos;
+        frame.ball_pos = ball_draw_pos;
 
-        m3dMat4x4Translate(&ball_transform, ball_pos);
+        dgnTransformsSetPosition(scene_transforms, ball_node, ball_draw_pos);
+        dgnTransformsUpdate(scene_transforms);
+        frame.ball_transform = *dgnTransformsGetWorld(scene_transforms, ball_node);
 
         /** -------- Camera -------- **/
 
-        //updateCamera(&camera, window, DGN_TRUE);
-        updateCamera(&camera, window, GAMEPAD_CONTROLS);
-        Mat4x4 vp_mat = m3dMat4x4MulMat4x4(dgnCameraGetProjection(camera),
-                        m3dMat4x4FromMat3x3(m3dMat3x3FromMat4x4(dgnCameraGetView(camera))));
-        //Mat4x4 vp_mat = dgnCameraGetProjection(camera);
-
-        /** -------- Shadows -------- **/
+        updateCamera(&camera, window, &controls);
+        frame.camera = camera;
 
-        DgnFrustum frustum = camera.frustum;
+        /** -------- Point lights -------- **/
 
-        for(int i = 0; i < CASCADE_COUNT; i++)
+        for(int i = 0; i < POINT_LIGHT_COUNT; i++)
         {
-            frustum.near = cascade_depths[i];
-            frustum.far = cascade_depths[i + 1];
+            float a = (float)i / POINT_LIGHT_COUNT * 2 * PI + dgnEngineGetSeconds() * 0.3f;
+            float r = 3.0f + 5.0f * ((i * 7) % POINT_LIGHT_COUNT) / POINT_LIGHT_COUNT;
 
-            shadow_cascades[i].view_mat = dgnLightingCreateDirViewMat(sun_dir);
-            shadow_cascades[i].proj_mat = dgnLightingCreateLightProjMat(camera, shadow_cascades[i], frustum, 10.0f);
+            frame.point_lights[i].position = (Vec3){cosf(a) * r, 0.5f + 0.3f * sinf(a * 3.0f), sinf(a) * r};
         }
 
-        /** ---------------- RENDER ---------------- **/
+        dgnProfileEnd(update_scope);
 
-        /** -------- Shadows -------- **/
+        /** ---------------- RENDER ---------------- **/
 
-        dgnRendererEnableClearFlag(DGN_CLEAR_FLAG_DEPTH);
-        dgnRendererSetDepthTest(DGN_DEPTH_PASS_LESS);
-        dgnRendererSetCullFace(DGN_FACE_FRONT);
-        dgnRendererSetViewport(0, 0, SHADOW_SIZE, SHADOW_SIZE);
+        // waits only when the render thread is a whole packet behind
+        DgnRenderPacket *packet = dgnRenderThreadBeginPacket(render_thread);
+        dgnRenderPacketPush(packet, renderFrame, &scene, &frame, sizeof(frame));
+        dgnRenderThreadSubmit(render_thread, packet);
 
-        for(int i = 0; i < CASCADE_COUNT; i++)
+        if(max_frames && dgnWindowGetFrameCount(window) >= max_frames)
         {
-            dgnFramebufferBind(shadow_cascades[i].framebuffer);
-            dgnRendererClear();
-            dgnRendererBindShader(shadow_shader);
+            dgnWindowClose(window);
+        }
+    }
 
-            dgnShaderUniformM4x4(shadow_u_light, dgnLightingCreateLightSpaceMat(shadow_cascades[i]));
-            dgnShaderUniformM4x4(shadow_u_model, m3dMat4x4InitIdentity());
+    dgnRenderThreadDestroy(render_thread);
 
-            for(int i = 0; i < level_mesh_count; i++)
-            {
-                dgnRendererBindMesh(level_mesh[i]);
-                dgnRendererDrawMesh();
-            }
+    if(profile_path)
+    {
+        dgnProfileWriteTrace(profile_path);
+    }
 
-            dgnShaderUniformM4x4(shadow_u_model, ball_transform);
-            dgnRendererBindMesh(ball_mesh[0]);
-            dgnRendererDrawMesh();
-        }
-        dgnFramebufferBind(0);
+    if(frame_stats_path)
+    {
+        dgnWindowDumpFrameStats(window, frame_stats_path, DGN_FRAME_STATS_JSON);
+    }
 
-        /** -------- Main Scene -------- **/
+    dgnDynamicResolutionDestroy(scene.dyn_res);
+    dgnLightClustersDestroy(scene.light_clusters);
+    dgnShadowCacheDestroy(scene.shadow_cache);
+    dgnShadowAtlasDestroy(scene.shadow_atlas);
+    if(scene.shadow_evsm)
+    {
+        dgnEvsmDestroy(scene.shadow_evsm);
+    }
 
-        dgnFramebufferBind(screen_framebuffer);
+    dgnTransformsDestroy(scene_transforms);
+    dgnLoopDestroy(loop);
+    dgnInputMapDestroy(controls.map);
+    dgnInputRecordStop();
 
-        dgnRendererSetViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
-        dgnRendererEnableClearFlag(DGN_CLEAR_FLAG_COLOR | DGN_CLEAR_FLAG_DEPTH);
-        dgnRendererSetDepthTest(DGN_DEPTH_PASS_LESS);
-        dgnRendererSetCullFace(DGN_FACE_BACK);
-        dgnRendererClear();
+    dgnMeshDestroyArr(scene.level_mesh, scene.level_mesh_count);
+    free(scene.shadow_receivers);
+    dgnMeshDestroyArr(scene.ball_mesh, 1);
 
-        dgnRendererBindShader(lit_shader);
+    dgnTextureDestroy(scene.skybox_texture);
+    dgnTextureDestroy(scene.checker_textures[0]);
+    dgnTextureDestroy(scene.checker_textures[1]);
+    dgnTextureDestroy(scene.checker_textures[2]);
+    dgnTextureDestroy(scene.checker_textures[3]);
+    dgnTextureStreamerDestroy(scene.texture_streamer);
 
-        dgnShaderUniformM4x4(lit_u_view, dgnCameraGetView(camera));
-        dgnShaderUniformM4x4(lit_u_projection, dgnCameraGetProjection(camera));
-        dgnShaderUniformV3(lit_u_light_dir, sun_dir);
-        dgnShaderUniformV3(lit_u_cam_pos, camera.pos);
+    dgnShaderDestroy(scene.skybox_shader);
+    dgnShaderDestroy(scene.lit_shader);
 
-        for(int i = 0; i < CASCADE_COUNT; i++)
-        {
-            dgnShaderUniformM4x4(lit_u_light_mat[i], dgnLightingCreateLightSpaceMat(shadow_cascades[i]));
-            dgnRendererBindTexture(shadow_cascades[i].texture, 20 + i);
-            dgnShaderUniformI(lit_u_shadow_map[i], 20 + i);
-            dgnShaderUniformF(lit_u_cascade_ends[i], cascade_depths[i + 1]);
-        }
+    dgnRendererTerminate();
+    dgnWindowDestroy(window);
+    dgnEngineTerminate();
+}
+
+void renderFrame(void *data, void *user_data)
+{
+    FrameState *frame = data;
+    Scene *scene = user_data;
+
+    dgnTextureStreamerUpdate(scene->texture_streamer);
+
+    if(frame->reload_lit_shader)
+    {
+        dgnShaderDestroy(scene->lit_shader);
+        scene->lit_shader = dgnShaderLoad("res/game/lit.vert", 0, "res/game/lit.frag");
+    }
+
+    if(frame->ball_moved)
+    {
+        dgnShadowCacheMarkDirty(scene->shadow_cache, frame->ball_boxes[0]);
+        dgnShadowCacheMarkDirty(scene->shadow_cache, frame->ball_boxes[1]);
+    }
+
+    Mat4x4 vp_mat = m3dMat4x4MulMat4x4(*dgnCameraGetProjection(&frame->camera),
+                    m3dMat4x4FromMat3x3(m3dMat3x3FromMat4x4(*dgnCameraGetView(&frame->camera))));
+    //Mat4x4 vp_mat = dgnCameraGetProjection(camera);
+
+    /** -------- Level of detail -------- **/
+
+    uint32_t scope = dgnProfileBegin("lod selection");
+    dgnMeshSelectLod(scene->ball_mesh[0], frame->ball_transform, &frame->camera);
+    for(int i = 0; i < scene->level_mesh_count; i++)
+    {
+        dgnMeshSelectLod(scene->level_mesh[i], m3dMat4x4InitIdentity(), &frame->camera);
+    }
+    dgnProfileEnd(scope);
+
+    /** -------- Point lights -------- **/
+
+    // the scene viewport changes size with the dynamic resolution, bin against what will be drawn
+    DgnCamera cluster_camera = frame->camera;
+    cluster_camera.frustum.width = dgnDynamicResolutionGetWidth(scene->dyn_res);
+    cluster_camera.frustum.height = dgnDynamicResolutionGetHeight(scene->dyn_res);
+
+    dgnLightClustersBuild(scene->light_clusters, &cluster_camera, frame->point_lights, POINT_LIGHT_COUNT);
+    dgnLightClustersUpload(scene->light_clusters);
 
-        dgnRendererBindCubemap(skybox_texture, 15);
-        dgnShaderUniformI(lit_u_skybox, 15);
+    /** -------- Shadows -------- **/
 
-        dgnShaderUniformM4x4(lit_u_model, m3dMat4x4InitIdentity());
-        dgnShaderUniformB(lit_u_has_texture, DGN_TRUE);
-        dgnShaderUniformI(lit_u_texture, 0);
-        dgnShaderUniformF(lit_u_specular, 7.0f);
-        dgnShaderUniformF(lit_u_refl_shine, 0.1f);
-        dgnShaderUniformF(lit_u_metalness, 0.0f);
-        for(int i = 0; i < level_mesh_count; i++)
+    // nearer cascades are more important and keep their full size when space runs out
+    scope = dgnProfileBegin("cascade setup");
+    dgnShadowAtlasBeginFrame(scene->shadow_atlas);
+
+    uint16_t cascade_handles[CASCADE_COUNT];
+    for(int i = 0; i < CASCADE_COUNT; i++)
+    {
+        cascade_handles[i] = dgnShadowAtlasRequest(scene->shadow_atlas, SHADOW_SIZE, CASCADE_COUNT - i);
+    }
+
+    dgnShadowAtlasPack(scene->shadow_atlas);
+
+    for(int i = 0; i < CASCADE_COUNT; i++)
+    {
+        DgnShadowMap old = scene->shadow_cascades[i];
+        scene->cascade_placed[i] = dgnShadowAtlasGetMap(scene->shadow_atlas, cascade_handles[i], &scene->shadow_cascades[i]);
+
+        // the cached map is somewhere else in the atlas now
+        if(old.x != scene->shadow_cascades[i].x || old.y != scene->shadow_cascades[i].y || old.width != scene->shadow_cascades[i].width)
         {
-            if(i < 4)
-            {
-                dgnRendererBindTexture(checker_textures[i], 0);
-            }
-            dgnRendererBindMesh(level_mesh[i]);
-            dgnRendererDrawMesh();
+            dgnShadowCacheInvalidateCascade(scene->shadow_cache, i);
         }
+    }
 
-        dgnShaderUniformB(lit_u_has_texture, DGN_TRUE);
-        dgnShaderUniformI(lit_u_texture, 0);
-        dgnRendererBindTexture(ball_texture, 0);
-        dgnShaderUniformF(lit_u_specular, 10.0f);
-        dgnShaderUniformF(lit_u_refl_shine, 0.2f);
-        dgnShaderUniformF(lit_u_metalness, 0.0f);
+    DgnBoundingBox scene_bounds = scene->level_bounds;
+    growBounds(&scene_bounds, frame->ball_pos, frame->ball_radius);
 
-        dgnShaderUniformM4x4(lit_u_model, ball_transform);
-        dgnRendererBindMesh(ball_mesh[0]);
-        dgnRendererDrawMesh();
+    // spend the cascades only on the depths something can be seen at
+    scene->shadow_receivers[scene->level_mesh_count] = (DgnBoundingSphere){frame->ball_pos, frame->ball_radius};
+    dgnLightingFitCascadeSplits(scene->cascade_depths, CASCADE_COUNT, &frame->camera, scene->shadow_receivers,
+                                scene->shadow_receiver_count, SHADOW_NEAR, SHADOW_FAR, CASCADE_SPLIT_BLEND);
 
-        dgnRendererBindMesh(0);
+    DgnFrustum frustum = frame->camera.frustum;
 
-        /** ---- SKYBOX ---- **/
-        dgnRendererSetDepthTest(DGN_DEPTH_PASS_LEQUAL);
-        dgnRendererBindShader(skybox_shader);
-        dgnRendererBindCubemap(skybox_texture, 0);
+    for(int i = 0; i < CASCADE_COUNT; i++)
+    {
+        frustum.near = scene->cascade_depths[i];
+        frustum.far = scene->cascade_depths[i + 1];
 
-        dgnShaderUniformM4x4(skybox_u_vp, vp_mat);
-        dgnShaderUniformV3(skybox_u_sun_dir, sun_dir);
+        scene->shadow_cascades[i].view_mat = dgnLightingCreateDirViewMat(frame->sun_dir);
+        scene->shadow_cascades[i].proj_mat = dgnLightingCreateFittedProjMat(&frame->camera, scene->shadow_cascades[i], frustum, CASCADE_FIT, scene_bounds, 10.0f);
+    }
+    dgnProfileEnd(scope);
 
-        dgnRendererBindSkybox();
-        dgnRendererDrawMesh();
+    /** ---------------- RENDER ---------------- **/
 
-        /** ---- Wire Frame ---- **/
+    /** -------- Shadows -------- **/
 
-        /*dgnRendererSetDepthTest(DGN_DEPTH_PASS_ALWAYS);
-        dgnRendererSetDrawMode(DGN_DRAW_MODE_LINES);
-        dgnRendererSetLineWidth(2.0f);
-        Mat4x4 wf_VP = m3dMat4x4MulMat4x4(dgnCameraGetProjection(camera), dgnCameraGetView(camera));
+    scope = dgnProfileBegin("shadow draw");
 
-        DgnLine line;
-        line.p1 = (Vec3){1.0f, 1.5f, 1.0f};
-        line.p2 = (Vec3){-1.0f, 0.0f, 1.0f};
+    // light projections use the standard depth range
+    if(scene->reversed_z)
+    {
+        dgnRendererSetReversedZ(DGN_FALSE);
+    }
+    dgnRendererEnableClearFlag(DGN_CLEAR_FLAG_DEPTH);
+
+    dgnShadowCacheBeginFrame(scene->shadow_cache);
+    uint8_t shadows_updated = DGN_FALSE;
 
-        if(dgnInputGetKey(DGN_KEY_N))
+    int caster_u_model = SHADOW_EVSM ? scene->evsm_u_model : scene->shadow_u_model;
+
+    for(int i = 0; i < CASCADE_COUNT; i++)
+    {
+        Mat4x4 light_space_mat = dgnLightingCreateLightSpaceMat(scene->shadow_cascades[i]);
+
+        if(!scene->cascade_placed[i] || !dgnShadowCacheNeedsUpdate(scene->shadow_cache, i, light_space_mat))
         {
-            point.x -= dgnWindowGetDelta(window) * 0.5f;
+            continue;
         }
-        if(dgnInputGetKey(DGN_KEY_M))
+
+        if(SHADOW_EVSM)
         {
-            point.x += dgnWindowGetDelta(window) * 0.5f;
+            dgnEvsmBeginMap(scene->shadow_evsm, scene->shadow_cascades[i]);
+            dgnRendererSetCullFace(DGN_FACE_FRONT);
+            dgnRendererSetDepthTest(DGN_DEPTH_PASS_LESS);
+            dgnRendererBindShader(scene->evsm_shader);
+            dgnShaderUniformM4x4(scene->evsm_u_light, light_space_mat);
+        }
+        else
+        {
+            dgnRendererSetupShadow(scene->shadow_cascades[i], scene->shadow_shader, scene->shadow_u_light, light_space_mat);
         }
 
-        //point = {0.0f, 1.5f, 1.0f};
-
-        DgnBoundingSphere s;
-        s.radius = 0.01f;
+        dgnShaderUniformM4x4(caster_u_model, m3dMat4x4InitIdentity());
 
-        dgnRendererBindShader(color_shader);
-        dgnShaderUniformV3(color_u_color, (Vec3){1.0f, 0.0f, 0.0f});
-        dgnRendererBindWireSphere();
+        for(int i = 0; i < scene->level_mesh_count; i++)
+        {
+            dgnRendererBindMesh(scene->level_mesh[i]);
+            dgnRendererDrawMesh();
+        }
 
-        s.center = point;
-        dgnShaderUniformM4x4(color_u_mvp, m3dMat4x4MulMat4x4(wf_VP, dgnCollisionSphereGetModel(s)));
+        dgnShaderUniformM4x4(caster_u_model, frame->ball_transform);
+        dgnRendererBindMesh(scene->ball_mesh[0]);
         dgnRendererDrawMesh();
 
-        dgnShaderUniformV3(color_u_color, (Vec3){0.0f, 1.0f, 0.0f});
-        s.center = point2;
-        dgnShaderUniformM4x4(color_u_mvp, m3dMat4x4MulMat4x4(wf_VP, dgnCollisionSphereGetModel(s)));
-        dgnRendererDrawMesh();
+        if(SHADOW_EVSM)
+        {
+            dgnEvsmBlur(scene->shadow_evsm, scene->shadow_cascades[i], EVSM_BLUR_RADIUS);
+        }
+
+        dgnShadowCacheMarkRendered(scene->shadow_cache, i, light_space_mat);
+        shadows_updated = DGN_TRUE;
+    }
 
-        dgnRendererBindShader(line_shader);
-        dgnShaderUniformV3(line_u_color, (Vec3){1.0f, 1.0f, 0.0f});
-        dgnShaderUniformM4x4(line_u_vp, wf_VP);
-        dgnRendererBindLine();
+    if(SHADOW_EVSM && shadows_updated)
+    {
+        dgnEvsmGenerateMipmaps(scene->shadow_evsm);
+    }
+    dgnFramebufferBind(0);
+    dgnProfileEnd(scope);
 
-        dgnShaderUniformV3(line_u_pos1, line.p1);
-        dgnShaderUniformV3(line_u_pos2, line.p2);
-        dgnRendererDrawMesh();*/
+    /** -------- Main Scene -------- **/
 
-        dgnRendererSetDrawMode(DGN_DRAW_MODE_TRIANGLES);
+    scope = dgnProfileBegin("scene draw");
+    dgnFramebufferBind(scene->screen_framebuffer);
 
-        /** ---- Screen quad ---- **/
+    dgnDynamicResolutionBeginFrame(scene->dyn_res);
+    // end frame may pick a new scale, the blit has to use the one drawn with
+    Vec2 scene_uv_scale = dgnDynamicResolutionGetUVScale(scene->dyn_res);
+    dgnRendererSetViewport(0, 0, dgnDynamicResolutionGetWidth(scene->dyn_res), dgnDynamicResolutionGetHeight(scene->dyn_res));
+    if(scene->reversed_z)
+    {
+        dgnRendererSetReversedZ(DGN_TRUE);
+    }
+    dgnRendererEnableClearFlag(DGN_CLEAR_FLAG_COLOR | DGN_CLEAR_FLAG_DEPTH);
+    dgnRendererSetDepthTest(scene->scene_depth_test);
+    dgnRendererSetCullFace(DGN_FACE_BACK);
+    dgnRendererClear();
 
-        dgnFramebufferBind(0);
+    dgnRendererBindShader(scene->lit_shader);
 
-        dgnRendererSetViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
-        dgnRendererSetDepthTest(DGN_DEPTH_PASS_ALWAYS);
-        dgnRendererBindShader(screen_shader);
+    dgnRendererSetCamera(&frame->camera);
+    dgnShaderUniformV3(scene->lit_u_light_dir, frame->sun_dir);
+    dgnShaderUniformV3(scene->lit_u_cam_pos, frame->camera.pos);
 
-        dgnShaderUniformB(screen_u_single, DGN_FALSE);
-        dgnShaderUniformV2(screen_u_scale, (Vec2){1.0f, 1.0f});
-        dgnShaderUniformV2(screen_u_offset, (Vec2){0.0f, 0.0f});
+    dgnRendererBindTexture(dgnShadowAtlasGetTexture(scene->shadow_atlas), 20);
+    dgnShaderUniformI(scene->lit_u_shadow_atlas, 20);
+    dgnRendererBindTexture(SHADOW_EVSM ? dgnEvsmGetTexture(scene->shadow_evsm) : NULL, 21);
+    dgnShaderUniformI(scene->lit_u_shadow_moments, 21);
+    dgnShaderUniformB(scene->lit_u_use_evsm, SHADOW_EVSM);
 
-        dgnRendererBindTexture(screen_texture, 0);
+    for(int i = 0; i < CASCADE_COUNT; i++)
+    {
+        Mat4x4 atlas_mat = dgnLightingCreateAtlasMat(scene->shadow_cascades[i]);
+        // a cascade with no room gets an empty area and reads as unshadowed
+        Vec4 rect = scene->cascade_placed[i] ? dgnLightingGetShadowRect(scene->shadow_cascades[i]) : (Vec4){1.0f, 1.0f, 0.0f, 0.0f};
 
-        dgnRendererBindScreenTexture();
-        dgnRendererDrawMesh();
+        dgnShaderUniformM4x4(scene->lit_u_light_mat[i], m3dMat4x4MulMat4x4(atlas_mat, dgnShadowCacheGetLightSpaceMat(scene->shadow_cache, i)));
+        dgnShaderUniformV4(scene->lit_u_shadow_rect[i], rect);
+        dgnShaderUniformF(scene->lit_u_cascade_ends[i], scene->cascade_depths[i + 1]);
+    }
 
-        for(int i = 0; i < CASCADE_COUNT; i++)
+    dgnRendererBindCubemap(scene->skybox_texture, 15);
+    dgnShaderUniformI(scene->lit_u_skybox, 15);
+
+    dgnLightClustersBind(scene->light_clusters, LIGHT_TEX_SLOT);
+    dgnShaderUniformI(scene->lit_u_cluster_grid, LIGHT_TEX_SLOT);
+    dgnShaderUniformI(scene->lit_u_cluster_indices, LIGHT_TEX_SLOT + 1);
+    dgnShaderUniformI(scene->lit_u_cluster_lights, LIGHT_TEX_SLOT + 2);
+    dgnShaderUniformV2(scene->lit_u_cluster_screen, (Vec2){dgnDynamicResolutionGetWidth(scene->dyn_res), dgnDynamicResolutionGetHeight(scene->dyn_res)});
+    dgnShaderUniformV2(scene->lit_u_cluster_depth, dgnLightClustersGetDepthParams(scene->light_clusters));
+
+    dgnRendererSetModel(m3dMat4x4InitIdentity());
+    dgnShaderUniformB(scene->lit_u_has_texture, DGN_TRUE);
+    dgnShaderUniformI(scene->lit_u_texture, 0);
+    dgnShaderUniformF(scene->lit_u_specular, 7.0f);
+    dgnShaderUniformF(scene->lit_u_refl_shine, 0.1f);
+    dgnShaderUniformF(scene->lit_u_metalness, 0.0f);
+    for(int i = 0; i < scene->level_mesh_count; i++)
+    {
+        if(i < 4)
         {
-            float cc_inverse = 1.0f / 10;
+            dgnRendererBindTexture(scene->checker_textures[i], 0);
+        }
+        dgnRendererBindMesh(scene->level_mesh[i]);
+        dgnRendererDrawMesh();
+    }
 
-            dgnShaderUniformB(screen_u_single, DGN_TRUE);
-            dgnShaderUniformV2(screen_u_scale, (Vec2){cc_inverse, cc_inverse * (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT});
+    dgnShaderUniformB(scene->lit_u_has_texture, DGN_TRUE);
+    dgnShaderUniformI(scene->lit_u_texture, 0);
+    dgnRendererBindTexture(scene->ball_texture, 0);
+    dgnShaderUniformF(scene->lit_u_specular, 10.0f);
+    dgnShaderUniformF(scene->lit_u_refl_shine, 0.2f);
+    dgnShaderUniformF(scene->lit_u_metalness, 0.0f);
 
-            dgnShaderUniformV2(screen_u_offset, (Vec2){ i * 2.0f * cc_inverse, 2.0f - 2.0f * cc_inverse * (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT});
+    dgnRendererSetModel(frame->ball_transform);
+    dgnRendererBindMesh(scene->ball_mesh[0]);
+    dgnRendererDrawMesh();
 
-            dgnRendererBindTexture(shadow_cascades[i].texture, 0);
+    dgnRendererBindMesh(0);
 
-            dgnRendererDrawMesh();
-        }
+    /** ---- SKYBOX ---- **/
+    dgnRendererSetDepthTest(scene->reversed_z ? DGN_DEPTH_PASS_GEQUAL : DGN_DEPTH_PASS_LEQUAL);
+    dgnRendererBindShader(scene->skybox_shader);
+    dgnRendererBindCubemap(scene->skybox_texture, 0);
+
+    dgnShaderUniformM4x4(scene->skybox_u_vp, vp_mat);
+    dgnShaderUniformV3(scene->skybox_u_sun_dir, frame->sun_dir);
+    dgnShaderUniformF(scene->skybox_u_far_depth, scene->reversed_z ? 0.0f : 1.0f);
+
+    dgnRendererBindSkybox();
+    dgnRendererDrawMesh();
 
-        dgnWindowSwapBuffers(window);
+    /** ---- Wire Frame ---- **/
+
+    /*dgnRendererSetDepthTest(DGN_DEPTH_PASS_ALWAYS);
+    dgnRendererSetDrawMode(DGN_DRAW_MODE_LINES);
+    dgnRendererSetLineWidth(2.0f);
+    Mat4x4 wf_VP = *dgnCameraGetViewProjection(&frame->camera);
+
+    DgnLine line;
+    line.p1 = (Vec3){1.0f, 1.5f, 1.0f};
+    line.p2 = (Vec3){-1.0f, 0.0f, 1.0f};
+
+    if(dgnInputGetKey(DGN_KEY_N))
+    {
+        point.x -= dgnWindowGetDelta(scene->window) * 0.5f;
+    }
+    if(dgnInputGetKey(DGN_KEY_M))
+    {
+        point.x += dgnWindowGetDelta(scene->window) * 0.5f;
     }
 
-    dgnMeshDestroyArr(level_mesh, level_mesh_count);
-    dgnMeshDestroyArr(ball_mesh, 1);
+    //point = {0.0f, 1.5f, 1.0f};
 
-    dgnTextureDestroy(skybox_texture);
-    dgnTextureDestroy(checker_textures[0]);
-    dgnTextureDestroy(checker_textures[1]);
-    dgnTextureDestroy(checker_textures[2]);
-    dgnTextureDestroy(checker_textures[3]);
+    DgnBoundingSphere s;
+    s.radius = 0.01f;
 
-    dgnShaderDestroy(skybox_shader);
-    dgnShaderDestroy(lit_shader);
+    dgnRendererBindShader(scene->color_shader);
+    dgnShaderUniformV3(scene->color_u_color, (Vec3){1.0f, 0.0f, 0.0f});
+    dgnRendererBindWireSphere();
 
-    dgnRendererTerminate();
-    dgnWindowDestroy(window);
-    dgnEngineTerminate();
-}
+    s.center = point;
+    dgnShaderUniformM4x4(scene->color_u_mvp, m3dMat4x4MulMat4x4(wf_VP, dgnCollisionSphereGetModel(s)));
+    dgnRendererDrawMesh();
 
+    dgnShaderUniformV3(scene->color_u_color, (Vec3){0.0f, 1.0f, 0.0f});
+    s.center = point2;
+    dgnShaderUniformM4x4(scene->color_u_mvp, m3dMat4x4MulMat4x4(wf_VP, dgnCollisionSphereGetModel(s)));
+    dgnRendererDrawMesh();
 
-uint8_t cam_lock = DGN_FALSE;
+    dgnRendererBindShader(scene->line_shader);
+    dgnShaderUniformV3(scene->line_u_color, (Vec3){1.0f, 1.0f, 0.0f});
+    dgnShaderUniformM4x4(scene->line_u_vp, wf_VP);
+    dgnRendererBindLine();
 
-void updateCamera(DgnCamera *camera, DgnWindow *window, uint8_t controller)
-{
-    float camera_rot_speed = PI * dgnWindowGetDelta(window);
-    float camera_move_speed = 3.0f * dgnWindowGetDelta(window);
-    Quat camera_rot_y;
-    Quat camera_rot_x;
+    dgnShaderUniformV3(scene->line_u_pos1, line.p1);
+    dgnShaderUniformV3(scene->line_u_pos2, line.p2);
+    dgnRendererDrawMesh();*/
+
+    dgnRendererSetDrawMode(DGN_DRAW_MODE_TRIANGLES);
+
+    dgnDynamicResolutionEndFrame(scene->dyn_res);
+    dgnProfileEnd(scope);
+
+    /** ---- Screen quad ---- **/
+
+    dgnFramebufferBind(0);
+
+    dgnRendererSetViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+    dgnRendererSetDepthTest(DGN_DEPTH_PASS_ALWAYS);
+    dgnRendererBindShader(scene->screen_shader);
+
+    dgnShaderUniformB(scene->screen_u_single, DGN_FALSE);
+    dgnShaderUniformV2(scene->screen_u_scale, (Vec2){1.0f, 1.0f});
+    dgnShaderUniformV2(scene->screen_u_offset, (Vec2){0.0f, 0.0f});
+    dgnShaderUniformV2(scene->screen_u_tex_scale, scene_uv_scale);
+
+    dgnRendererBindTexture(scene->screen_texture, 0);
+
+    dgnRendererBindScreenTexture();
+    dgnRendererDrawMesh();
+
+    dgnShaderUniformV2(scene->screen_u_tex_scale, (Vec2){1.0f, 1.0f});
 
-    if(controller)
     {
-        camera_rot_y = m3dQuatAngleAxis(
-                        dgnInputGetGamepadAxis(DGN_GAMEPAD_1, DGN_GAMEPAD_AXIS_RIGHT_X, 0.1f) * camera_rot_speed,
-                        (Vec3){0.0f, -1.0f, 0.0f});
+        float cc_inverse = 1.0f / 5;
 
-        camera_rot_x = m3dQuatAngleAxis(
-                        dgnInputGetGamepadAxis(DGN_GAMEPAD_1, DGN_GAMEPAD_AXIS_RIGHT_Y, 0.1f) * camera_rot_speed,
-                        m3dQuatRotateVec3(camera->rot, (Vec3){-1.0f, 0.0f, 0.0f}));
+        dgnShaderUniformB(scene->screen_u_single, DGN_TRUE);
+        dgnShaderUniformV2(scene->screen_u_scale, (Vec2){cc_inverse, cc_inverse * (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT});
 
-        camera->rot = m3dQuatMulQuat(m3dQuatMulQuat(camera_rot_y, camera_rot_x), camera->rot);
+        dgnShaderUniformV2(scene->screen_u_offset, (Vec2){0.0f, 2.0f - 2.0f * cc_inverse * (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT});
 
-        camera->pos = m3dVec3AddVec3(camera->pos,
-                                    m3dQuatRotateVec3(camera->rot, (Vec3){0.0f, 0.0f,
-                                    camera_move_speed * dgnInputGetGamepadAxis(DGN_GAMEPAD_1, DGN_GAMEPAD_AXIS_LEFT_Y, 0.1f)}));
+        dgnRendererBindTexture(dgnShadowAtlasGetTexture(scene->shadow_atlas), 0);
 
-        camera->pos = m3dVec3AddVec3(camera->pos,
-                                m3dQuatRotateVec3(camera->rot, (Vec3){
-                                camera_move_speed * dgnInputGetGamepadAxis(DGN_GAMEPAD_1, DGN_GAMEPAD_AXIS_LEFT_X, 0.1f),
-                                0.0f, 0.0f}));
+        dgnRendererDrawMesh();
     }
-    else
+
+    if(frame->show_frame_stats)
     {
-        camera_rot_speed = PI * 0.004f;
+        dgnFramebufferBind(0);
+        dgnWindowDrawFrameStats(scene->window, 10, 10, 300, 80);
+    }
+}
 
-        // Mouse and keyboard
-        if(dgnInputGetKeyDown(DGN_KEY_ESCAPE))
-        {
-            cam_lock = !cam_lock;
+uint8_t cam_lock = DGN_FALSE;
 
-            if(cam_lock)
-            {
-                dgnWindowSetRawCursorMode(window, DGN_TRUE);
-                dgnWindowSetCursorMode(window, DGN_CURSOR_DISABLED);
-            }
-            else
-            {
-                dgnWindowSetRawCursorMode(window, DGN_FALSE);
-                dgnWindowSetCursorMode(window, DGN_CURSOR_NORMAL);
-            }
-        }
+void updateCamera(DgnCamera *camera, DgnWindow *window, Controls *controls)
+{
+    DgnInputMap *map = controls->map;
+    float camera_rot_speed = PI * dgnWindowGetDelta(window);
+    float camera_move_speed = 3.0f * dgnWindowGetDelta(window);
+    // mouse deltas are already per frame
+    float mouse_rot_speed = PI * 0.004f;
+
+    if(dgnInputMapGetButtonDown(map, controls->toggle_cursor))
+    {
+        cam_lock = !cam_lock;
 
         if(cam_lock)
         {
-            camera_rot_y = m3dQuatAngleAxis(
-                        dgnInputGetMouseXDelta() * camera_rot_speed,
-                        (Vec3){0.0f, -1.0f, 0.0f});
-
-            camera_rot_x = m3dQuatAngleAxis(
-                        dgnInputGetMouseYDelta() * camera_rot_speed,
-                        m3dQuatRotateVec3(camera->rot, (Vec3){-1.0f, 0.0f, 0.0f}));
-            camera->rot = m3dQuatMulQuat(m3dQuatMulQuat(camera_rot_y, camera_rot_x), camera->rot);
+            dgnWindowSetRawCursorMode(window, DGN_TRUE);
+            dgnWindowSetCursorMode(window, DGN_CURSOR_DISABLED);
         }
+        else
+        {
+            dgnWindowSetRawCursorMode(window, DGN_FALSE);
+            dgnWindowSetCursorMode(window, DGN_CURSOR_NORMAL);
+        }
+    }
 
+    float look_x = dgnInputMapGetValue(map, controls->look_x) * camera_rot_speed;
+    float look_y = dgnInputMapGetValue(map, controls->look_y) * camera_rot_speed;
 
-        camera->pos = m3dVec3AddVec3(camera->pos,
-                                    m3dQuatRotateVec3(camera->rot, (Vec3){0.0f, 0.0f,
-                                    camera_move_speed * (dgnInputGetKey(DGN_KEY_S) - dgnInputGetKey(DGN_KEY_W))}));
-
-        camera->pos = m3dVec3AddVec3(camera->pos,
-                                    m3dQuatRotateVec3(camera->rot, (Vec3){
-                                    camera_move_speed * (dgnInputGetKey(DGN_KEY_D) - dgnInputGetKey(DGN_KEY_A)),
-                                    0.0f, 0.0f}));
+    if(cam_lock)
+    {
+        look_x += dgnInputMapGetValue(map, controls->mouse_look_x) * mouse_rot_speed;
+        look_y += dgnInputMapGetValue(map, controls->mouse_look_y) * mouse_rot_speed;
     }
+
+    Quat camera_rot_y = m3dQuatAngleAxis(look_x, (Vec3){0.0f, -1.0f, 0.0f});
+    Quat camera_rot_x = m3dQuatAngleAxis(look_y, m3dQuatRotateVec3(camera->rot, (Vec3){-1.0f, 0.0f, 0.0f}));
+    camera->rot = m3dQuatMulQuat(m3dQuatMulQuat(camera_rot_y, camera_rot_x), camera->rot);
+
+    camera->pos = m3dVec3AddVec3(camera->pos,
+                                 m3dQuatRotateVec3(camera->rot, (Vec3){
+                                 camera_move_speed * dgnInputMapGetValue(map, controls->move_x),
+                                 0.0f,
+                                 camera_move_speed * dgnInputMapGetValue(map, controls->move_z)}));
 }
 
 //TODO: Switch over to C++
 
 //TODO: triangle collision https://gdbooks.gitbooks.io/3dcollisions/content/Chapter4/closest_point_to_triangle.html
-//TODO: gamepad buttons getdown and getup functions
 //TODO: shader standard library
 //TODO: audio start
-//TODO: variance shadow mapping, screen space soft shadows?
+//TODO: screen space soft shadows?
+
+void growBounds(DgnBoundingBox *box, Vec3 center, float radius)
+{
+    box->max.x = fmaxf(box->max.x, center.x + radius);
+    box->max.y = fmaxf(box->max.y, center.y + radius);
+    box->max.z = fmaxf(box->max.z, center.z + radius);
+    box->min.x = fminf(box->min.x, center.x - radius);
+    box->min.y = fminf(box->min.y, center.y - radius);
+    box->min.z = fminf(box->min.z, center.z - radius);
+}
+
+void printUsage(const char *program)
+{
+    printf("Usage: %s [options]\n"
+           "    --headless                render offscreen\n"
+           "    --frames <n>              close after n frames\n"
+           "    --no-render-thread        run every render packet on submit\n"
+           "    --profile <file>          write a Chrome trace of the timed scopes on exit\n"
+           "    --gl-debug <mode>         get-error, sampled, sync, async or off\n"
+           "    --load-report             print where startup time went\n"
+           "    --record <file>           save this session's input\n"
+           "    --replay <file>           play back a recorded session\n"
+           "    --frame-stats <file>      write the frame time history as json on exit\n", program);
+}
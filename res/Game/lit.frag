@@ -13,6 +13,7 @@ varying vec2 vTexCoords;
 varying vec3 vFragPos;
 varying vec4 vLightFragPos[NUM_CASCADES];
 varying float vClipSpacePosZ;
+varying float vViewDepth;
 
 uniform float uTime;
 
@@ -24,7 +25,10 @@ uniform sampler2D uToonMap2;
 uniform bool uHasTexture;
 uniform samplerCube uSkybox;
 uniform vec3 uLightDir = normalize(vec3(1.0));
-uniform sampler2D uShadowMap[NUM_CASCADES];
+uniform sampler2D uShadowAtlas;
+uniform vec4 uShadowRect[NUM_CASCADES];
+uniform sampler2D uShadowMoments;
+uniform bool uUseEvsm;
 uniform float uCascadeEnd[NUM_CASCADES];
 
 const vec3 Radiance = vec3(1.6, 1.4, 1.0);
@@ -60,6 +64,17 @@ void clip(float value)
 const float SCREEN_NEAR = 0.1;
 const float SCREEN_FAR = 0.3;
 const vec2 SHADOW_BIAS = vec2(0.003, 0.0008);
+const float EVSM_BLEED_REDUCTION = 0.3;
+
+float cascadeShadow(int cascade, float NdotL, float samples, float tile)
+{
+	if(uUseEvsm)
+	{
+		return getShadowMultiplierEVSM(vLightFragPos[cascade], uShadowMoments, uShadowRect[cascade], EVSM_BLEED_REDUCTION);
+	}
+	
+	return getShadowMultiplierRandomBlur(vLightFragPos[cascade], uShadowAtlas, NdotL, SHADOW_BIAS, samples, tile, vFragPos, uShadowRect[cascade]);
+}
 
 void main()
 {
@@ -91,7 +106,7 @@ void main()
 		{
 			float distToCas = uCascadeEnd[i] - vClipSpacePosZ;
 			
-			shadowMult = getShadowMultiplierRandomBlur(vLightFragPos[i], uShadowMap[i], dot(N, L), SHADOW_BIAS, shadow_samples - i, shadow_tile, vFragPos);
+			shadowMult = cascadeShadow(i, dot(N, L), shadow_samples - i, shadow_tile);
 			
 			float blendDist = CASCADE_BLEND_DIST * vClipSpacePosZ / 1.414214;
 			if(distToCas < blendDist)
@@ -102,7 +117,7 @@ void main()
 				}
 				else
 				{
-					float border_shadow = getShadowMultiplierRandomBlur(vLightFragPos[i + 1], uShadowMap[i + 1], dot(N, L), SHADOW_BIAS, shadow_samples - i - 1, shadow_tile, vFragPos);
+					float border_shadow = cascadeShadow(i + 1, dot(N, L), shadow_samples - i - 1, shadow_tile);
 					shadowMult = mix(border_shadow, shadowMult, distToCas / blendDist);
 				}
 			}
@@ -118,7 +133,8 @@ void main()
 	vec3 ambient = albedo * irradiance * AmbFactor; 
 
 	vec3 light = diffuse + specular;
-	vec3 final = ambient + light * shadowMult;
+	vec3 local = clusteredLighting(vFragPos, N, V, albedo, uShininess, SpecFactor, vViewDepth);
+	vec3 final = ambient + light * shadowMult + local;
 
 	fragColor = vec4(final, 1.0);
 }
@@ -11,10 +11,11 @@ varying vec2 vTexCoords;
 varying vec3 vFragPos;
 varying vec4 vLightFragPos[NUM_CASCADES];
 varying float vClipSpacePosZ;
+varying float vViewDepth;
 
 uniform mat4 uModel;
-uniform mat4 uView;
-uniform mat4 uProjection;
+uniform mat4 uMVP;
+uniform mat3 uNormalMat;
 uniform mat4 uLightMat[NUM_CASCADES];
 
 void main()
@@ -26,10 +27,11 @@ void main()
 		vLightFragPos[i] = uLightMat[i] * fragPos;
 	}
 	
-	gl_Position = uProjection * uView * fragPos;
+	gl_Position = uMVP * vec4(aPos, 1.0);
 	vClipSpacePosZ = gl_Position.z;
+	vViewDepth = gl_Position.w;
 	
-	vNorm = mat3(transpose(inverse(uModel))) * aNorm;
+	vNorm = uNormalMat * aNorm;
 	vTexCoords = aTex;
 	vFragPos = fragPos.xyz;
 }
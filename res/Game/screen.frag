@@ -5,10 +5,13 @@ varying vec2 vTex;
 
 uniform sampler2D uTexture;
 uniform bool uSingle;
+uniform vec2 uTexScale = vec2(1);
 
 void main()
 {
-	vec3 finalColor = texture2D(uTexture, vTex).rgb;
+	// keep the bilinear footprint inside the drawn sub-rect of the target
+	vec2 uvMax = uTexScale - 0.5 / vec2(textureSize(uTexture, 0));
+	vec3 finalColor = texture2D(uTexture, min(vTex, uvMax)).rgb;
 	
 	if(uSingle)
 	{
@@ -6,6 +6,7 @@ varying vec2 vTex;
 
 uniform vec2 uScale = vec2(1);
 uniform vec2 uOffset;
+uniform vec2 uTexScale = vec2(1);
 
 void main()
 {
@@ -14,5 +15,5 @@ void main()
 	pos += uOffset - vec2(1.0);
 	
 	gl_Position = vec4(pos.x, pos.y, 0.0, 1);
-	vTex = aTex;
+	vTex = aTex * uTexScale;
 }
@@ -4,10 +4,12 @@ layout(location = 0) in vec3 aPos;
 varying vec3 vTex;
 
 uniform mat4 uVP;
+// depth of the far plane, 1 normally and 0 with reversed depth
+uniform float uFarDepth;
 
 void main()
 {
 	vec4 pos = uVP * vec4(aPos, 1.0);
-	gl_Position = pos.xyww; 
+	gl_Position = vec4(pos.xy, pos.w * uFarDepth, pos.w);
 	vTex = aPos;
 }
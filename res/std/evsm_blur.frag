@@ -0,0 +1,29 @@
+#version 330
+layout (location = 0) out vec4 fragMoments;
+
+varying vec2 vTex;
+
+uniform sampler2D uSource;
+// one texel along the blur axis
+uniform vec2 uDirection;
+// samples are kept inside this uv area so neighbouring maps do not bleed in
+uniform vec4 uClampRect;
+uniform int uRadius;
+
+void main()
+{
+	float sigma = max(float(uRadius) * 0.5, 0.5);
+	vec4 sum = vec4(0.0);
+	float total = 0.0;
+	
+	for(int i = -uRadius; i <= uRadius; i++)
+	{
+		float weight = exp(-float(i * i) / (2.0 * sigma * sigma));
+		vec2 uv = clamp(vTex + uDirection * float(i), uClampRect.xy, uClampRect.zw);
+		
+		sum += textureLod(uSource, uv, 0.0) * weight;
+		total += weight;
+	}
+	
+	fragMoments = sum / total;
+}
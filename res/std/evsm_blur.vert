@@ -0,0 +1,13 @@
+#version 330
+layout(location = 0) in vec3 aPos;
+
+varying vec2 vTex;
+
+// uv area of the map being blurred, the viewport covers the same area
+uniform vec4 uUVRect;
+
+void main()
+{
+	gl_Position = vec4(aPos.xy * 2.0 - 1.0, 0.0, 1.0);
+	vTex = mix(uUVRect.xy, uUVRect.zw, aPos.xy);
+}
@@ -0,0 +1,12 @@
+#version 330
+
+#include res/std/shadow.glh
+
+layout (location = 0) out vec4 fragMoments;
+
+void main()
+{
+	vec2 warped = warpDepthEVSM(gl_FragCoord.z);
+	
+	fragMoments = vec4(warped.x, warped.x * warped.x, warped.y, warped.y * warped.y);
+}
@@ -4,21 +4,136 @@
 #include <m3d/m3d.h>
 #include <stdint.h>
 
+#define DGN_RENDER_STAT_DRAW_CALLS 0
+#define DGN_RENDER_STAT_TRIANGLES 1
+#define DGN_RENDER_STAT_PROGRAM_BINDS 2
+#define DGN_RENDER_STAT_VAO_BINDS 3
+#define DGN_RENDER_STAT_TEXTURE_BINDS 4
+#define DGN_RENDER_STAT_FRAMEBUFFER_BINDS 5
+#define DGN_RENDER_STAT_UNIFORM_CALLS 6
+// buffer and texture data sent to the gpu
+#define DGN_RENDER_STAT_UPLOAD_BYTES 7
+#define DGN_RENDER_STAT_COUNT 8
+
+#define DGN_LOAD_STAGE_READ 0
+// image decoding, or the whole import for meshes since assimp reads the file itself
+#define DGN_LOAD_STAGE_DECODE 1
+#define DGN_LOAD_STAGE_CONVERT 2
+#define DGN_LOAD_STAGE_UPLOAD 3
+#define DGN_LOAD_STAGE_COMPILE 4
+#define DGN_LOAD_STAGE_COUNT 5
+
 #ifndef D_INTERNAL_H
 typedef void DgnWindow;
 typedef void DgnInput;
+typedef void DgnInputMap;
 typedef void DgnMesh;
 typedef void DgnShader;
 typedef void DgnTexture;
 typedef void DgnFramebuffer;
-typedef void DgnLight;
+typedef void DgnLightClusters;
+typedef void DgnShadowCache;
+typedef void DgnTransforms;
+typedef void DgnShadowAtlas;
+typedef void DgnEvsm;
+typedef void DgnDynamicResolution;
+typedef void DgnRenderGraph;
+typedef void DgnLoop;
+typedef void DgnRenderThread;
+typedef void DgnRenderPacket;
+typedef void DgnTextureStreamer;
 #endif // D_INTERNAL_H
 
+typedef void (*DgnRenderPassFunc)(DgnRenderGraph *graph, void *user_data);
+// data is the packet's own copy and can be changed freely, it is only valid until the command returns
+typedef void (*DgnRenderFunc)(void *data, void *user_data);
+
+typedef struct
+{
+    uint16_t width;
+    uint16_t height;
+    uint16_t storage_type;
+    uint16_t internal_type;
+    uint16_t data_type;
+    uint8_t filtering;
+}DgnRenderGraphTextureDesc;
+
+// seconds
+typedef struct
+{
+    float average;
+    float p50;
+    float p95;
+    float p99;
+    float max;
+}DgnFrameTimeStats;
+
+typedef struct
+{
+    uint32_t sample_count;
+    uint32_t hitch_count;
+    // between swaps, before the swap, and inside the swap
+    DgnFrameTimeStats frame;
+    DgnFrameTimeStats cpu;
+    DgnFrameTimeStats swap;
+}DgnFrameStats;
+
+typedef struct
+{
+    // indexed with DGN_RENDER_STAT_*
+    uint64_t last_frame[DGN_RENDER_STAT_COUNT];
+    // per frame, over the last average_frames frames
+    float average[DGN_RENDER_STAT_COUNT];
+    uint32_t average_frames;
+}DgnRendererStats;
+
+// one node of a frame's scope tree, children follow their parent with a depth one higher
+typedef struct
+{
+    const char *name;
+    uint16_t depth;
+    uint32_t calls;
+    // seconds, self leaves out the time spent in child scopes
+    float total;
+    float self;
+}DgnProfileScope;
+
+// seconds, stage arrays are indexed with DGN_LOAD_STAGE_*
+typedef struct
+{
+    uint32_t asset_count;
+    // from dgnLoadTimelineStart to dgnLoadTimelineStop
+    double wall_time;
+    // summed over every asset, stages on different threads can add up past the wall time
+    double stage_totals[DGN_LOAD_STAGE_COUNT];
+    // the chain of stages the wall time waited on, walked back from the end
+    double critical_path[DGN_LOAD_STAGE_COUNT];
+    // wall time on the critical path that no asset stage covered
+    double critical_other;
+}DgnLoadReport;
+
+typedef struct
+{
+    uint8_t type;
+    Vec3 position;
+    // spot lights only, must be normalized
+    Vec3 direction;
+    Vec3 color;
+    float range;
+    // spot cone half angles in radians
+    float inner_angle;
+    float outer_angle;
+}DgnLight;
+
 typedef struct
 {
     DgnTexture *texture;
     DgnFramebuffer *framebuffer;
 
+    // area of the texture the map is drawn to, a width of 0 uses the whole texture
+    uint16_t x, y;
+    uint16_t width, height;
+
     Mat4x4 view_mat;
     Mat4x4 proj_mat;
 }DgnShadowMap;
@@ -61,12 +176,37 @@ typedef struct
     float width, height;
 }DgnFrustum;
 
+typedef struct
+{
+    // values the matrices were last built from
+    Vec3 pos;
+    Quat rot;
+    DgnFrustum frustum;
+    uint8_t projection_type;
+    uint8_t view_valid;
+    uint8_t proj_valid;
+
+    Mat4x4 view;
+    Mat4x4 projection;
+    Mat4x4 view_projection;
+    Mat4x4 inverse_view;
+    Mat4x4 inverse_projection;
+    Mat4x4 inverse_view_projection;
+    // pointing inwards, indexed with DGN_FRUSTUM_PLANE_*
+    DgnPlane planes[6];
+}DgnCameraCache;
+
 typedef struct
 {
     Vec3 pos;
     Quat rot;
 
     DgnFrustum frustum;
+    // DGN_PROJECTION_*
+    uint8_t projection;
+
+    // kept up to date by the getters, only rebuilt when the values above change
+    DgnCameraCache cache;
 }DgnCamera;
 
 typedef struct
@@ -86,6 +226,8 @@ void dgnInputPollEvents();
 uint8_t dgnInputGetKey(uint16_t key);
 uint8_t dgnInputGetKeyDown(uint16_t key);
 uint8_t dgnInputGetKeyUp(uint16_t key);
+// keys whose state differs from the last frame, returns how many were written
+uint16_t dgnInputGetChangedKeys(uint16_t *out_keys, uint16_t max_keys);
 
 uint8_t dgnInputGetMouseButton(uint8_t button);
 uint8_t dgnInputGetMouseButtonDown(uint8_t button);
@@ -98,15 +240,134 @@ float dgnInputGetMouseYDelta();
 
 float dgnInputGetGamepadAxis(uint8_t gamepad, uint8_t axis, float deadzone);
 uint8_t dgnInputGetGamepadButton(uint8_t gamepad, uint8_t button);
+uint8_t dgnInputGetGamepadButtonDown(uint8_t gamepad, uint8_t button);
+uint8_t dgnInputGetGamepadButtonUp(uint8_t gamepad, uint8_t button);
+uint8_t dgnInputIsGamepadConnected(uint8_t gamepad);
+
+// bindings file, one "action source control [scale] [deadzone]" per line
+DgnInputMap *dgnInputMapLoad(const char *filepath);
+void dgnInputMapDestroy(DgnInputMap *map);
+// DGN_INPUT_ACTION_NONE when the file never binds the name, look ids up once and keep them
+uint16_t dgnInputMapGetAction(DgnInputMap *map, const char *name);
+void dgnInputMapSetGamepad(DgnInputMap *map, uint8_t gamepad);
+// evaluates every action, call once after dgnInputPollEvents
+void dgnInputMapUpdate(DgnInputMap *map);
+float dgnInputMapGetValue(DgnInputMap *map, uint16_t action);
+uint8_t dgnInputMapGetButton(DgnInputMap *map, uint16_t action);
+uint8_t dgnInputMapGetButtonDown(DgnInputMap *map, uint16_t action);
+uint8_t dgnInputMapGetButtonUp(DgnInputMap *map, uint16_t action);
+
+// records every input event until dgnInputRecordStop writes the file
+uint8_t dgnInputRecordStart(const char *filepath);
+uint8_t dgnInputRecordStop();
+// replaces live input with a recording, a fixed_delta of 0 keeps the recorded frame times
+uint8_t dgnInputReplayStart(const char *filepath, double fixed_delta);
+void dgnInputReplayStop();
+// false again once the last recorded frame has been played
+uint8_t dgnInputIsReplaying();
+
+/** ---------------- Loop Functions*/
+
+// fixed rate simulation, at most max_substeps ticks run per frame and the rest is dropped
+DgnLoop *dgnLoopCreate(double tick_delta, uint32_t max_substeps);
+void dgnLoopDestroy(DgnLoop *loop);
+// returns how many ticks to run, step them with while(dgnLoopStep(loop))
+uint32_t dgnLoopBeginFrame(DgnLoop *loop, double frame_delta);
+uint8_t dgnLoopStep(DgnLoop *loop);
+double dgnLoopGetTickDelta(DgnLoop *loop);
+// how far rendering is between the last two ticks, 0 to 1
+float dgnLoopGetAlpha(DgnLoop *loop);
+uint64_t dgnLoopGetTickCount(DgnLoop *loop);
+uint64_t dgnLoopGetDroppedTicks(DgnLoop *loop);
+
+// 0 disables the limiter
+void dgnLoopSetFrameLimit(DgnLoop *loop, double min_frame_time);
+// sleeps then spins until the frame has taken at least the limit
+void dgnLoopWaitFrame(DgnLoop *loop);
+
+/** ---------------- Profile Functions*/
+
+#define DGN_PROFILE_NONE 0xffffffff
+
+// read inline by DGN_PROFILE_SCOPE, so a disabled profiler costs one branch per scope
+extern uint8_t dgn_profile_enabled;
+
+// times the rest of the enclosing block, name must stay valid until the trace is written
+#if defined(__GNUC__) || defined(__clang__)
+void dgnProfileEnd(uint32_t scope);
+// inline so a disabled scope does not pay for a call on the way out either
+static inline void dgnProfileEndScope(uint32_t *scope)
+{
+    if(*scope != DGN_PROFILE_NONE) dgnProfileEnd(*scope);
+}
+#define DGN_PROFILE_CONCAT_INTERNAL(a, b) a##b
+#define DGN_PROFILE_VAR_INTERNAL(line) DGN_PROFILE_CONCAT_INTERNAL(dgn_profile_scope_, line)
+#define DGN_PROFILE_SCOPE(name) \
+    uint32_t DGN_PROFILE_VAR_INTERNAL(__LINE__) __attribute__((cleanup(dgnProfileEndScope))) = \
+        dgn_profile_enabled ? dgnProfileBegin(name) : DGN_PROFILE_NONE
+#else
+#define DGN_PROFILE_SCOPE(name)
+#endif
+
+void dgnProfileSetEnabled(uint8_t enabled);
+uint8_t dgnProfileIsEnabled();
+// shown on the thread's row of the trace, call before the thread's first scope
+void dgnProfileSetThreadName(const char *name);
+
+// scopes must end in reverse order, ending an outer scope also ends the ones inside it
+uint32_t dgnProfileBegin(const char *name);
+void dgnProfileEnd(uint32_t scope);
+
+// ends the calling thread's frame, the summary covers the scopes ended between the last two marks
+void dgnProfileFrameMark();
+// returns how many scopes were written, in depth first order with calls of the same scope merged
+uint32_t dgnProfileGetFrameScopes(DgnProfileScope *out_scopes, uint32_t max_scopes);
+void dgnProfilePrintFrame();
+// every scope still held by any thread, as Chrome trace event json
+uint8_t dgnProfileWriteTrace(const char *filepath);
+
+/** ---------------- Load Timeline Functions*/
+
+// clears the timeline and times every asset load stage until dgnLoadTimelineStop
+void dgnLoadTimelineStart();
+void dgnLoadTimelineStop();
+uint8_t dgnLoadTimelineIsRecording();
+
+void dgnLoadTimelineGetReport(DgnLoadReport *out_report);
+const char *dgnLoadTimelineGetStageName(uint8_t stage);
+// every asset's stages, the totals and the critical path
+void dgnLoadTimelinePrint();
+
+/** ---------------- Render Thread Functions*/
+
+// moves the window's context to a thread that runs submitted packets and swaps after each.
+// packet_count is 2 or 3 for double or triple buffering, 1 runs packets on submit without a thread
+DgnRenderThread *dgnRenderThreadCreate(DgnWindow *window, uint8_t packet_count, uint32_t packet_bytes);
+// runs what was submitted, then gives the context back to the calling thread
+void dgnRenderThreadDestroy(DgnRenderThread *thread);
+
+// waits for a free packet, at most packet_count - 1 frames are ever queued ahead of the gpu
+DgnRenderPacket *dgnRenderThreadBeginPacket(DgnRenderThread *thread);
+// copies size bytes of data into the packet, returns the copy or NULL when the packet is full
+void *dgnRenderPacketPush(DgnRenderPacket *packet, DgnRenderFunc func, void *user_data, const void *data, uint32_t size);
+// ends the calling thread's frame, dgnWindowGetDelta and the frame count advance here
+void dgnRenderThreadSubmit(DgnRenderThread *thread, DgnRenderPacket *packet);
+// waits until every submitted packet has run
+void dgnRenderThreadFlush(DgnRenderThread *thread);
+// seconds the last packet waited for a free slot and the render thread last waited for a packet
+void dgnRenderThreadGetWaitTimes(DgnRenderThread *thread, double *out_submit_wait, double *out_render_wait);
 
 /** ---------------- Window Functions*/
 
 uint8_t dgnWindowCreate(DgnWindow **out_window, uint16_t width, uint16_t height, const char* title);
+// offscreen context, an EGL pbuffer when built with DGN_USE_EGL, otherwise a hidden window
+uint8_t dgnWindowCreateHeadless(DgnWindow **out_window, uint16_t width, uint16_t height, const char* title);
 void dgnWindowDestroy(DgnWindow *window);
 void dgnWindowTerminate();
 
 void dgnWindowMakeCurrent(DgnWindow *window);
 uint8_t dgnWindowShouldClose(DgnWindow *window);
+void dgnWindowClose(DgnWindow *window);
 void dgnWindowSwapBuffers(DgnWindow *window);
 
 uint16_t dgnWindowGetWidth(DgnWindow *window);
@@ -114,6 +375,11 @@ uint16_t dgnWindowGetHeight(DgnWindow *window);
 const char* dgnWindowGetTitle(DgnWindow *window);
 uint64_t dgnWindowGetFrameCount(DgnWindow *window);
 double dgnWindowGetDelta(DgnWindow *window);
+uint8_t dgnWindowIsHeadless(DgnWindow *window);
+
+// reads the default framebuffer, bottom row first, out_rgba must hold width * height * 4 bytes
+uint8_t dgnWindowReadPixels(DgnWindow *window, uint8_t *out_rgba);
+uint8_t dgnWindowSaveFrame(DgnWindow *window, const char *filepath);
 
 void dgnWindowSetRawCursorMode(DgnWindow *window, uint8_t enabled);
 void dgnWindowSetCursorMode(DgnWindow *window, uint32_t cursor_mode);
@@ -123,6 +389,15 @@ void dgnWindowSetHeight(DgnWindow *window, uint16_t new_height);
 void dgnWindowSetSize(DgnWindow *window, uint16_t new_width, uint16_t new_height);
 void dgnWindowSetTitle(DgnWindow *window, const char* new_title);
 
+// frame times are kept for the last frames, changing the capacity clears them
+uint8_t dgnWindowSetStatsCapacity(DgnWindow *window, uint32_t frames);
+// target frame time, frames over twice this are hitches. 0 compares against twice the median
+void dgnWindowSetFrameBudget(DgnWindow *window, float seconds);
+void dgnWindowGetFrameStats(DgnWindow *window, DgnFrameStats *out_stats);
+uint8_t dgnWindowDumpFrameStats(DgnWindow *window, const char *filepath, uint8_t format);
+// bar graph of the history into the bound framebuffer, in pixels from the bottom left
+void dgnWindowDrawFrameStats(DgnWindow *window, uint16_t x, uint16_t y, uint16_t width, uint16_t height);
+
 /** ---------------- Rendering Functions*/
 
 uint8_t dgnRendererInitialize();
@@ -144,8 +419,26 @@ void dgnRendererBindScreenTexture();
 void dgnRendererDrawMesh();
 
 void dgnRendererSetDepthTest(uint16_t func);
+
+// view and projection used by dgnRendererSetModel until changed
+void dgnRendererSetCamera(DgnCamera *cam);
+void dgnRendererSetViewProjection(Mat4x4 view, Mat4x4 projection);
+// uploads uModel, uModelView, uMVP and uNormalMat to the bound shader, whichever it uses
+void dgnRendererSetModel(Mat4x4 model);
+// switches clip depth and the depth clear value for DGN_PROJECTION_REVERSED_Z_INFINITE, depth tests must use GREATER
+uint8_t dgnRendererSetReversedZ(uint8_t enabled);
 void dgnRendererSetClearColor(float red, float green, float blue);
 void dgnRendererSetVsync(uint8_t sync);
+
+// how debug builds catch gl errors, returns false when a callback mode falls back to sampling.
+// the callback modes need GL_KHR_debug, the glGetError modes only check anything in __DEBUG builds
+uint8_t dgnRendererSetDebugMode(uint8_t mode, uint32_t sample_interval);
+uint8_t dgnRendererGetDebugMode();
+
+// counts of the gl calls made by the engine, a frame ends at each swap
+void dgnRendererGetStats(DgnRendererStats *out_stats);
+const char *dgnRendererGetStatName(uint8_t stat);
+void dgnRendererResetStats();
 void dgnRendererSetDrawMode(uint8_t mode);
 void dgnRendererSetLineWidth(float width);
 void dgnRendererSetViewport(uint16_t x, uint16_t y, uint16_t width, uint16_t height);
@@ -161,6 +454,56 @@ void dgnRendererDisableFlag(uint16_t value);
 
 void dgnRendererSetupShadow(DgnShadowMap shadow, DgnShader *shader, int32_t uniform_loc, Mat4x4 light_view_mat);
 
+/** ---------------- Dynamic Resolution Functions ---------------- **/
+
+// target_frame_time is the gpu time in seconds the scene should take
+DgnDynamicResolution *dgnDynamicResolutionCreate(uint16_t width, uint16_t height, double target_frame_time, float min_scale, float max_scale);
+void dgnDynamicResolutionDestroy(DgnDynamicResolution *dyn_res);
+
+// wrap the scaled scene rendering, the scale for the next frame is updated from the timings
+void dgnDynamicResolutionBeginFrame(DgnDynamicResolution *dyn_res);
+void dgnDynamicResolutionEndFrame(DgnDynamicResolution *dyn_res);
+
+void dgnDynamicResolutionSetTarget(DgnDynamicResolution *dyn_res, double target_frame_time);
+void dgnDynamicResolutionSetScale(DgnDynamicResolution *dyn_res, float scale);
+
+float dgnDynamicResolutionGetScale(DgnDynamicResolution *dyn_res);
+double dgnDynamicResolutionGetFrameTime(DgnDynamicResolution *dyn_res);
+uint16_t dgnDynamicResolutionGetWidth(DgnDynamicResolution *dyn_res);
+uint16_t dgnDynamicResolutionGetHeight(DgnDynamicResolution *dyn_res);
+// fraction of the native sized target covered by the scene, for sampling it back
+Vec2 dgnDynamicResolutionGetUVScale(DgnDynamicResolution *dyn_res);
+
+/** ---------------- Render Graph Functions ---------------- **/
+
+// the null backend runs passes without touching gl, for tests and tooling
+DgnRenderGraph *dgnRenderGraphCreate(uint8_t backend);
+void dgnRenderGraphDestroy(DgnRenderGraph *graph);
+// forget this frame's passes and resources, pooled textures are kept for the next frame
+void dgnRenderGraphReset(DgnRenderGraph *graph);
+
+// transient textures only exist between their first and last use and may share memory
+uint16_t dgnRenderGraphCreateTexture(DgnRenderGraph *graph, const char *name, DgnRenderGraphTextureDesc desc);
+// imported textures outlive the graph, passes writing them are never culled
+uint16_t dgnRenderGraphImportTexture(DgnRenderGraph *graph, const char *name, DgnTexture *texture);
+
+uint16_t dgnRenderGraphAddPass(DgnRenderGraph *graph, const char *name, DgnRenderPassFunc execute, void *user_data);
+void dgnRenderGraphPassRead(DgnRenderGraph *graph, uint16_t pass, uint16_t resource);
+void dgnRenderGraphPassWrite(DgnRenderGraph *graph, uint16_t pass, uint16_t resource);
+void dgnRenderGraphPassWriteDepth(DgnRenderGraph *graph, uint16_t pass, uint16_t resource);
+// for passes with results outside the graph, such as drawing to the window
+void dgnRenderGraphPassSetSideEffect(DgnRenderGraph *graph, uint16_t pass);
+
+uint8_t dgnRenderGraphCompile(DgnRenderGraph *graph);
+void dgnRenderGraphExecute(DgnRenderGraph *graph);
+
+// only valid after compiling
+DgnTexture *dgnRenderGraphGetTexture(DgnRenderGraph *graph, uint16_t resource);
+uint8_t dgnRenderGraphIsPassCulled(DgnRenderGraph *graph, uint16_t pass);
+uint16_t dgnRenderGraphGetExecutionOrder(DgnRenderGraph *graph, uint16_t *out_passes);
+uint16_t dgnRenderGraphGetPhysicalTextureCount(DgnRenderGraph *graph);
+size_t dgnRenderGraphGetTransientMemory(DgnRenderGraph *graph);
+
 /** ---------------- Lighting Functions ---------------- **/
 
 // dir must be normalized going in
@@ -168,7 +511,90 @@ Mat4x4 dgnLightingCreateDirViewMat(Vec3 dir);
 Mat4x4 dgnLightingCreateLightSpaceMat(DgnShadowMap shadow);
 DgnTexture *dgnLightingCreateShadowMap(uint16_t width, uint16_t height, uint8_t light_type);
 
-Mat4x4 dgnLightingCreateLightProjMat(DgnCamera cam, DgnShadowMap shadow, DgnFrustum frustum, float near_pull);
+Mat4x4 dgnLightingCreateLightProjMat(DgnCamera *cam, DgnShadowMap shadow, DgnFrustum frustum, float near_pull);
+// fit_flags are DGN_CASCADE_FIT_*, scene_bounds is only used with DGN_CASCADE_FIT_CLAMP_Z which replaces near_pull
+Mat4x4 dgnLightingCreateFittedProjMat(DgnCamera *cam, DgnShadowMap shadow, DgnFrustum frustum, uint8_t fit_flags,
+                                      DgnBoundingBox scene_bounds, float near_pull);
+// cascade_count + 1 depths, log_blend of 0 is uniform and 1 is logarithmic
+void dgnLightingComputeCascadeSplits(float *out_depths, uint8_t cascade_count, float near, float far, float log_blend);
+// cascade_count + 1 depths placed from the view depths the receivers cover between near and far,
+// depths no receiver covers get no share of the cascades
+void dgnLightingFitCascadeSplits(float *out_depths, uint8_t cascade_count, DgnCamera *cam, const DgnBoundingSphere *receivers,
+                                 uint32_t receiver_count, float near, float far, float log_blend);
+// maps light clip space onto the shadow map's area of its texture, apply after the light space matrix
+Mat4x4 dgnLightingCreateAtlasMat(DgnShadowMap shadow);
+// uv bounds of the shadow map's area, inset by half a texel so filtering stays inside it
+Vec4 dgnLightingGetShadowRect(DgnShadowMap shadow);
+
+/** ---------------- Shadow Atlas Functions ---------------- **/
+
+// one depth texture shared by every shadow map, sizes are powers of two
+DgnShadowAtlas *dgnShadowAtlasCreate(uint16_t size, uint16_t min_tile);
+void dgnShadowAtlasDestroy(DgnShadowAtlas *atlas);
+
+void dgnShadowAtlasBeginFrame(DgnShadowAtlas *atlas);
+// returns a handle for this frame, requests that do not fit are halved in order of importance
+uint16_t dgnShadowAtlasRequest(DgnShadowAtlas *atlas, uint16_t size, float importance);
+uint16_t dgnShadowAtlasSizeForScreen(DgnShadowAtlas *atlas, float screen_fraction);
+// returns the number of requests that were placed
+uint16_t dgnShadowAtlasPack(DgnShadowAtlas *atlas);
+// fills the texture, framebuffer and area of map, DGN_FALSE if the request got no space
+uint8_t dgnShadowAtlasGetMap(DgnShadowAtlas *atlas, uint16_t handle, DgnShadowMap *map);
+
+DgnTexture *dgnShadowAtlasGetTexture(DgnShadowAtlas *atlas);
+float dgnShadowAtlasGetUsage(DgnShadowAtlas *atlas);
+
+/** ---------------- EVSM Functions ---------------- **/
+
+// exponential variance shadow moments, laid out like the shadow atlas of the same size
+DgnEvsm *dgnEvsmCreate(uint16_t size);
+void dgnEvsmDestroy(DgnEvsm *evsm);
+
+// binds the moment target and clears the map's area, draw casters with res/std/evsm_moments.frag after
+void dgnEvsmBeginMap(DgnEvsm *evsm, DgnShadowMap shadow);
+// separable gaussian blur limited to the map's area
+void dgnEvsmBlur(DgnEvsm *evsm, DgnShadowMap shadow, uint8_t radius);
+void dgnEvsmGenerateMipmaps(DgnEvsm *evsm);
+
+DgnTexture *dgnEvsmGetTexture(DgnEvsm *evsm);
+
+/** ---------------- Shadow Cache Functions ---------------- **/
+
+// keeps cascades from being redrawn while neither the light matrix nor a caster inside them changed
+DgnShadowCache *dgnShadowCacheCreate(uint8_t cascade_count);
+void dgnShadowCacheDestroy(DgnShadowCache *cache);
+
+void dgnShadowCacheBeginFrame(DgnShadowCache *cache);
+// a changed cascade only updates every interval frames and keeps its old matrix until it does
+void dgnShadowCacheSetInterval(DgnShadowCache *cache, uint8_t cascade, uint8_t interval);
+
+uint8_t dgnShadowCacheNeedsUpdate(DgnShadowCache *cache, uint8_t cascade, Mat4x4 light_space_mat);
+void dgnShadowCacheMarkRendered(DgnShadowCache *cache, uint8_t cascade, Mat4x4 light_space_mat);
+// mark a world space box a caster left or entered, cascades covering it are redrawn
+void dgnShadowCacheMarkDirty(DgnShadowCache *cache, DgnBoundingBox box);
+void dgnShadowCacheInvalidate(DgnShadowCache *cache);
+void dgnShadowCacheInvalidateCascade(DgnShadowCache *cache, uint8_t cascade);
+
+// the matrix the cached map was drawn with, use this when sampling it
+Mat4x4 dgnShadowCacheGetLightSpaceMat(DgnShadowCache *cache, uint8_t cascade);
+
+/** ---------------- Light Cluster Functions ---------------- **/
+
+// view space froxel grid, slices are spaced exponentially between the camera near and far
+DgnLightClusters *dgnLightClustersCreate(uint8_t dim_x, uint8_t dim_y, uint8_t dim_z, uint16_t max_lights);
+void dgnLightClustersDestroy(DgnLightClusters *clusters);
+
+// bins point and spot lights on the cpu, returns DGN_FALSE if a cluster ran out of room
+uint8_t dgnLightClustersBuild(DgnLightClusters *clusters, DgnCamera *cam, DgnLight *lights, uint16_t light_count);
+void dgnLightClustersUpload(DgnLightClusters *clusters);
+// binds the grid, index and light buffers to first_slot and the two slots after
+void dgnLightClustersBind(DgnLightClusters *clusters, uint8_t first_slot);
+
+uint32_t dgnLightClustersGetClusterIndex(DgnLightClusters *clusters, uint8_t x, uint8_t y, uint8_t z);
+const uint16_t *dgnLightClustersGetLights(DgnLightClusters *clusters, uint32_t cluster, uint16_t *out_count);
+uint32_t dgnLightClustersGetIndexCount(DgnLightClusters *clusters);
+uint8_t dgnLightClustersOverflowed(DgnLightClusters *clusters);
+Vec2 dgnLightClustersGetDepthParams(DgnLightClusters *clusters);
 
 /** ---------------- Collision Functions---------------- **/
 
@@ -202,11 +628,67 @@ Vec3 dgnCollisionBoxGetCenter(DgnBoundingBox box);
 Mat4x4 dgnCollisionBoxGetModel(DgnBoundingBox box);
 Mat4x4 dgnCollisionSphereGetModel(DgnBoundingSphere sphere);
 
+/** ---------------- Math Functions ---------------- **/
+
+// batches of any size, output may point at the input except for the shared lhs of dgnMathMulMat4x4Shared
+void dgnMathTransformPoints(const Mat4x4 *mat, const Vec3 *points, Vec3 *out, uint32_t count);
+void dgnMathTransformBoxes(const Mat4x4 *mat, const DgnBoundingBox *boxes, DgnBoundingBox *out, uint32_t count);
+// out[i] = lhs[i] * rhs[i]
+void dgnMathMulMat4x4N(const Mat4x4 *lhs, const Mat4x4 *rhs, Mat4x4 *out, uint32_t count);
+// out[i] = lhs * rhs[i]
+void dgnMathMulMat4x4Shared(const Mat4x4 *lhs, const Mat4x4 *rhs, Mat4x4 *out, uint32_t count);
+// translation * rotation * scale, pos and scale may be NULL
+void dgnMathQuatToMat4x4N(const Quat *rot, const Vec3 *pos, const Vec3 *scale, Mat4x4 *out, uint32_t count);
+// matrices for transforming normals, not normalized
+void dgnMathNormalMatrixN(const Mat4x4 *models, Mat3x3 *out, uint32_t count);
+
+uint8_t dgnMathGetSimdLevel();
+// returns the level actually used, never higher than the cpu supports
+uint8_t dgnMathSetSimdLevel(uint8_t level);
+
+/** ---------------- Transform Functions ---------------- **/
+
+DgnTransforms *dgnTransformsCreate(uint32_t capacity);
+void dgnTransformsDestroy(DgnTransforms *transforms);
+
+// parent is DGN_TRANSFORM_NONE for a root, returns DGN_TRANSFORM_NONE when full
+uint32_t dgnTransformsAdd(DgnTransforms *transforms, uint32_t parent);
+// fails if the new parent is the transform or one of its children
+uint8_t dgnTransformsSetParent(DgnTransforms *transforms, uint32_t handle, uint32_t parent);
+uint32_t dgnTransformsGetParent(DgnTransforms *transforms, uint32_t handle);
+uint32_t dgnTransformsGetCount(DgnTransforms *transforms);
+
+void dgnTransformsSetPosition(DgnTransforms *transforms, uint32_t handle, Vec3 pos);
+void dgnTransformsSetRotation(DgnTransforms *transforms, uint32_t handle, Quat rot);
+void dgnTransformsSetScale(DgnTransforms *transforms, uint32_t handle, Vec3 scale);
+Vec3 dgnTransformsGetPosition(DgnTransforms *transforms, uint32_t handle);
+Quat dgnTransformsGetRotation(DgnTransforms *transforms, uint32_t handle);
+Vec3 dgnTransformsGetScale(DgnTransforms *transforms, uint32_t handle);
+
+// recomputes the world matrices of changed transforms and their children only
+void dgnTransformsUpdate(DgnTransforms *transforms);
+// valid after dgnTransformsUpdate
+const Mat4x4 *dgnTransformsGetWorld(DgnTransforms *transforms, uint32_t handle);
+const Mat4x4 *dgnTransformsGetLocal(DgnTransforms *transforms, uint32_t handle);
+// world matrix was recomputed by the last update
+uint8_t dgnTransformsChanged(DgnTransforms *transforms, uint32_t handle);
+
 /** ---------------- Camera Functions ---------------- **/
 
-Mat4x4 dgnCameraGetProjection(DgnCamera cam);
-Mat4x4 dgnCameraGetView(DgnCamera cam);
-Mat4x4 dgnCameraGetInverseView(DgnCamera cam);
+void dgnCameraInit(DgnCamera *cam);
+void dgnCameraInvalidate(DgnCamera *cam);
+// rebuilds whatever changed since the last call, returns DGN_TRUE if anything did
+uint8_t dgnCameraUpdate(DgnCamera *cam);
+
+const Mat4x4 *dgnCameraGetProjection(DgnCamera *cam);
+const Mat4x4 *dgnCameraGetView(DgnCamera *cam);
+const Mat4x4 *dgnCameraGetViewProjection(DgnCamera *cam);
+const Mat4x4 *dgnCameraGetInverseView(DgnCamera *cam);
+const Mat4x4 *dgnCameraGetInverseProjection(DgnCamera *cam);
+const Mat4x4 *dgnCameraGetInverseViewProjection(DgnCamera *cam);
+const DgnPlane *dgnCameraGetPlanes(DgnCamera *cam);
+// DGN_TRUE if the sphere is completely outside the frustum
+uint8_t dgnCameraCullSphere(DgnCamera *cam, DgnBoundingSphere sphere);
 
 /** ---------------- Mesh Functions ---------------- **/
 
@@ -219,6 +701,13 @@ DgnMesh *dgnMeshCreate(
 
 DgnMesh **dgnMeshLoad(const char *filepath, uint16_t *out_num_meshes);
 
+DgnBoundingSphere dgnMeshGetBoundingSphere(DgnMesh *mesh);
+uint8_t dgnMeshGetLodCount(DgnMesh *mesh);
+uint32_t dgnMeshGetTriangleCount(DgnMesh *mesh, uint8_t lod);
+void dgnMeshSetLod(DgnMesh *mesh, uint8_t lod);
+// picks the level of detail from the projected size of the mesh and keeps it for the next bind
+uint8_t dgnMeshSelectLod(DgnMesh *mesh, Mat4x4 model, DgnCamera *cam);
+
 void dgnMeshDestroy(DgnMesh *mesh);
 void dgnMeshDestroyArr(DgnMesh **meshes, uint16_t num_meshes);
 
@@ -237,6 +726,7 @@ void dgnShaderUniformI(int32_t loc, int value);
 void dgnShaderUniformB(int32_t loc, uint8_t value);
 void dgnShaderUniformV3(int32_t loc, Vec3 value);
 void dgnShaderUniformV2(int32_t loc, Vec2 value);
+void dgnShaderUniformV4(int32_t loc, Vec4 value);
 void dgnShaderUniformM3x3(int32_t loc, Mat3x3 value);
 void dgnShaderUniformM4x4(int32_t loc, Mat4x4 value);
 
@@ -274,6 +764,31 @@ void dgnTextureSetBorderColor(DgnTexture *texture, float r, float g, float b, fl
 
 uint32_t dgnTextureGetWidth(DgnTexture *texture);
 uint32_t dgnTextureGetHeight(DgnTexture *texture);
+// false while a streamer is still loading the texture
+uint8_t dgnTextureIsResident(DgnTexture *texture);
+
+/** ---------------- Texture Streamer Functions ---------------- **/
+
+// decodes pngs on thread_count worker threads and uploads at most frame_upload_budget bytes per update,
+// 0 for no limit. use_pbo stages the uploads through a pixel buffer, it needs a budget.
+// create, update and destroy on the thread holding the context
+DgnTextureStreamer *dgnTextureStreamerCreate(uint8_t thread_count, uint32_t frame_upload_budget, uint8_t use_pbo);
+// textures still loading keep a placeholder of their own
+void dgnTextureStreamerDestroy(DgnTextureStreamer *streamer);
+
+// these return straight away without gl calls, the texture shows a shared placeholder,
+// then a small preview once decoded and the full image once every row is uploaded.
+// a file that fails to load turns magenta
+DgnTexture *dgnTextureStreamerLoad(DgnTextureStreamer *streamer, const char *filepath, uint8_t wrapping, uint8_t filtering,
+                                   uint8_t mipmapped, uint16_t storage_type);
+DgnTexture *dgnTextureStreamerLoadCubemap(DgnTextureStreamer *streamer, const char *filepath[6], uint8_t wrapping,
+                                          uint8_t filtering, uint16_t storage_type);
+
+// once per frame, uploads decoded images within the budget
+void dgnTextureStreamerUpdate(DgnTextureStreamer *streamer);
+void dgnTextureStreamerSetBudget(DgnTextureStreamer *streamer, uint32_t frame_upload_budget);
+// loads that are not resident yet
+uint32_t dgnTextureStreamerGetPending(DgnTextureStreamer *streamer);
 
 /** ---------------- FrameBuffer Functions ---------------- **/
 
@@ -376,11 +891,61 @@ void dgnFramebufferBind(DgnFramebuffer *buffer);
 
 #define DGN_FRAMEBUFFER_DEPTH 0x01
 #define DGN_FRAMEBUFFER_COLOR 0X02
+// with DGN_FRAMEBUFFER_DEPTH, a float depth buffer for reversed depth
+#define DGN_FRAMEBUFFER_DEPTH_FLOAT 0x04
+
+#define DGN_RENDER_GRAPH_BACKEND_GL 0x00
+#define DGN_RENDER_GRAPH_BACKEND_NULL 0x01
+#define DGN_RENDER_GRAPH_INVALID 0xFFFF
+
+#define DGN_SHADOW_ATLAS_NONE 0xFFFF
+
+// must match the constants in res/std/shadow.glh
+#define DGN_EVSM_POSITIVE_EXPONENT 40.0f
+#define DGN_EVSM_NEGATIVE_EXPONENT 5.0f
 
 #define DGN_LIGHT_TYPE_DIR 0X00
 #define DGN_LIGHT_TYPE_POINT 0X01
 #define DGN_LIGHT_TYPE_SPOT 0X02
 
+#define DGN_CASCADE_FIT_SPHERE 0x00
+#define DGN_CASCADE_FIT_AABB 0x01
+#define DGN_CASCADE_FIT_CLAMP_Z 0x02
+
+#define DGN_SIMD_SCALAR 0x00
+#define DGN_SIMD_SSE 0x01
+#define DGN_SIMD_AVX 0x02
+
+#define DGN_TRANSFORM_NONE 0xFFFFFFFF
+
+#define DGN_INPUT_ACTION_NONE 0xFFFF
+
+// glGetError around every glCall, exact but it stalls the driver on each call
+#define DGN_GL_DEBUG_GET_ERROR 0x00
+// glGetError after every sample_interval glCalls
+#define DGN_GL_DEBUG_SAMPLED 0x01
+// the driver reports from inside the failing call, so the glCall location is known
+#define DGN_GL_DEBUG_CALLBACK_SYNC 0x02
+// the driver reports when it gets to it, the cheapest, objects are named by their labels
+#define DGN_GL_DEBUG_CALLBACK_ASYNC 0x03
+#define DGN_GL_DEBUG_OFF 0x04
+// glCalls between checks for DGN_GL_DEBUG_SAMPLED, debug builds start sampling at this
+#define DGN_GL_DEBUG_SAMPLE_INTERVAL 64
+
+#define DGN_FRAME_STATS_CSV 0x00
+#define DGN_FRAME_STATS_JSON 0x01
+
+#define DGN_PROJECTION_STANDARD 0x00
+// depth 1 at the near plane and 0 at infinity, needs dgnRendererSetReversedZ
+#define DGN_PROJECTION_REVERSED_Z_INFINITE 0x01
+
+#define DGN_FRUSTUM_PLANE_LEFT 0
+#define DGN_FRUSTUM_PLANE_RIGHT 1
+#define DGN_FRUSTUM_PLANE_BOTTOM 2
+#define DGN_FRUSTUM_PLANE_TOP 3
+#define DGN_FRUSTUM_PLANE_NEAR 4
+#define DGN_FRUSTUM_PLANE_FAR 5
+
 /* The unknown key */
 #define DGN_KEY_UNKNOWN            -1
 
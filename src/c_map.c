@@ -144,69 +144,46 @@ size_t orderedMapSGetCount(OrderedMapS *map)
     return map->count;
 }
 
-uint8_t orderedMapSAtKey_internal(OrderedMapS *map, const char *key, MapElementS *out_element, size_t *out_index)
+// index of the first element whose key is not less than key
+static size_t orderedMapSLowerBound_internal(OrderedMapS *map, const char *key)
 {
-    if(map == NULL) return 0;
-    if(map->elements == NULL) return 0;
-
     size_t lower_bound = 0;
     size_t upper_bound = map->count;
-    upper_bound = upper_bound > 0 ? upper_bound - 1 : 0;
-    size_t current_index = 0;
-    size_t neighbor_index = 0;
 
-    // go to middle
-    // check two surrounding values
-    //      special cases for ends
-    // repeat until bottom bound and top bound are the same
-
-    while(1)
+    while(lower_bound < upper_bound)
     {
+        size_t current_index = lower_bound + (upper_bound - lower_bound) / 2;
 
-        // ints always truncate, or floor for unsigned
-        // average top and bottom bound to find midpoint
-        current_index = (lower_bound + upper_bound) / 2;
-        neighbor_index = current_index + 1;
-
-        int cmp1 = 0;
-        int cmp2 = 0;
-
-        cmp1 = strcmp(key, map->elements[current_index].key);
-
-        if(neighbor_index >= map->count) // at end of array
+        if(strcmp(map->elements[current_index].key, key) < 0)
         {
-            cmp2 = -1;
+            lower_bound = current_index + 1;
         }
         else
-        {
-            cmp2 = strcmp(key, map->elements[neighbor_index].key);
-        }
-
-        if(cmp1 > 0 && cmp2 < 0) // goes between the values, does not exist
-        {
-            return 0;
-        }
-        else if(cmp1 > 0 && cmp2 > 0) // goes later in the list
-        {
-            lower_bound = neighbor_index;
-        }
-        else if(cmp1 < 0 && cmp2 < 0) // goes later in the list
         {
             upper_bound = current_index;
         }
-        else if(cmp1 == 0 || cmp2 == 0)  // value correct value
-        {
-            size_t target_index = cmp1 == 0 ? current_index : neighbor_index;
+    }
 
-            if(out_element)
-                *out_element = map->elements[target_index];
-            if(out_index)
-                *out_index = target_index;
-            return 1;
-        }
+    return lower_bound;
+}
+
+uint8_t orderedMapSAtKey_internal(OrderedMapS *map, const char *key, MapElementS *out_element, size_t *out_index)
+{
+    if(map == NULL) return 0;
+    if(map->elements == NULL) return 0;
+
+    size_t target_index = orderedMapSLowerBound_internal(map, key);
+
+    if(target_index >= map->count || strcmp(map->elements[target_index].key, key) != 0)
+    {
+        return 0;
     }
 
-    return 0;
+    if(out_element)
+        *out_element = map->elements[target_index];
+    if(out_index)
+        *out_index = target_index;
+    return 1;
 }
 
 uint8_t orderedMapSAtIndex_internal(OrderedMapS *map, size_t i, MapElementS *out_element)
@@ -228,13 +205,6 @@ void orderedMapSInsert_internal(OrderedMapS *map, const char *key, void *value,
 {
     if(map == NULL) return;
 
-    size_t lower_bound = 0;
-    size_t upper_bound = map->count;
-    upper_bound = upper_bound > 0 ? upper_bound - 1 : 0;
-    size_t current_index = 0;
-    size_t neighbor_index = 0;
-    size_t target_index = 0;
-
     MapElementS element;
     element.key = key;
     element.value_size = sizeof_value;
@@ -245,69 +215,22 @@ void orderedMapSInsert_internal(OrderedMapS *map, const char *key, void *value,
         *(int8_t*)(element.value + i) = *(int8_t*)(value + i);
     }
 
-    // go to middle
-    // check two surrounding values
-    //      special cases for ends
-    // repeat until bottom bound and top bound are the same
+    size_t target_index = orderedMapSLowerBound_internal(map, key);
 
-    while(1)
+    if(target_index < map->count && strcmp(map->elements[target_index].key, key) == 0)
     {
-        // at the beginning of array
-        if(upper_bound == lower_bound && upper_bound == 0)
-        {
-            target_index = 0;
-            break;
-        }
-
-        // ints always truncate, or floor for unsigned
-        // average top and bottom bound to find midpoint
-        current_index = (lower_bound + upper_bound) / 2;
-        neighbor_index = current_index + 1;
-
-        int cmp1 = 0;
-        int cmp2 = 0;
-
-        if(neighbor_index >= map->count) // at end of array
+        if(replace)
         {
-            cmp2 = -1;
+            free(map->elements[target_index].value);
+            map->elements[target_index] = element;
         }
         else
         {
-            cmp2 = strcmp(key, map->elements[neighbor_index].key);
-        }
-
-        cmp1 = strcmp(key, map->elements[current_index].key);
-
-        if(cmp1 > 0 && cmp2 < 0) // goes between the values, correct index
-        {
-            target_index = neighbor_index;
-            break;
-        }
-        else if(cmp1 > 0 && cmp2 > 0) // goes later in the list
-        {
-            lower_bound = neighbor_index;
-        }
-        else if(cmp1 < 0 && cmp2 < 0) // goes later in the list
-        {
-            upper_bound = current_index;
-        }
-        else if(cmp1 == 0 || cmp2 == 0)  // value already exists
-        {
-            if(replace)
-            {
-                target_index = cmp1 == 0 ? current_index : neighbor_index;
-                free(map->elements[target_index].value);
-                map->elements[target_index] = element;
-                return;
-            }
-            else
-            {
-                return;
-            }
+            free(element.value);
         }
+        return;
     }
 
-
     // set the array at correct index to key-value pair
 
     // make room for the new element
@@ -1,29 +1,268 @@
 #include "d_internal.h"
 #include "DgnEngine/DgnEngine.h"
 
-Mat4x4 dgnCameraGetProjection(DgnCamera cam)
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+void dgnCameraInit(DgnCamera *cam)
+{
+    memset(cam, 0, sizeof(*cam));
+
+    cam->rot = (Quat){0.0f, 0.0f, 0.0f, 1.0f};
+    cam->projection = DGN_PROJECTION_STANDARD;
+}
+
+void dgnCameraInvalidate(DgnCamera *cam)
 {
-    return m3dMat4x4InitPerspective(cam.frustum.width, cam.frustum.height, cam.frustum.fov, cam.frustum.near, cam.frustum.far);
+    cam->cache.view_valid = DGN_FALSE;
+    cam->cache.proj_valid = DGN_FALSE;
 }
 
-Mat4x4 dgnCameraGetView(DgnCamera cam)
+/** ---- Building ---- **/
+
+static Mat4x4 buildViewInternal(Vec3 cam_pos, Quat cam_rot)
 {
     Mat4x4 pos = m3dMat4x4InitIdentity();
     Mat4x4 rot = m3dMat4x4InitIdentity();
 
-    m3dMat4x4Translate(&pos, m3dVec3MulValue(cam.pos, -1));
-    m3dMat4x4Rotate(&rot, m3dQuatConjugate(cam.rot));
+    m3dMat4x4Translate(&pos, m3dVec3MulValue(cam_pos, -1));
+    m3dMat4x4Rotate(&rot, m3dQuatConjugate(cam_rot));
 
     return m3dMat4x4MulMat4x4(rot, pos);
 }
 
-Mat4x4 dgnCameraGetInverseView(DgnCamera cam)
+static Mat4x4 buildInverseViewInternal(Vec3 cam_pos, Quat cam_rot)
 {
     Mat4x4 pos = m3dMat4x4InitIdentity();
     Mat4x4 rot = m3dMat4x4InitIdentity();
 
-    m3dMat4x4Translate(&pos, cam.pos);
-    m3dMat4x4Rotate(&rot, cam.rot);
+    m3dMat4x4Translate(&pos, cam_pos);
+    m3dMat4x4Rotate(&rot, cam_rot);
 
     return m3dMat4x4MulMat4x4(pos, rot);
 }
+
+// near maps to 1 and infinity to 0, needs the zero to one clip range from dgnRendererSetReversedZ
+static Mat4x4 buildReversedInfiniteInternal(DgnFrustum frustum)
+{
+    float f = 1.0f / tanf(frustum.fov / 2.0f);
+    Mat4x4 res = {{{0}}};
+
+    res.m[0][0] = f * frustum.height / frustum.width;
+    res.m[1][1] = f;
+    res.m[2][3] = frustum.near;
+    res.m[3][2] = -1.0f;
+
+    return res;
+}
+
+static Mat4x4 invertInternal(Mat4x4 a)
+{
+    const float *m = &a.m[0][0];
+    float inv[16];
+
+    inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+    inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+    inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+    inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+    inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+    inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+    inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+    inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+    inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+    inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+    inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+    inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+    inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+    inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+    inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+    inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+    float det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+    Mat4x4 res;
+
+    if(det == 0.0f)
+    {
+        return m3dMat4x4InitIdentity();
+    }
+
+    det = 1.0f / det;
+    for(int i = 0; i < 16; i++)
+    {
+        (&res.m[0][0])[i] = inv[i] * det;
+    }
+
+    return res;
+}
+
+// a * row_a + b * row_b of the view projection as a normalized plane
+static DgnPlane planeFromRowsInternal(const Mat4x4 *m, int row_a, float a, int row_b, float b)
+{
+    float p[4];
+    for(int c = 0; c < 4; c++)
+    {
+        p[c] = a * m->m[row_a][c] + b * m->m[row_b][c];
+    }
+
+    float len = sqrtf(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+    DgnPlane res;
+
+    // the far plane of an infinite projection, nothing is ever behind it
+    if(len < 1e-6f)
+    {
+        res.normal = (Vec3){0.0f, 0.0f, 0.0f};
+        res.distance = -FLT_MAX;
+        return res;
+    }
+
+    res.normal = (Vec3){p[0] / len, p[1] / len, p[2] / len};
+    res.distance = -p[3] / len;
+
+    return res;
+}
+
+static void extractPlanesInternal(DgnCameraCache *cache, uint8_t projection)
+{
+    const Mat4x4 *vp = &cache->view_projection;
+
+    cache->planes[DGN_FRUSTUM_PLANE_LEFT] = planeFromRowsInternal(vp, 3, 1.0f, 0, 1.0f);
+    cache->planes[DGN_FRUSTUM_PLANE_RIGHT] = planeFromRowsInternal(vp, 3, 1.0f, 0, -1.0f);
+    cache->planes[DGN_FRUSTUM_PLANE_BOTTOM] = planeFromRowsInternal(vp, 3, 1.0f, 1, 1.0f);
+    cache->planes[DGN_FRUSTUM_PLANE_TOP] = planeFromRowsInternal(vp, 3, 1.0f, 1, -1.0f);
+
+    if(projection == DGN_PROJECTION_REVERSED_Z_INFINITE)
+    {
+        // clip z runs from w at the near plane down to 0 at infinity
+        cache->planes[DGN_FRUSTUM_PLANE_NEAR] = planeFromRowsInternal(vp, 3, 1.0f, 2, -1.0f);
+        cache->planes[DGN_FRUSTUM_PLANE_FAR] = planeFromRowsInternal(vp, 2, 1.0f, 2, 0.0f);
+    }
+    else
+    {
+        cache->planes[DGN_FRUSTUM_PLANE_NEAR] = planeFromRowsInternal(vp, 3, 1.0f, 2, 1.0f);
+        cache->planes[DGN_FRUSTUM_PLANE_FAR] = planeFromRowsInternal(vp, 3, 1.0f, 2, -1.0f);
+    }
+}
+
+/** ---- Cache ---- **/
+
+static uint8_t viewChangedInternal(const DgnCamera *cam)
+{
+    const DgnCameraCache *c = &cam->cache;
+
+    return !c->view_valid ||
+           c->pos.x != cam->pos.x || c->pos.y != cam->pos.y || c->pos.z != cam->pos.z ||
+           c->rot.x != cam->rot.x || c->rot.y != cam->rot.y || c->rot.z != cam->rot.z || c->rot.w != cam->rot.w;
+}
+
+static uint8_t projectionChangedInternal(const DgnCamera *cam)
+{
+    const DgnCameraCache *c = &cam->cache;
+
+    return !c->proj_valid || c->projection_type != cam->projection ||
+           c->frustum.fov != cam->frustum.fov || c->frustum.near != cam->frustum.near || c->frustum.far != cam->frustum.far ||
+           c->frustum.width != cam->frustum.width || c->frustum.height != cam->frustum.height;
+}
+
+uint8_t dgnCameraUpdate(DgnCamera *cam)
+{
+    DgnCameraCache *c = &cam->cache;
+    uint8_t view_changed = viewChangedInternal(cam);
+    uint8_t proj_changed = projectionChangedInternal(cam);
+
+    if(!view_changed && !proj_changed)
+    {
+        return DGN_FALSE;
+    }
+
+    if(view_changed)
+    {
+        c->pos = cam->pos;
+        c->rot = cam->rot;
+        c->view = buildViewInternal(cam->pos, cam->rot);
+        c->inverse_view = buildInverseViewInternal(cam->pos, cam->rot);
+        c->view_valid = DGN_TRUE;
+    }
+
+    if(proj_changed)
+    {
+        c->frustum = cam->frustum;
+        c->projection_type = cam->projection;
+
+        if(cam->projection == DGN_PROJECTION_REVERSED_Z_INFINITE)
+        {
+            c->projection = buildReversedInfiniteInternal(cam->frustum);
+        }
+        else
+        {
+            c->projection = m3dMat4x4InitPerspective(cam->frustum.width, cam->frustum.height, cam->frustum.fov,
+                                                     cam->frustum.near, cam->frustum.far);
+        }
+
+        c->inverse_projection = invertInternal(c->projection);
+        c->proj_valid = DGN_TRUE;
+    }
+
+    dgnMathMulMat4x4N(&c->projection, &c->view, &c->view_projection, 1);
+    dgnMathMulMat4x4N(&c->inverse_view, &c->inverse_projection, &c->inverse_view_projection, 1);
+    extractPlanesInternal(c, cam->projection);
+
+    return DGN_TRUE;
+}
+
+const Mat4x4 *dgnCameraGetProjection(DgnCamera *cam)
+{
+    dgnCameraUpdate(cam);
+    return &cam->cache.projection;
+}
+
+const Mat4x4 *dgnCameraGetView(DgnCamera *cam)
+{
+    dgnCameraUpdate(cam);
+    return &cam->cache.view;
+}
+
+const Mat4x4 *dgnCameraGetInverseView(DgnCamera *cam)
+{
+    dgnCameraUpdate(cam);
+    return &cam->cache.inverse_view;
+}
+
+const Mat4x4 *dgnCameraGetInverseProjection(DgnCamera *cam)
+{
+    dgnCameraUpdate(cam);
+    return &cam->cache.inverse_projection;
+}
+
+const Mat4x4 *dgnCameraGetViewProjection(DgnCamera *cam)
+{
+    dgnCameraUpdate(cam);
+    return &cam->cache.view_projection;
+}
+
+const Mat4x4 *dgnCameraGetInverseViewProjection(DgnCamera *cam)
+{
+    dgnCameraUpdate(cam);
+    return &cam->cache.inverse_view_projection;
+}
+
+const DgnPlane *dgnCameraGetPlanes(DgnCamera *cam)
+{
+    dgnCameraUpdate(cam);
+    return cam->cache.planes;
+}
+
+uint8_t dgnCameraCullSphere(DgnCamera *cam, DgnBoundingSphere sphere)
+{
+    const DgnPlane *planes = dgnCameraGetPlanes(cam);
+
+    for(int i = 0; i < 6; i++)
+    {
+        if(dgnCollisionDistFromPlane(sphere.center, planes[i]) < -sphere.radius)
+        {
+            return DGN_TRUE;
+        }
+    }
+
+    return DGN_FALSE;
+}
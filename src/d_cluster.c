@@ -0,0 +1,560 @@
+#include "d_internal.h"
+#include "DgnEngine/DgnEngine.h"
+
+#include <MemLeaker/malloc.h>
+
+#include <math.h>
+#include <string.h>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif // __SSE__
+
+// per cluster bin size, lights past this in one cluster are dropped and counted
+#define MAX_LIGHTS_PER_CLUSTER 128
+// texels per light in the light data buffer
+#define LIGHT_TEXELS 3
+// cone given to point lights so the spot falloff is always 1
+#define POINT_LIGHT_INNER -1.0f
+#define POINT_LIGHT_OUTER -2.0f
+
+struct LightBoundsInternal
+{
+    // view space, depth is positive going into the screen
+    float x, y, depth;
+    float radius;
+
+    uint8_t visible;
+    uint8_t x0, x1;
+    uint8_t y0, y1;
+    uint8_t z0, z1;
+};
+
+struct DgnLightClusters
+{
+    uint8_t dim_x;
+    uint8_t dim_y;
+    uint8_t dim_z;
+    uint32_t cluster_count;
+    uint16_t max_lights;
+
+    // view space bounds, only rebuilt when the frustum changes
+    uint8_t bounds_valid;
+    DgnFrustum frustum;
+    float proj_x;
+    float proj_y;
+    float log_depth_scale;
+    float *cluster_min_x;
+    float *cluster_max_x;
+    float *row_min_y;
+    float *row_max_y;
+    float *slice_depths;
+
+    Mat4x4 view;
+    DgnLight *lights;
+    // light bounding sphere centers, world space and then view space
+    Vec3 *centers;
+    struct LightBoundsInternal *bounds;
+    uint16_t light_count;
+
+    // fixed size bins filled per depth slice, then compacted into grid and indices
+    uint16_t *bin_counts;
+    uint16_t *bin_lights;
+    uint8_t *slice_overflow;
+    uint8_t overflowed;
+
+    uint32_t *grid;
+    uint16_t *indices;
+    uint32_t index_count;
+    float *light_data;
+
+    // grid, indices and light data as texture buffers
+    uint8_t gpu_created;
+    uint32_t tbo_buffers[3];
+    uint32_t tbo_textures[3];
+};
+
+static float clampf(float v, float lo, float hi)
+{
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+DgnLightClusters *dgnLightClustersCreate(uint8_t dim_x, uint8_t dim_y, uint8_t dim_z, uint16_t max_lights)
+{
+    if(dim_x == 0 || dim_y == 0 || dim_z == 0 || max_lights == 0)
+    {
+        logError("LIGHT CLUSTERS", "Cluster grid and light count must not be empty");
+        return NULL;
+    }
+
+    DgnLightClusters *res = malloc(sizeof(*res));
+
+    if(res == NULL)
+    {
+        return NULL;
+    }
+
+    memset(res, 0, sizeof(*res));
+
+    res->dim_x = dim_x;
+    res->dim_y = dim_y;
+    res->dim_z = dim_z;
+    res->cluster_count = (uint32_t)dim_x * dim_y * dim_z;
+    res->max_lights = max_lights;
+
+    res->cluster_min_x = malloc(sizeof(float) * res->cluster_count);
+    res->cluster_max_x = malloc(sizeof(float) * res->cluster_count);
+    res->row_min_y = malloc(sizeof(float) * dim_y * dim_z);
+    res->row_max_y = malloc(sizeof(float) * dim_y * dim_z);
+    res->slice_depths = malloc(sizeof(float) * (dim_z + 1));
+    res->slice_overflow = malloc(dim_z);
+
+    res->lights = malloc(sizeof(DgnLight) * max_lights);
+    res->bounds = malloc(sizeof(struct LightBoundsInternal) * max_lights);
+    res->centers = malloc(sizeof(Vec3) * max_lights);
+
+    res->bin_counts = malloc(sizeof(uint16_t) * res->cluster_count);
+    res->bin_lights = malloc(sizeof(uint16_t) * res->cluster_count * MAX_LIGHTS_PER_CLUSTER);
+    res->grid = malloc(sizeof(uint32_t) * 2 * res->cluster_count);
+    res->indices = malloc(sizeof(uint16_t) * res->cluster_count * MAX_LIGHTS_PER_CLUSTER);
+    res->light_data = malloc(sizeof(float) * 4 * LIGHT_TEXELS * max_lights);
+
+    if(!res->cluster_min_x || !res->cluster_max_x || !res->row_min_y || !res->row_max_y || !res->slice_depths || !res->slice_overflow ||
+       !res->lights || !res->bounds || !res->centers || !res->bin_counts || !res->bin_lights || !res->grid || !res->indices ||
+       !res->light_data)
+    {
+        logError("LIGHT CLUSTERS", "Could not allocate cluster storage");
+        dgnLightClustersDestroy(res);
+        return NULL;
+    }
+
+    memset(res->grid, 0, sizeof(uint32_t) * 2 * res->cluster_count);
+
+    return res;
+}
+
+void dgnLightClustersDestroy(DgnLightClusters *clusters)
+{
+    if(clusters->gpu_created)
+    {
+        glCall(glDeleteTextures(3, clusters->tbo_textures));
+        glCall(glDeleteBuffers(3, clusters->tbo_buffers));
+    }
+
+    free(clusters->cluster_min_x);
+    free(clusters->cluster_max_x);
+    free(clusters->row_min_y);
+    free(clusters->row_max_y);
+    free(clusters->slice_depths);
+    free(clusters->slice_overflow);
+    free(clusters->lights);
+    free(clusters->bounds);
+    free(clusters->centers);
+    free(clusters->bin_counts);
+    free(clusters->bin_lights);
+    free(clusters->grid);
+    free(clusters->indices);
+    free(clusters->light_data);
+
+    free(clusters);
+}
+
+/** ---- Cluster bounds ---- **/
+
+static void buildClusterBoundsInternal(DgnLightClusters *clusters, DgnFrustum frustum, float proj_x, float proj_y)
+{
+    clusters->frustum = frustum;
+    clusters->proj_x = proj_x;
+    clusters->proj_y = proj_y;
+    clusters->log_depth_scale = clusters->dim_z / logf(frustum.far / frustum.near);
+
+    // exponential slices keep clusters roughly cube shaped along the view
+    for(uint8_t z = 0; z <= clusters->dim_z; z++)
+    {
+        clusters->slice_depths[z] = frustum.near * powf(frustum.far / frustum.near, (float)z / clusters->dim_z);
+    }
+
+    for(uint8_t z = 0; z < clusters->dim_z; z++)
+    {
+        float dn = clusters->slice_depths[z];
+        float df = clusters->slice_depths[z + 1];
+
+        for(uint8_t y = 0; y < clusters->dim_y; y++)
+        {
+            // ndc edges of the tile, view space extents grow with depth
+            float ny0 = -1.0f + 2.0f * y / clusters->dim_y;
+            float ny1 = -1.0f + 2.0f * (y + 1) / clusters->dim_y;
+            uint32_t row = (uint32_t)z * clusters->dim_y + y;
+
+            clusters->row_min_y[row] = fminf(ny0 * dn, ny0 * df) / proj_y;
+            clusters->row_max_y[row] = fmaxf(ny1 * dn, ny1 * df) / proj_y;
+
+            for(uint8_t x = 0; x < clusters->dim_x; x++)
+            {
+                float nx0 = -1.0f + 2.0f * x / clusters->dim_x;
+                float nx1 = -1.0f + 2.0f * (x + 1) / clusters->dim_x;
+                uint32_t c = row * clusters->dim_x + x;
+
+                clusters->cluster_min_x[c] = fminf(nx0 * dn, nx0 * df) / proj_x;
+                clusters->cluster_max_x[c] = fmaxf(nx1 * dn, nx1 * df) / proj_x;
+            }
+        }
+    }
+}
+
+/** ---- Light bounds ---- **/
+
+// conservative ndc range of a sphere along one axis, center and radius in view space
+static void sphereNdcRangeInternal(float c, float r, float dmin, float dmax, float proj, float *out_min, float *out_max)
+{
+    float lo = c - r;
+    float hi = c + r;
+
+    *out_min = (lo < 0.0f ? lo / dmin : lo / dmax) * proj;
+    *out_max = (hi > 0.0f ? hi / dmin : hi / dmax) * proj;
+}
+
+static void lightBoundsJobInternal(uint32_t begin, uint32_t end, void *user_data)
+{
+    DgnLightClusters *clusters = user_data;
+    DgnFrustum frustum = clusters->frustum;
+
+    for(uint32_t i = begin; i < end; i++)
+    {
+        DgnLight light = clusters->lights[i];
+        struct LightBoundsInternal *b = &clusters->bounds[i];
+
+        Vec3 center = light.position;
+        float radius = light.range;
+
+        // bounding sphere of the cone
+        if(light.type == DGN_LIGHT_TYPE_SPOT)
+        {
+            float cos_a = cosf(light.outer_angle);
+
+            if(light.outer_angle <= PI / 4.0f)
+            {
+                radius = light.range / (2.0f * cos_a);
+                center = m3dVec3AddVec3(light.position, m3dVec3MulValue(light.direction, radius));
+            }
+            else
+            {
+                center = m3dVec3AddVec3(light.position, m3dVec3MulValue(light.direction, light.range * cos_a));
+                radius = light.range * sinf(light.outer_angle);
+            }
+        }
+
+        clusters->centers[i] = center;
+        b->radius = radius;
+    }
+
+    // the whole batch goes to view space at once
+    dgnMathTransformPoints(&clusters->view, clusters->centers + begin, clusters->centers + begin, end - begin);
+
+    for(uint32_t i = begin; i < end; i++)
+    {
+        DgnLight light = clusters->lights[i];
+        struct LightBoundsInternal *b = &clusters->bounds[i];
+        Vec3 v = clusters->centers[i];
+        float radius = b->radius;
+
+        b->x = v.x;
+        b->y = v.y;
+        b->depth = -v.z;
+
+        float dmin = b->depth - radius;
+        float dmax = b->depth + radius;
+
+        b->visible = light.type != DGN_LIGHT_TYPE_DIR && dmax > frustum.near && dmin < frustum.far;
+
+        if(!b->visible) continue;
+
+        dmin = fmaxf(dmin, frustum.near);
+        dmax = fminf(dmax, frustum.far);
+
+        float nx0, nx1, ny0, ny1;
+        sphereNdcRangeInternal(b->x, radius, dmin, dmax, clusters->proj_x, &nx0, &nx1);
+        sphereNdcRangeInternal(b->y, radius, dmin, dmax, clusters->proj_y, &ny0, &ny1);
+
+        if(nx1 < -1.0f || nx0 > 1.0f || ny1 < -1.0f || ny0 > 1.0f)
+        {
+            b->visible = DGN_FALSE;
+            continue;
+        }
+
+        float fx = clusters->dim_x * 0.5f;
+        float fy = clusters->dim_y * 0.5f;
+
+        b->x0 = (uint8_t)clampf((nx0 + 1.0f) * fx, 0.0f, clusters->dim_x - 1);
+        b->x1 = (uint8_t)clampf((nx1 + 1.0f) * fx, 0.0f, clusters->dim_x - 1);
+        b->y0 = (uint8_t)clampf((ny0 + 1.0f) * fy, 0.0f, clusters->dim_y - 1);
+        b->y1 = (uint8_t)clampf((ny1 + 1.0f) * fy, 0.0f, clusters->dim_y - 1);
+        b->z0 = (uint8_t)clampf(logf(dmin / frustum.near) * clusters->log_depth_scale, 0.0f, clusters->dim_z - 1);
+        b->z1 = (uint8_t)clampf(logf(dmax / frustum.near) * clusters->log_depth_scale, 0.0f, clusters->dim_z - 1);
+    }
+}
+
+/** ---- Binning ---- **/
+
+static void binLightInternal(DgnLightClusters *clusters, uint32_t cluster, uint16_t light, uint32_t slice)
+{
+    uint16_t count = clusters->bin_counts[cluster];
+
+    if(count >= MAX_LIGHTS_PER_CLUSTER)
+    {
+        clusters->slice_overflow[slice] = DGN_TRUE;
+        return;
+    }
+
+    clusters->bin_lights[cluster * MAX_LIGHTS_PER_CLUSTER + count] = light;
+    clusters->bin_counts[cluster] = count + 1;
+}
+
+// one job per depth slice, so no two threads ever write the same cluster
+static void binSliceJobInternal(uint32_t begin, uint32_t end, void *user_data)
+{
+    DgnLightClusters *clusters = user_data;
+
+    for(uint32_t z = begin; z < end; z++)
+    {
+        uint32_t slice_start = z * clusters->dim_y * clusters->dim_x;
+        memset(clusters->bin_counts + slice_start, 0, sizeof(uint16_t) * clusters->dim_y * clusters->dim_x);
+        clusters->slice_overflow[z] = DGN_FALSE;
+
+        float dn = clusters->slice_depths[z];
+        float df = clusters->slice_depths[z + 1];
+
+        for(uint16_t l = 0; l < clusters->light_count; l++)
+        {
+            struct LightBoundsInternal *b = &clusters->bounds[l];
+
+            if(!b->visible || z < b->z0 || z > b->z1) continue;
+
+            float r2 = b->radius * b->radius;
+
+            // the depth and y distances are shared by a whole row of clusters
+            float dz = fmaxf(fmaxf(dn - b->depth, b->depth - df), 0.0f);
+
+            for(uint32_t y = b->y0; y <= b->y1; y++)
+            {
+                uint32_t row = z * clusters->dim_y + y;
+                float dy = fmaxf(fmaxf(clusters->row_min_y[row] - b->y, b->y - clusters->row_max_y[row]), 0.0f);
+                float dyz2 = dy * dy + dz * dz;
+
+                if(dyz2 > r2) continue;
+
+                uint32_t row_start = row * clusters->dim_x;
+                uint32_t x = b->x0;
+
+#ifdef __SSE__
+                __m128 cx = _mm_set1_ps(b->x);
+                __m128 rem = _mm_set1_ps(r2 - dyz2);
+                __m128 zero = _mm_setzero_ps();
+
+                for(; x + 4 <= (uint32_t)b->x1 + 1; x += 4)
+                {
+                    __m128 lo = _mm_loadu_ps(clusters->cluster_min_x + row_start + x);
+                    __m128 hi = _mm_loadu_ps(clusters->cluster_max_x + row_start + x);
+                    __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(lo, cx), _mm_sub_ps(cx, hi)), zero);
+                    int mask = _mm_movemask_ps(_mm_cmple_ps(_mm_mul_ps(dx, dx), rem));
+
+                    for(int k = 0; k < 4; k++)
+                    {
+                        if(mask & (1 << k)) binLightInternal(clusters, row_start + x + k, l, z);
+                    }
+                }
+#endif // __SSE__
+
+                for(; x <= b->x1; x++)
+                {
+                    float dx = fmaxf(fmaxf(clusters->cluster_min_x[row_start + x] - b->x,
+                                           b->x - clusters->cluster_max_x[row_start + x]), 0.0f);
+
+                    if(dx * dx + dyz2 <= r2) binLightInternal(clusters, row_start + x, l, z);
+                }
+            }
+        }
+    }
+}
+
+/** ---- Light data ---- **/
+
+static void packLightsInternal(DgnLightClusters *clusters)
+{
+    float *d = clusters->light_data;
+
+    for(uint16_t i = 0; i < clusters->light_count; i++)
+    {
+        DgnLight l = clusters->lights[i];
+        float cos_inner = POINT_LIGHT_INNER;
+        float cos_outer = POINT_LIGHT_OUTER;
+
+        if(l.type == DGN_LIGHT_TYPE_SPOT)
+        {
+            cos_outer = cosf(l.outer_angle);
+            // smoothstep needs the edges apart
+            cos_inner = fmaxf(cosf(l.inner_angle), cos_outer + 0.0001f);
+        }
+
+        d[0] = l.position.x;  d[1] = l.position.y;  d[2] = l.position.z;  d[3] = l.range;
+        d[4] = l.color.x;     d[5] = l.color.y;     d[6] = l.color.z;     d[7] = cos_inner;
+        d[8] = l.direction.x; d[9] = l.direction.y; d[10] = l.direction.z; d[11] = cos_outer;
+
+        d += 4 * LIGHT_TEXELS;
+    }
+}
+
+uint8_t dgnLightClustersBuild(DgnLightClusters *clusters, DgnCamera *cam, DgnLight *lights, uint16_t light_count)
+{
+    DGN_PROFILE_SCOPE("light culling");
+
+    if(light_count > clusters->max_lights)
+    {
+        logError("LIGHT CLUSTERS", "More lights than the clusters were created for, extra lights ignored");
+        light_count = clusters->max_lights;
+    }
+
+    const Mat4x4 *proj = dgnCameraGetProjection(cam);
+    DgnFrustum f = cam->frustum;
+    DgnFrustum old = clusters->frustum;
+
+    if(!clusters->bounds_valid || f.fov != old.fov || f.near != old.near || f.far != old.far ||
+       f.width != old.width || f.height != old.height)
+    {
+        buildClusterBoundsInternal(clusters, f, proj->m[0][0], proj->m[1][1]);
+        clusters->bounds_valid = DGN_TRUE;
+    }
+
+    memcpy(clusters->lights, lights, sizeof(DgnLight) * light_count);
+    clusters->light_count = light_count;
+    clusters->view = *dgnCameraGetView(cam);
+
+    dgnJobsParallelFor_internal(light_count, 64, lightBoundsJobInternal, clusters);
+    dgnJobsParallelFor_internal(clusters->dim_z, 1, binSliceJobInternal, clusters);
+
+    // compact the fixed size bins into one list the shader can index
+    uint32_t offset = 0;
+    for(uint32_t c = 0; c < clusters->cluster_count; c++)
+    {
+        uint16_t count = clusters->bin_counts[c];
+
+        clusters->grid[c * 2] = offset;
+        clusters->grid[c * 2 + 1] = count;
+
+        memcpy(clusters->indices + offset, clusters->bin_lights + c * MAX_LIGHTS_PER_CLUSTER, sizeof(uint16_t) * count);
+        offset += count;
+    }
+    clusters->index_count = offset;
+
+    packLightsInternal(clusters);
+
+    clusters->overflowed = DGN_FALSE;
+    for(uint8_t z = 0; z < clusters->dim_z; z++)
+    {
+        clusters->overflowed |= clusters->slice_overflow[z];
+    }
+
+    return !clusters->overflowed;
+}
+
+/** ---- GPU ---- **/
+
+static void createBuffersInternal(DgnLightClusters *clusters)
+{
+    static const GLenum formats[3] = {GL_RG32UI, GL_R16UI, GL_RGBA32F};
+    size_t sizes[3] =
+    {
+        sizeof(uint32_t) * 2 * clusters->cluster_count,
+        sizeof(uint16_t) * clusters->cluster_count * MAX_LIGHTS_PER_CLUSTER,
+        sizeof(float) * 4 * LIGHT_TEXELS * clusters->max_lights
+    };
+
+    glCall(glGenBuffers(3, clusters->tbo_buffers));
+    glCall(glGenTextures(3, clusters->tbo_textures));
+
+    for(int i = 0; i < 3; i++)
+    {
+        glCall(glBindBuffer(GL_TEXTURE_BUFFER, clusters->tbo_buffers[i]));
+        glCall(glBufferData(GL_TEXTURE_BUFFER, sizes[i], NULL, GL_DYNAMIC_DRAW));
+
+        glStatCall(DGN_RENDER_STAT_TEXTURE_BINDS, 1, glBindTexture(GL_TEXTURE_BUFFER, clusters->tbo_textures[i]));
+        glCall(glTexBuffer(GL_TEXTURE_BUFFER, formats[i], clusters->tbo_buffers[i]));
+    }
+
+    glLabel(GL_BUFFER, clusters->tbo_buffers[0], "light cluster grid");
+    glLabel(GL_TEXTURE, clusters->tbo_textures[0], "light cluster grid");
+    glLabel(GL_BUFFER, clusters->tbo_buffers[1], "light cluster indices");
+    glLabel(GL_TEXTURE, clusters->tbo_textures[1], "light cluster indices");
+    glLabel(GL_BUFFER, clusters->tbo_buffers[2], "light cluster lights");
+    glLabel(GL_TEXTURE, clusters->tbo_textures[2], "light cluster lights");
+
+    glStatCall(DGN_RENDER_STAT_TEXTURE_BINDS, 1, glBindTexture(GL_TEXTURE_BUFFER, 0));
+    glCall(glBindBuffer(GL_TEXTURE_BUFFER, 0));
+
+    clusters->gpu_created = DGN_TRUE;
+}
+
+static void uploadInternal(uint32_t buffer, const void *data, size_t size)
+{
+    if(size == 0) return;
+
+    glCall(glBindBuffer(GL_TEXTURE_BUFFER, buffer));
+    glStatCall(DGN_RENDER_STAT_UPLOAD_BYTES, size, glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data));
+}
+
+void dgnLightClustersUpload(DgnLightClusters *clusters)
+{
+    if(!clusters->gpu_created)
+    {
+        createBuffersInternal(clusters);
+    }
+
+    uploadInternal(clusters->tbo_buffers[0], clusters->grid, sizeof(uint32_t) * 2 * clusters->cluster_count);
+    uploadInternal(clusters->tbo_buffers[1], clusters->indices, sizeof(uint16_t) * clusters->index_count);
+    uploadInternal(clusters->tbo_buffers[2], clusters->light_data, sizeof(float) * 4 * LIGHT_TEXELS * clusters->light_count);
+
+    glCall(glBindBuffer(GL_TEXTURE_BUFFER, 0));
+}
+
+void dgnLightClustersBind(DgnLightClusters *clusters, uint8_t first_slot)
+{
+    if(!clusters->gpu_created)
+    {
+        createBuffersInternal(clusters);
+    }
+
+    for(int i = 0; i < 3; i++)
+    {
+        glCall(glActiveTexture(GL_TEXTURE0 + first_slot + i));
+        glStatCall(DGN_RENDER_STAT_TEXTURE_BINDS, 1, glBindTexture(GL_TEXTURE_BUFFER, clusters->tbo_textures[i]));
+    }
+}
+
+/** ---- Queries ---- **/
+
+uint32_t dgnLightClustersGetClusterIndex(DgnLightClusters *clusters, uint8_t x, uint8_t y, uint8_t z)
+{
+    return ((uint32_t)z * clusters->dim_y + y) * clusters->dim_x + x;
+}
+
+const uint16_t *dgnLightClustersGetLights(DgnLightClusters *clusters, uint32_t cluster, uint16_t *out_count)
+{
+    *out_count = (uint16_t)clusters->grid[cluster * 2 + 1];
+    return clusters->indices + clusters->grid[cluster * 2];
+}
+
+uint32_t dgnLightClustersGetIndexCount(DgnLightClusters *clusters)
+{
+    return clusters->index_count;
+}
+
+uint8_t dgnLightClustersOverflowed(DgnLightClusters *clusters)
+{
+    return clusters->overflowed;
+}
+
+// near plane and slices over log(far / near), matching uClusterDepth in lighting.glh
+Vec2 dgnLightClustersGetDepthParams(DgnLightClusters *clusters)
+{
+    return (Vec2){clusters->frustum.near, clusters->log_depth_scale};
+}
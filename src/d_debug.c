@@ -1,7 +1,17 @@
-#include <glad/glad.h>
+#include "d_internal.h"
+#include "DGNEngine/DGNEngine.h"
 
 #include <stdio.h>
 
+// only read in debug builds, glCall checks nothing in release
+static uint8_t s_debug_mode = DGN_GL_DEBUG_GET_ERROR;
+static uint32_t s_sample_interval = 1;
+static uint32_t s_sample_counter;
+
+// the glCall being made, a synchronous callback runs inside it
+static const char *s_call_file;
+static uint32_t s_call_line;
+
 void clearGLErrorsInternal()
 {
     while(glGetError() != GL_NO_ERROR);
@@ -56,6 +66,138 @@ void printDebugDataInternal(const char* file, uint32_t line)
     printf("File %s, Line %d\n", file, line);
 }
 
+void glCallBeginInternal(const char* file, uint32_t line)
+{
+    s_call_file = file;
+    s_call_line = line;
+
+    if(s_debug_mode == DGN_GL_DEBUG_GET_ERROR)
+    {
+        clearGLErrorsInternal();
+    }
+}
+
+void glCallEndInternal()
+{
+    if(s_debug_mode == DGN_GL_DEBUG_GET_ERROR)
+    {
+        if(!checkGLErrorsInternal()) printDebugDataInternal(s_call_file, s_call_line);
+    }
+    else if(s_debug_mode == DGN_GL_DEBUG_SAMPLED && ++s_sample_counter >= s_sample_interval)
+    {
+        s_sample_counter = 0;
+
+        // errors stick until read, so a sample catches anything since the last one
+        if(!checkGLErrorsInternal())
+        {
+            printDebugDataInternal(s_call_file, s_call_line);
+            printf("\tor one of the %u glCalls before it\n", s_sample_interval - 1);
+        }
+    }
+}
+
+/** ---- Debug output ---- **/
+
+static const char *debugTypeNameInternal(GLenum type)
+{
+    switch(type)
+    {
+    case GL_DEBUG_TYPE_ERROR:               return "ERROR";
+    case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "DEPRECATED";
+    case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:  return "UNDEFINED BEHAVIOR";
+    case GL_DEBUG_TYPE_PORTABILITY:         return "PORTABILITY";
+    case GL_DEBUG_TYPE_PERFORMANCE:         return "PERFORMANCE";
+    default:                                return "OTHER";
+    }
+}
+
+static const char *debugSeverityNameInternal(GLenum severity)
+{
+    switch(severity)
+    {
+    case GL_DEBUG_SEVERITY_HIGH:   return "HIGH";
+    case GL_DEBUG_SEVERITY_MEDIUM: return "MEDIUM";
+    case GL_DEBUG_SEVERITY_LOW:    return "LOW";
+    default:                       return "NOTIFICATION";
+    }
+}
+
+static void APIENTRY debugCallbackInternal(GLenum source, GLenum type, GLuint id, GLenum severity,
+                                           GLsizei length, const GLchar *message, const void *user_param)
+{
+    printf("GLDEBUG::%s::%s\n\t%s\n", debugTypeNameInternal(type), debugSeverityNameInternal(severity), message);
+
+    // asynchronous messages can arrive long after the call, from another thread
+    if(s_debug_mode == DGN_GL_DEBUG_CALLBACK_SYNC && s_call_file != NULL)
+    {
+        printf("\t");
+        printDebugDataInternal(s_call_file, s_call_line);
+    }
+}
+
+uint8_t dgnRendererSetDebugMode(uint8_t mode, uint32_t sample_interval)
+{
+    uint8_t callback = mode == DGN_GL_DEBUG_CALLBACK_SYNC || mode == DGN_GL_DEBUG_CALLBACK_ASYNC;
+    uint8_t res = DGN_TRUE;
+
+    if(callback && !GLAD_GL_KHR_debug)
+    {
+        logError("GL DEBUG", "GL_KHR_debug is not supported, sampling glGetError instead");
+        mode = DGN_GL_DEBUG_SAMPLED;
+        callback = DGN_FALSE;
+        res = DGN_FALSE;
+    }
+
+    if(GLAD_GL_KHR_debug)
+    {
+        if(callback)
+        {
+            glDebugMessageCallback(debugCallbackInternal, NULL);
+            // notifications are driver chatter about buffer placement and the like
+            glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, NULL, GL_FALSE);
+            glEnable(GL_DEBUG_OUTPUT);
+
+            if(mode == DGN_GL_DEBUG_CALLBACK_SYNC)
+            {
+                glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+            }
+            else
+            {
+                glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+            }
+        }
+        else
+        {
+            glDisable(GL_DEBUG_OUTPUT);
+            glDebugMessageCallback(NULL, NULL);
+        }
+    }
+
+    // errors made before the switch are not the new mode's to report
+    clearGLErrorsInternal();
+
+    s_debug_mode = mode;
+    s_sample_interval = sample_interval ? sample_interval : 1;
+    s_sample_counter = 0;
+
+    return res;
+}
+
+uint8_t dgnRendererGetDebugMode()
+{
+    return s_debug_mode;
+}
+
+void objectLabelInternal(GLenum identifier, GLuint name, const char *label, const char *file, uint32_t line)
+{
+    if(!GLAD_GL_KHR_debug || name == 0) return;
+
+    // the label is what the driver names the object in its messages
+    char buff[256];
+    snprintf(buff, sizeof(buff), "%s (%s:%u)", label, file, line);
+    glObjectLabel(identifier, name, -1, buff);
+}
+
 void logErrorInternal(const char* error, const char* message, const char* file, uint32_t line)
 {
     printf("ERROR::%s\n\tFile %s, line %u\n\t%s\n", error, file, line, message);
@@ -3,13 +3,51 @@
 
 #include <MemLeaker/malloc.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif // _WIN32
+
 void dgnEngineTerminate()
 {
+    dgnJobsTerm_internal();
+    profileTerm_internal();
+    loadTimelineTerm_internal();
     glfwTerminate();
     printMemUsage();
 }
 
 double dgnEngineGetSeconds()
 {
-    return glfwGetTime();
+    return clockSeconds_internal();
+}
+
+double clockSeconds_internal()
+{
+    // seconds since the first call, like glfwGetTime but without needing glfw
+#ifdef _WIN32
+    static LARGE_INTEGER start, frequency;
+    LARGE_INTEGER now;
+
+    if(frequency.QuadPart == 0)
+    {
+        QueryPerformanceFrequency(&frequency);
+        QueryPerformanceCounter(&start);
+    }
+    QueryPerformanceCounter(&now);
+
+    return (double)(now.QuadPart - start.QuadPart) / (double)frequency.QuadPart;
+#else
+    static struct timespec start;
+    struct timespec now;
+
+    if(start.tv_sec == 0 && start.tv_nsec == 0)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double)(now.tv_sec - start.tv_sec) + (double)(now.tv_nsec - start.tv_nsec) * 1e-9;
+#endif // _WIN32
 }
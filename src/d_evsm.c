@@ -0,0 +1,174 @@
+#include "d_internal.h"
+#include "DgnEngine/DgnEngine.h"
+
+#include <MemLeaker/malloc.h>
+
+#include <math.h>
+
+// deeper mip levels would average neighbouring maps of the atlas together
+#define MAX_MIP_LEVEL 4
+
+struct DgnEvsm
+{
+    // moments of every map, laid out like the shadow atlas
+    DgnTexture *moments;
+    // horizontal blur result, same size as moments
+    DgnTexture *temp;
+    DgnFramebuffer *moments_fb;
+    DgnFramebuffer *temp_fb;
+
+    DgnShader *blur_shader;
+    int32_t u_source;
+    int32_t u_direction;
+    int32_t u_uv_rect;
+    int32_t u_clamp_rect;
+    int32_t u_radius;
+
+    uint16_t size;
+};
+
+DgnEvsm *dgnEvsmCreate(uint16_t size)
+{
+    DgnEvsm *res = malloc(sizeof(*res));
+
+    if(res == NULL)
+    {
+        return NULL;
+    }
+
+    res->size = size;
+    res->moments = dgnTextureCreate(NULL, size, size, DGN_TEX_WRAP_CLAMP_TO_EDGE, DGN_TEX_FILTER_TRILINEAR, DGN_TRUE,
+                                    DGN_TEX_STORAGE_RGBA, DGN_TEX_STORAGE_RGBA32F, DGN_DATA_TYPE_FLOAT);
+    res->temp = dgnTextureCreate(NULL, size, size, DGN_TEX_WRAP_CLAMP_TO_EDGE, DGN_TEX_FILTER_NEAREST, DGN_FALSE,
+                                 DGN_TEX_STORAGE_RGBA, DGN_TEX_STORAGE_RGBA32F, DGN_DATA_TYPE_FLOAT);
+
+    uint8_t att = DGN_FRAMEBUFFER_COLOR;
+    // the moments pass still needs a depth buffer to keep the nearest caster
+    res->moments_fb = dgnFramebufferCreate(&res->moments, &att, 1, DGN_FRAMEBUFFER_DEPTH);
+    res->temp_fb = dgnFramebufferCreate(&res->temp, &att, 1, 0);
+
+    res->blur_shader = dgnShaderLoad("res/std/evsm_blur.vert", 0, "res/std/evsm_blur.frag");
+
+    if(res->moments_fb == NULL || res->temp_fb == NULL || res->blur_shader == NULL)
+    {
+        logError("EVSM", "Could not create moment targets or blur shader");
+
+        if(res->blur_shader) dgnShaderDestroy(res->blur_shader);
+        if(res->moments_fb) dgnFramebufferDestroy(res->moments_fb);
+        if(res->temp_fb) dgnFramebufferDestroy(res->temp_fb);
+        dgnTextureDestroy(res->moments);
+        dgnTextureDestroy(res->temp);
+        free(res);
+        return NULL;
+    }
+
+    dgnRendererBindTexture(res->moments, 0);
+    glCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, MAX_MIP_LEVEL));
+    dgnRendererBindTexture(NULL, 0);
+
+    res->u_source = dgnShaderGetUniformLoc(res->blur_shader, "uSource");
+    res->u_direction = dgnShaderGetUniformLoc(res->blur_shader, "uDirection");
+    res->u_uv_rect = dgnShaderGetUniformLoc(res->blur_shader, "uUVRect");
+    res->u_clamp_rect = dgnShaderGetUniformLoc(res->blur_shader, "uClampRect");
+    res->u_radius = dgnShaderGetUniformLoc(res->blur_shader, "uRadius");
+
+    return res;
+}
+
+void dgnEvsmDestroy(DgnEvsm *evsm)
+{
+    dgnShaderDestroy(evsm->blur_shader);
+    dgnFramebufferDestroy(evsm->moments_fb);
+    dgnFramebufferDestroy(evsm->temp_fb);
+    dgnTextureDestroy(evsm->moments);
+    dgnTextureDestroy(evsm->temp);
+
+    free(evsm);
+}
+
+static void shadowAreaInternal(DgnEvsm *evsm, DgnShadowMap shadow, uint16_t *x, uint16_t *y, uint16_t *w, uint16_t *h)
+{
+    *x = shadow.x;
+    *y = shadow.y;
+    *w = shadow.width ? shadow.width : evsm->size;
+    *h = shadow.width ? shadow.height : evsm->size;
+}
+
+void dgnEvsmBeginMap(DgnEvsm *evsm, DgnShadowMap shadow)
+{
+    uint16_t x, y, w, h;
+    shadowAreaInternal(evsm, shadow, &x, &y, &w, &h);
+
+    dgnFramebufferBind(evsm->moments_fb);
+    dgnRendererSetViewport(x, y, w, h);
+
+    // empty texels hold the moments of the far plane
+    float pos = expf(DGN_EVSM_POSITIVE_EXPONENT);
+    float neg = -expf(-DGN_EVSM_NEGATIVE_EXPONENT);
+    float far_moments[4] = {pos, pos * pos, neg, neg * neg};
+    float far_depth = 1.0f;
+
+    glCall(glScissor(x, y, w, h));
+    glCall(glEnable(GL_SCISSOR_TEST));
+    glCall(glClearBufferfv(GL_COLOR, 0, far_moments));
+    glCall(glClearBufferfv(GL_DEPTH, 0, &far_depth));
+    glCall(glDisable(GL_SCISSOR_TEST));
+}
+
+static void blurPassInternal(DgnEvsm *evsm, DgnTexture *source, DgnFramebuffer *target, Vec2 direction, Vec4 uv_rect, Vec4 clamp_rect)
+{
+    dgnFramebufferBind(target);
+    dgnRendererBindTexture(source, 0);
+
+    dgnShaderUniformV2(evsm->u_direction, direction);
+    dgnShaderUniformV4(evsm->u_uv_rect, uv_rect);
+    dgnShaderUniformV4(evsm->u_clamp_rect, clamp_rect);
+
+    dgnRendererBindScreenTexture();
+    dgnRendererDrawMesh();
+}
+
+void dgnEvsmBlur(DgnEvsm *evsm, DgnShadowMap shadow, uint8_t radius)
+{
+    if(radius == 0) return;
+
+    uint16_t x, y, w, h;
+    shadowAreaInternal(evsm, shadow, &x, &y, &w, &h);
+
+    float texel = 1.0f / evsm->size;
+    Vec4 uv_rect = {x * texel, y * texel, (x + w) * texel, (y + h) * texel};
+    Vec4 clamp_rect = {(x + 0.5f) * texel, (y + 0.5f) * texel, (x + w - 0.5f) * texel, (y + h - 0.5f) * texel};
+
+    GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+    GLboolean cull_face = glIsEnabled(GL_CULL_FACE);
+    glCall(glDisable(GL_DEPTH_TEST));
+    glCall(glDisable(GL_CULL_FACE));
+
+    dgnRendererSetViewport(x, y, w, h);
+    dgnRendererBindShader(evsm->blur_shader);
+    dgnShaderUniformI(evsm->u_source, 0);
+    dgnShaderUniformI(evsm->u_radius, radius);
+
+    blurPassInternal(evsm, evsm->moments, evsm->temp_fb, (Vec2){texel, 0.0f}, uv_rect, clamp_rect);
+    blurPassInternal(evsm, evsm->temp, evsm->moments_fb, (Vec2){0.0f, texel}, uv_rect, clamp_rect);
+
+    if(depth_test)
+    {
+        glCall(glEnable(GL_DEPTH_TEST));
+    }
+    if(cull_face)
+    {
+        glCall(glEnable(GL_CULL_FACE));
+    }
+}
+
+void dgnEvsmGenerateMipmaps(DgnEvsm *evsm)
+{
+    dgnRendererBindTexture(evsm->moments, 0);
+    glCall(glGenerateMipmap(GL_TEXTURE_2D));
+}
+
+DgnTexture *dgnEvsmGetTexture(DgnEvsm *evsm)
+{
+    return evsm->moments;
+}
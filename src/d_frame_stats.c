@@ -0,0 +1,286 @@
+#include "d_internal.h"
+#include "DGNEngine/DGNEngine.h"
+
+#include <MemLeaker/malloc.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// frames taking this many times the budget or median count as hitches
+#define HITCH_FACTOR 2.0f
+
+uint8_t dgnWindowSetStatsCapacity(DgnWindow *window, uint32_t frames)
+{
+    if(frames == 0)
+    {
+        logError("FRAME STATS", "History must hold at least one frame");
+        return DGN_FALSE;
+    }
+
+    float *frame_times = malloc(sizeof(float) * frames);
+    float *cpu_times = malloc(sizeof(float) * frames);
+    float *swap_times = malloc(sizeof(float) * frames);
+    float *scratch = malloc(sizeof(float) * frames);
+
+    if(frame_times == NULL || cpu_times == NULL || swap_times == NULL || scratch == NULL)
+    {
+        free(frame_times);
+        free(cpu_times);
+        free(swap_times);
+        free(scratch);
+        return DGN_FALSE;
+    }
+
+    frameStatsFree_internal(window);
+
+    window->frame_times = frame_times;
+    window->cpu_times = cpu_times;
+    window->swap_times = swap_times;
+    window->stats_scratch = scratch;
+    window->stats_capacity = frames;
+    window->stats_count = 0;
+    window->stats_head = 0;
+
+    return DGN_TRUE;
+}
+
+void dgnWindowSetFrameBudget(DgnWindow *window, float seconds)
+{
+    window->frame_budget = seconds;
+}
+
+void frameStatsPush_internal(DgnWindow *window, float frame, float cpu, float swap)
+{
+    if(window->stats_capacity == 0) return;
+
+    uint32_t i = window->stats_head;
+    window->frame_times[i] = frame;
+    window->cpu_times[i] = cpu;
+    window->swap_times[i] = swap;
+
+    window->stats_head = (i + 1) % window->stats_capacity;
+    if(window->stats_count < window->stats_capacity)
+    {
+        window->stats_count++;
+    }
+}
+
+void frameStatsFree_internal(DgnWindow *window)
+{
+    free(window->frame_times);
+    free(window->cpu_times);
+    free(window->swap_times);
+    free(window->stats_scratch);
+
+    window->frame_times = NULL;
+    window->cpu_times = NULL;
+    window->swap_times = NULL;
+    window->stats_scratch = NULL;
+    window->stats_capacity = 0;
+    window->stats_count = 0;
+    window->stats_head = 0;
+}
+
+/** ---- Queries ---- **/
+
+static int compareFloatInternal(const void *a, const void *b)
+{
+    float fa = *(const float*)a;
+    float fb = *(const float*)b;
+    return (fa > fb) - (fa < fb);
+}
+
+// nearest rank, sorted must hold count values
+static float percentileInternal(const float *sorted, uint32_t count, float p)
+{
+    uint32_t rank = (uint32_t)(p * count + 0.999f);
+    if(rank < 1) rank = 1;
+    if(rank > count) rank = count;
+
+    return sorted[rank - 1];
+}
+
+static void seriesStatsInternal(DgnWindow *window, const float *samples, DgnFrameTimeStats *out)
+{
+    uint32_t count = window->stats_count;
+    float *sorted = window->stats_scratch;
+    double sum = 0.0;
+
+    memset(out, 0, sizeof(*out));
+    if(count == 0) return;
+
+    // the ring is not in time order, but that does not matter once sorted
+    memcpy(sorted, samples, sizeof(float) * count);
+    qsort(sorted, count, sizeof(float), compareFloatInternal);
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        sum += sorted[i];
+    }
+
+    out->average = (float)(sum / count);
+    out->p50 = percentileInternal(sorted, count, 0.50f);
+    out->p95 = percentileInternal(sorted, count, 0.95f);
+    out->p99 = percentileInternal(sorted, count, 0.99f);
+    out->max = sorted[count - 1];
+}
+
+static float hitchThresholdInternal(DgnWindow *window, float p50)
+{
+    return HITCH_FACTOR * (window->frame_budget > 0.0f ? window->frame_budget : p50);
+}
+
+void dgnWindowGetFrameStats(DgnWindow *window, DgnFrameStats *out_stats)
+{
+    out_stats->sample_count = window->stats_count;
+
+    seriesStatsInternal(window, window->frame_times, &out_stats->frame);
+    seriesStatsInternal(window, window->cpu_times, &out_stats->cpu);
+    seriesStatsInternal(window, window->swap_times, &out_stats->swap);
+
+    float threshold = hitchThresholdInternal(window, out_stats->frame.p50);
+    out_stats->hitch_count = 0;
+
+    for(uint32_t i = 0; i < window->stats_count; i++)
+    {
+        out_stats->hitch_count += window->frame_times[i] > threshold;
+    }
+}
+
+/** ---- Export ---- **/
+
+static uint32_t oldestSampleInternal(DgnWindow *window)
+{
+    return window->stats_count < window->stats_capacity ? 0 : window->stats_head;
+}
+
+static void writeSeriesJsonInternal(FILE *file, const char *name, const DgnFrameTimeStats *s)
+{
+    fprintf(file, "  \"%s\": {\"average\": %f, \"p50\": %f, \"p95\": %f, \"p99\": %f, \"max\": %f},\n",
+            name, s->average, s->p50, s->p95, s->p99, s->max);
+}
+
+uint8_t dgnWindowDumpFrameStats(DgnWindow *window, const char *filepath, uint8_t format)
+{
+    FILE *file = fopen(filepath, "w");
+
+    if(file == NULL)
+    {
+        logError("FRAME STATS", filepath);
+        return DGN_FALSE;
+    }
+
+    uint32_t first = oldestSampleInternal(window);
+
+    if(format == DGN_FRAME_STATS_JSON)
+    {
+        DgnFrameStats stats;
+        dgnWindowGetFrameStats(window, &stats);
+
+        fprintf(file, "{\n  \"samples\": %u,\n  \"hitches\": %u,\n", stats.sample_count, stats.hitch_count);
+        writeSeriesJsonInternal(file, "frame", &stats.frame);
+        writeSeriesJsonInternal(file, "cpu", &stats.cpu);
+        writeSeriesJsonInternal(file, "swap", &stats.swap);
+        fprintf(file, "  \"frames\": [");
+
+        for(uint32_t n = 0; n < window->stats_count; n++)
+        {
+            uint32_t i = (first + n) % window->stats_capacity;
+            fprintf(file, "%s\n    [%f, %f, %f]", n ? "," : "",
+                    window->frame_times[i], window->cpu_times[i], window->swap_times[i]);
+        }
+
+        fprintf(file, "\n  ]\n}\n");
+    }
+    else
+    {
+        fprintf(file, "frame,frame_time,cpu_time,swap_time\n");
+
+        for(uint32_t n = 0; n < window->stats_count; n++)
+        {
+            uint32_t i = (first + n) % window->stats_capacity;
+            fprintf(file, "%u,%f,%f,%f\n", n, window->frame_times[i], window->cpu_times[i], window->swap_times[i]);
+        }
+    }
+
+    uint8_t ok = !ferror(file);
+    fclose(file);
+
+    return ok;
+}
+
+/** ---- Overlay ---- **/
+
+void dgnWindowDrawFrameStats(DgnWindow *window, uint16_t x, uint16_t y, uint16_t width, uint16_t height)
+{
+    uint32_t count = window->stats_count;
+    if(count == 0 || width == 0 || height == 0) return;
+
+    DgnFrameStats stats;
+    dgnWindowGetFrameStats(window, &stats);
+
+    float budget = window->frame_budget > 0.0f ? window->frame_budget : stats.frame.p50;
+    float hitch = hitchThresholdInternal(window, stats.frame.p50);
+    // the top of the graph is one and a half hitches
+    float top = hitch * 1.5f;
+
+    GLboolean scissor = glIsEnabled(GL_SCISSOR_TEST);
+    float clear_color[4];
+    glCall(glGetFloatv(GL_COLOR_CLEAR_VALUE, clear_color));
+    glCall(glEnable(GL_SCISSOR_TEST));
+
+    // backdrop
+    glCall(glScissor(x, y, width, height));
+    glCall(glClearColor(0.0f, 0.0f, 0.0f, 1.0f));
+    glCall(glClear(GL_COLOR_BUFFER_BIT));
+
+    // one column per frame, oldest on the left, sharing pixels when the history is wider than the graph
+    uint32_t first = oldestSampleInternal(window);
+    uint32_t columns = count < width ? count : width;
+
+    for(uint32_t c = 0; c < columns; c++)
+    {
+        uint32_t n0 = (uint32_t)((uint64_t)c * count / columns);
+        uint32_t n1 = (uint32_t)((uint64_t)(c + 1) * count / columns);
+        float t = 0.0f;
+
+        for(uint32_t n = n0; n < n1; n++)
+        {
+            float v = window->frame_times[(first + n) % window->stats_capacity];
+            if(v > t) t = v;
+        }
+
+        uint16_t h = (uint16_t)(height * (t < top ? t / top : 1.0f));
+        if(h == 0) continue;
+
+        if(t > hitch)
+        {
+            glCall(glClearColor(0.9f, 0.1f, 0.1f, 1.0f));
+        }
+        else if(t > budget)
+        {
+            glCall(glClearColor(0.9f, 0.8f, 0.1f, 1.0f));
+        }
+        else
+        {
+            glCall(glClearColor(0.1f, 0.8f, 0.2f, 1.0f));
+        }
+
+        uint16_t x0 = x + (uint16_t)((uint32_t)c * width / columns);
+        uint16_t x1 = x + (uint16_t)((uint32_t)(c + 1) * width / columns);
+        glCall(glScissor(x0, y, x1 - x0, h));
+        glCall(glClear(GL_COLOR_BUFFER_BIT));
+    }
+
+    // budget line
+    glCall(glScissor(x, y + (uint16_t)(height * budget / top), width, 1));
+    glCall(glClearColor(1.0f, 1.0f, 1.0f, 1.0f));
+    glCall(glClear(GL_COLOR_BUFFER_BIT));
+
+    glCall(glClearColor(clear_color[0], clear_color[1], clear_color[2], clear_color[3]));
+    if(!scissor)
+    {
+        glCall(glDisable(GL_SCISSOR_TEST));
+    }
+}
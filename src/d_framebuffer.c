@@ -7,14 +7,15 @@ DgnFramebuffer *dgnFramebufferCreate(DgnTexture **dst_textures, uint8_t *attachm
 {
     GLuint buffer = 0;
     glCall(glGenFramebuffers(1, &buffer));
-    glCall(glBindFramebuffer(GL_FRAMEBUFFER, buffer));
+    glStatCall(DGN_RENDER_STAT_FRAMEBUFFER_BINDS, 1, glBindFramebuffer(GL_FRAMEBUFFER, buffer));
 
     if(flags & DGN_FRAMEBUFFER_DEPTH)
     {
         GLuint depthrenderbuffer;
         glCall(glGenRenderbuffers(1, &depthrenderbuffer));
         glCall(glBindRenderbuffer(GL_RENDERBUFFER, depthrenderbuffer));
-        glCall(glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, dst_textures[0]->width[0], dst_textures[0]->height[0]));
+        GLenum depth_format = flags & DGN_FRAMEBUFFER_DEPTH_FLOAT ? GL_DEPTH_COMPONENT32F : GL_DEPTH_COMPONENT;
+        glCall(glRenderbufferStorage(GL_RENDERBUFFER, depth_format, dst_textures[0]->width[0], dst_textures[0]->height[0]));
         glCall(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthrenderbuffer));
     }
 
@@ -46,7 +47,9 @@ DgnFramebuffer *dgnFramebufferCreate(DgnTexture **dst_textures, uint8_t *attachm
         return NULL;
     }
 
-    glCall(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+    glStatCall(DGN_RENDER_STAT_FRAMEBUFFER_BINDS, 1, glBindFramebuffer(GL_FRAMEBUFFER, 0));
+
+    glLabel(GL_FRAMEBUFFER, buffer, "framebuffer");
 
     DgnFramebuffer *res = malloc(sizeof(*res));
     res->buffer = buffer;
@@ -65,10 +68,10 @@ void dgnFramebufferBind(DgnFramebuffer *buffer)
 {
     if(buffer == NULL)
     {
-        glCall(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+        glStatCall(DGN_RENDER_STAT_FRAMEBUFFER_BINDS, 1, glBindFramebuffer(GL_FRAMEBUFFER, 0));
     }
     else
     {
-        glCall(glBindFramebuffer(GL_FRAMEBUFFER, buffer->buffer));
+        glStatCall(DGN_RENDER_STAT_FRAMEBUFFER_BINDS, 1, glBindFramebuffer(GL_FRAMEBUFFER, buffer->buffer));
     }
 }
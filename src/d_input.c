@@ -4,85 +4,223 @@
 #include "d_defines.h"
 
 #include <math.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 #include "c_linked_list.h"
 #include "c_ordered_map.h"
 
+#define SOURCE_KEY 0
+#define SOURCE_MOUSE_BUTTON 1
+#define SOURCE_MOUSE_AXIS 2
+#define SOURCE_PAD_BUTTON 3
+#define SOURCE_PAD_AXIS 4
+
+// an action whose value reaches this counts as held
+#define ACTION_HELD_THRESHOLD 0.5f
+
+#define NAME_COUNT(arr) (sizeof(arr) / sizeof(*(arr)))
+
+// highest raw code each source can be sampled with, keys also have to fit the key bitset
+#define MAX_KEY_CODE (GLFW_KEY_LAST < INPUT_KEY_WORDS_INTERNAL * 64 ? GLFW_KEY_LAST : INPUT_KEY_WORDS_INTERNAL * 64 - 1)
+#define MAX_MOUSE_BUTTON_CODE GLFW_MOUSE_BUTTON_LAST
+#define MAX_MOUSE_AXIS_CODE 1
+#define MAX_PAD_BUTTON_CODE GLFW_GAMEPAD_BUTTON_LAST
+#define MAX_PAD_AXIS_CODE GLFW_GAMEPAD_AXIS_LAST
+
 typedef struct
 {
-    const char *axis;
-    uint16_t positive;
-    uint16_t negative;
-}KeyAxis;
+    uint16_t action;
+    uint8_t source;
+    uint16_t code;
+    float scale;
+    float deadzone;
+}InputBinding;
 
 typedef struct
 {
-    const char *axis;
-    uint8_t positive;
-    uint8_t negative;
-}ButtonAxis;
+    const char *name;
+    uint16_t code;
+}InputName;
 
-typedef struct
+struct DgnInputMap
 {
-    const char *axis;
+    // action name to action id, keys point into names
+    OrderedMapS *ids;
+    char **names;
+    uint16_t action_count;
+
+    // bindings sorted by action, action a owns [first[a], first[a + 1])
+    uint32_t *first;
+    uint8_t *source;
+    uint16_t *code;
+    float *scale;
+    float *deadzone;
+
+    float *values;
+    uint64_t *held;
+    uint64_t *held_l;
+    uint32_t held_words;
+
     uint8_t gamepad;
-    uint8_t gp_axis_name;
-    float deadzone;
-}GamepadAxis;
+};
+
+static const InputName s_key_names[] =
+{
+    {"SPACE", DGN_KEY_SPACE}, {"ESCAPE", DGN_KEY_ESCAPE}, {"ENTER", DGN_KEY_ENTER}, {"TAB", DGN_KEY_TAB},
+    {"RIGHT", DGN_KEY_RIGHT}, {"LEFT", DGN_KEY_LEFT}, {"DOWN", DGN_KEY_DOWN}, {"UP", DGN_KEY_UP},
+    {"LEFT_SHIFT", DGN_KEY_LEFT_SHIFT}, {"LEFT_CONTROL", DGN_KEY_LEFT_CONTROL}, {"LEFT_ALT", DGN_KEY_LEFT_ALT},
+    {"RIGHT_SHIFT", DGN_KEY_RIGHT_SHIFT}, {"RIGHT_CONTROL", DGN_KEY_RIGHT_CONTROL}, {"RIGHT_ALT", DGN_KEY_RIGHT_ALT},
+};
+
+static const InputName s_mouse_names[] =
+{
+    {"LEFT", DGN_MOUSE_BUTTON_LEFT}, {"RIGHT", DGN_MOUSE_BUTTON_RIGHT}, {"MIDDLE", DGN_MOUSE_BUTTON_MIDDLE},
+};
+
+static const InputName s_mouse_axis_names[] =
+{
+    {"X", 0}, {"Y", 1},
+};
+
+static const InputName s_pad_button_names[] =
+{
+    {"A", DGN_GAMEPAD_BUTTON_A}, {"B", DGN_GAMEPAD_BUTTON_B}, {"X", DGN_GAMEPAD_BUTTON_X}, {"Y", DGN_GAMEPAD_BUTTON_Y},
+    {"CROSS", DGN_GAMEPAD_BUTTON_CROSS}, {"CIRCLE", DGN_GAMEPAD_BUTTON_CIRCLE},
+    {"SQUARE", DGN_GAMEPAD_BUTTON_SQUARE}, {"TRIANGLE", DGN_GAMEPAD_BUTTON_TRIANGLE},
+    {"LEFT_BUMPER", DGN_GAMEPAD_BUTTON_LEFT_BUMPER}, {"RIGHT_BUMPER", DGN_GAMEPAD_BUTTON_RIGHT_BUMPER},
+    {"BACK", DGN_GAMEPAD_BUTTON_BACK}, {"START", DGN_GAMEPAD_BUTTON_START}, {"GUIDE", DGN_GAMEPAD_BUTTON_GUIDE},
+    {"LEFT_THUMB", DGN_GAMEPAD_BUTTON_LEFT_THUMB}, {"RIGHT_THUMB", DGN_GAMEPAD_BUTTON_RIGHT_THUMB},
+    {"DPAD_UP", DGN_GAMEPAD_BUTTON_DPAD_UP}, {"DPAD_RIGHT", DGN_GAMEPAD_BUTTON_DPAD_RIGHT},
+    {"DPAD_DOWN", DGN_GAMEPAD_BUTTON_DPAD_DOWN}, {"DPAD_LEFT", DGN_GAMEPAD_BUTTON_DPAD_LEFT},
+};
+
+static const InputName s_pad_axis_names[] =
+{
+    {"LEFT_X", DGN_GAMEPAD_AXIS_LEFT_X}, {"LEFT_Y", DGN_GAMEPAD_AXIS_LEFT_Y},
+    {"RIGHT_X", DGN_GAMEPAD_AXIS_RIGHT_X}, {"RIGHT_Y", DGN_GAMEPAD_AXIS_RIGHT_Y},
+    {"LEFT_TRIGGER", DGN_GAMEPAD_AXIS_LEFT_TRIGGER}, {"RIGHT_TRIGGER", DGN_GAMEPAD_AXIS_RIGHT_TRIGGER},
+};
 
 DgnInput *s_current_input;
 
+#define KEY_WORD(key) ((key) >> 6)
+#define KEY_BIT(key) (1ull << ((key) & 63))
+
+static uint32_t lowestBitInternal(uint64_t v)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, v);
+    return index;
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
 void dgnInputPollEvents()
 {
-    for(int i = 0; i <DGN_KEY_LAST; i++)
-    {
-        s_current_input->keys_l[i] = s_current_input->keys[i];
-    }
+    DgnInput *in = s_current_input;
+    uint8_t replaying = inputReplayActive_internal();
 
-    for(int i = 0; i <DGN_MOUSE_BUTTON_LAST; i++)
+    inputRecordFrame_internal();
+
+    // only words touched by an event since the last poll can differ from their last state
+    for(uint32_t w = 0; w < INPUT_KEY_WORDS_INTERNAL; w++)
     {
-        s_current_input->m_buttons_l[i] = s_current_input->m_buttons[i];
+        if(in->keys_events[w])
+        {
+            in->keys_l[w] = in->keys[w];
+            in->keys_events[w] = 0;
+        }
     }
 
-    for(int i = 0; i < DGN_GAMEPAD_LAST; i++)
+    in->m_buttons_l = in->m_buttons;
+
+    for(uint32_t pads = in->gp_connected; pads; pads &= pads - 1)
     {
-        glfwGetGamepadState(GLFW_JOYSTICK_1 + i, &s_current_input->gp_states[i]);
+        uint32_t i = lowestBitInternal(pads);
+        uint32_t bits = 0;
+
+        in->gp_buttons_l[i] = in->gp_buttons[i];
+
+        // a replay sets pad state from the recording after the events are polled
+        if(replaying) continue;
+
+        glfwGetGamepadState(GLFW_JOYSTICK_1 + i, &in->gp_states[i]);
+
+        for(uint32_t b = 0; b <= DGN_GAMEPAD_BUTTON_LAST; b++)
+        {
+            bits |= (uint32_t)(in->gp_states[i].buttons[b] == GLFW_PRESS) << b;
+        }
+
+        in->gp_buttons[i] = bits;
+        inputRecordPad_internal(i, DGN_TRUE, bits, in->gp_states[i].axes);
     }
 
-    s_current_input->mouse_x_d = 0;
-    s_current_input->mouse_y_d = 0;
+    in->mouse_x_d = 0;
+    in->mouse_y_d = 0;
 
     glfwPollEvents();
+
+    if(replaying)
+    {
+        inputReplayFrame_internal();
+    }
 }
 
 uint8_t dgnInputGetKey(uint16_t key)
 {
-    return s_current_input->keys[key];
+    return (s_current_input->keys[KEY_WORD(key)] & KEY_BIT(key)) != 0;
 }
 
 uint8_t dgnInputGetKeyDown(uint16_t key)
 {
-    return s_current_input->keys[key] && !s_current_input->keys_l[key];
+    uint64_t cur = s_current_input->keys[KEY_WORD(key)];
+    return ((cur ^ s_current_input->keys_l[KEY_WORD(key)]) & cur & KEY_BIT(key)) != 0;
 }
 
 uint8_t dgnInputGetKeyUp(uint16_t key)
 {
-    return !s_current_input->keys[key] && s_current_input->keys_l[key];
+    uint64_t last = s_current_input->keys_l[KEY_WORD(key)];
+    return ((s_current_input->keys[KEY_WORD(key)] ^ last) & last & KEY_BIT(key)) != 0;
+}
+
+uint16_t dgnInputGetChangedKeys(uint16_t *out_keys, uint16_t max_keys)
+{
+    uint16_t count = 0;
+
+    for(uint32_t w = 0; w < INPUT_KEY_WORDS_INTERNAL; w++)
+    {
+        for(uint64_t changed = s_current_input->keys[w] ^ s_current_input->keys_l[w]; changed; changed &= changed - 1)
+        {
+            if(count >= max_keys) return count;
+            out_keys[count++] = (uint16_t)(w * 64 + lowestBitInternal(changed));
+        }
+    }
+
+    return count;
 }
 
 uint8_t dgnInputGetMouseButton(uint8_t button)
 {
-    return s_current_input->m_buttons[button];
+    return (s_current_input->m_buttons >> button) & 1;
 }
 
 uint8_t dgnInputGetMouseButtonDown(uint8_t button)
 {
-    return s_current_input->m_buttons[button] && !s_current_input->m_buttons_l[button];
+    uint64_t cur = s_current_input->m_buttons;
+    return (((cur ^ s_current_input->m_buttons_l) & cur) >> button) & 1;
 }
 
 uint8_t dgnInputGetMouseButtonUp(uint8_t button)
 {
-    return !s_current_input->m_buttons[button] && s_current_input->m_buttons_l[button];
+    uint64_t last = s_current_input->m_buttons_l;
+    return (((s_current_input->m_buttons ^ last) & last) >> button) & 1;
 }
 
 int32_t dgnInputGetMouseX()
@@ -105,9 +243,16 @@ float dgnInputGetMouseYDelta()
     return s_current_input->mouse_y_d;
 }
 
+uint8_t dgnInputIsGamepadConnected(uint8_t gamepad)
+{
+    if(gamepad > DGN_GAMEPAD_LAST) return DGN_FALSE;
+
+    return (s_current_input->gp_connected >> gamepad) & 1;
+}
+
 float dgnInputGetGamepadAxis(uint8_t gamepad, uint8_t axis, float deadzone)
 {
-    if(gamepad > DGN_GAMEPAD_LAST) return 0.0f;
+    if(!dgnInputIsGamepadConnected(gamepad)) return 0.0f;
 
     float v = s_current_input->gp_states[gamepad].axes[axis];
 
@@ -116,58 +261,392 @@ float dgnInputGetGamepadAxis(uint8_t gamepad, uint8_t axis, float deadzone)
 
 uint8_t dgnInputGetGamepadButton(uint8_t gamepad, uint8_t button)
 {
-    if(gamepad > DGN_GAMEPAD_LAST) return 0.0f;
+    if(!dgnInputIsGamepadConnected(gamepad)) return DGN_FALSE;
 
-    return s_current_input->gp_states[gamepad].buttons[button];
+    return (s_current_input->gp_buttons[gamepad] >> button) & 1;
 }
 
-/*****************************************************************/
+uint8_t dgnInputGetGamepadButtonDown(uint8_t gamepad, uint8_t button)
+{
+    if(!dgnInputIsGamepadConnected(gamepad)) return DGN_FALSE;
 
-void set_input_holder_internal(DgnInput *input)
+    uint32_t cur = s_current_input->gp_buttons[gamepad];
+    return (((cur ^ s_current_input->gp_buttons_l[gamepad]) & cur) >> button) & 1;
+}
+
+uint8_t dgnInputGetGamepadButtonUp(uint8_t gamepad, uint8_t button)
+{
+    if(!dgnInputIsGamepadConnected(gamepad)) return DGN_FALSE;
+
+    uint32_t last = s_current_input->gp_buttons_l[gamepad];
+    return (((s_current_input->gp_buttons[gamepad] ^ last) & last) >> button) & 1;
+}
+
+/** ---- Action maps ---- **/
+
+static uint8_t findNameInternal(const InputName *names, uint32_t count, const char *name, uint16_t max_code, uint16_t *out_code)
 {
-     for(int i = 0; i <DGN_KEY_LAST; i++)
+    for(uint32_t i = 0; i < count; i++)
     {
-        input->keys[i] = DGN_FALSE;
-        input->keys_l[i] = DGN_FALSE;
+        if(strcmp(names[i].name, name) == 0)
+        {
+            *out_code = names[i].code;
+            return DGN_TRUE;
+        }
     }
 
-    for(int i = 0; i <DGN_MOUSE_BUTTON_LAST; i++)
+    // plain numbers are taken as the raw code, as long as the source has a control with that code
+    char *end;
+    long v = strtol(name, &end, 10);
+    if(end != name && *end == '\0')
     {
-        input->m_buttons[i] = DGN_FALSE;
-        input->m_buttons_l[i] = DGN_FALSE;
+        if(v < 0 || v > max_code)
+        {
+            logError("INPUT MAP", "Raw control code out of range");
+            return DGN_FALSE;
+        }
+
+        *out_code = (uint16_t)v;
+        return DGN_TRUE;
     }
 
-    s_current_input = input;
+    return DGN_FALSE;
 }
 
-void key_callback_internal(GLFWwindow* window, int key, int scancode, int action, int mods)
+static uint8_t parseKeyInternal(const char *name, uint16_t *out_code)
+{
+    // letters and digits share their codes with ascii
+    if(name[0] != '\0' && name[1] == '\0' &&
+       ((name[0] >= 'A' && name[0] <= 'Z') || (name[0] >= '0' && name[0] <= '9')))
+    {
+        *out_code = (uint16_t)name[0];
+        return DGN_TRUE;
+    }
+
+    if(name[0] == 'F' && name[1] >= '1' && name[1] <= '9')
+    {
+        int f = atoi(name + 1);
+        if(f >= 1 && f <= 25)
+        {
+            *out_code = DGN_KEY_F1 + f - 1;
+            return DGN_TRUE;
+        }
+    }
+
+    return findNameInternal(s_key_names, NAME_COUNT(s_key_names), name, MAX_KEY_CODE, out_code);
+}
+
+static uint8_t parseBindingInternal(const char *source, const char *control, InputBinding *out_binding)
+{
+    if(strcmp(source, "key") == 0)
+    {
+        out_binding->source = SOURCE_KEY;
+        return parseKeyInternal(control, &out_binding->code);
+    }
+    else if(strcmp(source, "mouse") == 0)
+    {
+        out_binding->source = SOURCE_MOUSE_BUTTON;
+        return findNameInternal(s_mouse_names, NAME_COUNT(s_mouse_names), control, MAX_MOUSE_BUTTON_CODE,
+                                &out_binding->code);
+    }
+    else if(strcmp(source, "mouse_axis") == 0)
+    {
+        out_binding->source = SOURCE_MOUSE_AXIS;
+        return findNameInternal(s_mouse_axis_names, NAME_COUNT(s_mouse_axis_names), control, MAX_MOUSE_AXIS_CODE,
+                                &out_binding->code);
+    }
+    else if(strcmp(source, "pad_button") == 0)
+    {
+        out_binding->source = SOURCE_PAD_BUTTON;
+        return findNameInternal(s_pad_button_names, NAME_COUNT(s_pad_button_names), control, MAX_PAD_BUTTON_CODE,
+                                &out_binding->code);
+    }
+    else if(strcmp(source, "pad_axis") == 0)
+    {
+        out_binding->source = SOURCE_PAD_AXIS;
+        return findNameInternal(s_pad_axis_names, NAME_COUNT(s_pad_axis_names), control, MAX_PAD_AXIS_CODE,
+                                &out_binding->code);
+    }
+
+    return DGN_FALSE;
+}
+
+// interns the name, returns the id of the action
+static uint16_t internActionInternal(DgnInputMap *map, const char *name)
+{
+    uint16_t *found = orderedMapSAtKey(map->ids, name);
+    if(found)
+    {
+        return *found;
+    }
+
+    size_t len = strlen(name) + 1;
+    uint16_t id = map->action_count++;
+
+    map->names = realloc(map->names, sizeof(*map->names) * map->action_count);
+    map->names[id] = malloc(len);
+    memcpy(map->names[id], name, len);
+
+    orderedMapSInsert(map->ids, map->names[id], &id, sizeof(id));
+
+    return id;
+}
+
+DgnInputMap *dgnInputMapLoad(const char *filepath)
+{
+    FILE *file = fopen(filepath, "r");
+
+    if(file == NULL)
+    {
+        logError("INPUT MAP", filepath);
+        return NULL;
+    }
+
+    DgnInputMap *res = calloc(1, sizeof(*res));
+
+    if(res == NULL)
+    {
+        fclose(file);
+        return NULL;
+    }
+
+    res->ids = orderedMapSCreate();
+    res->gamepad = DGN_GAMEPAD_1;
+
+    InputBinding *bindings = NULL;
+    uint32_t binding_count = 0;
+    uint32_t line_number = 0;
+    char line[256];
+
+    // one binding per line: action source control [scale] [deadzone]
+    while(fgets(line, sizeof(line), file) != NULL)
+    {
+        char action[64], source[32], control[32];
+        InputBinding b;
+        b.scale = 1.0f;
+        b.deadzone = 0.0f;
+
+        line_number++;
+
+        char *comment = strchr(line, '#');
+        if(comment) *comment = '\0';
+
+        int read = sscanf(line, "%63s %31s %31s %f %f", action, source, control, &b.scale, &b.deadzone);
+
+        if(read <= 0)
+        {
+            continue;
+        }
+
+        if(read < 3 || !parseBindingInternal(source, control, &b))
+        {
+            char msg[320];
+            snprintf(msg, sizeof(msg), "%s:%u: could not read binding", filepath, line_number);
+            logError("INPUT MAP", msg);
+            continue;
+        }
+
+        b.action = internActionInternal(res, action);
+
+        bindings = realloc(bindings, sizeof(*bindings) * (binding_count + 1));
+        bindings[binding_count++] = b;
+    }
+
+    fclose(file);
+
+    // counting sort by action so every action reads one contiguous run
+    res->first = calloc(res->action_count + 1, sizeof(*res->first));
+    res->source = malloc(binding_count + 1);
+    res->code = malloc(sizeof(*res->code) * (binding_count + 1));
+    res->scale = malloc(sizeof(*res->scale) * (binding_count + 1));
+    res->deadzone = malloc(sizeof(*res->deadzone) * (binding_count + 1));
+
+    for(uint32_t i = 0; i < binding_count; i++)
+    {
+        res->first[bindings[i].action + 1]++;
+    }
+    for(uint32_t a = 0; a < res->action_count; a++)
+    {
+        res->first[a + 1] += res->first[a];
+    }
+
+    uint32_t *cursor = malloc(sizeof(*cursor) * (res->action_count + 1));
+    memcpy(cursor, res->first, sizeof(*cursor) * (res->action_count + 1));
+
+    for(uint32_t i = 0; i < binding_count; i++)
+    {
+        uint32_t slot = cursor[bindings[i].action]++;
+        res->source[slot] = bindings[i].source;
+        res->code[slot] = bindings[i].code;
+        res->scale[slot] = bindings[i].scale;
+        res->deadzone[slot] = bindings[i].deadzone;
+    }
+
+    free(cursor);
+    free(bindings);
+
+    res->held_words = (res->action_count + 63) / 64;
+    res->values = calloc(res->action_count + 1, sizeof(*res->values));
+    res->held = calloc(res->held_words + 1, sizeof(*res->held));
+    res->held_l = calloc(res->held_words + 1, sizeof(*res->held_l));
+
+    return res;
+}
+
+void dgnInputMapDestroy(DgnInputMap *map)
 {
-    if(key != DGN_KEY_UNKNOWN)
+    orderedMapSDestroy(map->ids);
+
+    for(uint16_t i = 0; i < map->action_count; i++)
+    {
+        free(map->names[i]);
+    }
+    free(map->names);
+
+    free(map->first);
+    free(map->source);
+    free(map->code);
+    free(map->scale);
+    free(map->deadzone);
+    free(map->values);
+    free(map->held);
+    free(map->held_l);
+    free(map);
+}
+
+uint16_t dgnInputMapGetAction(DgnInputMap *map, const char *name)
+{
+    uint16_t *found = orderedMapSAtKey(map->ids, name);
+
+    return found ? *found : DGN_INPUT_ACTION_NONE;
+}
+
+void dgnInputMapSetGamepad(DgnInputMap *map, uint8_t gamepad)
+{
+    map->gamepad = gamepad;
+}
+
+static float sampleBindingInternal(DgnInputMap *map, uint32_t b)
+{
+    uint16_t code = map->code[b];
+
+    switch(map->source[b])
+    {
+    case SOURCE_KEY:
+        return dgnInputGetKey(code);
+    case SOURCE_MOUSE_BUTTON:
+        return dgnInputGetMouseButton(code);
+    case SOURCE_MOUSE_AXIS:
+        return code == 0 ? s_current_input->mouse_x_d : s_current_input->mouse_y_d;
+    case SOURCE_PAD_BUTTON:
+        return dgnInputGetGamepadButton(map->gamepad, code);
+    case SOURCE_PAD_AXIS:
+        return dgnInputGetGamepadAxis(map->gamepad, code, map->deadzone[b]);
+    }
+
+    return 0.0f;
+}
+
+void dgnInputMapUpdate(DgnInputMap *map)
+{
+    memcpy(map->held_l, map->held, sizeof(*map->held) * map->held_words);
+    memset(map->held, 0, sizeof(*map->held) * map->held_words);
+
+    for(uint16_t a = 0; a < map->action_count; a++)
     {
-        if(action == GLFW_PRESS)
+        float v = 0.0f;
+
+        for(uint32_t b = map->first[a]; b < map->first[a + 1]; b++)
         {
-            s_current_input->keys[key] = DGN_TRUE;
+            v += sampleBindingInternal(map, b) * map->scale[b];
         }
-        else if(action == GLFW_RELEASE)
+
+        map->values[a] = v;
+        map->held[a >> 6] |= (uint64_t)(fabsf(v) >= ACTION_HELD_THRESHOLD) << (a & 63);
+    }
+}
+
+float dgnInputMapGetValue(DgnInputMap *map, uint16_t action)
+{
+    if(action >= map->action_count) return 0.0f;
+
+    return map->values[action];
+}
+
+uint8_t dgnInputMapGetButton(DgnInputMap *map, uint16_t action)
+{
+    if(action >= map->action_count) return DGN_FALSE;
+
+    return (map->held[action >> 6] >> (action & 63)) & 1;
+}
+
+uint8_t dgnInputMapGetButtonDown(DgnInputMap *map, uint16_t action)
+{
+    if(action >= map->action_count) return DGN_FALSE;
+
+    uint64_t cur = map->held[action >> 6];
+    return (((cur ^ map->held_l[action >> 6]) & cur) >> (action & 63)) & 1;
+}
+
+uint8_t dgnInputMapGetButtonUp(DgnInputMap *map, uint16_t action)
+{
+    if(action >= map->action_count) return DGN_FALSE;
+
+    uint64_t last = map->held_l[action >> 6];
+    return (((map->held[action >> 6] ^ last) & last) >> (action & 63)) & 1;
+}
+
+/*****************************************************************/
+
+void set_input_holder_internal(DgnInput *input)
+{
+    memset(input, 0, sizeof(*input));
+
+    // pads plugged in before the window existed never send a connect event
+    for(int i = 0; i <= DGN_GAMEPAD_LAST; i++)
+    {
+        int jid = GLFW_JOYSTICK_1 + i;
+        if(glfwJoystickIsGamepad(jid))
         {
-            s_current_input->keys[key] = DGN_FALSE;
+            input->gp_connected |= 1u << i;
+            logMessage("%s Connected to port %u\n", glfwGetGamepadName(jid), jid);
         }
     }
+
+    s_current_input = input;
 }
 
-void mouse_button_callback_internal(GLFWwindow* window, int button, int action, int mods)
+void inputApplyKey_internal(int key, int action)
 {
+    if(key < 0 || key >= INPUT_KEY_WORDS_INTERNAL * 64) return;
+
     if(action == GLFW_PRESS)
     {
-        s_current_input->m_buttons[button] = DGN_TRUE;
+        s_current_input->keys[KEY_WORD(key)] |= KEY_BIT(key);
     }
     else if(action == GLFW_RELEASE)
     {
-        s_current_input->m_buttons[button] = DGN_FALSE;
+        s_current_input->keys[KEY_WORD(key)] &= ~KEY_BIT(key);
     }
+
+    s_current_input->keys_events[KEY_WORD(key)] |= KEY_BIT(key);
 }
 
-void cursor_position_callback_internal(GLFWwindow* window, double xpos, double ypos)
+void inputApplyMouseButton_internal(int button, int action)
+{
+    if(button < 0 || button >= 64) return;
+
+    if(action == GLFW_PRESS)
+    {
+        s_current_input->m_buttons |= 1ull << button;
+    }
+    else if(action == GLFW_RELEASE)
+    {
+        s_current_input->m_buttons &= ~(1ull << button);
+    }
+}
+
+void inputApplyCursor_internal(double xpos, double ypos)
 {
     s_current_input->mouse_x_d = xpos - s_current_input->mouse_x;
     s_current_input->mouse_y_d = ypos - s_current_input->mouse_y;
@@ -176,8 +655,108 @@ void cursor_position_callback_internal(GLFWwindow* window, double xpos, double y
     s_current_input->mouse_y = (int32_t)ypos;
 }
 
-void scroll_callback_internal(GLFWwindow *window, double xscroll, double yscroll)
+void inputApplyScroll_internal(double xscroll, double yscroll)
 {
     s_current_input->scroll_x = xscroll;
     s_current_input->scroll_y = yscroll;
 }
+
+void inputApplyGamepad_internal(uint32_t pad, uint8_t connected, uint32_t buttons, const float *axes)
+{
+    DgnInput *in = s_current_input;
+
+    if(!connected)
+    {
+        in->gp_connected &= ~(1u << pad);
+        memset(&in->gp_states[pad], 0, sizeof(in->gp_states[pad]));
+        in->gp_buttons[pad] = 0;
+        in->gp_buttons_l[pad] = 0;
+        return;
+    }
+
+    in->gp_connected |= 1u << pad;
+    in->gp_buttons[pad] = buttons;
+
+    for(uint32_t b = 0; b <= DGN_GAMEPAD_BUTTON_LAST; b++)
+    {
+        in->gp_states[pad].buttons[b] = (buttons >> b) & 1 ? GLFW_PRESS : GLFW_RELEASE;
+    }
+    for(uint32_t a = 0; a <= DGN_GAMEPAD_AXIS_LAST; a++)
+    {
+        in->gp_states[pad].axes[a] = axes[a];
+    }
+}
+
+void inputApplyReset_internal()
+{
+    DgnInput *in = s_current_input;
+
+    for(uint32_t w = 0; w < INPUT_KEY_WORDS_INTERNAL; w++)
+    {
+        in->keys_events[w] |= in->keys[w];
+        in->keys[w] = 0;
+    }
+    in->m_buttons = 0;
+
+    for(uint32_t pad = 0; pad < INPUT_GAMEPAD_COUNT_INTERNAL; pad++)
+    {
+        inputApplyGamepad_internal(pad, DGN_FALSE, 0, NULL);
+    }
+
+    in->mouse_x_d = 0;
+    in->mouse_y_d = 0;
+}
+
+// live events are dropped while a recording is replayed
+
+void key_callback_internal(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    if(inputReplayActive_internal()) return;
+
+    inputApplyKey_internal(key, action);
+    inputRecordEvent_internal(INPUT_EVENT_KEY_INTERNAL, action, key, 0.0f, 0.0f);
+}
+
+void mouse_button_callback_internal(GLFWwindow* window, int button, int action, int mods)
+{
+    if(inputReplayActive_internal()) return;
+
+    inputApplyMouseButton_internal(button, action);
+    inputRecordEvent_internal(INPUT_EVENT_MOUSE_BUTTON_INTERNAL, action, button, 0.0f, 0.0f);
+}
+
+void joystick_callback_internal(int jid, int event)
+{
+    uint32_t pad = jid - GLFW_JOYSTICK_1;
+    uint32_t bit = 1u << pad;
+
+    if(s_current_input == NULL || inputReplayActive_internal()) return;
+
+    if(event == GLFW_CONNECTED && glfwJoystickIsGamepad(jid))
+    {
+        s_current_input->gp_connected |= bit;
+        logMessage("%s Connected to port %u\n", glfwGetGamepadName(jid), jid);
+    }
+    else if(event == GLFW_DISCONNECTED && (s_current_input->gp_connected & bit))
+    {
+        inputApplyGamepad_internal(pad, DGN_FALSE, 0, NULL);
+        inputRecordPad_internal(pad, DGN_FALSE, 0, NULL);
+        logMessage("Gamepad disconnected from port %u\n", jid);
+    }
+}
+
+void cursor_position_callback_internal(GLFWwindow* window, double xpos, double ypos)
+{
+    if(inputReplayActive_internal()) return;
+
+    inputApplyCursor_internal(xpos, ypos);
+    inputRecordEvent_internal(INPUT_EVENT_CURSOR_INTERNAL, 0, 0, (float)xpos, (float)ypos);
+}
+
+void scroll_callback_internal(GLFWwindow *window, double xscroll, double yscroll)
+{
+    if(inputReplayActive_internal()) return;
+
+    inputApplyScroll_internal(xscroll, yscroll);
+    inputRecordEvent_internal(INPUT_EVENT_SCROLL_INTERNAL, 0, 0, (float)xscroll, (float)yscroll);
+}
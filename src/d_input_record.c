@@ -0,0 +1,384 @@
+#include "d_internal.h"
+#include "DGNEngine/DGNEngine.h"
+
+#include <MemLeaker/malloc.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#define RECORD_MAGIC "DGNR"
+#define RECORD_VERSION 1
+
+// time is seconds since the recording started, a frame event holds its delta in x
+typedef struct
+{
+    float time;
+    uint8_t type;
+    uint8_t action;
+    uint16_t code;
+    float x;
+    float y;
+}RecordedEvent;
+
+// every connected gamepad event is followed by one of these, in the same order
+typedef struct
+{
+    uint32_t buttons;
+    float axes[DGN_GAMEPAD_AXIS_LAST + 1];
+}RecordedPad;
+
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t frame_count;
+    uint32_t event_count;
+    uint32_t pad_count;
+}RecordHeader;
+
+typedef struct
+{
+    RecordedEvent *events;
+    uint32_t event_count;
+    uint32_t event_capacity;
+
+    RecordedPad *pads;
+    uint32_t pad_count;
+    uint32_t pad_capacity;
+
+    uint32_t frame_count;
+
+    // recording only
+    char *filepath;
+    double start_time;
+    double frame_time;
+    uint32_t pads_valid;
+    RecordedPad last_pads[INPUT_GAMEPAD_COUNT_INTERNAL];
+
+    // replay only
+    uint32_t event_cursor;
+    uint32_t pad_cursor;
+    double fixed_delta;
+    double frame_delta;
+}InputRecording;
+
+static InputRecording *s_record;
+static InputRecording *s_replay;
+
+static void destroyRecordingInternal(InputRecording *rec)
+{
+    free(rec->events);
+    free(rec->pads);
+    free(rec->filepath);
+    free(rec);
+}
+
+static void pushEventInternal(InputRecording *rec, uint8_t type, uint8_t action, uint16_t code, float x, float y)
+{
+    if(rec->event_count == rec->event_capacity)
+    {
+        rec->event_capacity = rec->event_capacity ? rec->event_capacity * 2 : 1024;
+        rec->events = realloc(rec->events, sizeof(*rec->events) * rec->event_capacity);
+    }
+
+    RecordedEvent *e = &rec->events[rec->event_count++];
+    e->time = (float)(clockSeconds_internal() - rec->start_time);
+    e->type = type;
+    e->action = action;
+    e->code = code;
+    e->x = x;
+    e->y = y;
+}
+
+static void pushPadInternal(InputRecording *rec, const RecordedPad *pad)
+{
+    if(rec->pad_count == rec->pad_capacity)
+    {
+        rec->pad_capacity = rec->pad_capacity ? rec->pad_capacity * 2 : 256;
+        rec->pads = realloc(rec->pads, sizeof(*rec->pads) * rec->pad_capacity);
+    }
+
+    rec->pads[rec->pad_count++] = *pad;
+}
+
+/** ---- Recording ---- **/
+
+uint8_t dgnInputRecordStart(const char *filepath)
+{
+    if(s_record != NULL || s_replay != NULL)
+    {
+        logError("INPUT RECORD", "A recording or replay is already running");
+        return DGN_FALSE;
+    }
+
+    InputRecording *rec = calloc(1, sizeof(*rec));
+
+    if(rec == NULL)
+    {
+        return DGN_FALSE;
+    }
+
+    size_t len = strlen(filepath) + 1;
+    rec->filepath = malloc(len);
+    memcpy(rec->filepath, filepath, len);
+
+    rec->start_time = clockSeconds_internal();
+    rec->frame_time = rec->start_time;
+    s_record = rec;
+
+    // state held before the start is written as events ahead of the first frame
+    for(uint16_t key = 0; key < INPUT_KEY_WORDS_INTERNAL * 64; key++)
+    {
+        if(dgnInputGetKey(key))
+        {
+            pushEventInternal(rec, INPUT_EVENT_KEY_INTERNAL, GLFW_PRESS, key, 0.0f, 0.0f);
+        }
+    }
+    for(uint8_t button = 0; button <= DGN_MOUSE_BUTTON_LAST; button++)
+    {
+        if(dgnInputGetMouseButton(button))
+        {
+            pushEventInternal(rec, INPUT_EVENT_MOUSE_BUTTON_INTERNAL, GLFW_PRESS, button, 0.0f, 0.0f);
+        }
+    }
+    pushEventInternal(rec, INPUT_EVENT_CURSOR_INTERNAL, 0, 0, (float)dgnInputGetMouseX(), (float)dgnInputGetMouseY());
+
+    return DGN_TRUE;
+}
+
+uint8_t dgnInputRecordStop()
+{
+    InputRecording *rec = s_record;
+
+    if(rec == NULL) return DGN_FALSE;
+
+    s_record = NULL;
+
+    FILE *file = fopen(rec->filepath, "wb");
+
+    if(file == NULL)
+    {
+        logError("INPUT RECORD", rec->filepath);
+        destroyRecordingInternal(rec);
+        return DGN_FALSE;
+    }
+
+    RecordHeader header;
+    memcpy(header.magic, RECORD_MAGIC, 4);
+    header.version = RECORD_VERSION;
+    header.frame_count = rec->frame_count;
+    header.event_count = rec->event_count;
+    header.pad_count = rec->pad_count;
+
+    uint8_t ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                 fwrite(rec->events, sizeof(*rec->events), rec->event_count, file) == rec->event_count &&
+                 fwrite(rec->pads, sizeof(*rec->pads), rec->pad_count, file) == rec->pad_count;
+
+    fclose(file);
+
+    if(!ok)
+    {
+        logError("INPUT RECORD", "Could not write the whole recording");
+    }
+
+    destroyRecordingInternal(rec);
+    return ok;
+}
+
+void inputRecordFrame_internal()
+{
+    if(s_record == NULL) return;
+
+    double time = clockSeconds_internal();
+    pushEventInternal(s_record, INPUT_EVENT_FRAME_INTERNAL, 0, 0, (float)(time - s_record->frame_time), 0.0f);
+    s_record->frame_time = time;
+    s_record->frame_count++;
+}
+
+void inputRecordEvent_internal(uint8_t type, uint8_t action, uint16_t code, float x, float y)
+{
+    if(s_record == NULL) return;
+
+    pushEventInternal(s_record, type, action, code, x, y);
+}
+
+void inputRecordPad_internal(uint32_t pad, uint8_t connected, uint32_t buttons, const float *axes)
+{
+    if(s_record == NULL) return;
+
+    uint32_t bit = 1u << pad;
+
+    if(!connected)
+    {
+        s_record->pads_valid &= ~bit;
+        pushEventInternal(s_record, INPUT_EVENT_GAMEPAD_INTERNAL, DGN_FALSE, pad, 0.0f, 0.0f);
+        return;
+    }
+
+    RecordedPad state;
+    state.buttons = buttons;
+    memcpy(state.axes, axes, sizeof(state.axes));
+
+    // sticks at rest do not cost anything
+    if((s_record->pads_valid & bit) && memcmp(&state, &s_record->last_pads[pad], sizeof(state)) == 0)
+    {
+        return;
+    }
+
+    s_record->pads_valid |= bit;
+    s_record->last_pads[pad] = state;
+
+    pushEventInternal(s_record, INPUT_EVENT_GAMEPAD_INTERNAL, DGN_TRUE, pad, 0.0f, 0.0f);
+    pushPadInternal(s_record, &state);
+}
+
+/** ---- Replay ---- **/
+
+// applies events until the next frame event, returns false at the end of the recording
+static uint8_t applyEventsInternal(InputRecording *rec)
+{
+    while(rec->event_cursor < rec->event_count)
+    {
+        const RecordedEvent *e = &rec->events[rec->event_cursor];
+
+        if(e->type == INPUT_EVENT_FRAME_INTERNAL)
+        {
+            return DGN_TRUE;
+        }
+
+        rec->event_cursor++;
+
+        switch(e->type)
+        {
+        case INPUT_EVENT_KEY_INTERNAL:
+            inputApplyKey_internal(e->code, e->action);
+            break;
+        case INPUT_EVENT_MOUSE_BUTTON_INTERNAL:
+            inputApplyMouseButton_internal(e->code, e->action);
+            break;
+        case INPUT_EVENT_CURSOR_INTERNAL:
+            inputApplyCursor_internal(e->x, e->y);
+            break;
+        case INPUT_EVENT_SCROLL_INTERNAL:
+            inputApplyScroll_internal(e->x, e->y);
+            break;
+        case INPUT_EVENT_GAMEPAD_INTERNAL:
+            if(e->code >= INPUT_GAMEPAD_COUNT_INTERNAL)
+            {
+                break;
+            }
+
+            if(!e->action)
+            {
+                inputApplyGamepad_internal(e->code, DGN_FALSE, 0, NULL);
+            }
+            else if(rec->pad_cursor < rec->pad_count)
+            {
+                const RecordedPad *pad = &rec->pads[rec->pad_cursor++];
+                inputApplyGamepad_internal(e->code, DGN_TRUE, pad->buttons, pad->axes);
+            }
+            break;
+        }
+    }
+
+    return DGN_FALSE;
+}
+
+uint8_t dgnInputReplayStart(const char *filepath, double fixed_delta)
+{
+    if(s_record != NULL || s_replay != NULL)
+    {
+        logError("INPUT REPLAY", "A recording or replay is already running");
+        return DGN_FALSE;
+    }
+
+    FILE *file = fopen(filepath, "rb");
+
+    if(file == NULL)
+    {
+        logError("INPUT REPLAY", filepath);
+        return DGN_FALSE;
+    }
+
+    RecordHeader header;
+    InputRecording *rec = calloc(1, sizeof(*rec));
+
+    if(rec == NULL || fread(&header, sizeof(header), 1, file) != 1 ||
+       memcmp(header.magic, RECORD_MAGIC, 4) != 0 || header.version != RECORD_VERSION)
+    {
+        logError("INPUT REPLAY", "Not an input recording or from another version");
+        fclose(file);
+        free(rec);
+        return DGN_FALSE;
+    }
+
+    rec->event_count = header.event_count;
+    rec->pad_count = header.pad_count;
+    rec->frame_count = header.frame_count;
+    rec->events = malloc(sizeof(*rec->events) * (rec->event_count + 1));
+    rec->pads = malloc(sizeof(*rec->pads) * (rec->pad_count + 1));
+
+    uint8_t ok = rec->events != NULL && rec->pads != NULL &&
+                 fread(rec->events, sizeof(*rec->events), rec->event_count, file) == rec->event_count &&
+                 fread(rec->pads, sizeof(*rec->pads), rec->pad_count, file) == rec->pad_count;
+
+    fclose(file);
+
+    if(!ok)
+    {
+        logError("INPUT REPLAY", "Recording is truncated");
+        destroyRecordingInternal(rec);
+        return DGN_FALSE;
+    }
+
+    rec->fixed_delta = fixed_delta;
+
+    // start from nothing held, then play the state captured ahead of the first frame
+    inputApplyReset_internal();
+    applyEventsInternal(rec);
+
+    s_replay = rec;
+    return DGN_TRUE;
+}
+
+void dgnInputReplayStop()
+{
+    if(s_replay == NULL) return;
+
+    destroyRecordingInternal(s_replay);
+    s_replay = NULL;
+}
+
+uint8_t dgnInputIsReplaying()
+{
+    return s_replay != NULL;
+}
+
+uint8_t inputReplayActive_internal()
+{
+    return s_replay != NULL;
+}
+
+void inputReplayFrame_internal()
+{
+    InputRecording *rec = s_replay;
+
+    if(rec->event_cursor >= rec->event_count)
+    {
+        dgnInputReplayStop();
+        return;
+    }
+
+    // the cursor always rests on a frame event between polls
+    rec->frame_delta = rec->events[rec->event_cursor++].x;
+
+    applyEventsInternal(rec);
+}
+
+uint8_t inputReplayDelta_internal(double *out_delta)
+{
+    if(s_replay == NULL) return DGN_FALSE;
+
+    *out_delta = s_replay->fixed_delta > 0.0 ? s_replay->fixed_delta : s_replay->frame_delta;
+    return DGN_TRUE;
+}
@@ -6,14 +6,37 @@
 #include <GLFW/glfw3.h>
 
 #define NUM_VERT_ATTRIB_INTERNAL 5
+#define MAX_MESH_LODS_INTERNAL 4
+#define DYN_RES_QUERY_COUNT_INTERNAL 4
+#define MAX_GRAPH_PASSES_INTERNAL 64
+#define MAX_GRAPH_RESOURCES_INTERNAL 64
+#define MAX_GRAPH_FRAMEBUFFERS_INTERNAL 32
+#define MAX_PASS_RESOURCES_INTERNAL 8
+#define MAX_JOB_THREADS_INTERNAL 15
+#define MAX_SHADOW_ATLAS_REQUESTS_INTERNAL 64
+// 64 bit words holding one bit for every GLFW key
+#define INPUT_KEY_WORDS_INTERNAL 6
+#define INPUT_GAMEPAD_COUNT_INTERNAL 16
+#define FRAME_STATS_DEFAULT_CAPACITY_INTERNAL 600
+
+// event types of an input recording
+#define INPUT_EVENT_FRAME_INTERNAL 0
+#define INPUT_EVENT_KEY_INTERNAL 1
+#define INPUT_EVENT_MOUSE_BUTTON_INTERNAL 2
+#define INPUT_EVENT_CURSOR_INTERNAL 3
+#define INPUT_EVENT_SCROLL_INTERNAL 4
+#define INPUT_EVENT_GAMEPAD_INTERNAL 5
 
 typedef struct
 {
-    uint8_t *keys;
-    uint8_t *keys_l;
+    // one bit per key and button, _l is the state at the start of the last poll
+    uint64_t keys[INPUT_KEY_WORDS_INTERNAL];
+    uint64_t keys_l[INPUT_KEY_WORDS_INTERNAL];
+    // keys that received an event since the last poll
+    uint64_t keys_events[INPUT_KEY_WORDS_INTERNAL];
 
-    uint8_t *m_buttons;
-    uint8_t *m_buttons_l;
+    uint64_t m_buttons;
+    uint64_t m_buttons_l;
 
     int32_t mouse_x;
     int32_t mouse_y;
@@ -24,7 +47,11 @@ typedef struct
     float scroll_x;
     float scroll_y;
 
-    GLFWgamepadstate *gp_states;
+    // kept by the joystick callback, only these pads are polled
+    uint32_t gp_connected;
+    GLFWgamepadstate gp_states[INPUT_GAMEPAD_COUNT_INTERNAL];
+    uint32_t gp_buttons[INPUT_GAMEPAD_COUNT_INTERNAL];
+    uint32_t gp_buttons_l[INPUT_GAMEPAD_COUNT_INTERNAL];
 }DgnInput;
 
 typedef struct
@@ -40,6 +67,23 @@ typedef struct
     double time_1;
     double delta;
 
+    // ring of the last stats_capacity frames, stats_head is the next one written
+    float *frame_times;
+    float *cpu_times;
+    float *swap_times;
+    float *stats_scratch;
+    uint32_t stats_capacity;
+    uint32_t stats_count;
+    uint32_t stats_head;
+    float frame_budget;
+
+    // headless windows have no native window, the egl handles are only set when built with DGN_USE_EGL
+    uint8_t headless;
+    uint8_t should_close;
+    void *egl_display;
+    void *egl_surface;
+    void *egl_context;
+
 }DgnWindow;
 
 typedef struct
@@ -48,11 +92,27 @@ typedef struct
     uint32_t VBO;
     uint32_t IBO;
     uint32_t length;
+
+    // every level of detail lives in the same index buffer
+    uint32_t lod_offsets[MAX_MESH_LODS_INTERNAL];
+    uint32_t lod_lengths[MAX_MESH_LODS_INTERNAL];
+    uint8_t lod_count;
+    uint8_t current_lod;
+
+    // bounds in mesh space, used for screen size lod selection
+    Vec3 center;
+    float radius;
 }DgnMesh;
 
 typedef struct
 {
     uint32_t program;
+
+    // per draw matrices set by dgnRendererSetModel, -1 when the shader does not use them
+    int32_t u_model;
+    int32_t u_model_view;
+    int32_t u_mvp;
+    int32_t u_normal_mat;
 }DgnShader;
 
 typedef struct
@@ -61,6 +121,9 @@ typedef struct
     uint16_t *width;
     uint16_t *height;
     uint8_t mipmapped;
+
+    // set while a streamer still owns the load, texture is a placeholder until it clears
+    struct TextureStreamRequest *stream;
 }DgnTexture;
 
 typedef struct
@@ -68,14 +131,173 @@ typedef struct
     uint32_t buffer;
 }DgnFramebuffer;
 
+typedef struct
+{
+    // native size, the render target is allocated at this size and the scene drawn into a corner of it
+    uint16_t width;
+    uint16_t height;
+
+    float scale;
+    float min_scale;
+    float max_scale;
+
+    double target_frame_time;
+    double smoothed_frame_time;
+    uint32_t frames_since_change;
+
+    // ring of gpu timer queries so reading a result never waits on the gpu
+    uint32_t queries[DYN_RES_QUERY_COUNT_INTERNAL];
+    uint8_t query_pending[DYN_RES_QUERY_COUNT_INTERNAL];
+    uint8_t query_index;
+    uint8_t query_active;
+}DgnDynamicResolution;
+
+typedef struct
+{
+    uint8_t cascade_count;
+    uint64_t frame;
+
+    // light space matrix each cached map was last rendered with
+    Mat4x4 *matrices;
+    uint8_t *valid;
+    uint8_t *dirty;
+    // frames between updates of a changed cascade, 1 updates as soon as it changes
+    uint8_t *intervals;
+}DgnShadowCache;
+
+typedef struct
+{
+    uint32_t capacity;
+    uint32_t count;
+
+    // per slot, sorted so every parent comes before its children
+    Vec3 *pos;
+    Quat *rot;
+    Vec3 *scale;
+    Mat4x4 *local;
+    Mat4x4 *world;
+    uint32_t *parent_slot;
+    uint8_t *flags;
+    uint32_t *slot_handle;
+
+    // per handle, handles never move
+    uint32_t *handle_slot;
+    uint32_t *handle_parent;
+
+    // slots of depth d are level_start[d] up to level_start[d + 1]
+    uint32_t *level_start;
+    uint32_t level_count;
+
+    uint32_t *sort_depth;
+    uint32_t *sort_order;
+    uint32_t *sort_cursor;
+    Mat4x4 *scratch;
+
+    uint8_t any_dirty;
+    uint8_t order_dirty;
+    uint32_t update_offset;
+}DgnTransforms;
+
+// defined in d_render_graph.c
+typedef struct DgnRenderGraph DgnRenderGraph;
+
+// defined in d_shadow_atlas.c
+typedef struct DgnShadowAtlas DgnShadowAtlas;
+
+// defined in d_evsm.c
+typedef struct DgnEvsm DgnEvsm;
+
+// defined in d_input.c
+typedef struct DgnInputMap DgnInputMap;
+
+// defined in d_loop.c
+typedef struct DgnLoop DgnLoop;
+
+// defined in d_cluster.c
+typedef struct DgnLightClusters DgnLightClusters;
+
+// defined in d_render_thread.c
+typedef struct DgnRenderThread DgnRenderThread;
+typedef struct DgnRenderPacket DgnRenderPacket;
+
+// defined in d_texture_stream.c
+typedef struct DgnTextureStreamer DgnTextureStreamer;
+
 void set_input_holder_internal(DgnInput *input);
 void key_callback_internal(GLFWwindow *window, int key, int scancode, int action, int mods);
 void cursor_position_callback_internal(GLFWwindow *window, double xpos, double ypos);
 void mouse_button_callback_internal(GLFWwindow *window, int button, int action, int mods);
 void scroll_callback_internal(GLFWwindow *window, double xscroll, double yscroll);
+void joystick_callback_internal(int jid, int event);
+
+// monotonic seconds, works without glfw being initialised
+double clockSeconds_internal();
+// loads gl functions from whichever api made the current context
+void *windowGetProcAddress_internal(const char *name);
+// makes the context current on, or releases it from, the calling thread
+void windowBindContext_internal(DgnWindow *window, uint8_t bind);
+// swaps without touching the frame timing
+void windowPresent_internal(DgnWindow *window);
+
+void profileTerm_internal();
+void loadTimelineTerm_internal();
+
+// adds to the renderer stats of the frame being drawn, the frame ends on present
+void renderStatAdd_internal(uint8_t stat, uint64_t amount);
+void renderStatsEndFrame_internal();
+
+#define LOAD_STAGE_NONE_INTERNAL 0xffffffff
+// times one stage of loading asset while the load timeline records, any thread may call these
+uint32_t loadStageBegin_internal(const char *asset, uint8_t stage);
+void loadStageEnd_internal(uint32_t stage);
+
+void frameStatsPush_internal(DgnWindow *window, float frame, float cpu, float swap);
+void frameStatsFree_internal(DgnWindow *window);
+
+// input changes shared by the callbacks and replays
+void inputApplyKey_internal(int key, int action);
+void inputApplyMouseButton_internal(int button, int action);
+void inputApplyCursor_internal(double xpos, double ypos);
+void inputApplyScroll_internal(double xscroll, double yscroll);
+void inputApplyGamepad_internal(uint32_t pad, uint8_t connected, uint32_t buttons, const float *axes);
+// releases everything and disconnects every pad
+void inputApplyReset_internal();
+
+// no-ops unless a recording is running
+void inputRecordFrame_internal();
+void inputRecordEvent_internal(uint8_t type, uint8_t action, uint16_t code, float x, float y);
+void inputRecordPad_internal(uint32_t pad, uint8_t connected, uint32_t buttons, const float *axes);
+
+uint8_t inputReplayActive_internal();
+void inputReplayFrame_internal();
+uint8_t inputReplayDelta_internal(double *out_delta);
+
+uint32_t meshSimplify_internal(uint32_t *dst, const uint32_t *indices, uint32_t index_count,
+                               const float *positions, uint32_t vertex_count, size_t stride,
+                               uint32_t target_index_count, float target_error);
+
+typedef void (*JobFuncInternal)(uint32_t begin, uint32_t end, void *user_data);
+
+// splits [0, count) into batches run across the worker threads, returns when all are done
+void dgnJobsParallelFor_internal(uint32_t count, uint32_t batch, JobFuncInternal func, void *user_data);
+uint8_t dgnJobsGetThreadCount_internal();
+void dgnJobsTerm_internal();
 
 uint8_t dgnShaderInit_internal();
 void dgnShaderTerm_internal();
+// shader source with includes and econsts expanded, returns the length or 0xFFFFFFFF
+uint32_t fileToString(char **out_str, const char *filepath);
+
+// any thread, logs and returns DGN_FALSE when the file could not be read or decoded
+uint8_t textureLoadPng_internal(const char *filepath, const char *asset, uint8_t **out_pixels, uint32_t *out_width, uint32_t *out_height);
+// on the bound texture of image_type
+void textureSetSampling_internal(GLenum image_type, uint8_t wrapping, uint8_t filtering, uint8_t mipmapped);
+// drops a streamed texture's load, its placeholder stays with the streamer
+void textureStreamCancel_internal(DgnTexture *texture);
+
+struct aiMesh;
+// filepath only names the load timeline stages
+DgnMesh *aiMeshConvert(struct aiMesh *mesh, const char *filepath);
 
 #ifdef __DEBUG
 #include <stdio.h>
@@ -85,14 +307,24 @@ uint8_t checkGLErrorsInternal();
 
 void printDebugDataInternal(const char* file, uint32_t line);
 void logErrorInternal(const char* error, const char* message, const char* file, uint32_t line);
+// what these check depends on dgnRendererSetDebugMode
+void glCallBeginInternal(const char* file, uint32_t line);
+void glCallEndInternal();
+void objectLabelInternal(GLenum identifier, GLuint name, const char *label, const char *file, uint32_t line);
 
-#define glCall(func) clearGLErrorsInternal(); func; if(!checkGLErrorsInternal()) printDebugDataInternal(__FILE__, __LINE__)
+#define glCall(func) glCallBeginInternal(__FILE__, __LINE__); func; glCallEndInternal()
+// names a gl object in debug output, tagged with where it was made
+#define glLabel(identifier, name, label) objectLabelInternal(identifier, name, label, __FILE__, __LINE__)
 #define logError(error, message) logErrorInternal(error, message, __FILE__, __LINE__)
 #define logMessage(str, ...) printf(str, __VA_ARGS__)
 #else
 #define glCall(func) func
+#define glLabel(identifier, name, label)
 #define logError(error, message)
 #endif // __DEBUG
 
+// a glCall that also counts towards dgnRendererGetStats
+#define glStatCall(stat, amount, func) renderStatAdd_internal(stat, amount); glCall(func)
+
 #endif // D_INTERNAL_H
 
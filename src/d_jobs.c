@@ -0,0 +1,192 @@
+#include "d_internal.h"
+#include "DgnEngine/DgnEngine.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif // _WIN32
+
+// Persistent worker pool for data parallel loops. The calling thread works
+// alongside the workers and parallel for calls are serialised, one loop at a time.
+
+static pthread_t s_workers[MAX_JOB_THREADS_INTERNAL];
+static uint8_t s_worker_count = 0;
+static uint8_t s_initialized = DGN_FALSE;
+static uint8_t s_quit = DGN_FALSE;
+
+static pthread_mutex_t s_submit_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_start_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t s_done_cond = PTHREAD_COND_INITIALIZER;
+
+static uint64_t s_generation = 0;
+static uint8_t s_busy_workers = 0;
+
+static JobFuncInternal s_func;
+static void *s_user_data;
+static uint32_t s_count;
+static uint32_t s_batch;
+static atomic_uint s_next;
+
+static void runBatchesInternal()
+{
+    DGN_PROFILE_SCOPE("job batches");
+
+    while(1)
+    {
+        uint32_t begin = atomic_fetch_add(&s_next, s_batch);
+        if(begin >= s_count) break;
+
+        uint32_t end = begin + s_batch < s_count ? begin + s_batch : s_count;
+        s_func(begin, end, s_user_data);
+    }
+}
+
+static void *workerMainInternal(void *arg)
+{
+    // generation at creation, so a worker that starts late still joins the first loop
+    uint64_t seen = *(uint64_t*)arg;
+
+    dgnProfileSetThreadName("jobs worker");
+
+    pthread_mutex_lock(&s_mutex);
+    while(1)
+    {
+        while(s_generation == seen && !s_quit)
+        {
+            pthread_cond_wait(&s_start_cond, &s_mutex);
+        }
+
+        if(s_quit) break;
+
+        seen = s_generation;
+        pthread_mutex_unlock(&s_mutex);
+
+        runBatchesInternal();
+
+        pthread_mutex_lock(&s_mutex);
+        if(--s_busy_workers == 0)
+        {
+            pthread_cond_signal(&s_done_cond);
+        }
+    }
+    pthread_mutex_unlock(&s_mutex);
+
+    return NULL;
+}
+
+static uint8_t cpuCountInternal()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    long count = info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif // _WIN32
+
+    if(count < 1) count = 1;
+    if(count > MAX_JOB_THREADS_INTERNAL + 1) count = MAX_JOB_THREADS_INTERNAL + 1;
+
+    return (uint8_t)count;
+}
+
+static void initInternal()
+{
+    s_quit = DGN_FALSE;
+    s_worker_count = 0;
+
+    // the calling thread is one of the cores
+    uint8_t wanted = cpuCountInternal() - 1;
+    static uint64_t start_generation;
+    start_generation = s_generation;
+
+    for(uint8_t i = 0; i < wanted; i++)
+    {
+        if(pthread_create(&s_workers[s_worker_count], NULL, workerMainInternal, &start_generation) != 0)
+        {
+            logError("JOB SYSTEM", "Could not start worker thread");
+            break;
+        }
+        s_worker_count++;
+    }
+
+    s_initialized = DGN_TRUE;
+}
+
+void dgnJobsParallelFor_internal(uint32_t count, uint32_t batch, JobFuncInternal func, void *user_data)
+{
+    if(count == 0) return;
+    if(batch == 0) batch = 1;
+
+    pthread_mutex_lock(&s_submit_mutex);
+
+    if(!s_initialized)
+    {
+        initInternal();
+    }
+
+    // not worth waking anyone for a single batch
+    if(s_worker_count == 0 || count <= batch)
+    {
+        pthread_mutex_unlock(&s_submit_mutex);
+        func(0, count, user_data);
+        return;
+    }
+
+    pthread_mutex_lock(&s_mutex);
+    s_func = func;
+    s_user_data = user_data;
+    s_count = count;
+    s_batch = batch;
+    atomic_store(&s_next, 0);
+    s_busy_workers = s_worker_count;
+    s_generation++;
+    pthread_cond_broadcast(&s_start_cond);
+    pthread_mutex_unlock(&s_mutex);
+
+    runBatchesInternal();
+
+    pthread_mutex_lock(&s_mutex);
+    while(s_busy_workers > 0)
+    {
+        pthread_cond_wait(&s_done_cond, &s_mutex);
+    }
+    pthread_mutex_unlock(&s_mutex);
+
+    pthread_mutex_unlock(&s_submit_mutex);
+}
+
+uint8_t dgnJobsGetThreadCount_internal()
+{
+    if(!s_initialized)
+    {
+        pthread_mutex_lock(&s_submit_mutex);
+        if(!s_initialized) initInternal();
+        pthread_mutex_unlock(&s_submit_mutex);
+    }
+
+    return s_worker_count + 1;
+}
+
+void dgnJobsTerm_internal()
+{
+    if(!s_initialized) return;
+
+    pthread_mutex_lock(&s_mutex);
+    s_quit = DGN_TRUE;
+    pthread_cond_broadcast(&s_start_cond);
+    pthread_mutex_unlock(&s_mutex);
+
+    for(uint8_t i = 0; i < s_worker_count; i++)
+    {
+        pthread_join(s_workers[i], NULL);
+    }
+
+    s_worker_count = 0;
+    s_initialized = DGN_FALSE;
+}
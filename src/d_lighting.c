@@ -6,6 +6,11 @@
 #include <float.h>
 #include <math.h>
 
+// the tight fit's size is rounded up to this fraction of the cascade's bounding sphere
+#define CASCADE_SIZE_STEPS 32.0f
+// depth bins the receivers are sorted into when placing the splits
+#define SPLIT_HISTOGRAM_BINS 64
+
 Mat4x4 dgnLightingCreateDirViewMat(Vec3 dir)
 {
     Mat4x4 light_rot = m3dMat4x4InitIdentity();
@@ -17,7 +22,8 @@ Mat4x4 dgnLightingCreateDirViewMat(Vec3 dir)
     return light_rot;
 }
 
-Mat4x4 dgnLightingCreateLightProjMat(DgnCamera cam, DgnShadowMap shadow, DgnFrustum frustum, float near_pull)
+// corners of the frustum slice in light space
+static void frustumCornersLightInternal(DgnCamera *cam, DgnShadowMap shadow, DgnFrustum frustum, Vec3 out_corners[8])
 {
     float ratio = frustum.width / frustum.height;
     float tanHalfHFOV = tanf(frustum.fov * ratio / 2.0f);
@@ -31,38 +37,52 @@ Mat4x4 dgnLightingCreateLightProjMat(DgnCamera cam, DgnShadowMap shadow, DgnFrus
     float proj_far_x = proj_far_z   * tanHalfHFOV;
 
     // local positions
-    Vec4 frustum_corners[] =
+    Vec3 frustum_corners[] =
     {
         // near
-        {proj_near_x,  -proj_near_y, proj_near_z, 1.0f},
-        {proj_near_x,   proj_near_y, proj_near_z, 1.0f},
-        {-proj_near_x, -proj_near_y, proj_near_z, 1.0f},
-        {-proj_near_x,  proj_near_y, proj_near_z, 1.0f},
+        {proj_near_x,  -proj_near_y, proj_near_z},
+        {proj_near_x,   proj_near_y, proj_near_z},
+        {-proj_near_x, -proj_near_y, proj_near_z},
+        {-proj_near_x,  proj_near_y, proj_near_z},
 
         // far plane
-        {proj_far_x,  -proj_far_y, proj_far_z, 1.0f},
-        {proj_far_x,   proj_far_y, proj_far_z, 1.0f},
-        {-proj_far_x, -proj_far_y, proj_far_z, 1.0f},
-        {-proj_far_x,  proj_far_y, proj_far_z, 1.0f}
+        {proj_far_x,  -proj_far_y, proj_far_z},
+        {proj_far_x,   proj_far_y, proj_far_z},
+        {-proj_far_x, -proj_far_y, proj_far_z},
+        {-proj_far_x,  proj_far_y, proj_far_z}
     };
 
-    // transform to world space
+    // view to world to light space in one matrix and one batch
 
-    //Vec3 frustum_corners_W[8];
-    Vec3 frustum_corners_L[8];
-    Mat4x4 inv_view = dgnCameraGetInverseView(cam);
+    Mat4x4 view_to_light;
+    dgnMathMulMat4x4N(&shadow.view_mat, dgnCameraGetInverseView(cam), &view_to_light, 1);
 
-    for (uint8_t j = 0 ; j < 8 ; j++)
-    {
+    dgnMathTransformPoints(&view_to_light, frustum_corners, out_corners, 8);
+}
+
+static DgnBoundingBox boxToLightInternal(DgnBoundingBox box, Mat4x4 light_view)
+{
+    dgnMathTransformBoxes(&light_view, &box, &box, 1);
+    return box;
+}
 
-        // Transform the frustum coordinate from view to world space
-        Vec4 vW = m3dMat4x4MulVec4(inv_view, frustum_corners[j]);
+Mat4x4 dgnLightingCreateLightProjMat(DgnCamera *cam, DgnShadowMap shadow, DgnFrustum frustum, float near_pull)
+{
+    DgnBoundingBox no_bounds = {{0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}};
 
-        // Transform the frustum coordinate from world to light space
-        Vec4 vL = m3dMat4x4MulVec4(shadow.view_mat, vW);
-        frustum_corners_L[j] = (Vec3){vL.x, vL.y, vL.z};
-        //frustum_corners_W[j] = (Vec3){vW.x, vW.y, vW.z};
-    }
+    return dgnLightingCreateFittedProjMat(cam, shadow, frustum, DGN_CASCADE_FIT_SPHERE, no_bounds, near_pull);
+}
+
+Mat4x4 dgnLightingCreateFittedProjMat(DgnCamera *cam, DgnShadowMap shadow, DgnFrustum frustum, uint8_t fit_flags,
+                                      DgnBoundingBox scene_bounds, float near_pull)
+{
+    DGN_PROFILE_SCOPE("cascade fit");
+
+    Vec3 frustum_corners_L[8];
+    frustumCornersLightInternal(cam, shadow, frustum, frustum_corners_L);
+
+    uint16_t map_width = shadow.width ? shadow.width : dgnTextureGetWidth(shadow.texture);
+    uint16_t map_height = shadow.width ? shadow.height : dgnTextureGetHeight(shadow.texture);
 
     /** ---- Fix Shadow Shimmering ---- **/
 
@@ -72,20 +92,162 @@ Mat4x4 dgnLightingCreateLightProjMat(DgnCamera cam, DgnShadowMap shadow, DgnFrus
     sphere.radius /= 1.414314f;
     DgnBoundingBox ortho_box;
 
-    /** -- Position shimmering -- **/
-    float rx2 = sphere.radius * 2.0f;
-    Vec3 texel_world_size = {rx2 / dgnTextureGetWidth(shadow.texture),
-                             rx2 / dgnTextureGetHeight(shadow.texture), 1.0f};
+    if(fit_flags & DGN_CASCADE_FIT_AABB)
+    {
+        // the tight box changes size as the camera turns, so its size is rounded up to steps of
+        // the rotation independent sphere and only the position is left to move
+        ortho_box = dgnCollisionGenerateBox(frustum_corners_L, 8);
+
+        if(fit_flags & DGN_CASCADE_FIT_CLAMP_Z)
+        {
+            // nothing to receive a shadow outside the scene
+            DgnBoundingBox scene_L = boxToLightInternal(scene_bounds, shadow.view_mat);
+            ortho_box.min.x = fmaxf(ortho_box.min.x, scene_L.min.x);
+            ortho_box.min.y = fmaxf(ortho_box.min.y, scene_L.min.y);
+            ortho_box.max.x = fmaxf(fminf(ortho_box.max.x, scene_L.max.x), ortho_box.min.x);
+            ortho_box.max.y = fmaxf(fminf(ortho_box.max.y, scene_L.max.y), ortho_box.min.y);
+        }
+
+        float quantum = sphere.radius * 2.0f / CASCADE_SIZE_STEPS;
+        float extent_x = fmaxf(ceilf((ortho_box.max.x - ortho_box.min.x) / quantum), 1.0f) * quantum;
+        float extent_y = fmaxf(ceilf((ortho_box.max.y - ortho_box.min.y) / quantum), 1.0f) * quantum;
+
+        /** -- Position shimmering -- **/
+        // snapping min down can cost up to a texel, so the extent spans one texel less than the map
+        // and the ortho width is exactly map_width of the same texels the snap uses
+        float texel_x = extent_x / (map_width - 1);
+        float texel_y = extent_y / (map_height - 1);
+
+        ortho_box.min.x = floorf(ortho_box.min.x / texel_x) * texel_x;
+        ortho_box.min.y = floorf(ortho_box.min.y / texel_y) * texel_y;
+        ortho_box.max.x = ortho_box.min.x + texel_x * map_width;
+        ortho_box.max.y = ortho_box.min.y + texel_y * map_height;
+    }
+    else
+    {
+        /** -- Position shimmering -- **/
+        float rx2 = sphere.radius * 2.0f;
+        Vec3 texel_world_size = {rx2 / map_width, rx2 / map_height, 1.0f};
+
+        sphere.center = m3dVec3DivVec3(sphere.center, texel_world_size);
+        sphere.center.x = floor(sphere.center.x);
+        sphere.center.y = floor(sphere.center.y);
+        sphere.center = m3dVec3MulVec3(sphere.center, texel_world_size);
+
+        ortho_box.max = m3dVec3AddVec3(sphere.center, (Vec3){sphere.radius, sphere.radius, sphere.radius});
+        ortho_box.min = m3dVec3SubVec3(sphere.center, (Vec3){sphere.radius, sphere.radius, sphere.radius});
+    }
+
+    float near_z = ortho_box.min.z - near_pull;
+    float far_z = ortho_box.max.z;
+
+    if(fit_flags & DGN_CASCADE_FIT_CLAMP_Z)
+    {
+        // every caster in the scene stays in front of the near plane and
+        // the far plane stops at the last receiver
+        DgnBoundingBox scene_L = boxToLightInternal(scene_bounds, shadow.view_mat);
+        near_z = scene_L.min.z;
+        far_z = fmaxf(fminf(ortho_box.max.z, scene_L.max.z), near_z + 0.01f);
+    }
+
+    return m3dMat4x4InitOrtho(ortho_box.max.x, ortho_box.min.x, ortho_box.max.y, ortho_box.min.y, near_z, far_z);
+}
+
+void dgnLightingComputeCascadeSplits(float *out_depths, uint8_t cascade_count, float near, float far, float log_blend)
+{
+    for(uint8_t i = 0; i <= cascade_count; i++)
+    {
+        float ioverm = (float)i / (float)cascade_count;
+        float dist_uni = near + (far - near) * ioverm;
+        float dist_log = near * powf(far / near, ioverm);
+
+        out_depths[i] = m3d1DLerp(dist_uni, dist_log, log_blend);
+    }
+}
+
+// bins are spaced logarithmically between near and far, like the splits themselves
+static float binEdgeInternal(uint16_t bin, float near, float far)
+{
+    return near * powf(far / near, (float)bin / SPLIT_HISTOGRAM_BINS);
+}
+
+static uint16_t binIndexInternal(float depth, float near, float far)
+{
+    float bin = logf(depth / near) / logf(far / near) * SPLIT_HISTOGRAM_BINS;
+    return (uint16_t)fminf(fmaxf(bin, 0.0f), SPLIT_HISTOGRAM_BINS - 1);
+}
+
+void dgnLightingFitCascadeSplits(float *out_depths, uint8_t cascade_count, DgnCamera *cam, const DgnBoundingSphere *receivers,
+                                 uint32_t receiver_count, float near, float far, float log_blend)
+{
+    DGN_PROFILE_SCOPE("cascade splits");
+
+    uint8_t covered[SPLIT_HISTOGRAM_BINS] = {0};
+    float lo = far;
+    float hi = near;
+
+    const Mat4x4 *view = dgnCameraGetView(cam);
+
+    for(uint32_t i = 0; i < receiver_count; i++)
+    {
+        Vec3 center;
+        dgnMathTransformPoints(view, &receivers[i].center, &center, 1);
+
+        // view space looks down -z
+        float start = fmaxf(-center.z - receivers[i].radius, near);
+        float end = fminf(-center.z + receivers[i].radius, far);
+        if(end <= start) continue;
+
+        lo = fminf(lo, start);
+        hi = fmaxf(hi, end);
+
+        uint16_t last = binIndexInternal(end, near, far);
+        for(uint16_t b = binIndexInternal(start, near, far); b <= last; b++)
+        {
+            covered[b] = DGN_TRUE;
+        }
+    }
+
+    // nothing worth fitting to, keep the whole range
+    if(hi <= lo * 1.01f)
+    {
+        dgnLightingComputeCascadeSplits(out_depths, cascade_count, near, far, log_blend);
+        return;
+    }
+
+    // covered depth up to the start of each bin, empty stretches add nothing
+    float covered_before[SPLIT_HISTOGRAM_BINS + 1];
+    covered_before[0] = 0.0f;
+
+    for(uint16_t b = 0; b < SPLIT_HISTOGRAM_BINS; b++)
+    {
+        float start = fmaxf(binEdgeInternal(b, near, far), lo);
+        float end = fminf(binEdgeInternal(b + 1, near, far), hi);
+        covered_before[b + 1] = covered_before[b] + (covered[b] ? fmaxf(end - start, 0.0f) : 0.0f);
+    }
+
+    // split the covered depth as usual, then map each split back through the histogram, so a
+    // gap with no receivers collapses into a single boundary instead of taking a cascade's share
+    float covered_total = covered_before[SPLIT_HISTOGRAM_BINS];
+    dgnLightingComputeCascadeSplits(out_depths, cascade_count, lo, lo + covered_total, log_blend);
 
-    sphere.center = m3dVec3DivVec3(sphere.center, texel_world_size);
-    sphere.center.x = floor(sphere.center.x);
-    sphere.center.y = floor(sphere.center.y);
-    sphere.center = m3dVec3MulVec3(sphere.center, texel_world_size);
+    for(uint8_t i = 1; i < cascade_count; i++)
+    {
+        float target = out_depths[i] - lo;
+        out_depths[i] = hi;
 
-    ortho_box.max = m3dVec3AddVec3(sphere.center, (Vec3){sphere.radius, sphere.radius, sphere.radius});
-    ortho_box.min = m3dVec3SubVec3(sphere.center, (Vec3){sphere.radius, sphere.radius, sphere.radius});
+        for(uint16_t b = 0; b < SPLIT_HISTOGRAM_BINS; b++)
+        {
+            if(covered[b] && covered_before[b + 1] >= target && covered_before[b + 1] > covered_before[b])
+            {
+                out_depths[i] = fmaxf(binEdgeInternal(b, near, far), lo) + target - covered_before[b];
+                break;
+            }
+        }
+    }
 
-    return m3dMat4x4InitOrtho(ortho_box.max.x, ortho_box.min.x, ortho_box.max.y, ortho_box.min.y, ortho_box.min.z - near_pull, ortho_box.max.z);
+    out_depths[0] = lo;
+    out_depths[cascade_count] = hi;
 }
 
 Mat4x4 dgnLightingCreateLightSpaceMat(DgnShadowMap shadow)
@@ -93,6 +255,41 @@ Mat4x4 dgnLightingCreateLightSpaceMat(DgnShadowMap shadow)
     return m3dMat4x4MulMat4x4(shadow.proj_mat, shadow.view_mat);
 }
 
+Mat4x4 dgnLightingCreateAtlasMat(DgnShadowMap shadow)
+{
+    Mat4x4 res = m3dMat4x4InitIdentity();
+
+    if(shadow.width == 0)
+    {
+        return res;
+    }
+
+    float tex_width = dgnTextureGetWidth(shadow.texture);
+    float tex_height = dgnTextureGetHeight(shadow.texture);
+
+    // clip space x and y of -1 to 1 land on the map's area, still in the texture's clip space
+    res.m[0][0] = shadow.width / tex_width;
+    res.m[1][1] = shadow.height / tex_height;
+    res.m[0][3] = (2.0f * shadow.x + shadow.width) / tex_width - 1.0f;
+    res.m[1][3] = (2.0f * shadow.y + shadow.height) / tex_height - 1.0f;
+
+    return res;
+}
+
+Vec4 dgnLightingGetShadowRect(DgnShadowMap shadow)
+{
+    float tex_width = dgnTextureGetWidth(shadow.texture);
+    float tex_height = dgnTextureGetHeight(shadow.texture);
+
+    if(shadow.width == 0)
+    {
+        return (Vec4){0.0f, 0.0f, 1.0f, 1.0f};
+    }
+
+    return (Vec4){(shadow.x + 0.5f) / tex_width, (shadow.y + 0.5f) / tex_height,
+                  (shadow.x + shadow.width - 0.5f) / tex_width, (shadow.y + shadow.height - 0.5f) / tex_height};
+}
+
 DgnTexture *dgnLightingCreateShadowMap(uint16_t width, uint16_t height, uint8_t light_type)
 {
     DgnTexture *res = NULL;
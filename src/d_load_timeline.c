@@ -0,0 +1,330 @@
+#include "d_internal.h"
+#include "DGNEngine/DGNEngine.h"
+
+#include <MemLeaker/malloc.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+// stage handles carry the timeline generation above the segment index, so a stage begun before
+// dgnLoadTimelineStart cleared the timeline cannot end a newer one
+#define SEGMENT_INDEX_BITS 24
+#define SEGMENT_INDEX_MASK ((1u << SEGMENT_INDEX_BITS) - 1)
+
+typedef struct
+{
+    uint32_t asset;
+    uint8_t stage;
+    double start;
+    // negative while the stage is still running
+    double end;
+}LoadSegment;
+
+static const char *s_stage_names[DGN_LOAD_STAGE_COUNT] =
+{
+    "read",
+    "decode",
+    "convert",
+    "upload",
+    "compile"
+};
+
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t s_recording;
+static uint8_t s_generation;
+static double s_start;
+static double s_stop;
+
+static char **s_assets;
+static uint32_t s_asset_count;
+static uint32_t s_asset_capacity;
+
+static LoadSegment *s_segments;
+static uint32_t s_segment_count;
+static uint32_t s_segment_capacity;
+
+static void clearInternal()
+{
+    for(uint32_t i = 0; i < s_asset_count; i++)
+    {
+        free(s_assets[i]);
+    }
+
+    s_asset_count = 0;
+    s_segment_count = 0;
+}
+
+static uint32_t findAssetInternal(const char *asset)
+{
+    for(uint32_t i = 0; i < s_asset_count; i++)
+    {
+        if(strcmp(s_assets[i], asset) == 0)
+        {
+            return i;
+        }
+    }
+
+    if(s_asset_count == s_asset_capacity)
+    {
+        s_asset_capacity = s_asset_capacity ? s_asset_capacity * 2 : 32;
+        s_assets = realloc(s_assets, sizeof(*s_assets) * s_asset_capacity);
+    }
+
+    size_t len = strlen(asset) + 1;
+    s_assets[s_asset_count] = malloc(len);
+    memcpy(s_assets[s_asset_count], asset, len);
+
+    return s_asset_count++;
+}
+
+/** ---- Recording ---- **/
+
+void dgnLoadTimelineStart()
+{
+    pthread_mutex_lock(&s_mutex);
+
+    clearInternal();
+    s_generation++;
+    s_recording = DGN_TRUE;
+    s_start = clockSeconds_internal();
+    s_stop = s_start;
+
+    pthread_mutex_unlock(&s_mutex);
+}
+
+void dgnLoadTimelineStop()
+{
+    pthread_mutex_lock(&s_mutex);
+
+    if(s_recording)
+    {
+        s_recording = DGN_FALSE;
+        s_stop = clockSeconds_internal();
+    }
+
+    pthread_mutex_unlock(&s_mutex);
+}
+
+uint8_t dgnLoadTimelineIsRecording()
+{
+    pthread_mutex_lock(&s_mutex);
+    uint8_t recording = s_recording;
+    pthread_mutex_unlock(&s_mutex);
+
+    return recording;
+}
+
+uint32_t loadStageBegin_internal(const char *asset, uint8_t stage)
+{
+    pthread_mutex_lock(&s_mutex);
+
+    if(!s_recording || asset == NULL || stage >= DGN_LOAD_STAGE_COUNT || s_segment_count > SEGMENT_INDEX_MASK)
+    {
+        pthread_mutex_unlock(&s_mutex);
+        return LOAD_STAGE_NONE_INTERNAL;
+    }
+
+    if(s_segment_count == s_segment_capacity)
+    {
+        s_segment_capacity = s_segment_capacity ? s_segment_capacity * 2 : 256;
+        s_segments = realloc(s_segments, sizeof(*s_segments) * s_segment_capacity);
+    }
+
+    uint32_t index = s_segment_count++;
+    LoadSegment *segment = &s_segments[index];
+    segment->asset = findAssetInternal(asset);
+    segment->stage = stage;
+    segment->end = -1.0;
+    segment->start = clockSeconds_internal();
+
+    uint32_t handle = ((uint32_t)s_generation << SEGMENT_INDEX_BITS) | index;
+
+    pthread_mutex_unlock(&s_mutex);
+
+    return handle;
+}
+
+void loadStageEnd_internal(uint32_t stage)
+{
+    if(stage == LOAD_STAGE_NONE_INTERNAL) return;
+
+    double time = clockSeconds_internal();
+
+    pthread_mutex_lock(&s_mutex);
+
+    uint32_t index = stage & SEGMENT_INDEX_MASK;
+    if((uint8_t)(stage >> SEGMENT_INDEX_BITS) == s_generation && index < s_segment_count)
+    {
+        s_segments[index].end = time;
+    }
+
+    pthread_mutex_unlock(&s_mutex);
+}
+
+void loadTimelineTerm_internal()
+{
+    pthread_mutex_lock(&s_mutex);
+
+    clearInternal();
+    s_recording = DGN_FALSE;
+
+    free(s_assets);
+    free(s_segments);
+    s_assets = NULL;
+    s_segments = NULL;
+    s_asset_capacity = 0;
+    s_segment_capacity = 0;
+
+    pthread_mutex_unlock(&s_mutex);
+}
+
+/** ---- Report ---- **/
+
+// expects the lock to be held
+static void reportInternal(DgnLoadReport *out_report)
+{
+    memset(out_report, 0, sizeof(*out_report));
+
+    double stop = s_recording ? clockSeconds_internal() : s_stop;
+
+    out_report->asset_count = s_asset_count;
+    out_report->wall_time = stop - s_start;
+
+    for(uint32_t i = 0; i < s_segment_count; i++)
+    {
+        const LoadSegment *segment = &s_segments[i];
+
+        if(segment->end >= 0.0)
+        {
+            out_report->stage_totals[segment->stage] += segment->end - segment->start;
+        }
+    }
+
+    // from the end, keep stepping to the start of the stage that finished last before that point,
+    // anything running alongside it on another thread did not hold the load up
+    double time = stop;
+
+    while(time > s_start)
+    {
+        const LoadSegment *latest = NULL;
+
+        for(uint32_t i = 0; i < s_segment_count; i++)
+        {
+            const LoadSegment *segment = &s_segments[i];
+
+            if(segment->end < 0.0 || segment->end > time || segment->start >= time)
+            {
+                continue;
+            }
+
+            if(latest == NULL || segment->end > latest->end ||
+               (segment->end == latest->end && segment->start < latest->start))
+            {
+                latest = segment;
+            }
+        }
+
+        if(latest == NULL)
+        {
+            out_report->critical_other += time - s_start;
+            break;
+        }
+
+        double start = latest->start > s_start ? latest->start : s_start;
+
+        out_report->critical_other += time - latest->end;
+        out_report->critical_path[latest->stage] += latest->end - start;
+        time = start;
+    }
+}
+
+void dgnLoadTimelineGetReport(DgnLoadReport *out_report)
+{
+    pthread_mutex_lock(&s_mutex);
+    reportInternal(out_report);
+    pthread_mutex_unlock(&s_mutex);
+}
+
+const char *dgnLoadTimelineGetStageName(uint8_t stage)
+{
+    return stage < DGN_LOAD_STAGE_COUNT ? s_stage_names[stage] : "";
+}
+
+static void printMsInternal(double seconds)
+{
+    if(seconds > 0.0)
+    {
+        printf(" %9.2f", seconds * 1000.0);
+    }
+    else
+    {
+        printf(" %9s", "-");
+    }
+}
+
+void dgnLoadTimelinePrint()
+{
+    pthread_mutex_lock(&s_mutex);
+
+    DgnLoadReport report;
+    reportInternal(&report);
+
+    printf("---- Load timeline, ms ----\n%-48s", "asset");
+    for(uint8_t s = 0; s < DGN_LOAD_STAGE_COUNT; s++)
+    {
+        printf(" %9s", s_stage_names[s]);
+    }
+    printf(" %9s\n", "total");
+
+    for(uint32_t a = 0; a < s_asset_count; a++)
+    {
+        double stages[DGN_LOAD_STAGE_COUNT] = {0};
+        double total = 0.0;
+
+        for(uint32_t i = 0; i < s_segment_count; i++)
+        {
+            const LoadSegment *segment = &s_segments[i];
+
+            if(segment->asset == a && segment->end >= 0.0)
+            {
+                stages[segment->stage] += segment->end - segment->start;
+                total += segment->end - segment->start;
+            }
+        }
+
+        // long paths keep their end, that is the part telling assets apart
+        size_t len = strlen(s_assets[a]);
+        printf("%-48s", len > 48 ? s_assets[a] + len - 48 : s_assets[a]);
+        for(uint8_t s = 0; s < DGN_LOAD_STAGE_COUNT; s++)
+        {
+            printMsInternal(stages[s]);
+        }
+        printMsInternal(total);
+        printf("\n");
+    }
+
+    double total = 0.0;
+    printf("%-48s", "all assets");
+    for(uint8_t s = 0; s < DGN_LOAD_STAGE_COUNT; s++)
+    {
+        printMsInternal(report.stage_totals[s]);
+        total += report.stage_totals[s];
+    }
+    printMsInternal(total);
+    printf("\n");
+
+    printf("critical path over %.2f ms of wall time:\n", report.wall_time * 1000.0);
+    for(uint8_t s = 0; s < DGN_LOAD_STAGE_COUNT; s++)
+    {
+        if(report.critical_path[s] > 0.0)
+        {
+            printf("    %-10s %9.2f ms %5.1f%%\n", s_stage_names[s], report.critical_path[s] * 1000.0,
+                   report.wall_time > 0.0 ? report.critical_path[s] / report.wall_time * 100.0 : 0.0);
+        }
+    }
+    printf("    %-10s %9.2f ms %5.1f%%\n", "other", report.critical_other * 1000.0,
+           report.wall_time > 0.0 ? report.critical_other / report.wall_time * 100.0 : 0.0);
+
+    pthread_mutex_unlock(&s_mutex);
+}
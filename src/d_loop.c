@@ -0,0 +1,205 @@
+#include "d_internal.h"
+#include "DGNEngine/DGNEngine.h"
+
+#include <MemLeaker/malloc.h>
+
+#ifdef _WIN32
+#include <windows.h>
+// timeBeginPeriod, links against winmm
+#include <mmsystem.h>
+#else
+#include <time.h>
+#endif // _WIN32
+
+// the limiter never trusts a sleep to end closer than this to the deadline
+#define MIN_SPIN_MARGIN 0.0005
+#define START_SPIN_MARGIN 0.002
+// past this the limiter would spin most of a short frame away, a rare late wake up is cheaper
+#define MAX_SPIN_MARGIN 0.003
+// how fast a large oversleep is forgotten
+#define SPIN_MARGIN_DECAY 0.99
+
+struct DgnLoop
+{
+    double tick_delta;
+    double accumulator;
+    uint32_t max_substeps;
+    uint32_t ticks_left;
+
+    uint64_t tick_count;
+    uint64_t dropped_ticks;
+
+    // frame limiter
+    double frame_limit;
+    double frame_start;
+    double spin_margin;
+    // windows sleeps in ~15.6 ms steps unless the timer period is raised while limiting
+    uint8_t timer_raised;
+};
+
+DgnLoop *dgnLoopCreate(double tick_delta, uint32_t max_substeps)
+{
+    if(tick_delta <= 0.0 || max_substeps == 0)
+    {
+        logError("LOOP", "Tick delta and max substeps must be above 0");
+        return NULL;
+    }
+
+    DgnLoop *res = malloc(sizeof(*res));
+
+    if(res == NULL)
+    {
+        return NULL;
+    }
+
+    res->tick_delta = tick_delta;
+    res->accumulator = 0.0;
+    res->max_substeps = max_substeps;
+    res->ticks_left = 0;
+    res->tick_count = 0;
+    res->dropped_ticks = 0;
+
+    res->frame_limit = 0.0;
+    res->frame_start = clockSeconds_internal();
+    res->spin_margin = START_SPIN_MARGIN;
+    res->timer_raised = DGN_FALSE;
+
+    return res;
+}
+
+static void raiseTimerInternal(DgnLoop *loop, uint8_t raise)
+{
+#ifdef _WIN32
+    if(raise && !loop->timer_raised)
+    {
+        loop->timer_raised = timeBeginPeriod(1) == TIMERR_NOERROR;
+    }
+    else if(!raise && loop->timer_raised)
+    {
+        timeEndPeriod(1);
+        loop->timer_raised = DGN_FALSE;
+    }
+#endif // _WIN32
+}
+
+void dgnLoopDestroy(DgnLoop *loop)
+{
+    raiseTimerInternal(loop, DGN_FALSE);
+
+    free(loop);
+}
+
+/** ---- Simulation ---- **/
+
+uint32_t dgnLoopBeginFrame(DgnLoop *loop, double frame_delta)
+{
+    loop->accumulator += frame_delta > 0.0 ? frame_delta : 0.0;
+
+    uint32_t ticks = (uint32_t)(loop->accumulator / loop->tick_delta);
+
+    // after a long hitch, drop the time the simulation cannot catch up on instead of spiralling
+    if(ticks > loop->max_substeps)
+    {
+        loop->dropped_ticks += ticks - loop->max_substeps;
+        loop->accumulator -= (ticks - loop->max_substeps) * loop->tick_delta;
+        ticks = loop->max_substeps;
+    }
+
+    loop->ticks_left = ticks;
+
+    return ticks;
+}
+
+uint8_t dgnLoopStep(DgnLoop *loop)
+{
+    if(loop->ticks_left == 0)
+    {
+        return DGN_FALSE;
+    }
+
+    loop->ticks_left--;
+    loop->accumulator -= loop->tick_delta;
+    loop->tick_count++;
+
+    return DGN_TRUE;
+}
+
+double dgnLoopGetTickDelta(DgnLoop *loop)
+{
+    return loop->tick_delta;
+}
+
+float dgnLoopGetAlpha(DgnLoop *loop)
+{
+    float alpha = (float)(loop->accumulator / loop->tick_delta);
+
+    return alpha < 0.0f ? 0.0f : alpha > 1.0f ? 1.0f : alpha;
+}
+
+uint64_t dgnLoopGetTickCount(DgnLoop *loop)
+{
+    return loop->tick_count;
+}
+
+uint64_t dgnLoopGetDroppedTicks(DgnLoop *loop)
+{
+    return loop->dropped_ticks;
+}
+
+/** ---- Frame limiter ---- **/
+
+void dgnLoopSetFrameLimit(DgnLoop *loop, double min_frame_time)
+{
+    loop->frame_limit = min_frame_time > 0.0 ? min_frame_time : 0.0;
+
+    raiseTimerInternal(loop, loop->frame_limit > 0.0);
+}
+
+static void sleepInternal(double seconds)
+{
+#ifdef _WIN32
+    Sleep((DWORD)(seconds * 1000.0));
+#else
+    struct timespec ts;
+    ts.tv_sec = (time_t)seconds;
+    ts.tv_nsec = (long)((seconds - ts.tv_sec) * 1e9);
+    nanosleep(&ts, NULL);
+#endif // _WIN32
+}
+
+void dgnLoopWaitFrame(DgnLoop *loop)
+{
+    double deadline = loop->frame_start + loop->frame_limit;
+    double now = clockSeconds_internal();
+
+    if(loop->frame_limit > 0.0 && now < deadline)
+    {
+        double max_margin = loop->frame_limit * 0.5 < MAX_SPIN_MARGIN ? loop->frame_limit * 0.5 : MAX_SPIN_MARGIN;
+
+        // coarse sleeps while the os can be trusted to wake in time
+        while(deadline - now > loop->spin_margin)
+        {
+            double want = deadline - now - loop->spin_margin;
+            sleepInternal(want);
+
+            double after = clockSeconds_internal();
+            double over = (after - now) - want;
+            now = after;
+
+            // grow straight to a bad wake up, then slowly shrink back towards the minimum
+            loop->spin_margin *= SPIN_MARGIN_DECAY;
+            if(over > loop->spin_margin) loop->spin_margin = over;
+            if(loop->spin_margin > max_margin) loop->spin_margin = max_margin;
+            if(loop->spin_margin < MIN_SPIN_MARGIN) loop->spin_margin = MIN_SPIN_MARGIN;
+        }
+
+        // the last fraction is spun for precision
+        while(now < deadline)
+        {
+            now = clockSeconds_internal();
+        }
+    }
+
+    // a late frame starts the next one from now, rather than trying to catch up
+    loop->frame_start = loop->frame_limit > 0.0 && now - deadline < loop->frame_limit ? deadline : now;
+}
@@ -0,0 +1,522 @@
+#include "d_internal.h"
+#include "DgnEngine/DgnEngine.h"
+
+#include <pthread.h>
+#include <math.h>
+
+// Batched math kernels. Every function has a scalar version and, on x86, SSE and AVX
+// versions picked once at runtime. Output arrays may be the input arrays.
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define MATH_SSE_INTERNAL
+#include <xmmintrin.h>
+
+#if defined(__GNUC__)
+#define MATH_AVX_INTERNAL
+#define AVX_TARGET_INTERNAL __attribute__((target("avx")))
+#include <immintrin.h>
+#include <cpuid.h>
+#elif defined(_MSC_VER)
+#define MATH_AVX_INTERNAL
+#define AVX_TARGET_INTERNAL
+#include <immintrin.h>
+#include <intrin.h>
+#endif // __GNUC__
+
+#endif // __SSE__
+
+struct MathKernelsInternal
+{
+    void (*transform_points)(const Mat4x4 *mat, const Vec3 *points, Vec3 *out, uint32_t count);
+    void (*transform_boxes)(const Mat4x4 *mat, const DgnBoundingBox *boxes, DgnBoundingBox *out, uint32_t count);
+    // lhs_step is 0 when every rhs is multiplied by the same lhs
+    void (*mul_mat4x4)(const Mat4x4 *lhs, uint32_t lhs_step, const Mat4x4 *rhs, Mat4x4 *out, uint32_t count);
+    void (*quat_to_mat4x4)(const Quat *rot, const Vec3 *pos, const Vec3 *scale, Mat4x4 *out, uint32_t count);
+};
+
+static const struct MathKernelsInternal *s_kernels;
+static uint8_t s_level;
+static uint8_t s_supported_level;
+static pthread_once_t s_once = PTHREAD_ONCE_INIT;
+
+/** ---- Scalar ---- **/
+
+static void transformPointsScalar(const Mat4x4 *mat, const Vec3 *points, Vec3 *out, uint32_t count)
+{
+    const float (*m)[4] = mat->m;
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        Vec3 p = points[i];
+
+        out[i].x = m[0][0] * p.x + m[0][1] * p.y + m[0][2] * p.z + m[0][3];
+        out[i].y = m[1][0] * p.x + m[1][1] * p.y + m[1][2] * p.z + m[1][3];
+        out[i].z = m[2][0] * p.x + m[2][1] * p.y + m[2][2] * p.z + m[2][3];
+    }
+}
+
+static void transformBoxesScalar(const Mat4x4 *mat, const DgnBoundingBox *boxes, DgnBoundingBox *out, uint32_t count)
+{
+    const float (*m)[4] = mat->m;
+
+    // the new box is the transformed center plus the extents through the absolute matrix
+    for(uint32_t i = 0; i < count; i++)
+    {
+        float c[3] = {(boxes[i].max.x + boxes[i].min.x) * 0.5f,
+                      (boxes[i].max.y + boxes[i].min.y) * 0.5f,
+                      (boxes[i].max.z + boxes[i].min.z) * 0.5f};
+        float e[3] = {(boxes[i].max.x - boxes[i].min.x) * 0.5f,
+                      (boxes[i].max.y - boxes[i].min.y) * 0.5f,
+                      (boxes[i].max.z - boxes[i].min.z) * 0.5f};
+        float nc[3];
+        float ne[3];
+
+        for(int r = 0; r < 3; r++)
+        {
+            nc[r] = m[r][0] * c[0] + m[r][1] * c[1] + m[r][2] * c[2] + m[r][3];
+            ne[r] = fabsf(m[r][0]) * e[0] + fabsf(m[r][1]) * e[1] + fabsf(m[r][2]) * e[2];
+        }
+
+        out[i].max = (Vec3){nc[0] + ne[0], nc[1] + ne[1], nc[2] + ne[2]};
+        out[i].min = (Vec3){nc[0] - ne[0], nc[1] - ne[1], nc[2] - ne[2]};
+    }
+}
+
+static void mulMat4x4Scalar(const Mat4x4 *lhs, uint32_t lhs_step, const Mat4x4 *rhs, Mat4x4 *out, uint32_t count)
+{
+    for(uint32_t i = 0; i < count; i++)
+    {
+        const Mat4x4 *a = lhs + i * lhs_step;
+        Mat4x4 res;
+
+        for(int r = 0; r < 4; r++)
+        {
+            for(int c = 0; c < 4; c++)
+            {
+                res.m[r][c] = a->m[r][0] * rhs[i].m[0][c] + a->m[r][1] * rhs[i].m[1][c] +
+                              a->m[r][2] * rhs[i].m[2][c] + a->m[r][3] * rhs[i].m[3][c];
+            }
+        }
+
+        out[i] = res;
+    }
+}
+
+static void quatToMat4x4Scalar(const Quat *rot, const Vec3 *pos, const Vec3 *scale, Mat4x4 *out, uint32_t count)
+{
+    for(uint32_t i = 0; i < count; i++)
+    {
+        Quat q = rot[i];
+        Vec3 t = pos ? pos[i] : (Vec3){0.0f, 0.0f, 0.0f};
+        Vec3 s = scale ? scale[i] : (Vec3){1.0f, 1.0f, 1.0f};
+
+        float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+        float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+        float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+        out[i] = (Mat4x4){{
+            {(1.0f - 2.0f * (yy + zz)) * s.x, 2.0f * (xy - wz) * s.y, 2.0f * (xz + wy) * s.z, t.x},
+            {2.0f * (xy + wz) * s.x, (1.0f - 2.0f * (xx + zz)) * s.y, 2.0f * (yz - wx) * s.z, t.y},
+            {2.0f * (xz - wy) * s.x, 2.0f * (yz + wx) * s.y, (1.0f - 2.0f * (xx + yy)) * s.z, t.z},
+            {0.0f, 0.0f, 0.0f, 1.0f}
+        }};
+    }
+}
+
+static const struct MathKernelsInternal s_scalar_kernels =
+{
+    transformPointsScalar, transformBoxesScalar, mulMat4x4Scalar, quatToMat4x4Scalar
+};
+
+#ifdef MATH_SSE_INTERNAL
+
+/** ---- SSE ---- **/
+
+// four packed Vec3 (12 floats) to x, y and z lanes
+static inline void loadVec3x4Internal(const Vec3 *p, __m128 *x, __m128 *y, __m128 *z)
+{
+    const float *f = (const float*)p;
+    __m128 a = _mm_loadu_ps(f);     // x0 y0 z0 x1
+    __m128 b = _mm_loadu_ps(f + 4); // y1 z1 x2 y2
+    __m128 c = _mm_loadu_ps(f + 8); // z2 x3 y3 z3
+
+    *x = _mm_shuffle_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 3, 0)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 1, 0));
+    *y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+    *z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 3, 0)), _MM_SHUFFLE(1, 0, 2, 0));
+}
+
+static inline void storeVec3x4Internal(Vec3 *p, __m128 x, __m128 y, __m128 z)
+{
+    float *f = (float*)p;
+
+    _mm_storeu_ps(f,     _mm_shuffle_ps(_mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 0, 0, 0)), _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(f + 4, _mm_shuffle_ps(_mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)), _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(f + 8, _mm_shuffle_ps(_mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)), _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+static void transformPointsSSE(const Mat4x4 *mat, const Vec3 *points, Vec3 *out, uint32_t count)
+{
+    __m128 m[3][4];
+    for(int r = 0; r < 3; r++)
+    {
+        for(int c = 0; c < 4; c++) m[r][c] = _mm_set1_ps(mat->m[r][c]);
+    }
+
+    uint32_t i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128 x, y, z;
+        loadVec3x4Internal(points + i, &x, &y, &z);
+
+        __m128 ox = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0][0], x), _mm_mul_ps(m[0][1], y)), _mm_add_ps(_mm_mul_ps(m[0][2], z), m[0][3]));
+        __m128 oy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[1][0], x), _mm_mul_ps(m[1][1], y)), _mm_add_ps(_mm_mul_ps(m[1][2], z), m[1][3]));
+        __m128 oz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[2][0], x), _mm_mul_ps(m[2][1], y)), _mm_add_ps(_mm_mul_ps(m[2][2], z), m[2][3]));
+
+        storeVec3x4Internal(out + i, ox, oy, oz);
+    }
+
+    transformPointsScalar(mat, points + i, out + i, count - i);
+}
+
+static void transformBoxesSSE(const Mat4x4 *mat, const DgnBoundingBox *boxes, DgnBoundingBox *out, uint32_t count)
+{
+    __m128 m[3][4];
+    __m128 a[3][3];
+    __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 half = _mm_set1_ps(0.5f);
+
+    for(int r = 0; r < 3; r++)
+    {
+        for(int c = 0; c < 4; c++) m[r][c] = _mm_set1_ps(mat->m[r][c]);
+        for(int c = 0; c < 3; c++) a[r][c] = _mm_andnot_ps(sign, m[r][c]);
+    }
+
+    uint32_t i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        const DgnBoundingBox *b = boxes + i;
+
+        // boxes are six floats apart, gathering is cheaper than shuffling 24 floats
+        __m128 max[3] = {_mm_setr_ps(b[0].max.x, b[1].max.x, b[2].max.x, b[3].max.x),
+                         _mm_setr_ps(b[0].max.y, b[1].max.y, b[2].max.y, b[3].max.y),
+                         _mm_setr_ps(b[0].max.z, b[1].max.z, b[2].max.z, b[3].max.z)};
+        __m128 min[3] = {_mm_setr_ps(b[0].min.x, b[1].min.x, b[2].min.x, b[3].min.x),
+                         _mm_setr_ps(b[0].min.y, b[1].min.y, b[2].min.y, b[3].min.y),
+                         _mm_setr_ps(b[0].min.z, b[1].min.z, b[2].min.z, b[3].min.z)};
+
+        __m128 c[3], e[3];
+        for(int k = 0; k < 3; k++)
+        {
+            c[k] = _mm_mul_ps(_mm_add_ps(max[k], min[k]), half);
+            e[k] = _mm_mul_ps(_mm_sub_ps(max[k], min[k]), half);
+        }
+
+        float nmax[3][4], nmin[3][4];
+        for(int r = 0; r < 3; r++)
+        {
+            __m128 nc = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[r][0], c[0]), _mm_mul_ps(m[r][1], c[1])), _mm_add_ps(_mm_mul_ps(m[r][2], c[2]), m[r][3]));
+            __m128 ne = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[r][0], e[0]), _mm_mul_ps(a[r][1], e[1])), _mm_mul_ps(a[r][2], e[2]));
+
+            _mm_storeu_ps(nmax[r], _mm_add_ps(nc, ne));
+            _mm_storeu_ps(nmin[r], _mm_sub_ps(nc, ne));
+        }
+
+        for(int k = 0; k < 4; k++)
+        {
+            out[i + k].max = (Vec3){nmax[0][k], nmax[1][k], nmax[2][k]};
+            out[i + k].min = (Vec3){nmin[0][k], nmin[1][k], nmin[2][k]};
+        }
+    }
+
+    transformBoxesScalar(mat, boxes + i, out + i, count - i);
+}
+
+static void mulMat4x4SSE(const Mat4x4 *lhs, uint32_t lhs_step, const Mat4x4 *rhs, Mat4x4 *out, uint32_t count)
+{
+    for(uint32_t i = 0; i < count; i++)
+    {
+        const Mat4x4 *a = lhs + i * lhs_step;
+
+        // every row of the result is a mix of the rows of rhs
+        __m128 b0 = _mm_loadu_ps(rhs[i].m[0]);
+        __m128 b1 = _mm_loadu_ps(rhs[i].m[1]);
+        __m128 b2 = _mm_loadu_ps(rhs[i].m[2]);
+        __m128 b3 = _mm_loadu_ps(rhs[i].m[3]);
+        __m128 rows[4];
+
+        for(int r = 0; r < 4; r++)
+        {
+            rows[r] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a->m[r][0]), b0), _mm_mul_ps(_mm_set1_ps(a->m[r][1]), b1)),
+                                 _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a->m[r][2]), b2), _mm_mul_ps(_mm_set1_ps(a->m[r][3]), b3)));
+        }
+
+        for(int r = 0; r < 4; r++)
+        {
+            _mm_storeu_ps(out[i].m[r], rows[r]);
+        }
+    }
+}
+
+static void quatToMat4x4SSE(const Quat *rot, const Vec3 *pos, const Vec3 *scale, Mat4x4 *out, uint32_t count)
+{
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 two = _mm_set1_ps(2.0f);
+    __m128 zero = _mm_setzero_ps();
+    __m128 last_row = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+
+    uint32_t i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(&rot[i].x);
+        __m128 y = _mm_loadu_ps(&rot[i + 1].x);
+        __m128 z = _mm_loadu_ps(&rot[i + 2].x);
+        __m128 w = _mm_loadu_ps(&rot[i + 3].x);
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+
+        __m128 tx = zero, ty = zero, tz = zero;
+        __m128 sx = one, sy = one, sz = one;
+
+        if(pos)
+        {
+            loadVec3x4Internal(pos + i, &tx, &ty, &tz);
+        }
+        if(scale)
+        {
+            loadVec3x4Internal(scale + i, &sx, &sy, &sz);
+        }
+
+        __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+        __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+        __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+        __m128 r0[4] = {_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx),
+                        _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy),
+                        _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz), tx};
+        __m128 r1[4] = {_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx),
+                        _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy),
+                        _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz), ty};
+        __m128 r2[4] = {_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx),
+                        _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy),
+                        _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz), tz};
+
+        // lanes hold one matrix each, transposing turns them back into rows
+        _MM_TRANSPOSE4_PS(r0[0], r0[1], r0[2], r0[3]);
+        _MM_TRANSPOSE4_PS(r1[0], r1[1], r1[2], r1[3]);
+        _MM_TRANSPOSE4_PS(r2[0], r2[1], r2[2], r2[3]);
+
+        for(int k = 0; k < 4; k++)
+        {
+            _mm_storeu_ps(out[i + k].m[0], r0[k]);
+            _mm_storeu_ps(out[i + k].m[1], r1[k]);
+            _mm_storeu_ps(out[i + k].m[2], r2[k]);
+            _mm_storeu_ps(out[i + k].m[3], last_row);
+        }
+    }
+
+    quatToMat4x4Scalar(rot + i, pos ? pos + i : NULL, scale ? scale + i : NULL, out + i, count - i);
+}
+
+static const struct MathKernelsInternal s_sse_kernels =
+{
+    transformPointsSSE, transformBoxesSSE, mulMat4x4SSE, quatToMat4x4SSE
+};
+
+#endif // MATH_SSE_INTERNAL
+
+#ifdef MATH_AVX_INTERNAL
+
+/** ---- AVX ---- **/
+
+AVX_TARGET_INTERNAL
+static void transformPointsAVX(const Mat4x4 *mat, const Vec3 *points, Vec3 *out, uint32_t count)
+{
+    __m256 m[3][4];
+    for(int r = 0; r < 3; r++)
+    {
+        for(int c = 0; c < 4; c++) m[r][c] = _mm256_set1_ps(mat->m[r][c]);
+    }
+
+    uint32_t i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        __m128 x0, y0, z0, x1, y1, z1;
+        loadVec3x4Internal(points + i, &x0, &y0, &z0);
+        loadVec3x4Internal(points + i + 4, &x1, &y1, &z1);
+
+        __m256 x = _mm256_insertf128_ps(_mm256_castps128_ps256(x0), x1, 1);
+        __m256 y = _mm256_insertf128_ps(_mm256_castps128_ps256(y0), y1, 1);
+        __m256 z = _mm256_insertf128_ps(_mm256_castps128_ps256(z0), z1, 1);
+
+        __m256 ox = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[0][0], x), _mm256_mul_ps(m[0][1], y)), _mm256_add_ps(_mm256_mul_ps(m[0][2], z), m[0][3]));
+        __m256 oy = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[1][0], x), _mm256_mul_ps(m[1][1], y)), _mm256_add_ps(_mm256_mul_ps(m[1][2], z), m[1][3]));
+        __m256 oz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[2][0], x), _mm256_mul_ps(m[2][1], y)), _mm256_add_ps(_mm256_mul_ps(m[2][2], z), m[2][3]));
+
+        storeVec3x4Internal(out + i, _mm256_castps256_ps128(ox), _mm256_castps256_ps128(oy), _mm256_castps256_ps128(oz));
+        storeVec3x4Internal(out + i + 4, _mm256_extractf128_ps(ox, 1), _mm256_extractf128_ps(oy, 1), _mm256_extractf128_ps(oz, 1));
+    }
+
+    transformPointsSSE(mat, points + i, out + i, count - i);
+}
+
+AVX_TARGET_INTERNAL
+static void mulMat4x4AVX(const Mat4x4 *lhs, uint32_t lhs_step, const Mat4x4 *rhs, Mat4x4 *out, uint32_t count)
+{
+    for(uint32_t i = 0; i < count; i++)
+    {
+        const Mat4x4 *a = lhs + i * lhs_step;
+
+        // two rows of the result per register
+        __m256 b0 = _mm256_broadcast_ps((const __m128*)rhs[i].m[0]);
+        __m256 b1 = _mm256_broadcast_ps((const __m128*)rhs[i].m[1]);
+        __m256 b2 = _mm256_broadcast_ps((const __m128*)rhs[i].m[2]);
+        __m256 b3 = _mm256_broadcast_ps((const __m128*)rhs[i].m[3]);
+        __m256 rows[2];
+
+        for(int r = 0; r < 2; r++)
+        {
+            const float *lo = a->m[r * 2];
+            const float *hi = a->m[r * 2 + 1];
+
+            rows[r] = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_setr_ps(lo[0], lo[0], lo[0], lo[0], hi[0], hi[0], hi[0], hi[0]), b0),
+                                                  _mm256_mul_ps(_mm256_setr_ps(lo[1], lo[1], lo[1], lo[1], hi[1], hi[1], hi[1], hi[1]), b1)),
+                                    _mm256_add_ps(_mm256_mul_ps(_mm256_setr_ps(lo[2], lo[2], lo[2], lo[2], hi[2], hi[2], hi[2], hi[2]), b2),
+                                                  _mm256_mul_ps(_mm256_setr_ps(lo[3], lo[3], lo[3], lo[3], hi[3], hi[3], hi[3], hi[3]), b3)));
+        }
+
+        _mm256_storeu_ps(out[i].m[0], rows[0]);
+        _mm256_storeu_ps(out[i].m[2], rows[1]);
+    }
+}
+
+static const struct MathKernelsInternal s_avx_kernels =
+{
+    transformPointsAVX, transformBoxesSSE, mulMat4x4AVX, quatToMat4x4SSE
+};
+
+#endif // MATH_AVX_INTERNAL
+
+/** ---- Dispatch ---- **/
+
+static uint8_t cpuSupportsAvxInternal()
+{
+#if defined(MATH_AVX_INTERNAL) && defined(__GNUC__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx") ? DGN_TRUE : DGN_FALSE;
+#elif defined(MATH_AVX_INTERNAL)
+    int info[4];
+    __cpuid(info, 1);
+
+    // the cpu has it and the os saves the ymm registers
+    uint8_t cpu = (info[2] & (1 << 28)) && (info[2] & (1 << 27));
+    return cpu && (_xgetbv(0) & 0x6) == 0x6;
+#else
+    return DGN_FALSE;
+#endif // MATH_AVX_INTERNAL
+}
+
+static void selectKernelsInternal(uint8_t level)
+{
+    if(level > s_supported_level) level = s_supported_level;
+
+    s_level = level;
+    s_kernels = &s_scalar_kernels;
+
+#ifdef MATH_SSE_INTERNAL
+    if(level == DGN_SIMD_SSE) s_kernels = &s_sse_kernels;
+#endif // MATH_SSE_INTERNAL
+#ifdef MATH_AVX_INTERNAL
+    if(level == DGN_SIMD_AVX) s_kernels = &s_avx_kernels;
+#endif // MATH_AVX_INTERNAL
+}
+
+static void initInternal()
+{
+    s_supported_level = DGN_SIMD_SCALAR;
+
+#ifdef MATH_SSE_INTERNAL
+    s_supported_level = DGN_SIMD_SSE;
+#endif // MATH_SSE_INTERNAL
+
+    if(cpuSupportsAvxInternal())
+    {
+        s_supported_level = DGN_SIMD_AVX;
+    }
+
+    selectKernelsInternal(s_supported_level);
+}
+
+static inline const struct MathKernelsInternal *kernelsInternal()
+{
+    pthread_once(&s_once, initInternal);
+    return s_kernels;
+}
+
+uint8_t dgnMathGetSimdLevel()
+{
+    kernelsInternal();
+    return s_level;
+}
+
+uint8_t dgnMathSetSimdLevel(uint8_t level)
+{
+    kernelsInternal();
+    selectKernelsInternal(level);
+    return s_level;
+}
+
+/** ---- Batches ---- **/
+
+void dgnMathTransformPoints(const Mat4x4 *mat, const Vec3 *points, Vec3 *out, uint32_t count)
+{
+    kernelsInternal()->transform_points(mat, points, out, count);
+}
+
+void dgnMathTransformBoxes(const Mat4x4 *mat, const DgnBoundingBox *boxes, DgnBoundingBox *out, uint32_t count)
+{
+    kernelsInternal()->transform_boxes(mat, boxes, out, count);
+}
+
+void dgnMathMulMat4x4N(const Mat4x4 *lhs, const Mat4x4 *rhs, Mat4x4 *out, uint32_t count)
+{
+    kernelsInternal()->mul_mat4x4(lhs, 1, rhs, out, count);
+}
+
+void dgnMathMulMat4x4Shared(const Mat4x4 *lhs, const Mat4x4 *rhs, Mat4x4 *out, uint32_t count)
+{
+    kernelsInternal()->mul_mat4x4(lhs, 0, rhs, out, count);
+}
+
+void dgnMathQuatToMat4x4N(const Quat *rot, const Vec3 *pos, const Vec3 *scale, Mat4x4 *out, uint32_t count)
+{
+    kernelsInternal()->quat_to_mat4x4(rot, pos, scale, out, count);
+}
+
+void dgnMathNormalMatrixN(const Mat4x4 *models, Mat3x3 *out, uint32_t count)
+{
+    // the cofactor matrix is the inverse transpose scaled by the determinant, normals are
+    // renormalized anyway so only the sign of the determinant has to be undone
+    for(uint32_t i = 0; i < count; i++)
+    {
+        const float (*m)[4] = models[i].m;
+        Mat3x3 r;
+
+        r.m[0][0] = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+        r.m[0][1] = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+        r.m[0][2] = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+        r.m[1][0] = m[0][2] * m[2][1] - m[0][1] * m[2][2];
+        r.m[1][1] = m[0][0] * m[2][2] - m[0][2] * m[2][0];
+        r.m[1][2] = m[0][1] * m[2][0] - m[0][0] * m[2][1];
+        r.m[2][0] = m[0][1] * m[1][2] - m[0][2] * m[1][1];
+        r.m[2][1] = m[0][2] * m[1][0] - m[0][0] * m[1][2];
+        r.m[2][2] = m[0][0] * m[1][1] - m[0][1] * m[1][0];
+
+        float det = m[0][0] * r.m[0][0] + m[0][1] * r.m[0][1] + m[0][2] * r.m[0][2];
+
+        if(det < 0.0f)
+        {
+            for(int j = 0; j < 9; j++) (&r.m[0][0])[j] = -(&r.m[0][0])[j];
+        }
+
+        out[i] = r;
+    }
+}
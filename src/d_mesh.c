@@ -11,6 +11,21 @@
 
 #include <MemLeaker/malloc.h>
 
+#include <float.h>
+#include <math.h>
+
+// each level targets this fraction of the previous level's triangles
+#define LOD_REDUCTION 0.4f
+// a level that cannot drop below this fraction of the previous one is not worth keeping
+#define LOD_MIN_GAIN 0.85f
+// allowed mean deviation from the source surface, relative to the mesh radius
+#define LOD_MAX_ERROR 0.05f
+// fraction of the lod threshold the projected size has to cross before switching
+#define LOD_HYSTERESIS 0.15f
+
+// projected diameter over screen height below which each level is used
+static const float s_lod_screen_sizes[MAX_MESH_LODS_INTERNAL] = {1.0f, 0.25f, 0.1f, 0.04f};
+
 DgnMesh* dgnMeshCreate(float vertex_data[],
     size_t vertex_data_size,
     uint32_t index_data[],
@@ -23,16 +38,16 @@ DgnMesh* dgnMeshCreate(float vertex_data[],
     glCall(glGenBuffers(1, &vbo));
     glCall(glGenBuffers(1, &ibo));
 
-    glCall(glBindVertexArray(vao));
+    glStatCall(DGN_RENDER_STAT_VAO_BINDS, 1, glBindVertexArray(vao));
 
     // -------- Index Data
     glCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo));
-    glCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_data_size, index_data, GL_STATIC_DRAW));
+    glStatCall(DGN_RENDER_STAT_UPLOAD_BYTES, index_data_size, glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_data_size, index_data, GL_STATIC_DRAW));
     glCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
 
     // -------- Vertex Data
     glCall(glBindBuffer(GL_ARRAY_BUFFER, vbo));
-    glCall(glBufferData(GL_ARRAY_BUFFER, vertex_data_size, vertex_data, GL_STATIC_DRAW));
+    glStatCall(DGN_RENDER_STAT_UPLOAD_BYTES, vertex_data_size, glBufferData(GL_ARRAY_BUFFER, vertex_data_size, vertex_data, GL_STATIC_DRAW));
 
     uint32_t index = 0;
     uint32_t stride = 0;
@@ -88,7 +103,11 @@ DgnMesh* dgnMeshCreate(float vertex_data[],
 
     glCall(glBindBuffer(GL_ARRAY_BUFFER, 0));
 
-    glCall(glBindVertexArray(0));
+    glStatCall(DGN_RENDER_STAT_VAO_BINDS, 1, glBindVertexArray(0));
+
+    glLabel(GL_VERTEX_ARRAY, vao, "mesh");
+    glLabel(GL_BUFFER, vbo, "mesh vertices");
+    glLabel(GL_BUFFER, ibo, "mesh indices");
 
     DgnMesh *res = malloc(sizeof(*res));
 
@@ -97,11 +116,45 @@ DgnMesh* dgnMeshCreate(float vertex_data[],
     res->IBO = ibo;
     res->length = index_data_size / sizeof(*index_data);
 
+    res->lod_offsets[0] = 0;
+    res->lod_lengths[0] = res->length;
+    res->lod_count = 1;
+    res->current_lod = 0;
+
+    res->center = (Vec3){0.0f, 0.0f, 0.0f};
+    res->radius = 0.0f;
+
+    // position is always the first attribute
+    if(mesh_type & DGN_VERT_ATTRIB_POSITION)
+    {
+        size_t stride_floats = stride / sizeof(float);
+        size_t vertex_count = vertex_data_size / stride;
+        Vec3 min = {FLT_MAX, FLT_MAX, FLT_MAX};
+        Vec3 max = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+
+        for(size_t v = 0; v < vertex_count; v++)
+        {
+            float *p = vertex_data + v * stride_floats;
+            min = (Vec3){fminf(min.x, p[0]), fminf(min.y, p[1]), fminf(min.z, p[2])};
+            max = (Vec3){fmaxf(max.x, p[0]), fmaxf(max.y, p[1]), fmaxf(max.z, p[2])};
+        }
+
+        if(vertex_count > 0)
+        {
+            res->center = m3dVec3DivValue(m3dVec3AddVec3(min, max), 2.0f);
+            res->radius = m3dVec3Distance(max, res->center);
+        }
+    }
+
     return res;
 }
 
-DgnMesh *aiMeshConvert(struct aiMesh* mesh)
+DgnMesh *aiMeshConvert(struct aiMesh* mesh, const char *filepath)
 {
+    DGN_PROFILE_SCOPE("mesh convert");
+
+    uint32_t stage = loadStageBegin_internal(filepath, DGN_LOAD_STAGE_CONVERT);
+
     uint8_t single_vertex_size = 0;
     uint16_t mesh_type = 0;
 
@@ -174,7 +227,77 @@ DgnMesh *aiMeshConvert(struct aiMesh* mesh)
         }
     }
 
+    /** ---- Levels of detail ---- **/
+
+    // all levels are appended to the same index buffer, lod 0 first
+    uint32_t lod_offsets[MAX_MESH_LODS_INTERNAL] = {0};
+    uint32_t lod_lengths[MAX_MESH_LODS_INTERNAL] = {mesh->mNumFaces * 3};
+    uint8_t lod_count = 1;
+
+    uint32_t *lod_indices = NULL;
+    if(mesh_type & DGN_VERT_ATTRIB_POSITION)
+    {
+        lod_indices = realloc(indices, size_indices * MAX_MESH_LODS_INTERNAL);
+
+        // the full mesh is still usable without room for the smaller levels
+        if(lod_indices == NULL)
+        {
+            logError("MESH LODS", "Out of memory, only the full detail level is kept");
+        }
+    }
+
+    if(lod_indices != NULL)
+    {
+        indices = lod_indices;
+
+        Vec3 min = {FLT_MAX, FLT_MAX, FLT_MAX};
+        Vec3 max = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+        for(uint32_t v = 0; v < mesh->mNumVertices; v++)
+        {
+            struct aiVector3D p = mesh->mVertices[v];
+            min = (Vec3){fminf(min.x, p.x), fminf(min.y, p.y), fminf(min.z, p.z)};
+            max = (Vec3){fmaxf(max.x, p.x), fmaxf(max.y, p.y), fmaxf(max.z, p.z)};
+        }
+        float radius = m3dVec3Distance(max, min) / 2.0f;
+
+        DGN_PROFILE_SCOPE("mesh lods");
+
+        for(; lod_count < MAX_MESH_LODS_INTERNAL; lod_count++)
+        {
+            uint32_t prev_offset = lod_offsets[lod_count - 1];
+            uint32_t prev_length = lod_lengths[lod_count - 1];
+            uint32_t target = (uint32_t)(prev_length / 3 * LOD_REDUCTION) * 3;
+            uint32_t offset = prev_offset + prev_length;
+
+            uint32_t length = meshSimplify_internal(indices + offset, indices + prev_offset, prev_length,
+                                                    vertices, mesh->mNumVertices, single_vertex_size,
+                                                    target, radius * LOD_MAX_ERROR);
+
+            if(length == 0 || length > prev_length * LOD_MIN_GAIN)
+            {
+                break;
+            }
+
+            lod_offsets[lod_count] = offset;
+            lod_lengths[lod_count] = length;
+        }
+
+        size_indices = (lod_offsets[lod_count - 1] + lod_lengths[lod_count - 1]) * sizeof(uint32_t);
+    }
+
+    loadStageEnd_internal(stage);
+
+    stage = loadStageBegin_internal(filepath, DGN_LOAD_STAGE_UPLOAD);
     DgnMesh *res = dgnMeshCreate(vertices, size_vertices, indices, size_indices, mesh_type);
+    loadStageEnd_internal(stage);
+
+    if(res != NULL)
+    {
+        res->length = lod_lengths[0];
+        res->lod_count = lod_count;
+        memcpy(res->lod_offsets, lod_offsets, sizeof(lod_offsets));
+        memcpy(res->lod_lengths, lod_lengths, sizeof(lod_lengths));
+    }
 
     free(vertices);
     free(indices);
@@ -184,7 +307,11 @@ DgnMesh *aiMeshConvert(struct aiMesh* mesh)
 
 DgnMesh **dgnMeshLoad(const char *filepath, uint16_t *out_num_meshes)
 {
-    const struct aiScene* scene = aiImportFile( filepath, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+    DGN_PROFILE_SCOPE("dgnMeshLoad");
+
+    uint32_t stage = loadStageBegin_internal(filepath, DGN_LOAD_STAGE_DECODE);
+    const struct aiScene* scene = aiImportFile( filepath, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+    loadStageEnd_internal(stage);
     // If the import failed, report it
     if(!scene)
     {
@@ -209,7 +336,14 @@ DgnMesh **dgnMeshLoad(const char *filepath, uint16_t *out_num_meshes)
     // Now we can access the file's contents
     for(int i = 0; i < mesh_num; i++)
     {
-        res[i] = aiMeshConvert(scene->mMeshes[i]);
+        res[i] = aiMeshConvert(scene->mMeshes[i], filepath);
+
+        if(res[i] != NULL)
+        {
+            glLabel(GL_VERTEX_ARRAY, res[i]->VAO, filepath);
+            glLabel(GL_BUFFER, res[i]->VBO, filepath);
+            glLabel(GL_BUFFER, res[i]->IBO, filepath);
+        }
     }
 
     // We're done. Release all resources associated with this import
@@ -217,9 +351,71 @@ DgnMesh **dgnMeshLoad(const char *filepath, uint16_t *out_num_meshes)
     return res;
 }
 
+DgnBoundingSphere dgnMeshGetBoundingSphere(DgnMesh *mesh)
+{
+    return (DgnBoundingSphere){mesh->center, mesh->radius};
+}
+
+uint8_t dgnMeshGetLodCount(DgnMesh *mesh)
+{
+    return mesh->lod_count;
+}
+
+uint32_t dgnMeshGetTriangleCount(DgnMesh *mesh, uint8_t lod)
+{
+    if(lod >= mesh->lod_count) lod = mesh->lod_count - 1;
+
+    return mesh->lod_lengths[lod] / 3;
+}
+
+void dgnMeshSetLod(DgnMesh *mesh, uint8_t lod)
+{
+    mesh->current_lod = lod < mesh->lod_count ? lod : mesh->lod_count - 1;
+}
+
+uint8_t dgnMeshSelectLod(DgnMesh *mesh, Mat4x4 model, DgnCamera *cam)
+{
+    if(mesh->lod_count <= 1)
+    {
+        return mesh->current_lod = 0;
+    }
+
+    Vec4 c = m3dMat4x4MulVec4(model, (Vec4){mesh->center.x, mesh->center.y, mesh->center.z, 1.0f});
+    Vec3 world_center = {c.x, c.y, c.z};
+
+    // largest axis scale of the model matrix
+    float sx = m3dVec3Length((Vec3){model.m[0][0], model.m[1][0], model.m[2][0]});
+    float sy = m3dVec3Length((Vec3){model.m[0][1], model.m[1][1], model.m[2][1]});
+    float sz = m3dVec3Length((Vec3){model.m[0][2], model.m[1][2], model.m[2][2]});
+    float radius = mesh->radius * fmaxf(sx, fmaxf(sy, sz));
+
+    float dist = m3dVec3Distance(world_center, cam->pos);
+    float screen_size = 1.0f;
+
+    if(dist > radius)
+    {
+        // projected diameter as a fraction of the screen height
+        screen_size = radius / (dist * tanf(cam->frustum.fov / 2.0f));
+    }
+
+    uint8_t lod = mesh->current_lod;
+
+    // only move one step past a threshold once the size has cleared it by the hysteresis band
+    while(lod + 1 < mesh->lod_count && screen_size < s_lod_screen_sizes[lod + 1] * (1.0f - LOD_HYSTERESIS))
+    {
+        lod++;
+    }
+    while(lod > 0 && screen_size > s_lod_screen_sizes[lod] * (1.0f + LOD_HYSTERESIS))
+    {
+        lod--;
+    }
+
+    return mesh->current_lod = lod;
+}
+
 void dgnMeshDestroy(DgnMesh *mesh)
 {
-    glCall(glBindVertexArray(0));
+    glStatCall(DGN_RENDER_STAT_VAO_BINDS, 1, glBindVertexArray(0));
     glCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
 
     glCall(glDeleteBuffers(1, &mesh->VBO));
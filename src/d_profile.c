@@ -0,0 +1,521 @@
+#include "d_internal.h"
+#include "DGNEngine/DGNEngine.h"
+
+#include <MemLeaker/malloc.h>
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define PROFILE_USE_TSC
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif // _MSC_VER
+#elif defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL _Thread_local
+#endif // _MSC_VER
+
+// must be a power of two, each thread keeps this many of its most recent scopes
+#define PROFILE_RING_EVENTS (1 << 15)
+#define PROFILE_MAX_DEPTH 64
+#define PROFILE_NAME_LENGTH 32
+// the tick rate is measured over at least this long before it is trusted
+#define PROFILE_MIN_CALIBRATION 0.01
+#define PROFILE_PRINT_SCOPES 256
+
+typedef struct
+{
+    const char *name;
+    uint64_t start;
+    uint64_t end;
+    uint32_t depth;
+}ProfileEvent;
+
+typedef struct ProfileThread
+{
+    struct ProfileThread *next;
+    uint32_t id;
+    char name[PROFILE_NAME_LENGTH];
+
+    // only the owning thread writes, readers use head to tell which events are complete
+    ProfileEvent *events;
+    _Atomic uint64_t head;
+
+    // scopes begun and not yet ended
+    const char *open_names[PROFILE_MAX_DEPTH];
+    uint64_t open_starts[PROFILE_MAX_DEPTH];
+    uint32_t depth;
+
+    // ring positions at the last two frame marks
+    uint64_t frame_start;
+    uint64_t frame_end;
+}ProfileThread;
+
+// a tree node while merging a frame's scopes
+typedef struct
+{
+    const char *name;
+    uint64_t total;
+    uint64_t child;
+    uint32_t calls;
+    int32_t parent;
+    int32_t first_child;
+    int32_t last_child;
+    int32_t next_sibling;
+}ProfileNode;
+
+uint8_t dgn_profile_enabled;
+
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static ProfileThread *s_threads;
+static uint32_t s_thread_count;
+// bumped on terminate so threads drop their freed ring
+static uint32_t s_generation;
+
+static uint8_t s_calibrated;
+static uint64_t s_origin_ticks;
+static double s_origin_seconds;
+
+static THREAD_LOCAL ProfileThread *t_thread;
+static THREAD_LOCAL uint32_t t_generation;
+static THREAD_LOCAL char t_name[PROFILE_NAME_LENGTH];
+
+/** ---- Clock ---- **/
+
+static inline uint64_t ticksInternal()
+{
+#if defined(PROFILE_USE_TSC)
+    return __rdtsc();
+#elif defined(_WIN32)
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (uint64_t)now.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+#endif
+}
+
+static double secondsPerTickInternal()
+{
+#if defined(PROFILE_USE_TSC)
+    // the tsc rate is not reported anywhere portable, so it is measured against the os clock
+    double seconds = clockSeconds_internal() - s_origin_seconds;
+    while(seconds < PROFILE_MIN_CALIBRATION)
+    {
+        seconds = clockSeconds_internal() - s_origin_seconds;
+    }
+
+    return seconds / (double)(ticksInternal() - s_origin_ticks);
+#elif defined(_WIN32)
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return 1.0 / (double)frequency.QuadPart;
+#else
+    return 1e-9;
+#endif
+}
+
+/** ---- Threads ---- **/
+
+static ProfileThread *currentThreadInternal()
+{
+    return t_generation == s_generation ? t_thread : NULL;
+}
+
+static ProfileThread *threadInternal()
+{
+    ProfileThread *t = currentThreadInternal();
+    if(t != NULL) return t;
+
+    t = calloc(1, sizeof(*t));
+    if(t == NULL) return NULL;
+
+    t->events = malloc(sizeof(*t->events) * PROFILE_RING_EVENTS);
+    if(t->events == NULL)
+    {
+        free(t);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&s_mutex);
+    t->id = ++s_thread_count;
+    if(t_name[0])
+    {
+        memcpy(t->name, t_name, PROFILE_NAME_LENGTH);
+    }
+    else
+    {
+        snprintf(t->name, PROFILE_NAME_LENGTH, "thread %u", t->id);
+    }
+    t->next = s_threads;
+    s_threads = t;
+    t_generation = s_generation;
+    pthread_mutex_unlock(&s_mutex);
+
+    t_thread = t;
+    return t;
+}
+
+void dgnProfileSetEnabled(uint8_t enabled)
+{
+    pthread_mutex_lock(&s_mutex);
+    if(enabled && !s_calibrated)
+    {
+        s_origin_seconds = clockSeconds_internal();
+        s_origin_ticks = ticksInternal();
+        s_calibrated = DGN_TRUE;
+    }
+    dgn_profile_enabled = enabled != 0;
+    pthread_mutex_unlock(&s_mutex);
+}
+
+uint8_t dgnProfileIsEnabled()
+{
+    return dgn_profile_enabled;
+}
+
+void dgnProfileSetThreadName(const char *name)
+{
+    snprintf(t_name, PROFILE_NAME_LENGTH, "%s", name);
+
+    ProfileThread *t = currentThreadInternal();
+    if(t != NULL)
+    {
+        pthread_mutex_lock(&s_mutex);
+        memcpy(t->name, t_name, PROFILE_NAME_LENGTH);
+        pthread_mutex_unlock(&s_mutex);
+    }
+}
+
+void profileTerm_internal()
+{
+    pthread_mutex_lock(&s_mutex);
+    dgn_profile_enabled = DGN_FALSE;
+
+    while(s_threads != NULL)
+    {
+        ProfileThread *next = s_threads->next;
+        free(s_threads->events);
+        free(s_threads);
+        s_threads = next;
+    }
+
+    s_thread_count = 0;
+    s_generation++;
+    pthread_mutex_unlock(&s_mutex);
+}
+
+/** ---- Scopes ---- **/
+
+uint32_t dgnProfileBegin(const char *name)
+{
+    if(!dgn_profile_enabled) return DGN_PROFILE_NONE;
+
+    ProfileThread *t = threadInternal();
+    if(t == NULL || t->depth >= PROFILE_MAX_DEPTH) return DGN_PROFILE_NONE;
+
+    uint32_t scope = t->depth++;
+    t->open_names[scope] = name;
+    t->open_starts[scope] = ticksInternal();
+
+    return scope;
+}
+
+void dgnProfileEnd(uint32_t scope)
+{
+    if(scope == DGN_PROFILE_NONE) return;
+
+    uint64_t end = ticksInternal();
+
+    ProfileThread *t = currentThreadInternal();
+    if(t == NULL || scope >= t->depth) return;
+
+    uint64_t head = atomic_load_explicit(&t->head, memory_order_relaxed);
+
+    // scopes left open inside this one end with it
+    while(t->depth > scope)
+    {
+        t->depth--;
+
+        ProfileEvent *e = &t->events[head & (PROFILE_RING_EVENTS - 1)];
+        e->name = t->open_names[t->depth];
+        e->start = t->open_starts[t->depth];
+        e->end = end;
+        e->depth = t->depth;
+        head++;
+    }
+
+    atomic_store_explicit(&t->head, head, memory_order_release);
+}
+
+/** ---- Frame summary ---- **/
+
+void dgnProfileFrameMark()
+{
+    ProfileThread *t = dgn_profile_enabled ? threadInternal() : currentThreadInternal();
+    if(t == NULL) return;
+
+    t->frame_start = t->frame_end;
+    t->frame_end = atomic_load_explicit(&t->head, memory_order_relaxed);
+}
+
+static int compareEventInternal(const void *a, const void *b)
+{
+    const ProfileEvent *ea = a;
+    const ProfileEvent *eb = b;
+
+    if(ea->start != eb->start) return ea->start < eb->start ? -1 : 1;
+    return (ea->depth > eb->depth) - (ea->depth < eb->depth);
+}
+
+static int32_t findChildInternal(ProfileNode *nodes, int32_t parent, const char *name)
+{
+    for(int32_t n = nodes[parent].first_child; n >= 0; n = nodes[n].next_sibling)
+    {
+        if(nodes[n].name == name || strcmp(nodes[n].name, name) == 0)
+        {
+            return n;
+        }
+    }
+
+    return -1;
+}
+
+uint32_t dgnProfileGetFrameScopes(DgnProfileScope *out_scopes, uint32_t max_scopes)
+{
+    ProfileThread *t = currentThreadInternal();
+    if(t == NULL || max_scopes == 0) return 0;
+
+    // events overwritten since the mark are gone
+    uint64_t head = atomic_load_explicit(&t->head, memory_order_relaxed);
+    uint64_t first = t->frame_start;
+    if(head > PROFILE_RING_EVENTS && first < head - PROFILE_RING_EVENTS)
+    {
+        first = head - PROFILE_RING_EVENTS;
+    }
+    if(first >= t->frame_end) return 0;
+
+    uint32_t count = (uint32_t)(t->frame_end - first);
+    ProfileEvent *events = malloc(sizeof(*events) * count);
+    ProfileNode *nodes = malloc(sizeof(*nodes) * (count + 1));
+
+    if(events == NULL || nodes == NULL)
+    {
+        free(events);
+        free(nodes);
+        return 0;
+    }
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        events[i] = t->events[(first + i) & (PROFILE_RING_EVENTS - 1)];
+    }
+
+    // the ring is in end order, the tree is built in start order so parents come first
+    qsort(events, count, sizeof(*events), compareEventInternal);
+
+    // node 0 is the root everything without a parent hangs from
+    uint32_t node_count = 1;
+    memset(&nodes[0], 0, sizeof(nodes[0]));
+    nodes[0].parent = nodes[0].first_child = nodes[0].last_child = nodes[0].next_sibling = -1;
+
+    int32_t stack_nodes[PROFILE_MAX_DEPTH];
+    uint64_t stack_ends[PROFILE_MAX_DEPTH];
+    uint32_t stack_count = 0;
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        ProfileEvent *e = &events[i];
+
+        // a parent that began before the frame mark is missing, its children move up a level
+        while(stack_count > 0 && (stack_count > e->depth || stack_ends[stack_count - 1] < e->end))
+        {
+            stack_count--;
+        }
+
+        int32_t parent = stack_count > 0 ? stack_nodes[stack_count - 1] : 0;
+        int32_t n = findChildInternal(nodes, parent, e->name);
+        uint64_t time = e->end - e->start;
+
+        if(n < 0)
+        {
+            n = node_count++;
+            nodes[n].name = e->name;
+            nodes[n].total = 0;
+            nodes[n].child = 0;
+            nodes[n].calls = 0;
+            nodes[n].parent = parent;
+            nodes[n].first_child = nodes[n].last_child = nodes[n].next_sibling = -1;
+
+            if(nodes[parent].last_child >= 0)
+            {
+                nodes[nodes[parent].last_child].next_sibling = n;
+            }
+            else
+            {
+                nodes[parent].first_child = n;
+            }
+            nodes[parent].last_child = n;
+        }
+
+        nodes[n].total += time;
+        nodes[n].calls++;
+        nodes[parent].child += time;
+
+        stack_nodes[stack_count] = n;
+        stack_ends[stack_count] = e->end;
+        stack_count++;
+    }
+
+    double seconds_per_tick = secondsPerTickInternal();
+    uint32_t written = 0;
+    uint16_t depth = 0;
+    int32_t n = nodes[0].first_child;
+
+    while(n > 0 && written < max_scopes)
+    {
+        DgnProfileScope *out = &out_scopes[written++];
+        out->name = nodes[n].name;
+        out->depth = depth;
+        out->calls = nodes[n].calls;
+        out->total = (float)(nodes[n].total * seconds_per_tick);
+        out->self = (float)((nodes[n].total - nodes[n].child) * seconds_per_tick);
+
+        if(nodes[n].first_child >= 0)
+        {
+            n = nodes[n].first_child;
+            depth++;
+            continue;
+        }
+
+        while(n > 0 && nodes[n].next_sibling < 0)
+        {
+            n = nodes[n].parent;
+            depth--;
+        }
+
+        if(n > 0) n = nodes[n].next_sibling;
+    }
+
+    free(events);
+    free(nodes);
+
+    return written;
+}
+
+void dgnProfilePrintFrame()
+{
+    DgnProfileScope scopes[PROFILE_PRINT_SCOPES];
+    uint32_t count = dgnProfileGetFrameScopes(scopes, PROFILE_PRINT_SCOPES);
+
+    printf("%-40s %10s %10s %6s\n", "scope", "total ms", "self ms", "calls");
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        char label[64];
+        snprintf(label, sizeof(label), "%*s%s", scopes[i].depth * 2, "", scopes[i].name);
+
+        printf("%-40s %10.3f %10.3f %6u\n", label, scopes[i].total * 1000.0f, scopes[i].self * 1000.0f, scopes[i].calls);
+    }
+}
+
+/** ---- Trace export ---- **/
+
+static void writeJsonStringInternal(FILE *file, const char *s)
+{
+    fputc('"', file);
+    for(; *s; s++)
+    {
+        if(*s == '"' || *s == '\\')
+        {
+            fputc('\\', file);
+        }
+        fputc(*s, file);
+    }
+    fputc('"', file);
+}
+
+uint8_t dgnProfileWriteTrace(const char *filepath)
+{
+    FILE *file = fopen(filepath, "w");
+
+    if(file == NULL)
+    {
+        logError("PROFILE", filepath);
+        return DGN_FALSE;
+    }
+
+    ProfileEvent *copy = malloc(sizeof(*copy) * PROFILE_RING_EVENTS);
+
+    if(copy == NULL)
+    {
+        fclose(file);
+        return DGN_FALSE;
+    }
+
+    // microseconds since profiling was first enabled
+    double us_per_tick = secondsPerTickInternal() * 1e6;
+    uint8_t first_event = DGN_TRUE;
+
+    fprintf(file, "{\"traceEvents\": [");
+
+    pthread_mutex_lock(&s_mutex);
+    for(ProfileThread *t = s_threads; t != NULL; t = t->next)
+    {
+        fprintf(file, "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": ",
+                first_event ? "" : ",", t->id);
+        writeJsonStringInternal(file, t->name);
+        fprintf(file, "}}");
+        first_event = DGN_FALSE;
+
+        // the owner keeps writing while this copies, anything it may have lapped is skipped after
+        uint64_t head = atomic_load_explicit(&t->head, memory_order_acquire);
+        uint64_t begin = head > PROFILE_RING_EVENTS ? head - PROFILE_RING_EVENTS : 0;
+
+        for(uint64_t i = begin; i < head; i++)
+        {
+            copy[i - begin] = t->events[i & (PROFILE_RING_EVENTS - 1)];
+        }
+
+        atomic_thread_fence(memory_order_acquire);
+        uint64_t after = atomic_load_explicit(&t->head, memory_order_relaxed);
+        uint64_t valid = after > PROFILE_RING_EVENTS ? after - PROFILE_RING_EVENTS : 0;
+
+        for(uint64_t i = begin > valid ? begin : valid; i < head; i++)
+        {
+            const ProfileEvent *e = &copy[i - begin];
+            double ts = (double)(int64_t)(e->start - s_origin_ticks) * us_per_tick;
+            double dur = (double)(e->end - e->start) * us_per_tick;
+
+            fprintf(file, ",\n{\"name\": ");
+            writeJsonStringInternal(file, e->name);
+            fprintf(file, ", \"cat\": \"dgn\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": %u}",
+                    ts, dur, t->id);
+        }
+    }
+    pthread_mutex_unlock(&s_mutex);
+
+    fprintf(file, "\n], \"displayTimeUnit\": \"ms\"}\n");
+
+    free(copy);
+
+    uint8_t ok = !ferror(file);
+    fclose(file);
+
+    return ok;
+}
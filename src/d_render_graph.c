@@ -0,0 +1,729 @@
+#include "d_internal.h"
+#include "DgnEngine/DgnEngine.h"
+
+#include <MemLeaker/malloc.h>
+#include <string.h>
+
+// physical textures not claimed for this many compiles are released
+#define POOL_TRIM_FRAMES 4
+
+#define GRAPH_ACCESS_READ_INTERNAL 0x01
+#define GRAPH_ACCESS_COLOR_INTERNAL 0x02
+#define GRAPH_ACCESS_DEPTH_INTERNAL 0x04
+#define GRAPH_ACCESS_WRITE_INTERNAL (GRAPH_ACCESS_COLOR_INTERNAL | GRAPH_ACCESS_DEPTH_INTERNAL)
+
+// the earlier pass produces what the later one sees, keeping the later pass keeps the earlier
+#define GRAPH_DEP_DATA_INTERNAL 0x01
+// the earlier pass reads what the later one overwrites, it only has to run first
+#define GRAPH_DEP_ORDER_INTERNAL 0x02
+
+// the graph's types need the public desc and callback types, so they live here instead of d_internal.h
+
+typedef struct
+{
+    uint16_t resource;
+    uint8_t access;
+}RenderGraphUse;
+
+typedef struct
+{
+    const char *name;
+    DgnRenderPassFunc execute;
+    void *user_data;
+
+    RenderGraphUse uses[MAX_PASS_RESOURCES_INTERNAL];
+    uint8_t use_count;
+
+    uint8_t side_effect;
+    uint8_t needed;
+}RenderGraphPass;
+
+typedef struct
+{
+    const char *name;
+    DgnRenderGraphTextureDesc desc;
+    uint8_t imported;
+
+    // positions in the execution order
+    uint16_t first_use;
+    uint16_t last_use;
+
+    int16_t physical;
+    DgnTexture *texture;
+}RenderGraphResource;
+
+typedef struct
+{
+    DgnRenderGraphTextureDesc desc;
+    DgnTexture *texture;
+    uint8_t unused_frames;
+}RenderGraphPhysical;
+
+typedef struct
+{
+    DgnTexture *textures[MAX_PASS_RESOURCES_INTERNAL];
+    uint8_t types[MAX_PASS_RESOURCES_INTERNAL];
+    uint8_t count;
+    DgnFramebuffer *framebuffer;
+}RenderGraphFramebuffer;
+
+struct DgnRenderGraph
+{
+    uint8_t backend;
+    uint8_t compiled;
+
+    RenderGraphPass passes[MAX_GRAPH_PASSES_INTERNAL];
+    uint16_t pass_count;
+
+    RenderGraphResource resources[MAX_GRAPH_RESOURCES_INTERNAL];
+    uint16_t resource_count;
+
+    uint16_t order[MAX_GRAPH_PASSES_INTERNAL];
+    uint16_t order_count;
+
+    // survives resets so transient textures are reused frame to frame
+    RenderGraphPhysical physicals[MAX_GRAPH_RESOURCES_INTERNAL];
+    int16_t physical_count;
+
+    RenderGraphFramebuffer framebuffers[MAX_GRAPH_FRAMEBUFFERS_INTERNAL];
+    uint8_t framebuffer_count;
+};
+
+static size_t bytesPerPixelInternal(uint16_t internal_type)
+{
+    switch(internal_type)
+    {
+    case DGN_TEX_STORAGE_RGBA32F:
+        return 16;
+    case DGN_TEX_STORAGE_RGB32F:
+        return 12;
+    case DGN_TEX_STORAGE_RGBA16F:
+        return 8;
+    case DGN_TEX_STORAGE_RGB16F:
+        return 6;
+    case DGN_TEX_STORAGE_RGB:
+    case DGN_TEX_STORAGE_SRGB:
+        return 3;
+    case DGN_TEX_STORAGE_RGBA:
+    case DGN_TEX_STORAGE_SRGBA:
+    case DGN_TEX_STORAGE_DEPTH:
+    default:
+        return 4;
+    }
+}
+
+static uint8_t descEqualInternal(DgnRenderGraphTextureDesc a, DgnRenderGraphTextureDesc b)
+{
+    return a.width == b.width && a.height == b.height &&
+           a.storage_type == b.storage_type && a.internal_type == b.internal_type &&
+           a.data_type == b.data_type && a.filtering == b.filtering;
+}
+
+DgnRenderGraph *dgnRenderGraphCreate(uint8_t backend)
+{
+    DgnRenderGraph *res = malloc(sizeof(*res));
+
+    if(res == NULL)
+    {
+        return NULL;
+    }
+
+    memset(res, 0, sizeof(*res));
+    res->backend = backend;
+
+    return res;
+}
+
+static void destroyFramebuffersInternal(DgnRenderGraph *graph)
+{
+    for(int i = 0; i < graph->framebuffer_count; i++)
+    {
+        if(graph->framebuffers[i].framebuffer != NULL)
+        {
+            dgnFramebufferDestroy(graph->framebuffers[i].framebuffer);
+        }
+    }
+
+    graph->framebuffer_count = 0;
+}
+
+static void destroyPhysicalInternal(DgnRenderGraph *graph, RenderGraphPhysical *physical)
+{
+    if(graph->backend == DGN_RENDER_GRAPH_BACKEND_GL)
+    {
+        dgnTextureDestroy(physical->texture);
+    }
+    else
+    {
+        free(physical->texture);
+    }
+
+    physical->texture = NULL;
+}
+
+void dgnRenderGraphDestroy(DgnRenderGraph *graph)
+{
+    destroyFramebuffersInternal(graph);
+
+    for(int i = 0; i < graph->physical_count; i++)
+    {
+        destroyPhysicalInternal(graph, &graph->physicals[i]);
+    }
+
+    free(graph);
+}
+
+void dgnRenderGraphReset(DgnRenderGraph *graph)
+{
+    graph->pass_count = 0;
+    graph->resource_count = 0;
+    graph->order_count = 0;
+    graph->compiled = DGN_FALSE;
+}
+
+/** ---------------- Declaration ---------------- **/
+
+static uint16_t addResourceInternal(DgnRenderGraph *graph, const char *name)
+{
+    if(graph->resource_count >= MAX_GRAPH_RESOURCES_INTERNAL)
+    {
+        logError("RENDER GRAPH", "Too many resources declared");
+        return DGN_RENDER_GRAPH_INVALID;
+    }
+
+    RenderGraphResource *r = &graph->resources[graph->resource_count];
+    memset(r, 0, sizeof(*r));
+    r->name = name;
+    r->physical = -1;
+
+    return graph->resource_count++;
+}
+
+uint16_t dgnRenderGraphCreateTexture(DgnRenderGraph *graph, const char *name, DgnRenderGraphTextureDesc desc)
+{
+    uint16_t id = addResourceInternal(graph, name);
+    if(id == DGN_RENDER_GRAPH_INVALID) return id;
+
+    graph->resources[id].desc = desc;
+    graph->resources[id].imported = DGN_FALSE;
+
+    return id;
+}
+
+uint16_t dgnRenderGraphImportTexture(DgnRenderGraph *graph, const char *name, DgnTexture *texture)
+{
+    uint16_t id = addResourceInternal(graph, name);
+    if(id == DGN_RENDER_GRAPH_INVALID) return id;
+
+    RenderGraphResource *r = &graph->resources[id];
+    r->imported = DGN_TRUE;
+    r->texture = texture;
+
+    if(texture != NULL)
+    {
+        r->desc.width = dgnTextureGetWidth(texture);
+        r->desc.height = dgnTextureGetHeight(texture);
+    }
+
+    return id;
+}
+
+uint16_t dgnRenderGraphAddPass(DgnRenderGraph *graph, const char *name, DgnRenderPassFunc execute, void *user_data)
+{
+    if(graph->pass_count >= MAX_GRAPH_PASSES_INTERNAL)
+    {
+        logError("RENDER GRAPH", "Too many passes declared");
+        return DGN_RENDER_GRAPH_INVALID;
+    }
+
+    RenderGraphPass *p = &graph->passes[graph->pass_count];
+    memset(p, 0, sizeof(*p));
+    p->name = name;
+    p->execute = execute;
+    p->user_data = user_data;
+
+    return graph->pass_count++;
+}
+
+static void passUseInternal(DgnRenderGraph *graph, uint16_t pass, uint16_t resource, uint8_t access)
+{
+    if(pass >= graph->pass_count || resource >= graph->resource_count) return;
+
+    RenderGraphPass *p = &graph->passes[pass];
+
+    if(p->use_count >= MAX_PASS_RESOURCES_INTERNAL)
+    {
+        logError("RENDER GRAPH", p->name);
+        return;
+    }
+
+    p->uses[p->use_count].resource = resource;
+    p->uses[p->use_count].access = access;
+    p->use_count++;
+}
+
+void dgnRenderGraphPassRead(DgnRenderGraph *graph, uint16_t pass, uint16_t resource)
+{
+    passUseInternal(graph, pass, resource, GRAPH_ACCESS_READ_INTERNAL);
+}
+
+void dgnRenderGraphPassWrite(DgnRenderGraph *graph, uint16_t pass, uint16_t resource)
+{
+    passUseInternal(graph, pass, resource, GRAPH_ACCESS_COLOR_INTERNAL);
+}
+
+void dgnRenderGraphPassWriteDepth(DgnRenderGraph *graph, uint16_t pass, uint16_t resource)
+{
+    passUseInternal(graph, pass, resource, GRAPH_ACCESS_DEPTH_INTERNAL);
+}
+
+void dgnRenderGraphPassSetSideEffect(DgnRenderGraph *graph, uint16_t pass)
+{
+    if(pass >= graph->pass_count) return;
+
+    graph->passes[pass].side_effect = DGN_TRUE;
+}
+
+/** ---------------- Compilation ---------------- **/
+
+static uint8_t passAccessInternal(RenderGraphPass *p, uint16_t resource)
+{
+    uint8_t access = 0;
+
+    for(int u = 0; u < p->use_count; u++)
+    {
+        if(p->uses[u].resource == resource)
+        {
+            access |= p->uses[u].access;
+        }
+    }
+
+    return access;
+}
+
+// each write makes a new version of the resource, passes see the version of the last writer declared before them
+static int32_t lastWriterInternal(DgnRenderGraph *graph, uint16_t resource, uint16_t before)
+{
+    for(int32_t p = (int32_t)before - 1; p >= 0; p--)
+    {
+        if(passAccessInternal(&graph->passes[p], resource) & GRAPH_ACCESS_WRITE_INTERNAL)
+        {
+            return p;
+        }
+    }
+
+    return -1;
+}
+
+// GRAPH_DEP_* flags for why pass b has to run before pass a, 0 if it does not
+static uint8_t dependencyInternal(DgnRenderGraph *graph, uint16_t a, uint16_t b)
+{
+    // dependencies follow declaration order, so they can never form a cycle
+    if(b >= a) return 0;
+
+    RenderGraphPass *pa = &graph->passes[a];
+    RenderGraphPass *pb = &graph->passes[b];
+    uint8_t dependency = 0;
+
+    for(int u = 0; u < pa->use_count; u++)
+    {
+        uint16_t r = pa->uses[u].resource;
+        uint8_t a_access = passAccessInternal(pa, r);
+        uint8_t b_access = passAccessInternal(pb, r);
+
+        if(!b_access) continue;
+
+        // a reads the version b wrote, or a writes on top of it
+        int32_t writer = lastWriterInternal(graph, r, a);
+        if(b == writer)
+        {
+            dependency |= GRAPH_DEP_DATA_INTERNAL;
+        }
+        // b read the version a replaces, readers of older versions wait through their writer
+        else if((a_access & GRAPH_ACCESS_WRITE_INTERNAL) && (b_access & GRAPH_ACCESS_READ_INTERNAL) && (int32_t)b > writer)
+        {
+            dependency |= GRAPH_DEP_ORDER_INTERNAL;
+        }
+    }
+
+    return dependency;
+}
+
+static void cullPassesInternal(DgnRenderGraph *graph)
+{
+    DGN_PROFILE_SCOPE("pass culling");
+
+    uint16_t stack[MAX_GRAPH_PASSES_INTERNAL];
+    uint16_t stack_count = 0;
+
+    for(uint16_t p = 0; p < graph->pass_count; p++)
+    {
+        RenderGraphPass *pass = &graph->passes[p];
+        pass->needed = pass->side_effect;
+
+        // anything written into an imported texture outlives the graph
+        for(int u = 0; u < pass->use_count; u++)
+        {
+            if((pass->uses[u].access & GRAPH_ACCESS_WRITE_INTERNAL) && graph->resources[pass->uses[u].resource].imported)
+            {
+                pass->needed = DGN_TRUE;
+            }
+        }
+
+        if(pass->needed)
+        {
+            stack[stack_count++] = p;
+        }
+    }
+
+    while(stack_count > 0)
+    {
+        uint16_t p = stack[--stack_count];
+
+        for(uint16_t q = 0; q < graph->pass_count; q++)
+        {
+            if(!graph->passes[q].needed && (dependencyInternal(graph, p, q) & GRAPH_DEP_DATA_INTERNAL))
+            {
+                graph->passes[q].needed = DGN_TRUE;
+                stack[stack_count++] = q;
+            }
+        }
+    }
+}
+
+static uint8_t orderPassesInternal(DgnRenderGraph *graph)
+{
+    uint8_t placed[MAX_GRAPH_PASSES_INTERNAL] = {0};
+    uint16_t needed_count = 0;
+
+    for(uint16_t p = 0; p < graph->pass_count; p++)
+    {
+        needed_count += graph->passes[p].needed;
+    }
+
+    graph->order_count = 0;
+
+    // repeatedly take the first declared pass whose dependencies are placed, keeps the user's order where possible
+    while(graph->order_count < needed_count)
+    {
+        uint8_t progress = DGN_FALSE;
+
+        for(uint16_t p = 0; p < graph->pass_count; p++)
+        {
+            if(!graph->passes[p].needed || placed[p]) continue;
+
+            uint8_t ready = DGN_TRUE;
+            for(uint16_t q = 0; q < graph->pass_count && ready; q++)
+            {
+                if(graph->passes[q].needed && !placed[q] && dependencyInternal(graph, p, q))
+                {
+                    ready = DGN_FALSE;
+                }
+            }
+
+            if(ready)
+            {
+                placed[p] = DGN_TRUE;
+                graph->order[graph->order_count++] = p;
+                progress = DGN_TRUE;
+                break;
+            }
+        }
+
+        if(!progress)
+        {
+            logError("RENDER GRAPH", "Pass dependencies form a cycle");
+            return DGN_FALSE;
+        }
+    }
+
+    return DGN_TRUE;
+}
+
+static int16_t allocatePhysicalInternal(DgnRenderGraph *graph, DgnRenderGraphTextureDesc desc)
+{
+    if(graph->physical_count >= MAX_GRAPH_RESOURCES_INTERNAL)
+    {
+        logError("RENDER GRAPH", "Too many physical textures");
+        return -1;
+    }
+
+    RenderGraphPhysical *physical = &graph->physicals[graph->physical_count];
+    physical->desc = desc;
+    physical->unused_frames = 0;
+
+    if(graph->backend == DGN_RENDER_GRAPH_BACKEND_GL)
+    {
+        physical->texture = dgnTextureCreate(NULL, desc.width, desc.height, DGN_TEX_WRAP_CLAMP_TO_EDGE,
+                                             desc.filtering, DGN_FALSE, desc.storage_type, desc.internal_type, desc.data_type);
+    }
+    else
+    {
+        // the null backend only needs something to hand out, nothing is ever drawn into it
+        physical->texture = malloc(sizeof(*physical->texture));
+        physical->texture->texture = 0;
+        physical->texture->width = NULL;
+        physical->texture->height = NULL;
+        physical->texture->mipmapped = DGN_FALSE;
+        physical->texture->stream = NULL;
+    }
+
+    return graph->physical_count++;
+}
+
+static void aliasResourcesInternal(DgnRenderGraph *graph)
+{
+    for(uint16_t r = 0; r < graph->resource_count; r++)
+    {
+        graph->resources[r].first_use = UINT16_MAX;
+        graph->resources[r].last_use = 0;
+        graph->resources[r].physical = -1;
+    }
+
+    for(uint16_t o = 0; o < graph->order_count; o++)
+    {
+        RenderGraphPass *p = &graph->passes[graph->order[o]];
+
+        for(int u = 0; u < p->use_count; u++)
+        {
+            RenderGraphResource *r = &graph->resources[p->uses[u].resource];
+            if(r->first_use == UINT16_MAX) r->first_use = o;
+            r->last_use = o;
+        }
+    }
+
+    // the order index after which each physical texture is free again this frame
+    int32_t busy_until[MAX_GRAPH_RESOURCES_INTERNAL];
+    for(int i = 0; i < MAX_GRAPH_RESOURCES_INTERNAL; i++)
+    {
+        busy_until[i] = -1;
+    }
+
+    uint8_t claimed[MAX_GRAPH_RESOURCES_INTERNAL] = {0};
+
+    // hand out physical textures in order of first use, reusing any with a matching desc whose last user is done
+    for(uint16_t o = 0; o < graph->order_count; o++)
+    {
+        for(uint16_t id = 0; id < graph->resource_count; id++)
+        {
+            RenderGraphResource *r = &graph->resources[id];
+            if(r->imported || r->first_use != o) continue;
+
+            int16_t chosen = -1;
+            for(int16_t i = 0; i < graph->physical_count; i++)
+            {
+                if(busy_until[i] < (int32_t)o && descEqualInternal(graph->physicals[i].desc, r->desc))
+                {
+                    chosen = i;
+                    break;
+                }
+            }
+
+            if(chosen < 0)
+            {
+                chosen = allocatePhysicalInternal(graph, r->desc);
+                if(chosen < 0) continue;
+            }
+
+            r->physical = chosen;
+            busy_until[chosen] = r->last_use;
+            claimed[chosen] = DGN_TRUE;
+        }
+    }
+
+    // release textures nothing has asked for in a while, compacting the pool
+    uint8_t trimmed = DGN_FALSE;
+    int16_t remap[MAX_GRAPH_RESOURCES_INTERNAL];
+    int16_t write = 0;
+
+    for(int16_t i = 0; i < graph->physical_count; i++)
+    {
+        RenderGraphPhysical *physical = &graph->physicals[i];
+        physical->unused_frames = claimed[i] ? 0 : physical->unused_frames + 1;
+
+        if(physical->unused_frames > POOL_TRIM_FRAMES)
+        {
+            destroyPhysicalInternal(graph, physical);
+            remap[i] = -1;
+            trimmed = DGN_TRUE;
+            continue;
+        }
+
+        remap[i] = write;
+        graph->physicals[write++] = *physical;
+    }
+
+    graph->physical_count = write;
+
+    if(trimmed)
+    {
+        // cached framebuffers may point at released textures
+        destroyFramebuffersInternal(graph);
+
+        for(uint16_t id = 0; id < graph->resource_count; id++)
+        {
+            if(graph->resources[id].physical >= 0)
+            {
+                graph->resources[id].physical = remap[graph->resources[id].physical];
+            }
+        }
+    }
+
+    for(uint16_t id = 0; id < graph->resource_count; id++)
+    {
+        RenderGraphResource *r = &graph->resources[id];
+        if(!r->imported)
+        {
+            r->texture = r->physical >= 0 ? graph->physicals[r->physical].texture : NULL;
+        }
+    }
+}
+
+uint8_t dgnRenderGraphCompile(DgnRenderGraph *graph)
+{
+    cullPassesInternal(graph);
+
+    if(!orderPassesInternal(graph))
+    {
+        return DGN_FALSE;
+    }
+
+    aliasResourcesInternal(graph);
+    graph->compiled = DGN_TRUE;
+
+    return DGN_TRUE;
+}
+
+/** ---------------- Execution ---------------- **/
+
+static DgnFramebuffer *passFramebufferInternal(DgnRenderGraph *graph, RenderGraphPass *p)
+{
+    DgnTexture *textures[MAX_PASS_RESOURCES_INTERNAL];
+    uint8_t types[MAX_PASS_RESOURCES_INTERNAL];
+    uint8_t count = 0;
+
+    for(int u = 0; u < p->use_count; u++)
+    {
+        uint8_t access = p->uses[u].access;
+        if(!(access & GRAPH_ACCESS_WRITE_INTERNAL)) continue;
+
+        textures[count] = graph->resources[p->uses[u].resource].texture;
+        types[count] = access & GRAPH_ACCESS_DEPTH_INTERNAL ? DGN_FRAMEBUFFER_DEPTH : DGN_FRAMEBUFFER_COLOR;
+        count++;
+    }
+
+    if(count == 0) return NULL;
+
+    for(int i = 0; i < graph->framebuffer_count; i++)
+    {
+        RenderGraphFramebuffer *cached = &graph->framebuffers[i];
+        if(cached->count == count &&
+           memcmp(cached->textures, textures, sizeof(*textures) * count) == 0 &&
+           memcmp(cached->types, types, sizeof(*types) * count) == 0)
+        {
+            return cached->framebuffer;
+        }
+    }
+
+    if(graph->framebuffer_count >= MAX_GRAPH_FRAMEBUFFERS_INTERNAL)
+    {
+        destroyFramebuffersInternal(graph);
+    }
+
+    RenderGraphFramebuffer *entry = &graph->framebuffers[graph->framebuffer_count++];
+    entry->count = count;
+    memcpy(entry->textures, textures, sizeof(*textures) * count);
+    memcpy(entry->types, types, sizeof(*types) * count);
+    entry->framebuffer = dgnFramebufferCreate(textures, types, count, 0);
+
+    return entry->framebuffer;
+}
+
+void dgnRenderGraphExecute(DgnRenderGraph *graph)
+{
+    if(!graph->compiled && !dgnRenderGraphCompile(graph))
+    {
+        return;
+    }
+
+    for(uint16_t o = 0; o < graph->order_count; o++)
+    {
+        RenderGraphPass *p = &graph->passes[graph->order[o]];
+        uint32_t scope = dgnProfileBegin(p->name);
+
+        if(graph->backend == DGN_RENDER_GRAPH_BACKEND_GL)
+        {
+            DgnFramebuffer *framebuffer = passFramebufferInternal(graph, p);
+            dgnFramebufferBind(framebuffer);
+
+            if(framebuffer != NULL)
+            {
+                for(int u = 0; u < p->use_count; u++)
+                {
+                    if(p->uses[u].access & GRAPH_ACCESS_WRITE_INTERNAL)
+                    {
+                        DgnRenderGraphTextureDesc desc = graph->resources[p->uses[u].resource].desc;
+                        dgnRendererSetViewport(0, 0, desc.width, desc.height);
+                        break;
+                    }
+                }
+            }
+        }
+
+        if(p->execute != NULL)
+        {
+            p->execute(graph, p->user_data);
+        }
+
+        dgnProfileEnd(scope);
+    }
+
+    if(graph->backend == DGN_RENDER_GRAPH_BACKEND_GL)
+    {
+        dgnFramebufferBind(NULL);
+    }
+}
+
+/** ---------------- Queries ---------------- **/
+
+DgnTexture *dgnRenderGraphGetTexture(DgnRenderGraph *graph, uint16_t resource)
+{
+    if(resource >= graph->resource_count) return NULL;
+
+    return graph->resources[resource].texture;
+}
+
+uint8_t dgnRenderGraphIsPassCulled(DgnRenderGraph *graph, uint16_t pass)
+{
+    if(pass >= graph->pass_count) return DGN_TRUE;
+
+    return !graph->passes[pass].needed;
+}
+
+uint16_t dgnRenderGraphGetExecutionOrder(DgnRenderGraph *graph, uint16_t *out_passes)
+{
+    if(out_passes != NULL)
+    {
+        memcpy(out_passes, graph->order, sizeof(*out_passes) * graph->order_count);
+    }
+
+    return graph->order_count;
+}
+
+uint16_t dgnRenderGraphGetPhysicalTextureCount(DgnRenderGraph *graph)
+{
+    return graph->physical_count;
+}
+
+size_t dgnRenderGraphGetTransientMemory(DgnRenderGraph *graph)
+{
+    size_t res = 0;
+
+    for(int i = 0; i < graph->physical_count; i++)
+    {
+        DgnRenderGraphTextureDesc desc = graph->physicals[i].desc;
+        res += (size_t)desc.width * desc.height * bytesPerPixelInternal(desc.internal_type);
+    }
+
+    return res;
+}
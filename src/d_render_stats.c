@@ -0,0 +1,98 @@
+#include "d_internal.h"
+#include "DGNEngine/DGNEngine.h"
+
+#include <pthread.h>
+#include <string.h>
+
+// frames the rolling averages cover
+#define RENDER_STATS_HISTORY 120
+
+static const char *s_stat_names[DGN_RENDER_STAT_COUNT] =
+{
+    "draw calls",
+    "triangles",
+    "program binds",
+    "vao binds",
+    "texture binds",
+    "framebuffer binds",
+    "uniform calls",
+    "upload bytes"
+};
+
+// only the thread the context is current on counts, so the live counters need no lock
+static uint64_t s_current[DGN_RENDER_STAT_COUNT];
+
+// finished frames are read from any thread
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t s_history[RENDER_STATS_HISTORY][DGN_RENDER_STAT_COUNT];
+static uint64_t s_sums[DGN_RENDER_STAT_COUNT];
+static uint32_t s_history_head;
+static uint32_t s_history_count;
+
+void renderStatAdd_internal(uint8_t stat, uint64_t amount)
+{
+    s_current[stat] += amount;
+}
+
+void renderStatsEndFrame_internal()
+{
+    pthread_mutex_lock(&s_mutex);
+
+    uint64_t *slot = s_history[s_history_head];
+
+    // the running sums drop the frame being overwritten
+    for(uint8_t i = 0; i < DGN_RENDER_STAT_COUNT; i++)
+    {
+        if(s_history_count == RENDER_STATS_HISTORY)
+        {
+            s_sums[i] -= slot[i];
+        }
+        s_sums[i] += s_current[i];
+        slot[i] = s_current[i];
+    }
+
+    s_history_head = (s_history_head + 1) % RENDER_STATS_HISTORY;
+    if(s_history_count < RENDER_STATS_HISTORY)
+    {
+        s_history_count++;
+    }
+
+    pthread_mutex_unlock(&s_mutex);
+
+    memset(s_current, 0, sizeof(s_current));
+}
+
+void dgnRendererGetStats(DgnRendererStats *out_stats)
+{
+    memset(out_stats, 0, sizeof(*out_stats));
+
+    pthread_mutex_lock(&s_mutex);
+
+    if(s_history_count > 0)
+    {
+        uint32_t last = (s_history_head + RENDER_STATS_HISTORY - 1) % RENDER_STATS_HISTORY;
+
+        for(uint8_t i = 0; i < DGN_RENDER_STAT_COUNT; i++)
+        {
+            out_stats->last_frame[i] = s_history[last][i];
+            out_stats->average[i] = (float)((double)s_sums[i] / s_history_count);
+        }
+    }
+    out_stats->average_frames = s_history_count;
+
+    pthread_mutex_unlock(&s_mutex);
+}
+
+const char *dgnRendererGetStatName(uint8_t stat)
+{
+    return stat < DGN_RENDER_STAT_COUNT ? s_stat_names[stat] : "";
+}
+
+void dgnRendererResetStats()
+{
+    pthread_mutex_lock(&s_mutex);
+    memset(s_sums, 0, sizeof(s_sums));
+    s_history_head = 0;
+    s_history_count = 0;
+    pthread_mutex_unlock(&s_mutex);
+}
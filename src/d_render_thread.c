@@ -0,0 +1,330 @@
+#include "d_internal.h"
+#include "DGNEngine/DGNEngine.h"
+
+#include <MemLeaker/malloc.h>
+
+#include <pthread.h>
+#include <string.h>
+
+// command data is kept at this alignment so any vector or matrix type can be copied in
+#define PACKET_ALIGN 16
+#define ALIGN_UP(x) (((x) + PACKET_ALIGN - 1) & ~(uint32_t)(PACKET_ALIGN - 1))
+
+#define PACKET_FREE 0
+#define PACKET_FILLING 1
+#define PACKET_QUEUED 2
+
+// each command is a header followed by its data, back to back in the packet's memory
+typedef struct
+{
+    DgnRenderFunc func;
+    void *user_data;
+    uint32_t size;
+}RenderCommand;
+
+struct DgnRenderPacket
+{
+    uint8_t *memory;
+    uint32_t capacity;
+    uint32_t used;
+    uint8_t state;
+};
+
+struct DgnRenderThread
+{
+    DgnWindow *window;
+    uint8_t threaded;
+    uint8_t quit;
+
+    DgnRenderPacket *packets;
+    uint8_t packet_count;
+    // written by the submitting thread, read by the render thread
+    uint8_t write_index;
+    uint8_t read_index;
+
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t queued_cond;
+    pthread_cond_t free_cond;
+
+    // render side timing for the window's frame stats
+    double present_time;
+
+    double submit_wait;
+    double render_wait;
+};
+
+static void runPacketInternal(DgnRenderThread *thread, DgnRenderPacket *packet)
+{
+    DGN_PROFILE_SCOPE("render packet");
+
+    double start = clockSeconds_internal();
+    uint32_t offset = 0;
+
+    while(offset < packet->used)
+    {
+        RenderCommand *command = (RenderCommand*)(packet->memory + offset);
+        uint8_t *data = (uint8_t*)command + ALIGN_UP(sizeof(RenderCommand));
+
+        command->func(data, command->user_data);
+        offset += ALIGN_UP(sizeof(RenderCommand)) + ALIGN_UP(command->size);
+    }
+
+    double swap_start = clockSeconds_internal();
+    uint32_t scope = dgnProfileBegin("present");
+    windowPresent_internal(thread->window);
+    dgnProfileEnd(scope);
+    double time = clockSeconds_internal();
+
+    // frame time is present to present, cpu time only counts running the packet
+    frameStatsPush_internal(thread->window, (float)(time - thread->present_time),
+                            (float)(swap_start - start), (float)(time - swap_start));
+    thread->present_time = time;
+}
+
+static void *renderMainInternal(void *arg)
+{
+    DgnRenderThread *thread = arg;
+
+    dgnProfileSetThreadName("render");
+    windowBindContext_internal(thread->window, DGN_TRUE);
+
+    pthread_mutex_lock(&thread->mutex);
+    while(1)
+    {
+        DgnRenderPacket *packet = &thread->packets[thread->read_index];
+        double wait_start = clockSeconds_internal();
+
+        // queued packets are still run after quitting, so nothing submitted is lost
+        while(packet->state != PACKET_QUEUED && !thread->quit)
+        {
+            pthread_cond_wait(&thread->queued_cond, &thread->mutex);
+        }
+
+        if(packet->state != PACKET_QUEUED) break;
+
+        thread->render_wait = clockSeconds_internal() - wait_start;
+        pthread_mutex_unlock(&thread->mutex);
+
+        runPacketInternal(thread, packet);
+        // the render thread's frames end at each present
+        dgnProfileFrameMark();
+
+        pthread_mutex_lock(&thread->mutex);
+        packet->state = PACKET_FREE;
+        thread->read_index = (thread->read_index + 1) % thread->packet_count;
+        pthread_cond_broadcast(&thread->free_cond);
+    }
+    pthread_mutex_unlock(&thread->mutex);
+
+    windowBindContext_internal(thread->window, DGN_FALSE);
+
+    return NULL;
+}
+
+DgnRenderThread *dgnRenderThreadCreate(DgnWindow *window, uint8_t packet_count, uint32_t packet_bytes)
+{
+    if(packet_count < 1 || packet_count > 3)
+    {
+        logError("RENDER THREAD", "Packet count must be 1, 2 or 3");
+        return NULL;
+    }
+
+    DgnRenderThread *res = calloc(1, sizeof(*res));
+
+    if(res == NULL)
+    {
+        return NULL;
+    }
+
+    res->window = window;
+    res->threaded = packet_count > 1;
+    res->packet_count = packet_count;
+    res->packets = calloc(packet_count, sizeof(*res->packets));
+    res->present_time = clockSeconds_internal();
+
+    uint8_t ok = res->packets != NULL;
+
+    for(uint8_t i = 0; ok && i < packet_count; i++)
+    {
+        res->packets[i].memory = malloc(packet_bytes);
+        res->packets[i].capacity = packet_bytes;
+        ok = res->packets[i].memory != NULL;
+    }
+
+    if(!ok)
+    {
+        for(uint8_t i = 0; res->packets && i < packet_count; i++)
+        {
+            free(res->packets[i].memory);
+        }
+        free(res->packets);
+        free(res);
+        return NULL;
+    }
+
+    if(!res->threaded)
+    {
+        return res;
+    }
+
+    pthread_mutex_init(&res->mutex, NULL);
+    pthread_cond_init(&res->queued_cond, NULL);
+    pthread_cond_init(&res->free_cond, NULL);
+
+    // a context can only be current on one thread at a time
+    windowBindContext_internal(window, DGN_FALSE);
+
+    if(pthread_create(&res->thread, NULL, renderMainInternal, res) != 0)
+    {
+        logError("RENDER THREAD", "Could not start the render thread, packets run on submit");
+        windowBindContext_internal(window, DGN_TRUE);
+        pthread_mutex_destroy(&res->mutex);
+        pthread_cond_destroy(&res->queued_cond);
+        pthread_cond_destroy(&res->free_cond);
+        res->threaded = DGN_FALSE;
+    }
+
+    return res;
+}
+
+void dgnRenderThreadDestroy(DgnRenderThread *thread)
+{
+    if(thread->threaded)
+    {
+        pthread_mutex_lock(&thread->mutex);
+        thread->quit = DGN_TRUE;
+        pthread_cond_signal(&thread->queued_cond);
+        pthread_mutex_unlock(&thread->mutex);
+
+        pthread_join(thread->thread, NULL);
+
+        pthread_mutex_destroy(&thread->mutex);
+        pthread_cond_destroy(&thread->queued_cond);
+        pthread_cond_destroy(&thread->free_cond);
+
+        windowBindContext_internal(thread->window, DGN_TRUE);
+    }
+
+    for(uint8_t i = 0; i < thread->packet_count; i++)
+    {
+        free(thread->packets[i].memory);
+    }
+
+    free(thread->packets);
+    free(thread);
+}
+
+/** ---- Packets ---- **/
+
+DgnRenderPacket *dgnRenderThreadBeginPacket(DgnRenderThread *thread)
+{
+    DgnRenderPacket *packet = &thread->packets[thread->write_index];
+
+    if(thread->threaded)
+    {
+        double wait_start = clockSeconds_internal();
+        uint32_t scope = dgnProfileBegin("wait for packet");
+
+        // a full ring holds the submitting thread to the render thread's pace
+        pthread_mutex_lock(&thread->mutex);
+        while(packet->state != PACKET_FREE)
+        {
+            pthread_cond_wait(&thread->free_cond, &thread->mutex);
+        }
+        thread->submit_wait = clockSeconds_internal() - wait_start;
+        packet->state = PACKET_FILLING;
+        pthread_mutex_unlock(&thread->mutex);
+
+        dgnProfileEnd(scope);
+    }
+
+    packet->used = 0;
+
+    return packet;
+}
+
+void *dgnRenderPacketPush(DgnRenderPacket *packet, DgnRenderFunc func, void *user_data, const void *data, uint32_t size)
+{
+    uint32_t header = ALIGN_UP(sizeof(RenderCommand));
+
+    if(packet->used + header + ALIGN_UP(size) > packet->capacity)
+    {
+        logError("RENDER THREAD", "Packet is full, command dropped");
+        return NULL;
+    }
+
+    RenderCommand *command = (RenderCommand*)(packet->memory + packet->used);
+    uint8_t *copy = (uint8_t*)command + header;
+
+    command->func = func;
+    command->user_data = user_data;
+    command->size = size;
+
+    if(data != NULL)
+    {
+        memcpy(copy, data, size);
+    }
+
+    packet->used += header + ALIGN_UP(size);
+
+    return copy;
+}
+
+void dgnRenderThreadSubmit(DgnRenderThread *thread, DgnRenderPacket *packet)
+{
+    DGN_PROFILE_SCOPE("submit");
+
+    if(thread->threaded)
+    {
+        pthread_mutex_lock(&thread->mutex);
+        packet->state = PACKET_QUEUED;
+        thread->write_index = (thread->write_index + 1) % thread->packet_count;
+        pthread_cond_signal(&thread->queued_cond);
+        pthread_mutex_unlock(&thread->mutex);
+    }
+    else
+    {
+        runPacketInternal(thread, packet);
+        packet->state = PACKET_FREE;
+    }
+
+    // the window's delta and frame count belong to the submitting thread
+    DgnWindow *window = thread->window;
+    double time = clockSeconds_internal();
+
+    window->frame_count++;
+    window->delta = time - window->time_1;
+    window->time_1 = time;
+}
+
+void dgnRenderThreadFlush(DgnRenderThread *thread)
+{
+    if(!thread->threaded) return;
+
+    pthread_mutex_lock(&thread->mutex);
+    for(uint8_t i = 0; i < thread->packet_count; i++)
+    {
+        while(thread->packets[i].state == PACKET_QUEUED)
+        {
+            pthread_cond_wait(&thread->free_cond, &thread->mutex);
+        }
+    }
+    pthread_mutex_unlock(&thread->mutex);
+}
+
+void dgnRenderThreadGetWaitTimes(DgnRenderThread *thread, double *out_submit_wait, double *out_render_wait)
+{
+    if(thread->threaded)
+    {
+        pthread_mutex_lock(&thread->mutex);
+    }
+
+    *out_submit_wait = thread->submit_wait;
+    *out_render_wait = thread->render_wait;
+
+    if(thread->threaded)
+    {
+        pthread_mutex_unlock(&thread->mutex);
+    }
+}
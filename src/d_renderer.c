@@ -8,6 +8,11 @@
 static unsigned int s_clear_flags;
 static uint8_t s_render_mode = DGN_DRAW_MODE_TRIANGLES;
 static uint32_t s_size_bound_mesh = 0;
+static uint64_t s_offset_bound_mesh = 0;
+
+static DgnShader *s_bound_shader = NULL;
+static Mat4x4 s_view;
+static Mat4x4 s_view_projection;
 
 static DgnMesh *s_skybox_mesh = 0;
 static DgnMesh *s_screen_mesh = 0;
@@ -23,7 +28,7 @@ uint8_t genLineMeshInternal();
 
 uint8_t dgnRendererInitialize()
 {
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    if (!gladLoadGLLoader((GLADloadproc)windowGetProcAddress_internal))
     {
         return DGN_FALSE;
     }
@@ -36,6 +41,11 @@ uint8_t dgnRendererInitialize()
 
     ASSERT_RETURN(dgnShaderInit_internal());
 
+#ifdef __DEBUG
+    // a glGetError on every call leaves debug builds too slow to profile
+    dgnRendererSetDebugMode(GLAD_GL_KHR_debug ? DGN_GL_DEBUG_CALLBACK_ASYNC : DGN_GL_DEBUG_SAMPLED, DGN_GL_DEBUG_SAMPLE_INTERVAL);
+#endif // __DEBUG
+
     return DGN_TRUE;
 }
 
@@ -55,27 +65,76 @@ void dgnRendererBindMesh(DgnMesh* mesh)
 {
     if(mesh == NULL)
     {
-        glCall(glBindVertexArray(0));
+        glStatCall(DGN_RENDER_STAT_VAO_BINDS, 1, glBindVertexArray(0));
         glCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
         s_size_bound_mesh = 0;
+        s_offset_bound_mesh = 0;
     }
     else
     {
-        glCall(glBindVertexArray(mesh->VAO));
+        glStatCall(DGN_RENDER_STAT_VAO_BINDS, 1, glBindVertexArray(mesh->VAO));
         glCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->IBO));
-        s_size_bound_mesh = mesh->length;
+        s_size_bound_mesh = mesh->lod_lengths[mesh->current_lod];
+        s_offset_bound_mesh = mesh->lod_offsets[mesh->current_lod] * sizeof(uint32_t);
     }
 }
 
 void dgnRendererBindShader(DgnShader* shader)
 {
+    s_bound_shader = shader;
+
     if(shader == NULL)
     {
-        glCall(glUseProgram(0));
+        glStatCall(DGN_RENDER_STAT_PROGRAM_BINDS, 1, glUseProgram(0));
     }
     else
     {
-        glCall(glUseProgram(shader->program));
+        glStatCall(DGN_RENDER_STAT_PROGRAM_BINDS, 1, glUseProgram(shader->program));
+    }
+}
+
+void dgnRendererSetCamera(DgnCamera *cam)
+{
+    s_view = *dgnCameraGetView(cam);
+    s_view_projection = *dgnCameraGetViewProjection(cam);
+}
+
+void dgnRendererSetViewProjection(Mat4x4 view, Mat4x4 projection)
+{
+    s_view = view;
+    dgnMathMulMat4x4N(&projection, &view, &s_view_projection, 1);
+}
+
+void dgnRendererSetModel(Mat4x4 model)
+{
+    DgnShader *shader = s_bound_shader;
+
+    if(shader == NULL) return;
+
+    if(shader->u_model != -1)
+    {
+        dgnShaderUniformM4x4(shader->u_model, model);
+    }
+
+    if(shader->u_mvp != -1)
+    {
+        Mat4x4 mvp;
+        dgnMathMulMat4x4N(&s_view_projection, &model, &mvp, 1);
+        dgnShaderUniformM4x4(shader->u_mvp, mvp);
+    }
+
+    if(shader->u_model_view != -1)
+    {
+        Mat4x4 model_view;
+        dgnMathMulMat4x4N(&s_view, &model, &model_view, 1);
+        dgnShaderUniformM4x4(shader->u_model_view, model_view);
+    }
+
+    if(shader->u_normal_mat != -1)
+    {
+        Mat3x3 normal_mat;
+        dgnMathNormalMatrixN(&model, &normal_mat, 1);
+        dgnShaderUniformM3x3(shader->u_normal_mat, normal_mat);
     }
 }
 
@@ -85,11 +144,11 @@ void bindTextureInternal(GLenum type, DgnTexture *texture, uint8_t slot)
 
     if(texture == NULL)
     {
-        glCall(glBindTexture(type, 0));
+        glStatCall(DGN_RENDER_STAT_TEXTURE_BINDS, 1, glBindTexture(type, 0));
     }
     else
     {
-        glCall(glBindTexture(type, texture->texture));
+        glStatCall(DGN_RENDER_STAT_TEXTURE_BINDS, 1, glBindTexture(type, texture->texture));
     }
 }
 
@@ -103,6 +162,20 @@ void dgnRendererBindCubemap(DgnTexture *texture, uint8_t slot)
     bindTextureInternal(GL_TEXTURE_CUBE_MAP, texture, slot);
 }
 
+static uint32_t trianglesInternal(uint8_t mode, uint32_t count)
+{
+    switch(mode)
+    {
+    case DGN_DRAW_MODE_TRIANGLES:
+        return count / 3;
+    case DGN_DRAW_MODE_TRIANGLE_STRIP:
+    case DGN_DRAW_MODE_TRIANGLE_FAN:
+        return count > 2 ? count - 2 : 0;
+    default:
+        return 0;
+    }
+}
+
 void dgnRendererBindWireCube()
 {
     dgnRendererBindMesh(s_wire_cube_mesh);
@@ -130,7 +203,8 @@ void dgnRendererBindScreenTexture()
 
 void dgnRendererDrawMesh()
 {
-    glCall(glDrawElements(s_render_mode, s_size_bound_mesh, GL_UNSIGNED_INT, NULL));
+    renderStatAdd_internal(DGN_RENDER_STAT_TRIANGLES, trianglesInternal(s_render_mode, s_size_bound_mesh));
+    glStatCall(DGN_RENDER_STAT_DRAW_CALLS, 1, glDrawElements(s_render_mode, s_size_bound_mesh, GL_UNSIGNED_INT, (void*)s_offset_bound_mesh));
 }
 
 void dgnRendererSetDepthTest(uint16_t func)
@@ -138,6 +212,24 @@ void dgnRendererSetDepthTest(uint16_t func)
     glDepthFunc(func);
 }
 
+uint8_t dgnRendererSetReversedZ(uint8_t enabled)
+{
+    if(!GLAD_GL_ARB_clip_control)
+    {
+        if(enabled)
+        {
+            logError("RENDERER", "Reversed depth needs GL_ARB_clip_control");
+        }
+        return DGN_FALSE;
+    }
+
+    // zero to one clip depth keeps the float depth buffer's precision near 0, where the far values land
+    glCall(glClipControl(GL_LOWER_LEFT, enabled ? GL_ZERO_TO_ONE : GL_NEGATIVE_ONE_TO_ONE));
+    glCall(glClearDepth(enabled ? 0.0 : 1.0));
+
+    return DGN_TRUE;
+}
+
 void dgnRendererSetClearColor(float red, float green, float blue)
 {
     glCall(glClearColor(red, green, blue, 1.0f));
@@ -201,8 +293,22 @@ void dgnRendererDisableFlag(uint16_t value)
 void dgnRendererSetupShadow(DgnShadowMap shadow, DgnShader *shader, int32_t uniform_loc, Mat4x4 light_view_mat)
 {
     dgnFramebufferBind(shadow.framebuffer);
-    dgnRendererClear();
-    dgnRendererSetViewport(0, 0, shadow.texture->width[0], shadow.texture->height[0]);
+
+    if(shadow.width == 0)
+    {
+        dgnRendererSetViewport(0, 0, shadow.texture->width[0], shadow.texture->height[0]);
+        dgnRendererClear();
+    }
+    else
+    {
+        // only clear this map's area, the rest of the atlas may still be in use
+        dgnRendererSetViewport(shadow.x, shadow.y, shadow.width, shadow.height);
+        glCall(glScissor(shadow.x, shadow.y, shadow.width, shadow.height));
+        glCall(glEnable(GL_SCISSOR_TEST));
+        dgnRendererClear();
+        glCall(glDisable(GL_SCISSOR_TEST));
+    }
+
     dgnRendererSetCullFace(DGN_FACE_FRONT);
     dgnRendererSetDepthTest(DGN_DEPTH_PASS_LESS);
 
@@ -0,0 +1,187 @@
+#include "d_internal.h"
+#include "DgnEngine/DgnEngine.h"
+
+#include <MemLeaker/malloc.h>
+
+#include <math.h>
+
+// weight of the newest sample in the smoothed frame time
+#define FRAME_TIME_SMOOTHING 0.1
+// frames to wait after a change before judging the new scale
+#define SETTLE_FRAMES 8
+// over budget by this much and the scale drops without waiting to settle
+#define PANIC_RATIO 1.5
+// scales are snapped to this step so small noise does not cause constant resizes
+#define SCALE_STEP 0.025f
+// largest single move, dropping is allowed to be quicker than recovering
+#define MAX_SCALE_DOWN 0.15f
+#define MAX_SCALE_UP 0.05f
+
+DgnDynamicResolution *dgnDynamicResolutionCreate(uint16_t width, uint16_t height, double target_frame_time, float min_scale, float max_scale)
+{
+    DgnDynamicResolution *res = malloc(sizeof(*res));
+
+    if(res == NULL)
+    {
+        return NULL;
+    }
+
+    res->width = width;
+    res->height = height;
+    res->min_scale = min_scale;
+    res->max_scale = max_scale;
+    res->scale = max_scale;
+    res->target_frame_time = target_frame_time;
+    res->smoothed_frame_time = 0.0;
+    res->frames_since_change = 0;
+    res->query_index = 0;
+    res->query_active = DGN_FALSE;
+
+    glCall(glGenQueries(DYN_RES_QUERY_COUNT_INTERNAL, res->queries));
+
+    for(int i = 0; i < DYN_RES_QUERY_COUNT_INTERNAL; i++)
+    {
+        res->query_pending[i] = DGN_FALSE;
+    }
+
+    return res;
+}
+
+void dgnDynamicResolutionDestroy(DgnDynamicResolution *dyn_res)
+{
+    glCall(glDeleteQueries(DYN_RES_QUERY_COUNT_INTERNAL, dyn_res->queries));
+
+    free(dyn_res);
+}
+
+static void updateScaleInternal(DgnDynamicResolution *dyn_res, double frame_time)
+{
+    if(dyn_res->smoothed_frame_time <= 0.0)
+    {
+        dyn_res->smoothed_frame_time = frame_time;
+    }
+    else
+    {
+        dyn_res->smoothed_frame_time += (frame_time - dyn_res->smoothed_frame_time) * FRAME_TIME_SMOOTHING;
+    }
+
+    dyn_res->frames_since_change++;
+
+    double ratio = dyn_res->target_frame_time / dyn_res->smoothed_frame_time;
+    uint8_t panic = frame_time > dyn_res->target_frame_time * PANIC_RATIO;
+
+    if(dyn_res->frames_since_change < SETTLE_FRAMES && !panic)
+    {
+        return;
+    }
+
+    // stay put inside the dead band around the target
+    if(ratio > 0.95 && ratio < 1.1 && !panic)
+    {
+        return;
+    }
+
+    if(panic)
+    {
+        ratio = dyn_res->target_frame_time / frame_time;
+    }
+
+    // cost scales with pixel count, which is the square of the axis scale
+    float wanted = dyn_res->scale * sqrtf((float)ratio);
+    wanted = fmaxf(wanted, dyn_res->scale - MAX_SCALE_DOWN);
+    wanted = fminf(wanted, dyn_res->scale + MAX_SCALE_UP);
+    wanted = roundf(wanted / SCALE_STEP) * SCALE_STEP;
+    wanted = fmaxf(dyn_res->min_scale, fminf(wanted, dyn_res->max_scale));
+
+    if(wanted != dyn_res->scale)
+    {
+        dyn_res->scale = wanted;
+        dyn_res->frames_since_change = 0;
+        // the old samples describe a different resolution
+        dyn_res->smoothed_frame_time = 0.0;
+    }
+}
+
+void dgnDynamicResolutionBeginFrame(DgnDynamicResolution *dyn_res)
+{
+    uint8_t i = dyn_res->query_index;
+
+    // the gpu is more than a ring behind, skip timing this frame rather than stall
+    if(dyn_res->query_pending[i])
+    {
+        return;
+    }
+
+    glCall(glBeginQuery(GL_TIME_ELAPSED, dyn_res->queries[i]));
+    dyn_res->query_pending[i] = DGN_TRUE;
+    dyn_res->query_active = DGN_TRUE;
+}
+
+void dgnDynamicResolutionEndFrame(DgnDynamicResolution *dyn_res)
+{
+    if(dyn_res->query_active)
+    {
+        glCall(glEndQuery(GL_TIME_ELAPSED));
+        dyn_res->query_active = DGN_FALSE;
+        dyn_res->query_index = (dyn_res->query_index + 1) % DYN_RES_QUERY_COUNT_INTERNAL;
+    }
+
+    // collect every finished query, oldest first
+    for(int k = 0; k < DYN_RES_QUERY_COUNT_INTERNAL; k++)
+    {
+        uint8_t i = (dyn_res->query_index + k) % DYN_RES_QUERY_COUNT_INTERNAL;
+
+        if(!dyn_res->query_pending[i]) continue;
+
+        GLint available = 0;
+        glCall(glGetQueryObjectiv(dyn_res->queries[i], GL_QUERY_RESULT_AVAILABLE, &available));
+
+        if(!available) continue;
+
+        GLuint64 elapsed = 0;
+        glCall(glGetQueryObjectui64v(dyn_res->queries[i], GL_QUERY_RESULT, &elapsed));
+        dyn_res->query_pending[i] = DGN_FALSE;
+
+        updateScaleInternal(dyn_res, elapsed / 1.0e9);
+    }
+}
+
+void dgnDynamicResolutionSetTarget(DgnDynamicResolution *dyn_res, double target_frame_time)
+{
+    dyn_res->target_frame_time = target_frame_time;
+}
+
+void dgnDynamicResolutionSetScale(DgnDynamicResolution *dyn_res, float scale)
+{
+    dyn_res->scale = fmaxf(dyn_res->min_scale, fminf(scale, dyn_res->max_scale));
+    dyn_res->frames_since_change = 0;
+    dyn_res->smoothed_frame_time = 0.0;
+}
+
+float dgnDynamicResolutionGetScale(DgnDynamicResolution *dyn_res)
+{
+    return dyn_res->scale;
+}
+
+double dgnDynamicResolutionGetFrameTime(DgnDynamicResolution *dyn_res)
+{
+    return dyn_res->smoothed_frame_time;
+}
+
+uint16_t dgnDynamicResolutionGetWidth(DgnDynamicResolution *dyn_res)
+{
+    uint16_t w = (uint16_t)(dyn_res->width * dyn_res->scale + 0.5f);
+    return w > 0 ? w : 1;
+}
+
+uint16_t dgnDynamicResolutionGetHeight(DgnDynamicResolution *dyn_res)
+{
+    uint16_t h = (uint16_t)(dyn_res->height * dyn_res->scale + 0.5f);
+    return h > 0 ? h : 1;
+}
+
+Vec2 dgnDynamicResolutionGetUVScale(DgnDynamicResolution *dyn_res)
+{
+    return (Vec2){(float)dgnDynamicResolutionGetWidth(dyn_res) / dyn_res->width,
+                  (float)dgnDynamicResolutionGetHeight(dyn_res) / dyn_res->height};
+}
@@ -2,6 +2,7 @@
 #include "DgnEngine/DgnEngine.h"
 
 #include <MemLeaker/malloc.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -53,6 +54,8 @@ static uint32_t genShaderInternal(char *data, uint16_t shader_type)
 
 DgnShader *dgnShaderCreate(char *vertex_code, char *geometry_code, char *fragment_code)
 {
+    DGN_PROFILE_SCOPE("shader compile");
+
     DgnShader *res = malloc(sizeof(*res));
 
     if(res == NULL)
@@ -99,6 +102,13 @@ DgnShader *dgnShaderCreate(char *vertex_code, char *geometry_code, char *fragmen
     glCall(glDeleteShader(fragment));
 
     res->program = program;
+    glLabel(GL_PROGRAM, program, "shader");
+
+    // looked up once, most shaders only use some of them so missing ones are not errors
+    glCall(res->u_model = glGetUniformLocation(program, "uModel"));
+    glCall(res->u_model_view = glGetUniformLocation(program, "uModelView"));
+    glCall(res->u_mvp = glGetUniformLocation(program, "uMVP"));
+    glCall(res->u_normal_mat = glGetUniformLocation(program, "uNormalMat"));
 
     return res;
 }
@@ -110,6 +120,9 @@ uint32_t fileToString(char **out_str, const char *filepath)
 {
     if(filepath == NULL) return FILE_LOAD_NULL;
 
+    // includes load through here too, so they nest under the file including them
+    DGN_PROFILE_SCOPE("shader preprocess");
+
     FILE *file = fopen(filepath, "r");
 
     if(file == NULL)
@@ -250,26 +263,42 @@ uint32_t fileToString(char **out_str, const char *filepath)
 
 DgnShader *dgnShaderLoad(const char* vertex_path, const char* geometry_path, const char* fragment_path)
 {
+    DGN_PROFILE_SCOPE("dgnShaderLoad");
+
     // -------- Load the files
 
     char *v_code = NULL;
     char *g_code = NULL;
     char *f_code = NULL;
 
-    if(fileToString(&v_code, vertex_path) == FILE_LOAD_ERROR)
-    {
-        return NULL;
-    }
-    if(fileToString(&g_code, geometry_path) == FILE_LOAD_ERROR)
-    {
-        return NULL;
-    }
-    if(fileToString(&f_code, fragment_path) == FILE_LOAD_ERROR)
+    // programs share stage files, so the timeline names them after all of theirs
+    char asset[256];
+    snprintf(asset, sizeof(asset), "%s%s%s%s%s", vertex_path,
+             geometry_path ? " " : "", geometry_path ? geometry_path : "",
+             fragment_path ? " " : "", fragment_path ? fragment_path : "");
+
+    uint32_t stage = loadStageBegin_internal(asset, DGN_LOAD_STAGE_READ);
+    uint8_t read = fileToString(&v_code, vertex_path) != FILE_LOAD_ERROR &&
+                   fileToString(&g_code, geometry_path) != FILE_LOAD_ERROR &&
+                   fileToString(&f_code, fragment_path) != FILE_LOAD_ERROR;
+    loadStageEnd_internal(stage);
+
+    if(!read)
     {
+        free(v_code);
+        free(g_code);
+        free(f_code);
         return NULL;
     }
 
+    stage = loadStageBegin_internal(asset, DGN_LOAD_STAGE_COMPILE);
     DgnShader* res = dgnShaderCreate(v_code, g_code, f_code);
+    loadStageEnd_internal(stage);
+
+    if(res != NULL)
+    {
+        glLabel(GL_PROGRAM, res->program, fragment_path ? fragment_path : vertex_path);
+    }
 
     free(v_code);
     free(g_code);
@@ -303,37 +332,42 @@ int32_t dgnShaderGetUniformLoc(DgnShader *shader, const char *name)
 
 void dgnShaderUniformF(int32_t loc, float value)
 {
-    glUniform1f(loc, value);
+    glStatCall(DGN_RENDER_STAT_UNIFORM_CALLS, 1, glUniform1f(loc, value));
 }
 
 void dgnShaderUniformI(int32_t loc, int value)
 {
-    glUniform1i(loc, value);
+    glStatCall(DGN_RENDER_STAT_UNIFORM_CALLS, 1, glUniform1i(loc, value));
 }
 
 void dgnShaderUniformB(int32_t loc, uint8_t value)
 {
-    glUniform1i(loc, value);
+    glStatCall(DGN_RENDER_STAT_UNIFORM_CALLS, 1, glUniform1i(loc, value));
 }
 
 void dgnShaderUniformV2(int32_t loc, Vec2 value)
 {
-    glUniform2f(loc, value.x, value.y);
+    glStatCall(DGN_RENDER_STAT_UNIFORM_CALLS, 1, glUniform2f(loc, value.x, value.y));
 }
 
 void dgnShaderUniformV3(int32_t loc, Vec3 value)
 {
-    glUniform3f(loc, value.x, value.y, value.z);
+    glStatCall(DGN_RENDER_STAT_UNIFORM_CALLS, 1, glUniform3f(loc, value.x, value.y, value.z));
+}
+
+void dgnShaderUniformV4(int32_t loc, Vec4 value)
+{
+    glStatCall(DGN_RENDER_STAT_UNIFORM_CALLS, 1, glUniform4f(loc, value.x, value.y, value.z, value.w));
 }
 
 void dgnShaderUniformM3x3(int32_t loc, Mat3x3 value)
 {
-    glUniformMatrix3fv(loc, 1, GL_TRUE, value.m[0]);
+    glStatCall(DGN_RENDER_STAT_UNIFORM_CALLS, 1, glUniformMatrix3fv(loc, 1, GL_TRUE, value.m[0]));
 }
 
 void dgnShaderUniformM4x4(int32_t loc, Mat4x4 value)
 {
-    glUniformMatrix4fv(loc, 1, GL_TRUE, value.m[0]);
+    glStatCall(DGN_RENDER_STAT_UNIFORM_CALLS, 1, glUniformMatrix4fv(loc, 1, GL_TRUE, value.m[0]));
 }
 
 void dgnShaderSetEconstI(const char *name, int value)
@@ -0,0 +1,262 @@
+#include "d_internal.h"
+#include "DgnEngine/DgnEngine.h"
+
+#include <MemLeaker/malloc.h>
+
+#include <stdlib.h>
+
+// quadtree node states, a split node has its four children one level down
+#define NODE_FREE 0
+#define NODE_SPLIT 1
+#define NODE_USED 2
+
+struct DgnShadowAtlas
+{
+    DgnTexture *texture;
+    DgnFramebuffer *framebuffer;
+    uint16_t size;
+    uint16_t min_tile;
+
+    uint8_t levels;
+    uint8_t *nodes;
+    uint32_t node_count;
+
+    uint16_t request_count;
+    uint16_t request_sizes[MAX_SHADOW_ATLAS_REQUESTS_INTERNAL];
+    float request_importance[MAX_SHADOW_ATLAS_REQUESTS_INTERNAL];
+
+    // results of the last pack, a size of 0 did not fit
+    uint16_t tile_x[MAX_SHADOW_ATLAS_REQUESTS_INTERNAL];
+    uint16_t tile_y[MAX_SHADOW_ATLAS_REQUESTS_INTERNAL];
+    uint16_t tile_size[MAX_SHADOW_ATLAS_REQUESTS_INTERNAL];
+    uint32_t used_texels;
+};
+
+static uint8_t isPowerOfTwoInternal(uint16_t v)
+{
+    return v != 0 && (v & (v - 1)) == 0;
+}
+
+static uint16_t roundDownPowerOfTwoInternal(uint16_t v)
+{
+    uint16_t res = 1;
+    while((uint32_t)res * 2 <= v) res *= 2;
+    return res;
+}
+
+DgnShadowAtlas *dgnShadowAtlasCreate(uint16_t size, uint16_t min_tile)
+{
+    if(!isPowerOfTwoInternal(size) || !isPowerOfTwoInternal(min_tile) || min_tile > size)
+    {
+        logError("SHADOW ATLAS", "Atlas and tile sizes must be powers of two");
+        return NULL;
+    }
+
+    DgnShadowAtlas *res = malloc(sizeof(*res));
+
+    if(res == NULL)
+    {
+        return NULL;
+    }
+
+    res->size = size;
+    res->min_tile = min_tile;
+    res->levels = 1;
+    res->node_count = 1;
+    res->request_count = 0;
+    res->used_texels = 0;
+
+    uint32_t level_nodes = 1;
+    for(uint16_t s = size; s > min_tile; s /= 2)
+    {
+        level_nodes *= 4;
+        res->node_count += level_nodes;
+        res->levels++;
+    }
+
+    res->nodes = calloc(res->node_count, 1);
+
+    // no colour attachment and no separate depth buffer, the texture is the depth attachment
+    uint8_t att = DGN_FRAMEBUFFER_DEPTH;
+    res->texture = dgnLightingCreateShadowMap(size, size, DGN_LIGHT_TYPE_DIR);
+    res->framebuffer = res->texture ? dgnFramebufferCreate(&res->texture, &att, 1, 0) : NULL;
+
+    if(res->nodes == NULL || res->framebuffer == NULL)
+    {
+        logError("SHADOW ATLAS", "Could not create atlas storage");
+        dgnShadowAtlasDestroy(res);
+        return NULL;
+    }
+
+    return res;
+}
+
+void dgnShadowAtlasDestroy(DgnShadowAtlas *atlas)
+{
+    if(atlas->framebuffer) dgnFramebufferDestroy(atlas->framebuffer);
+    if(atlas->texture) dgnTextureDestroy(atlas->texture);
+
+    free(atlas->nodes);
+    free(atlas);
+}
+
+void dgnShadowAtlasBeginFrame(DgnShadowAtlas *atlas)
+{
+    atlas->request_count = 0;
+}
+
+uint16_t dgnShadowAtlasRequest(DgnShadowAtlas *atlas, uint16_t size, float importance)
+{
+    if(atlas->request_count >= MAX_SHADOW_ATLAS_REQUESTS_INTERNAL)
+    {
+        logError("SHADOW ATLAS", "Too many shadow map requests this frame");
+        return DGN_SHADOW_ATLAS_NONE;
+    }
+
+    size = roundDownPowerOfTwoInternal(size);
+    if(size > atlas->size) size = atlas->size;
+    if(size < atlas->min_tile) size = atlas->min_tile;
+
+    uint16_t handle = atlas->request_count++;
+    atlas->request_sizes[handle] = size;
+    atlas->request_importance[handle] = importance;
+
+    return handle;
+}
+
+uint16_t dgnShadowAtlasSizeForScreen(DgnShadowAtlas *atlas, float screen_fraction)
+{
+    // a map covering the whole screen gets half the atlas, one quarter of the memory
+    float wanted = screen_fraction * atlas->size * 0.5f;
+    uint16_t size = atlas->min_tile;
+
+    while(size < atlas->size / 2 && size * 2 <= wanted) size *= 2;
+
+    return size;
+}
+
+/** ---- Packing ---- **/
+
+// first free node of the wanted size under this one, splitting on the way down
+static uint8_t allocInternal(DgnShadowAtlas *atlas, uint32_t level_start, uint32_t index,
+                             uint16_t node_size, uint16_t x, uint16_t y, uint16_t want, uint16_t *out_x, uint16_t *out_y)
+{
+    uint8_t *state = &atlas->nodes[level_start + index];
+
+    if(node_size == want)
+    {
+        if(*state != NODE_FREE) return DGN_FALSE;
+
+        *state = NODE_USED;
+        *out_x = x;
+        *out_y = y;
+        return DGN_TRUE;
+    }
+
+    if(*state == NODE_USED) return DGN_FALSE;
+
+    uint8_t was_free = *state == NODE_FREE;
+    *state = NODE_SPLIT;
+
+    // levels are stored one after another, so the next level starts at 4 * start + 1
+    uint32_t child_start = level_start * 4 + 1;
+    uint16_t half = node_size / 2;
+
+    for(uint32_t c = 0; c < 4; c++)
+    {
+        if(allocInternal(atlas, child_start, index * 4 + c, half,
+                         x + (c & 1) * half, y + (c >> 1) * half, want, out_x, out_y))
+        {
+            return DGN_TRUE;
+        }
+    }
+
+    // nothing fit, undo the split so the node stays usable as a whole
+    if(was_free)
+    {
+        *state = NODE_FREE;
+    }
+
+    return DGN_FALSE;
+}
+
+static DgnShadowAtlas *s_sort_atlas;
+
+static int compareRequestsInternal(const void *a, const void *b)
+{
+    uint16_t ia = *(const uint16_t*)a;
+    uint16_t ib = *(const uint16_t*)b;
+    float d = s_sort_atlas->request_importance[ib] - s_sort_atlas->request_importance[ia];
+
+    if(d != 0.0f) return d > 0.0f ? 1 : -1;
+
+    // keep the order stable so rectangles do not move between identical frames
+    return (int)ia - (int)ib;
+}
+
+uint16_t dgnShadowAtlasPack(DgnShadowAtlas *atlas)
+{
+    uint16_t order[MAX_SHADOW_ATLAS_REQUESTS_INTERNAL];
+    uint16_t placed = 0;
+
+    for(uint16_t i = 0; i < atlas->request_count; i++)
+    {
+        order[i] = i;
+        atlas->tile_size[i] = 0;
+    }
+
+    s_sort_atlas = atlas;
+    qsort(order, atlas->request_count, sizeof(uint16_t), compareRequestsInternal);
+
+    for(uint32_t i = 0; i < atlas->node_count; i++)
+    {
+        atlas->nodes[i] = NODE_FREE;
+    }
+    atlas->used_texels = 0;
+
+    // the most important maps are placed first, anything that does not fit is halved until it does
+    for(uint16_t i = 0; i < atlas->request_count; i++)
+    {
+        uint16_t r = order[i];
+
+        for(uint16_t size = atlas->request_sizes[r]; size >= atlas->min_tile; size /= 2)
+        {
+            if(allocInternal(atlas, 0, 0, atlas->size, 0, 0, size, &atlas->tile_x[r], &atlas->tile_y[r]))
+            {
+                atlas->tile_size[r] = size;
+                atlas->used_texels += (uint32_t)size * size;
+                placed++;
+                break;
+            }
+        }
+    }
+
+    return placed;
+}
+
+uint8_t dgnShadowAtlasGetMap(DgnShadowAtlas *atlas, uint16_t handle, DgnShadowMap *map)
+{
+    if(handle >= atlas->request_count || atlas->tile_size[handle] == 0)
+    {
+        return DGN_FALSE;
+    }
+
+    map->texture = atlas->texture;
+    map->framebuffer = atlas->framebuffer;
+    map->x = atlas->tile_x[handle];
+    map->y = atlas->tile_y[handle];
+    map->width = atlas->tile_size[handle];
+    map->height = atlas->tile_size[handle];
+
+    return DGN_TRUE;
+}
+
+DgnTexture *dgnShadowAtlasGetTexture(DgnShadowAtlas *atlas)
+{
+    return atlas->texture;
+}
+
+float dgnShadowAtlasGetUsage(DgnShadowAtlas *atlas)
+{
+    return (float)atlas->used_texels / ((float)atlas->size * atlas->size);
+}
@@ -0,0 +1,151 @@
+#include "d_internal.h"
+#include "DgnEngine/DgnEngine.h"
+
+#include <MemLeaker/malloc.h>
+
+#include <float.h>
+#include <math.h>
+
+// matrices closer than this are treated as the same snapped projection
+#define MATRIX_TOLERANCE 1.0e-4f
+
+DgnShadowCache *dgnShadowCacheCreate(uint8_t cascade_count)
+{
+    DgnShadowCache *res = malloc(sizeof(*res));
+
+    if(res == NULL)
+    {
+        return NULL;
+    }
+
+    res->cascade_count = cascade_count;
+    res->frame = 0;
+    res->matrices = malloc(sizeof(Mat4x4) * cascade_count);
+    res->valid = malloc(cascade_count);
+    res->dirty = malloc(cascade_count);
+    res->intervals = malloc(cascade_count);
+
+    if(!res->matrices || !res->valid || !res->dirty || !res->intervals)
+    {
+        logError("SHADOW CACHE", "Could not allocate cascade state");
+        dgnShadowCacheDestroy(res);
+        return NULL;
+    }
+
+    for(uint8_t i = 0; i < cascade_count; i++)
+    {
+        res->matrices[i] = m3dMat4x4InitIdentity();
+        res->valid[i] = DGN_FALSE;
+        res->dirty[i] = DGN_FALSE;
+        res->intervals[i] = 1;
+    }
+
+    return res;
+}
+
+void dgnShadowCacheDestroy(DgnShadowCache *cache)
+{
+    free(cache->matrices);
+    free(cache->valid);
+    free(cache->dirty);
+    free(cache->intervals);
+
+    free(cache);
+}
+
+void dgnShadowCacheBeginFrame(DgnShadowCache *cache)
+{
+    cache->frame++;
+}
+
+void dgnShadowCacheSetInterval(DgnShadowCache *cache, uint8_t cascade, uint8_t interval)
+{
+    cache->intervals[cascade] = interval > 0 ? interval : 1;
+}
+
+static uint8_t matricesMatchInternal(Mat4x4 a, Mat4x4 b)
+{
+    for(int r = 0; r < 4; r++)
+    {
+        for(int c = 0; c < 4; c++)
+        {
+            if(fabsf(a.m[r][c] - b.m[r][c]) > MATRIX_TOLERANCE * (1.0f + fabsf(a.m[r][c])))
+            {
+                return DGN_FALSE;
+            }
+        }
+    }
+
+    return DGN_TRUE;
+}
+
+uint8_t dgnShadowCacheNeedsUpdate(DgnShadowCache *cache, uint8_t cascade, Mat4x4 light_space_mat)
+{
+    if(!cache->valid[cascade])
+    {
+        return DGN_TRUE;
+    }
+
+    if(!cache->dirty[cascade] && matricesMatchInternal(cache->matrices[cascade], light_space_mat))
+    {
+        return DGN_FALSE;
+    }
+
+    // staggered cascades keep using the old map, offset so they do not all land on one frame
+    return (cache->frame + cascade) % cache->intervals[cascade] == 0;
+}
+
+void dgnShadowCacheMarkRendered(DgnShadowCache *cache, uint8_t cascade, Mat4x4 light_space_mat)
+{
+    cache->matrices[cascade] = light_space_mat;
+    cache->valid[cascade] = DGN_TRUE;
+    cache->dirty[cascade] = DGN_FALSE;
+}
+
+void dgnShadowCacheMarkDirty(DgnShadowCache *cache, DgnBoundingBox box)
+{
+    for(uint8_t i = 0; i < cache->cascade_count; i++)
+    {
+        if(!cache->valid[i] || cache->dirty[i]) continue;
+
+        // the light projection is orthographic, so the corners land in clip space with w of 1
+        Vec3 lo = {FLT_MAX, FLT_MAX, FLT_MAX};
+        Vec3 hi = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+
+        for(int c = 0; c < 8; c++)
+        {
+            Vec4 corner = {c & 1 ? box.max.x : box.min.x,
+                           c & 2 ? box.max.y : box.min.y,
+                           c & 4 ? box.max.z : box.min.z, 1.0f};
+
+            Vec4 p = m3dMat4x4MulVec4(cache->matrices[i], corner);
+
+            lo.x = fminf(lo.x, p.x); hi.x = fmaxf(hi.x, p.x);
+            lo.y = fminf(lo.y, p.y); hi.y = fmaxf(hi.y, p.y);
+            lo.z = fminf(lo.z, p.z); hi.z = fmaxf(hi.z, p.z);
+        }
+
+        if(hi.x >= -1.0f && lo.x <= 1.0f && hi.y >= -1.0f && lo.y <= 1.0f && hi.z >= -1.0f && lo.z <= 1.0f)
+        {
+            cache->dirty[i] = DGN_TRUE;
+        }
+    }
+}
+
+void dgnShadowCacheInvalidate(DgnShadowCache *cache)
+{
+    for(uint8_t i = 0; i < cache->cascade_count; i++)
+    {
+        cache->valid[i] = DGN_FALSE;
+    }
+}
+
+void dgnShadowCacheInvalidateCascade(DgnShadowCache *cache, uint8_t cascade)
+{
+    cache->valid[cascade] = DGN_FALSE;
+}
+
+Mat4x4 dgnShadowCacheGetLightSpaceMat(DgnShadowCache *cache, uint8_t cascade)
+{
+    return cache->matrices[cascade];
+}
@@ -0,0 +1,385 @@
+#include "d_internal.h"
+#include "DgnEngine/DgnEngine.h"
+
+#include <MemLeaker/malloc.h>
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+// Quadric error metric edge collapse, see Garland & Heckbert 1997.
+// Vertices are only ever collapsed onto one of their neighbours, so the
+// simplified index buffer still points into the original vertex buffer
+// and no new vertex data has to be uploaded per level of detail.
+
+typedef struct
+{
+    // symmetric 4x4 matrix, xx xy xz xw yy yz yw zz zw ww
+    double a[10];
+    double weight;
+}Quadric;
+
+typedef struct
+{
+    uint32_t from;
+    uint32_t to;
+    float cost;
+}Collapse;
+
+static void quadricFromPlane(Quadric *q, double nx, double ny, double nz, double d, double weight)
+{
+    q->a[0] = nx * nx * weight;
+    q->a[1] = nx * ny * weight;
+    q->a[2] = nx * nz * weight;
+    q->a[3] = nx * d  * weight;
+    q->a[4] = ny * ny * weight;
+    q->a[5] = ny * nz * weight;
+    q->a[6] = ny * d  * weight;
+    q->a[7] = nz * nz * weight;
+    q->a[8] = nz * d  * weight;
+    q->a[9] = d  * d  * weight;
+    q->weight = weight;
+}
+
+static void quadricAdd(Quadric *dst, const Quadric *src)
+{
+    for(int i = 0; i < 10; i++)
+    {
+        dst->a[i] += src->a[i];
+    }
+    dst->weight += src->weight;
+}
+
+static double quadricError(const Quadric *q, const float *p)
+{
+    double x = p[0], y = p[1], z = p[2];
+
+    double e = q->a[0] * x * x + 2.0 * q->a[1] * x * y + 2.0 * q->a[2] * x * z + 2.0 * q->a[3] * x
+             + q->a[4] * y * y + 2.0 * q->a[5] * y * z + 2.0 * q->a[6] * y
+             + q->a[7] * z * z + 2.0 * q->a[8] * z
+             + q->a[9];
+
+    // mean squared distance to the accumulated planes
+    return q->weight > 0.0 ? fabs(e) / q->weight : 0.0;
+}
+
+static void triangleNormal(const float *p0, const float *p1, const float *p2, double *out)
+{
+    double e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+    double e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+
+    out[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    out[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    out[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+static uint32_t hashPosition(const float *p)
+{
+    uint32_t h = 2166136261u;
+    uint32_t bits[3];
+    memcpy(bits, p, sizeof(bits));
+
+    for(int i = 0; i < 3; i++)
+    {
+        h = (h ^ bits[i]) * 16777619u;
+    }
+
+    return h;
+}
+
+static uint32_t hashEdge(uint32_t a, uint32_t b)
+{
+    return (a * 73856093u) ^ (b * 19349663u);
+}
+
+static int compareCollapse(const void *a, const void *b)
+{
+    float ca = ((const Collapse*)a)->cost;
+    float cb = ((const Collapse*)b)->cost;
+
+    return (ca > cb) - (ca < cb);
+}
+
+// Vertices that share a position with another vertex sit on a uv or normal seam,
+// and vertices on an open border define the silhouette, so neither may move.
+static void findLockedVertices(uint8_t *locked, const uint32_t *indices, uint32_t index_count,
+                               const float *positions, uint32_t vertex_count, size_t stride)
+{
+    uint32_t table_size = 1;
+    while(table_size < vertex_count * 2) table_size <<= 1;
+
+    uint32_t *table = malloc(sizeof(*table) * table_size);
+    uint32_t *remap = malloc(sizeof(*remap) * vertex_count);
+    memset(table, 0xFF, sizeof(*table) * table_size);
+
+    for(uint32_t v = 0; v < vertex_count; v++)
+    {
+        const float *p = positions + v * stride;
+        uint32_t slot = hashPosition(p) & (table_size - 1);
+
+        while(table[slot] != UINT32_MAX && memcmp(positions + table[slot] * stride, p, sizeof(float) * 3) != 0)
+        {
+            slot = (slot + 1) & (table_size - 1);
+        }
+
+        if(table[slot] == UINT32_MAX)
+        {
+            table[slot] = v;
+        }
+        remap[v] = table[slot];
+
+        if(remap[v] != v)
+        {
+            locked[v] = DGN_TRUE;
+            locked[remap[v]] = DGN_TRUE;
+        }
+    }
+
+    free(table);
+
+    // count every undirected edge on the welded positions, edges used once are borders
+    uint32_t edge_table_size = 1;
+    while(edge_table_size < index_count * 2) edge_table_size <<= 1;
+
+    uint32_t *edge_keys = malloc(sizeof(*edge_keys) * edge_table_size * 2);
+    uint32_t *edge_counts = calloc(edge_table_size, sizeof(*edge_counts));
+    memset(edge_keys, 0xFF, sizeof(*edge_keys) * edge_table_size * 2);
+
+    for(uint32_t i = 0; i < index_count; i++)
+    {
+        uint32_t a = remap[indices[i]];
+        uint32_t b = remap[indices[i - i % 3 + (i + 1) % 3]];
+        if(a > b)
+        {
+            uint32_t t = a; a = b; b = t;
+        }
+
+        uint32_t slot = hashEdge(a, b) & (edge_table_size - 1);
+        while(edge_keys[slot * 2] != UINT32_MAX && (edge_keys[slot * 2] != a || edge_keys[slot * 2 + 1] != b))
+        {
+            slot = (slot + 1) & (edge_table_size - 1);
+        }
+
+        edge_keys[slot * 2] = a;
+        edge_keys[slot * 2 + 1] = b;
+        edge_counts[slot]++;
+    }
+
+    for(uint32_t slot = 0; slot < edge_table_size; slot++)
+    {
+        if(edge_counts[slot] == 1)
+        {
+            locked[edge_keys[slot * 2]] = DGN_TRUE;
+            locked[edge_keys[slot * 2 + 1]] = DGN_TRUE;
+        }
+    }
+
+    // the welded lock has to reach every wedge of that position
+    for(uint32_t v = 0; v < vertex_count; v++)
+    {
+        if(locked[remap[v]])
+        {
+            locked[v] = DGN_TRUE;
+        }
+    }
+
+    free(edge_keys);
+    free(edge_counts);
+    free(remap);
+}
+
+uint32_t meshSimplify_internal(uint32_t *dst, const uint32_t *indices, uint32_t index_count,
+                               const float *positions, uint32_t vertex_count, size_t stride,
+                               uint32_t target_index_count, float target_error)
+{
+    memcpy(dst, indices, sizeof(*indices) * index_count);
+
+    if(index_count <= target_index_count || vertex_count == 0)
+    {
+        return index_count;
+    }
+
+    uint8_t *locked = calloc(vertex_count, sizeof(*locked));
+    findLockedVertices(locked, indices, index_count, positions, vertex_count, stride);
+
+    Quadric *quadrics = calloc(vertex_count, sizeof(*quadrics));
+
+    for(uint32_t i = 0; i < index_count; i += 3)
+    {
+        const float *p0 = positions + dst[i] * stride;
+        const float *p1 = positions + dst[i + 1] * stride;
+        const float *p2 = positions + dst[i + 2] * stride;
+
+        double n[3];
+        triangleNormal(p0, p1, p2, n);
+        double len = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if(len <= 0.0) continue;
+
+        n[0] /= len; n[1] /= len; n[2] /= len;
+        double d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+
+        Quadric q;
+        quadricFromPlane(&q, n[0], n[1], n[2], d, len * 0.5);
+
+        quadricAdd(&quadrics[dst[i]], &q);
+        quadricAdd(&quadrics[dst[i + 1]], &q);
+        quadricAdd(&quadrics[dst[i + 2]], &q);
+    }
+
+    uint32_t *adj_offsets = malloc(sizeof(*adj_offsets) * (vertex_count + 1));
+    uint32_t *adj_tris = malloc(sizeof(*adj_tris) * index_count);
+    uint32_t *collapse_remap = malloc(sizeof(*collapse_remap) * vertex_count);
+    uint8_t *touched = malloc(sizeof(*touched) * vertex_count);
+    Collapse *collapses = malloc(sizeof(*collapses) * index_count);
+
+    float max_error = target_error * target_error;
+
+    while(index_count > target_index_count)
+    {
+        /** ---- vertex to triangle adjacency ---- **/
+
+        memset(adj_offsets, 0, sizeof(*adj_offsets) * (vertex_count + 1));
+        for(uint32_t i = 0; i < index_count; i++)
+        {
+            adj_offsets[dst[i] + 1]++;
+        }
+        for(uint32_t v = 0; v < vertex_count; v++)
+        {
+            adj_offsets[v + 1] += adj_offsets[v];
+        }
+        for(uint32_t i = 0; i < index_count; i++)
+        {
+            adj_tris[adj_offsets[dst[i]]++] = i / 3;
+        }
+        // the fill pass shifted every offset forward by one bucket
+        for(uint32_t v = vertex_count; v > 0; v--)
+        {
+            adj_offsets[v] = adj_offsets[v - 1];
+        }
+        adj_offsets[0] = 0;
+
+        /** ---- rank every candidate edge ---- **/
+
+        uint32_t collapse_count = 0;
+        for(uint32_t i = 0; i < index_count; i++)
+        {
+            uint32_t from = dst[i];
+            uint32_t to = dst[i - i % 3 + (i + 1) % 3];
+
+            if(locked[from]) continue;
+
+            Quadric q = quadrics[from];
+            quadricAdd(&q, &quadrics[to]);
+
+            collapses[collapse_count].from = from;
+            collapses[collapse_count].to = to;
+            collapses[collapse_count].cost = (float)quadricError(&q, positions + to * stride);
+            collapse_count++;
+        }
+
+        if(collapse_count == 0) break;
+
+        qsort(collapses, collapse_count, sizeof(*collapses), compareCollapse);
+
+        /** ---- collapse the cheapest independent edges ---- **/
+
+        for(uint32_t v = 0; v < vertex_count; v++)
+        {
+            collapse_remap[v] = v;
+        }
+        memset(touched, 0, sizeof(*touched) * vertex_count);
+
+        // every collapse removes roughly two triangles
+        uint32_t triangles_needed = (index_count - target_index_count) / 3;
+        uint32_t triangles_removed = 0;
+        uint32_t applied = 0;
+
+        for(uint32_t c = 0; c < collapse_count && triangles_removed < triangles_needed; c++)
+        {
+            Collapse col = collapses[c];
+
+            if(col.cost > max_error) break;
+            if(touched[col.from] || touched[col.to]) continue;
+
+            const float *p_to = positions + col.to * stride;
+            uint8_t flipped = DGN_FALSE;
+            uint32_t removed = 0;
+
+            for(uint32_t a = adj_offsets[col.from]; a < adj_offsets[col.from + 1]; a++)
+            {
+                const uint32_t *tri = dst + adj_tris[a] * 3;
+
+                if(tri[0] == col.to || tri[1] == col.to || tri[2] == col.to)
+                {
+                    removed++;
+                    continue;
+                }
+
+                const float *p[3];
+                const float *p_new[3];
+                for(int k = 0; k < 3; k++)
+                {
+                    p[k] = positions + tri[k] * stride;
+                    p_new[k] = tri[k] == col.from ? p_to : p[k];
+                }
+
+                double n_old[3], n_new[3];
+                triangleNormal(p[0], p[1], p[2], n_old);
+                triangleNormal(p_new[0], p_new[1], p_new[2], n_new);
+
+                if(n_old[0] * n_new[0] + n_old[1] * n_new[1] + n_old[2] * n_new[2] <= 0.0)
+                {
+                    flipped = DGN_TRUE;
+                    break;
+                }
+            }
+
+            if(flipped) continue;
+
+            collapse_remap[col.from] = col.to;
+            quadricAdd(&quadrics[col.to], &quadrics[col.from]);
+
+            // keep the one ring fixed for the rest of this pass so the adjacency stays valid
+            for(uint32_t a = adj_offsets[col.from]; a < adj_offsets[col.from + 1]; a++)
+            {
+                const uint32_t *tri = dst + adj_tris[a] * 3;
+                touched[tri[0]] = DGN_TRUE;
+                touched[tri[1]] = DGN_TRUE;
+                touched[tri[2]] = DGN_TRUE;
+            }
+
+            triangles_removed += removed;
+            applied++;
+        }
+
+        if(applied == 0) break;
+
+        /** ---- rewrite and drop degenerate triangles ---- **/
+
+        uint32_t write = 0;
+        for(uint32_t i = 0; i < index_count; i += 3)
+        {
+            uint32_t a = collapse_remap[dst[i]];
+            uint32_t b = collapse_remap[dst[i + 1]];
+            uint32_t c = collapse_remap[dst[i + 2]];
+
+            if(a == b || b == c || a == c) continue;
+
+            dst[write++] = a;
+            dst[write++] = b;
+            dst[write++] = c;
+        }
+
+        index_count = write;
+    }
+
+    free(collapses);
+    free(touched);
+    free(collapse_remap);
+    free(adj_tris);
+    free(adj_offsets);
+    free(quadrics);
+    free(locked);
+
+    return index_count;
+}
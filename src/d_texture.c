@@ -72,6 +72,48 @@ static void setFilterInternal(GLenum image_type, uint8_t filter_mode, uint8_t mi
     }
 }
 
+// size of the pixel data a glTexImage call reads, nothing is sent when data is NULL
+static uint64_t uploadBytesInternal(const void *data, uint32_t width, uint32_t height, GLenum format, GLenum type)
+{
+    if(data == NULL) return 0;
+
+    uint32_t channels = 4;
+    switch(format)
+    {
+    case GL_RED:
+    case GL_DEPTH_COMPONENT:
+        channels = 1;
+        break;
+    case GL_RG:
+        channels = 2;
+        break;
+    case GL_RGB:
+        channels = 3;
+        break;
+    }
+
+    uint32_t channel_bytes = 1;
+    switch(type)
+    {
+    case GL_UNSIGNED_SHORT:
+    case GL_HALF_FLOAT:
+        channel_bytes = 2;
+        break;
+    case GL_UNSIGNED_INT:
+    case GL_FLOAT:
+        channel_bytes = 4;
+        break;
+    }
+
+    return (uint64_t)width * height * channels * channel_bytes;
+}
+
+void textureSetSampling_internal(GLenum image_type, uint8_t wrapping, uint8_t filtering, uint8_t mipmapped)
+{
+    setWrapInternal(image_type, wrapping);
+    setFilterInternal(image_type, filtering, mipmapped);
+}
+
 DgnTexture *dgnTextureCreate(
     uint8_t *data,
     uint32_t width,
@@ -88,24 +130,28 @@ DgnTexture *dgnTextureCreate(
     uint32_t tex;
     glCall(glGenTextures(1, &tex));
 
-    glCall(glBindTexture(GL_TEXTURE_2D, tex));
+    glStatCall(DGN_RENDER_STAT_TEXTURE_BINDS, 1, glBindTexture(GL_TEXTURE_2D, tex));
 
     setWrapInternal(GL_TEXTURE_2D, wrapping);
     setFilterInternal(GL_TEXTURE_2D, filtering, mipmapped);
 
-    glCall(glTexImage2D(GL_TEXTURE_2D, 0, internal_type, width, height, 0, storage_type, data_type, data));
+    glStatCall(DGN_RENDER_STAT_UPLOAD_BYTES, uploadBytesInternal(data, width, height, storage_type, data_type),
+               glTexImage2D(GL_TEXTURE_2D, 0, internal_type, width, height, 0, storage_type, data_type, data));
 
     if(mipmapped)
     {
         glCall(glGenerateMipmap(GL_TEXTURE_2D));
     }
 
-    glCall(glBindTexture(GL_TEXTURE_2D, 0));
+    glStatCall(DGN_RENDER_STAT_TEXTURE_BINDS, 1, glBindTexture(GL_TEXTURE_2D, 0));
+
+    glLabel(GL_TEXTURE, tex, "texture");
 
     DgnTexture *res = malloc(sizeof(*res));
 
     res->texture = tex;
     res->mipmapped = mipmapped;
+    res->stream = NULL;
     res->width = malloc(sizeof(*res->width));
     res->height = malloc(sizeof(*res->height));
 
@@ -129,48 +175,124 @@ DgnTexture *dgnCubemapCreate(
     uint32_t tex;
     glCall(glGenTextures(1, &tex));
 
-    glCall(glBindTexture(GL_TEXTURE_CUBE_MAP, tex));
+    glStatCall(DGN_RENDER_STAT_TEXTURE_BINDS, 1, glBindTexture(GL_TEXTURE_CUBE_MAP, tex));
 
     setWrapInternal(GL_TEXTURE_CUBE_MAP, wrapping);
     setFilterInternal(GL_TEXTURE_CUBE_MAP, filtering, DGN_TRUE);
 
     for(int i = 0; i < 6; i++)
     {
-        glCall(glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, storage_type, width[i], height[i], 0, GL_RGBA, GL_UNSIGNED_BYTE, data[i]));
+        glStatCall(DGN_RENDER_STAT_UPLOAD_BYTES, uploadBytesInternal(data[i], width[i], height[i], GL_RGBA, GL_UNSIGNED_BYTE),
+                   glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, storage_type, width[i], height[i], 0, GL_RGBA, GL_UNSIGNED_BYTE, data[i]));
     }
 
     glCall(glGenerateMipmap(GL_TEXTURE_CUBE_MAP));
 
-    glCall(glBindTexture(GL_TEXTURE_CUBE_MAP, 0));
+    glStatCall(DGN_RENDER_STAT_TEXTURE_BINDS, 1, glBindTexture(GL_TEXTURE_CUBE_MAP, 0));
+
+    glLabel(GL_TEXTURE, tex, "cubemap");
 
     DgnTexture *res = malloc(sizeof(*res));
 
     res->texture = tex;
     res->mipmapped = DGN_TRUE;
+    res->stream = NULL;
     res->width = malloc(sizeof(*res->width) * 6);
     res->height = malloc(sizeof(*res->height) * 6);
 
-    memcpy(res->width, width, 6 * sizeof(*width));
-    memcpy(res->height, width, 6 * sizeof(*height));
+    // the sizes are stored narrower than they are given
+    for(int i = 0; i < 6; i++)
+    {
+        res->width[i] = width[i];
+        res->height[i] = height[i];
+    }
 
     return res;
 }
 
-DgnTexture *dgnTextureLoad(const char *filepath, uint8_t wrapping, uint8_t filtering, uint8_t mipmapped, uint16_t storage_type)
+// whole file into memory, NULL if it could not be read
+static uint8_t *readFileInternal(const char *filepath, size_t *out_size)
 {
-    uint8_t *pixels;
-    uint32_t width, height;
+    FILE *file = fopen(filepath, "rb");
+
+    if(file == NULL) return NULL;
+
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    if(length <= 0)
+    {
+        fclose(file);
+        return NULL;
+    }
+
+    uint8_t *data = malloc(length);
+    size_t read = fread(data, 1, length, file);
+    fclose(file);
+
+    if(read != (size_t)length)
+    {
+        free(data);
+        return NULL;
+    }
 
-    unsigned error = lodepng_decode32_file(&pixels, &width, &height, filepath);
-    if(error )
+    *out_size = length;
+    return data;
+}
+
+// reading and decoding are timed apart, as stages of asset on the load timeline
+uint8_t textureLoadPng_internal(const char *filepath, const char *asset, uint8_t **out_pixels, uint32_t *out_width, uint32_t *out_height)
+{
+    size_t size = 0;
+
+    uint32_t stage = loadStageBegin_internal(asset, DGN_LOAD_STAGE_READ);
+    uint8_t *file = readFileInternal(filepath, &size);
+    loadStageEnd_internal(stage);
+
+    if(file == NULL)
+    {
+        logError("PNG LOADING", filepath);
+        return DGN_FALSE;
+    }
+
+    stage = loadStageBegin_internal(asset, DGN_LOAD_STAGE_DECODE);
+    unsigned error = lodepng_decode32(out_pixels, out_width, out_height, file, size);
+    loadStageEnd_internal(stage);
+
+    free(file);
+
+    if(error)
     {
         char str[256];
         sprintf_s(str, 256, "%s\n\tFile: %s", lodepng_error_text(error), filepath);
         logError("PNG LOADING", str);
+        return DGN_FALSE;
+    }
+
+    return DGN_TRUE;
+}
+
+DgnTexture *dgnTextureLoad(const char *filepath, uint8_t wrapping, uint8_t filtering, uint8_t mipmapped, uint16_t storage_type)
+{
+    uint8_t *pixels;
+    uint32_t width, height;
+
+    if(!textureLoadPng_internal(filepath, filepath, &pixels, &width, &height))
+    {
         return NULL;
     }
 
-    return dgnTextureCreate(pixels, width, height, wrapping, filtering, mipmapped, DGN_TEX_STORAGE_RGBA, storage_type, DGN_DATA_TYPE_UBYTE);
+    uint32_t stage = loadStageBegin_internal(filepath, DGN_LOAD_STAGE_UPLOAD);
+    DgnTexture *res = dgnTextureCreate(pixels, width, height, wrapping, filtering, mipmapped, DGN_TEX_STORAGE_RGBA, storage_type, DGN_DATA_TYPE_UBYTE);
+    loadStageEnd_internal(stage);
+
+    if(res != NULL)
+    {
+        glLabel(GL_TEXTURE, res->texture, filepath);
+    }
+
+    return res;
 }
 
 DgnTexture *dgnCubemapLoad(const char *filepath[6], uint8_t wrapping, uint8_t filtering, uint16_t storage_type)
@@ -178,24 +300,38 @@ DgnTexture *dgnCubemapLoad(const char *filepath[6], uint8_t wrapping, uint8_t fi
     uint8_t *pixels[6];
     uint32_t width[6], height[6];
 
+    // the faces are timed together, as one asset named after the first
     for(int i = 0; i < 6; i++)
     {
-        unsigned error = lodepng_decode32_file(&pixels[i], &width[i], &height[i], filepath[i]);
-        if(error)
+        if(!textureLoadPng_internal(filepath[i], filepath[0], &pixels[i], &width[i], &height[i]))
         {
-            char str[256];
-            sprintf_s(str, 256, "%s\n\tFile: %s", lodepng_error_text(error), filepath[i]);
-            logError("PNG LOADING", str);
             return NULL;
         }
     }
 
-    return dgnCubemapCreate(pixels, width, height, wrapping, filtering, storage_type);
+    uint32_t stage = loadStageBegin_internal(filepath[0], DGN_LOAD_STAGE_UPLOAD);
+    DgnTexture *res = dgnCubemapCreate(pixels, width, height, wrapping, filtering, storage_type);
+    loadStageEnd_internal(stage);
+
+    if(res != NULL)
+    {
+        glLabel(GL_TEXTURE, res->texture, filepath[0]);
+    }
+
+    return res;
 }
 
 void dgnTextureDestroy(DgnTexture *texture)
 {
-    glCall(glDeleteTextures(1, &texture->texture));
+    // a streamed texture still shows its streamer's placeholder
+    if(texture->stream)
+    {
+        textureStreamCancel_internal(texture);
+    }
+    else
+    {
+        glCall(glDeleteTextures(1, &texture->texture));
+    }
 
     free(texture->width);
     free(texture->height);
@@ -204,25 +340,25 @@ void dgnTextureDestroy(DgnTexture *texture)
 
 void dgnTextureSetWrap(DgnTexture *texture, uint8_t wrap_mode)
 {
-    glCall(glBindTexture(GL_TEXTURE_2D, texture->texture));
+    glStatCall(DGN_RENDER_STAT_TEXTURE_BINDS, 1, glBindTexture(GL_TEXTURE_2D, texture->texture));
     setWrapInternal(GL_TEXTURE_2D, wrap_mode);
-    glCall(glBindTexture(GL_TEXTURE_2D, 0));
+    glStatCall(DGN_RENDER_STAT_TEXTURE_BINDS, 1, glBindTexture(GL_TEXTURE_2D, 0));
 }
 
 void dgnTextureSetFilter(DgnTexture *texture, uint8_t filter_mode)
 {
-    glCall(glBindTexture(GL_TEXTURE_2D, texture->texture));
+    glStatCall(DGN_RENDER_STAT_TEXTURE_BINDS, 1, glBindTexture(GL_TEXTURE_2D, texture->texture));
     setFilterInternal(GL_TEXTURE_2D, filter_mode, texture->mipmapped);
-    glCall(glBindTexture(GL_TEXTURE_2D, 0));
+    glStatCall(DGN_RENDER_STAT_TEXTURE_BINDS, 1, glBindTexture(GL_TEXTURE_2D, 0));
 }
 
 void dgnTextureSetBorderColor(DgnTexture *texture, float r, float g, float b, float a)
 {
     float color[] = {r, g, b, a};
 
-    glCall(glBindTexture(GL_TEXTURE_2D, texture->texture));
+    glStatCall(DGN_RENDER_STAT_TEXTURE_BINDS, 1, glBindTexture(GL_TEXTURE_2D, texture->texture));
     glCall(glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, color));
-    glCall(glBindTexture(GL_TEXTURE_2D, 0));
+    glStatCall(DGN_RENDER_STAT_TEXTURE_BINDS, 1, glBindTexture(GL_TEXTURE_2D, 0));
 }
 
 uint32_t dgnTextureGetWidth(DgnTexture *texture)
@@ -234,3 +370,8 @@ uint32_t dgnTextureGetHeight(DgnTexture *texture)
 {
     return texture->height[0];
 }
+
+uint8_t dgnTextureIsResident(DgnTexture *texture)
+{
+    return texture->stream == NULL;
+}
@@ -0,0 +1,815 @@
+#include "d_internal.h"
+#include "DGNEngine/DGNEngine.h"
+
+#include <stdlib.h>
+
+// decoded pixels come from lodepng, which allocates without MemLeaker
+static void freePixelsInternal(uint8_t *pixels)
+{
+    free(pixels);
+}
+
+#include <MemLeaker/malloc.h>
+
+#include <pthread.h>
+#include <string.h>
+
+// Textures decode on worker threads and upload a few rows at a time from dgnTextureStreamerUpdate,
+// so a frame never spends more than the budget on sending pixels. Until then a texture shows a
+// shared placeholder, then a tiny preview once its image is decoded.
+
+#define MAX_STREAM_THREADS 8
+// longer side of the preview, in pixels
+#define PREVIEW_SIZE 16
+// slices staged in the pixel buffer by one update
+#define MAX_UPLOAD_SLICES 32
+
+typedef struct TextureStreamRequest TextureStreamRequest;
+
+struct TextureStreamRequest
+{
+    DgnTextureStreamer *streamer;
+    // NULL once the texture was destroyed, the request goes when its workers are done with it
+    DgnTexture *texture;
+
+    char *filepaths[6];
+    uint8_t face_count;
+    uint8_t wrapping;
+    uint8_t filtering;
+    uint8_t mipmapped;
+    uint16_t storage_type;
+
+    // written by the workers, faces_done and failed are read under the streamer's mutex
+    uint8_t *pixels[6];
+    uint32_t width[6];
+    uint32_t height[6];
+    uint8_t *preview_pixels[6];
+    uint32_t preview_width[6];
+    uint32_t preview_height[6];
+    uint8_t faces_done;
+    uint8_t failed;
+
+    // only touched by the thread updating the streamer
+    DgnTexture *preview;
+    uint32_t gl_texture;
+    uint8_t upload_face;
+    uint32_t upload_row;
+    uint8_t finished;
+
+    TextureStreamRequest *next;
+};
+
+typedef struct
+{
+    TextureStreamRequest *request;
+    uint8_t face;
+}DecodeJob;
+
+typedef struct
+{
+    GLenum bind_target;
+    GLenum target;
+    uint32_t texture;
+    uint32_t row;
+    uint32_t rows;
+    uint32_t width;
+    size_t offset;
+}UploadSlice;
+
+// what one update has sent so far
+typedef struct
+{
+    uint32_t budget;
+    uint64_t used;
+
+    // the pixel buffer is mapped on the first staged slice
+    uint8_t *mapped;
+    size_t staged;
+    UploadSlice slices[MAX_UPLOAD_SLICES];
+    uint32_t slice_count;
+}UploadFrame;
+
+struct DgnTextureStreamer
+{
+    pthread_t threads[MAX_STREAM_THREADS];
+    uint8_t thread_count;
+    uint8_t quit;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t job_cond;
+
+    // ring of faces waiting for a worker
+    DecodeJob *jobs;
+    uint32_t job_capacity;
+    uint32_t job_start;
+    uint32_t job_count;
+
+    // in the order they were loaded, appended by any thread but only unlinked by the update
+    TextureStreamRequest *first;
+    TextureStreamRequest *last;
+    uint32_t pending;
+
+    uint32_t budget;
+    uint32_t pbo;
+
+    DgnTexture *placeholder;
+    DgnTexture *placeholder_cubemap;
+};
+
+static const uint8_t s_placeholder_color[4] = {128, 128, 128, 255};
+static const uint8_t s_error_color[4] = {255, 0, 255, 255};
+
+/** ---- Decoding ---- **/
+
+// box filtered, halving until the longer side fits
+static void buildPreviewInternal(TextureStreamRequest *request, uint8_t face)
+{
+    uint32_t width = request->width[face];
+    uint32_t height = request->height[face];
+    const uint8_t *pixels = request->pixels[face];
+
+    uint32_t step = 1;
+    while(width / step > PREVIEW_SIZE || height / step > PREVIEW_SIZE)
+    {
+        step *= 2;
+    }
+
+    uint32_t preview_width = width / step ? width / step : 1;
+    uint32_t preview_height = height / step ? height / step : 1;
+    uint8_t *preview = malloc(preview_width * preview_height * 4);
+
+    for(uint32_t y = 0; y < preview_height; y++)
+    {
+        for(uint32_t x = 0; x < preview_width; x++)
+        {
+            uint32_t sum[4] = {0};
+            uint32_t count = 0;
+
+            for(uint32_t sy = y * step; sy < (y + 1) * step && sy < height; sy++)
+            {
+                for(uint32_t sx = x * step; sx < (x + 1) * step && sx < width; sx++)
+                {
+                    const uint8_t *pixel = pixels + ((size_t)sy * width + sx) * 4;
+                    sum[0] += pixel[0];
+                    sum[1] += pixel[1];
+                    sum[2] += pixel[2];
+                    sum[3] += pixel[3];
+                    count++;
+                }
+            }
+
+            uint8_t *out = preview + ((size_t)y * preview_width + x) * 4;
+            for(int c = 0; c < 4; c++)
+            {
+                out[c] = (uint8_t)(sum[c] / count);
+            }
+        }
+    }
+
+    request->preview_pixels[face] = preview;
+    request->preview_width[face] = preview_width;
+    request->preview_height[face] = preview_height;
+}
+
+static uint8_t decodeFaceInternal(TextureStreamRequest *request, uint8_t face)
+{
+    DGN_PROFILE_SCOPE("texture decode");
+
+    // the faces of a cubemap are timed as one asset, like dgnCubemapLoad does
+    if(!textureLoadPng_internal(request->filepaths[face], request->filepaths[0], &request->pixels[face],
+                                &request->width[face], &request->height[face]))
+    {
+        request->pixels[face] = NULL;
+        return DGN_FALSE;
+    }
+
+    buildPreviewInternal(request, face);
+    return DGN_TRUE;
+}
+
+static void *workerMainInternal(void *arg)
+{
+    DgnTextureStreamer *streamer = arg;
+
+    dgnProfileSetThreadName("texture decode");
+
+    pthread_mutex_lock(&streamer->mutex);
+    while(1)
+    {
+        while(streamer->job_count == 0 && !streamer->quit)
+        {
+            pthread_cond_wait(&streamer->job_cond, &streamer->mutex);
+        }
+
+        if(streamer->quit) break;
+
+        DecodeJob job = streamer->jobs[streamer->job_start];
+        streamer->job_start = (streamer->job_start + 1) % streamer->job_capacity;
+        streamer->job_count--;
+
+        // destroyed textures are not worth decoding
+        uint8_t wanted = job.request->texture != NULL;
+        pthread_mutex_unlock(&streamer->mutex);
+
+        uint8_t loaded = wanted && decodeFaceInternal(job.request, job.face);
+
+        pthread_mutex_lock(&streamer->mutex);
+        if(wanted && !loaded)
+        {
+            job.request->failed = DGN_TRUE;
+        }
+        job.request->faces_done++;
+    }
+    pthread_mutex_unlock(&streamer->mutex);
+
+    return NULL;
+}
+
+/** ---- Textures ---- **/
+
+// 1x1 of one color, a cubemap when face_count is 6
+static DgnTexture *solidTextureInternal(const uint8_t color[4], uint8_t face_count)
+{
+    if(face_count == 6)
+    {
+        uint8_t *faces[6];
+        uint32_t size[6];
+        for(int i = 0; i < 6; i++)
+        {
+            faces[i] = (uint8_t*)color;
+            size[i] = 1;
+        }
+
+        return dgnCubemapCreate(faces, size, size, DGN_TEX_WRAP_CLAMP_TO_EDGE, DGN_TEX_FILTER_NEAREST, DGN_TEX_STORAGE_RGBA);
+    }
+
+    return dgnTextureCreate((uint8_t*)color, 1, 1, DGN_TEX_WRAP_REPEAT, DGN_TEX_FILTER_NEAREST, DGN_FALSE,
+                            DGN_TEX_STORAGE_RGBA, DGN_TEX_STORAGE_RGBA, DGN_DATA_TYPE_UBYTE);
+}
+
+// texture takes from's gl texture and size, from is freed and texture no longer streams
+static void adoptInternal(DgnTexture *texture, DgnTexture *from, uint8_t face_count)
+{
+    texture->texture = from->texture;
+    for(uint8_t i = 0; i < face_count; i++)
+    {
+        texture->width[i] = from->width[face_count == 6 ? i : 0];
+        texture->height[i] = from->height[face_count == 6 ? i : 0];
+    }
+    texture->stream = NULL;
+
+    free(from->width);
+    free(from->height);
+    free(from);
+}
+
+static GLenum bindTargetInternal(const TextureStreamRequest *request)
+{
+    return request->face_count == 6 ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+}
+
+static GLenum faceTargetInternal(const TextureStreamRequest *request, uint8_t face)
+{
+    return request->face_count == 6 ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D;
+}
+
+static void freeRequestInternal(TextureStreamRequest *request)
+{
+    for(uint8_t i = 0; i < request->face_count; i++)
+    {
+        free(request->filepaths[i]);
+        freePixelsInternal(request->pixels[i]);
+        free(request->preview_pixels[i]);
+    }
+
+    free(request);
+}
+
+/** ---- Uploading ---- **/
+
+// shows the preview and allocates the full texture, the rows are sent later within the budget
+static void startUploadInternal(TextureStreamRequest *request)
+{
+    if(request->face_count == 6)
+    {
+        request->preview = dgnCubemapCreate(request->preview_pixels, request->preview_width, request->preview_height,
+                                            request->wrapping, request->filtering, request->storage_type);
+    }
+    else
+    {
+        request->preview = dgnTextureCreate(request->preview_pixels[0], request->preview_width[0], request->preview_height[0],
+                                            request->wrapping, request->filtering, DGN_FALSE, DGN_TEX_STORAGE_RGBA,
+                                            request->storage_type, DGN_DATA_TYPE_UBYTE);
+    }
+    request->texture->texture = request->preview->texture;
+
+    GLenum target = bindTargetInternal(request);
+
+    glCall(glGenTextures(1, &request->gl_texture));
+    glStatCall(DGN_RENDER_STAT_TEXTURE_BINDS, 1, glBindTexture(target, request->gl_texture));
+
+    textureSetSampling_internal(target, request->wrapping, request->filtering, request->mipmapped);
+
+    for(uint8_t i = 0; i < request->face_count; i++)
+    {
+        glCall(glTexImage2D(faceTargetInternal(request, i), 0, request->storage_type, request->width[i], request->height[i],
+                            0, GL_RGBA, GL_UNSIGNED_BYTE, NULL));
+    }
+
+    glStatCall(DGN_RENDER_STAT_TEXTURE_BINDS, 1, glBindTexture(target, 0));
+
+    glLabel(GL_TEXTURE, request->gl_texture, request->filepaths[0]);
+}
+
+static uint8_t mapBufferInternal(DgnTextureStreamer *streamer, UploadFrame *frame)
+{
+    glCall(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, streamer->pbo));
+    // orphaned, so writing never waits on the copies of the last update
+    glCall(glBufferData(GL_PIXEL_UNPACK_BUFFER, frame->budget, NULL, GL_STREAM_DRAW));
+    glCall(frame->mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, frame->budget,
+                                            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    glCall(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+
+    return frame->mapped != NULL;
+}
+
+// sends rows until the request is done or the frame's budget is spent, false once it is spent
+static uint8_t uploadRowsInternal(DgnTextureStreamer *streamer, UploadFrame *frame, TextureStreamRequest *request)
+{
+    while(request->upload_face < request->face_count)
+    {
+        uint8_t face = request->upload_face;
+        uint32_t width = request->width[face];
+        uint32_t height = request->height[face];
+        uint64_t row_bytes = (uint64_t)width * 4;
+        uint32_t rows = height - request->upload_row;
+
+        if(frame->budget)
+        {
+            uint64_t allowed = frame->used < frame->budget ? (frame->budget - frame->used) / row_bytes : 0;
+
+            // a row wider than the whole budget still goes on its own, so every load finishes
+            if(allowed == 0)
+            {
+                if(frame->used > 0) return DGN_FALSE;
+                allowed = 1;
+            }
+
+            if(rows > allowed)
+            {
+                rows = (uint32_t)allowed;
+            }
+        }
+
+        const uint8_t *src = request->pixels[face] + request->upload_row * row_bytes;
+        uint64_t bytes = rows * row_bytes;
+
+        uint8_t staged = DGN_FALSE;
+        if(streamer->pbo && bytes <= frame->budget - frame->staged)
+        {
+            if(frame->slice_count == MAX_UPLOAD_SLICES) return DGN_FALSE;
+
+            if(frame->mapped || mapBufferInternal(streamer, frame))
+            {
+                memcpy(frame->mapped + frame->staged, src, bytes);
+
+                UploadSlice *slice = &frame->slices[frame->slice_count++];
+                slice->bind_target = bindTargetInternal(request);
+                slice->target = faceTargetInternal(request, face);
+                slice->texture = request->gl_texture;
+                slice->row = request->upload_row;
+                slice->rows = rows;
+                slice->width = width;
+                slice->offset = frame->staged;
+
+                frame->staged += bytes;
+                staged = DGN_TRUE;
+            }
+        }
+
+        if(!staged)
+        {
+            GLenum target = bindTargetInternal(request);
+
+            glStatCall(DGN_RENDER_STAT_TEXTURE_BINDS, 1, glBindTexture(target, request->gl_texture));
+            glStatCall(DGN_RENDER_STAT_UPLOAD_BYTES, bytes,
+                       glTexSubImage2D(faceTargetInternal(request, face), 0, 0, request->upload_row, width, rows,
+                                       GL_RGBA, GL_UNSIGNED_BYTE, src));
+            glStatCall(DGN_RENDER_STAT_TEXTURE_BINDS, 1, glBindTexture(target, 0));
+        }
+
+        frame->used += bytes;
+        request->upload_row += rows;
+
+        if(request->upload_row == height)
+        {
+            request->upload_face++;
+            request->upload_row = 0;
+        }
+    }
+
+    return DGN_TRUE;
+}
+
+// copies the staged slices from the pixel buffer into their textures
+static void flushInternal(DgnTextureStreamer *streamer, UploadFrame *frame)
+{
+    if(frame->mapped == NULL) return;
+
+    glCall(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, streamer->pbo));
+
+    GLboolean intact;
+    glCall(intact = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER));
+    if(!intact)
+    {
+        logError("TEXTURE STREAMING", "Pixel buffer was lost while mapped, some rows are corrupt");
+    }
+
+    for(uint32_t i = 0; i < frame->slice_count; i++)
+    {
+        const UploadSlice *slice = &frame->slices[i];
+
+        glStatCall(DGN_RENDER_STAT_TEXTURE_BINDS, 1, glBindTexture(slice->bind_target, slice->texture));
+        glStatCall(DGN_RENDER_STAT_UPLOAD_BYTES, (uint64_t)slice->width * slice->rows * 4,
+                   glTexSubImage2D(slice->target, 0, 0, slice->row, slice->width, slice->rows, GL_RGBA, GL_UNSIGNED_BYTE,
+                                   (const void*)slice->offset));
+        glStatCall(DGN_RENDER_STAT_TEXTURE_BINDS, 1, glBindTexture(slice->bind_target, 0));
+    }
+
+    glCall(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+
+    frame->mapped = NULL;
+}
+
+// every row is sent, the full texture replaces the preview
+static void finishUploadInternal(TextureStreamRequest *request)
+{
+    DgnTexture *texture = request->texture;
+
+    if(request->mipmapped)
+    {
+        GLenum target = bindTargetInternal(request);
+
+        glStatCall(DGN_RENDER_STAT_TEXTURE_BINDS, 1, glBindTexture(target, request->gl_texture));
+        glCall(glGenerateMipmap(target));
+        glStatCall(DGN_RENDER_STAT_TEXTURE_BINDS, 1, glBindTexture(target, 0));
+    }
+
+    dgnTextureDestroy(request->preview);
+    request->preview = NULL;
+
+    texture->texture = request->gl_texture;
+    for(uint8_t i = 0; i < request->face_count; i++)
+    {
+        texture->width[i] = request->width[i];
+        texture->height[i] = request->height[i];
+    }
+    texture->stream = NULL;
+
+    request->gl_texture = 0;
+    request->finished = DGN_TRUE;
+}
+
+/** ---- Streamer ---- **/
+
+DgnTextureStreamer *dgnTextureStreamerCreate(uint8_t thread_count, uint32_t frame_upload_budget, uint8_t use_pbo)
+{
+    DgnTextureStreamer *streamer = malloc(sizeof(*streamer));
+    memset(streamer, 0, sizeof(*streamer));
+
+    pthread_mutex_init(&streamer->mutex, NULL);
+    pthread_cond_init(&streamer->job_cond, NULL);
+
+    streamer->budget = frame_upload_budget;
+    streamer->placeholder = solidTextureInternal(s_placeholder_color, 1);
+    streamer->placeholder_cubemap = solidTextureInternal(s_placeholder_color, 6);
+
+    glLabel(GL_TEXTURE, streamer->placeholder->texture, "stream placeholder");
+    glLabel(GL_TEXTURE, streamer->placeholder_cubemap->texture, "stream placeholder cubemap");
+
+    if(use_pbo)
+    {
+        glCall(glGenBuffers(1, &streamer->pbo));
+        glLabel(GL_BUFFER, streamer->pbo, "texture stream pbo");
+    }
+
+    if(thread_count < 1) thread_count = 1;
+    if(thread_count > MAX_STREAM_THREADS) thread_count = MAX_STREAM_THREADS;
+
+    for(uint8_t i = 0; i < thread_count; i++)
+    {
+        if(pthread_create(&streamer->threads[streamer->thread_count], NULL, workerMainInternal, streamer) != 0)
+        {
+            logError("TEXTURE STREAMING", "Could not start decode thread");
+            break;
+        }
+        streamer->thread_count++;
+    }
+
+    if(streamer->thread_count == 0)
+    {
+        dgnTextureStreamerDestroy(streamer);
+        return NULL;
+    }
+
+    return streamer;
+}
+
+void dgnTextureStreamerDestroy(DgnTextureStreamer *streamer)
+{
+    pthread_mutex_lock(&streamer->mutex);
+    streamer->quit = DGN_TRUE;
+    pthread_cond_broadcast(&streamer->job_cond);
+    pthread_mutex_unlock(&streamer->mutex);
+
+    for(uint8_t i = 0; i < streamer->thread_count; i++)
+    {
+        pthread_join(streamer->threads[i], NULL);
+    }
+
+    // nothing decodes any more, queued faces go with their requests
+    TextureStreamRequest *request = streamer->first;
+    while(request)
+    {
+        TextureStreamRequest *next = request->next;
+
+        if(request->texture)
+        {
+            if(request->preview)
+            {
+                adoptInternal(request->texture, request->preview, request->face_count);
+            }
+            else
+            {
+                adoptInternal(request->texture, solidTextureInternal(s_placeholder_color, request->face_count), request->face_count);
+            }
+        }
+
+        if(request->gl_texture)
+        {
+            glCall(glDeleteTextures(1, &request->gl_texture));
+        }
+
+        freeRequestInternal(request);
+        request = next;
+    }
+
+    dgnTextureDestroy(streamer->placeholder);
+    dgnTextureDestroy(streamer->placeholder_cubemap);
+
+    if(streamer->pbo)
+    {
+        glCall(glDeleteBuffers(1, &streamer->pbo));
+    }
+
+    pthread_mutex_destroy(&streamer->mutex);
+    pthread_cond_destroy(&streamer->job_cond);
+
+    free(streamer->jobs);
+    free(streamer);
+}
+
+static DgnTexture *queueInternal(DgnTextureStreamer *streamer, const char **filepaths, uint8_t face_count,
+                                 uint8_t wrapping, uint8_t filtering, uint8_t mipmapped, uint16_t storage_type)
+{
+    TextureStreamRequest *request = malloc(sizeof(*request));
+    memset(request, 0, sizeof(*request));
+
+    request->streamer = streamer;
+    request->face_count = face_count;
+    request->wrapping = wrapping;
+    request->filtering = filtering;
+    request->mipmapped = mipmapped;
+    request->storage_type = storage_type;
+
+    for(uint8_t i = 0; i < face_count; i++)
+    {
+        size_t len = strlen(filepaths[i]) + 1;
+        request->filepaths[i] = malloc(len);
+        memcpy(request->filepaths[i], filepaths[i], len);
+    }
+
+    // the placeholder's name is all that is read, so no gl call is needed here
+    DgnTexture *placeholder = face_count == 6 ? streamer->placeholder_cubemap : streamer->placeholder;
+
+    DgnTexture *texture = malloc(sizeof(*texture));
+    texture->texture = placeholder->texture;
+    texture->mipmapped = mipmapped;
+    texture->width = malloc(sizeof(*texture->width) * face_count);
+    texture->height = malloc(sizeof(*texture->height) * face_count);
+    for(uint8_t i = 0; i < face_count; i++)
+    {
+        texture->width[i] = 1;
+        texture->height[i] = 1;
+    }
+    texture->stream = request;
+    request->texture = texture;
+
+    pthread_mutex_lock(&streamer->mutex);
+
+    if(streamer->last)
+    {
+        streamer->last->next = request;
+    }
+    else
+    {
+        streamer->first = request;
+    }
+    streamer->last = request;
+    streamer->pending++;
+
+    if(streamer->job_count + face_count > streamer->job_capacity)
+    {
+        uint32_t capacity = streamer->job_capacity ? streamer->job_capacity * 2 : 32;
+        DecodeJob *jobs = malloc(sizeof(*jobs) * capacity);
+
+        for(uint32_t i = 0; i < streamer->job_count; i++)
+        {
+            jobs[i] = streamer->jobs[(streamer->job_start + i) % streamer->job_capacity];
+        }
+
+        free(streamer->jobs);
+        streamer->jobs = jobs;
+        streamer->job_capacity = capacity;
+        streamer->job_start = 0;
+    }
+
+    // one job per face, so the faces of a cubemap decode side by side
+    for(uint8_t i = 0; i < face_count; i++)
+    {
+        DecodeJob *job = &streamer->jobs[(streamer->job_start + streamer->job_count++) % streamer->job_capacity];
+        job->request = request;
+        job->face = i;
+    }
+
+    pthread_cond_broadcast(&streamer->job_cond);
+    pthread_mutex_unlock(&streamer->mutex);
+
+    return texture;
+}
+
+DgnTexture *dgnTextureStreamerLoad(DgnTextureStreamer *streamer, const char *filepath, uint8_t wrapping, uint8_t filtering,
+                                   uint8_t mipmapped, uint16_t storage_type)
+{
+    return queueInternal(streamer, &filepath, 1, wrapping, filtering, mipmapped, storage_type);
+}
+
+DgnTexture *dgnTextureStreamerLoadCubemap(DgnTextureStreamer *streamer, const char *filepath[6], uint8_t wrapping,
+                                          uint8_t filtering, uint16_t storage_type)
+{
+    // cubemaps are always mipmapped, as with dgnCubemapCreate
+    return queueInternal(streamer, filepath, 6, wrapping, filtering, DGN_TRUE, storage_type);
+}
+
+void textureStreamCancel_internal(DgnTexture *texture)
+{
+    TextureStreamRequest *request = texture->stream;
+
+    pthread_mutex_lock(&request->streamer->mutex);
+    request->texture = NULL;
+    pthread_mutex_unlock(&request->streamer->mutex);
+
+    if(request->preview)
+    {
+        dgnTextureDestroy(request->preview);
+        request->preview = NULL;
+    }
+
+    if(request->gl_texture)
+    {
+        glCall(glDeleteTextures(1, &request->gl_texture));
+        request->gl_texture = 0;
+    }
+}
+
+void dgnTextureStreamerUpdate(DgnTextureStreamer *streamer)
+{
+    DGN_PROFILE_SCOPE("texture streaming");
+
+    UploadFrame frame;
+    frame.used = 0;
+    frame.mapped = NULL;
+    frame.staged = 0;
+    frame.slice_count = 0;
+
+    pthread_mutex_lock(&streamer->mutex);
+    frame.budget = streamer->budget;
+    TextureStreamRequest *first = streamer->first;
+    pthread_mutex_unlock(&streamer->mutex);
+
+    glCall(glActiveTexture(GL_TEXTURE0));
+
+    // oldest first, so loads become resident in the order they were asked for
+    uint8_t budget_left = DGN_TRUE;
+    TextureStreamRequest *next;
+    for(TextureStreamRequest *request = first; request; request = next)
+    {
+        pthread_mutex_lock(&streamer->mutex);
+        uint8_t decoded = request->faces_done == request->face_count;
+        uint8_t failed = request->failed;
+        uint8_t cancelled = request->texture == NULL;
+        next = request->next;
+        pthread_mutex_unlock(&streamer->mutex);
+
+        // waits for every face even when cancelled, a worker may still be writing one
+        if(!decoded || request->finished) continue;
+
+        if(cancelled)
+        {
+            request->finished = DGN_TRUE;
+            continue;
+        }
+
+        if(failed)
+        {
+            // magenta, so the missing file stands out
+            adoptInternal(request->texture, solidTextureInternal(s_error_color, request->face_count), request->face_count);
+            request->finished = DGN_TRUE;
+            continue;
+        }
+
+        if(!budget_left) continue;
+
+        uint32_t stage = loadStageBegin_internal(request->filepaths[0], DGN_LOAD_STAGE_UPLOAD);
+
+        if(request->gl_texture == 0)
+        {
+            startUploadInternal(request);
+        }
+
+        budget_left = uploadRowsInternal(streamer, &frame, request);
+
+        loadStageEnd_internal(stage);
+    }
+
+    flushInternal(streamer, &frame);
+
+    // after the flush, staged rows have to reach the texture before its mipmaps are made
+    for(TextureStreamRequest *request = first; request; request = next)
+    {
+        pthread_mutex_lock(&streamer->mutex);
+        next = request->next;
+        pthread_mutex_unlock(&streamer->mutex);
+
+        if(!request->finished && request->gl_texture && request->upload_face == request->face_count)
+        {
+            uint32_t stage = loadStageBegin_internal(request->filepaths[0], DGN_LOAD_STAGE_UPLOAD);
+            finishUploadInternal(request);
+            loadStageEnd_internal(stage);
+        }
+    }
+
+    TextureStreamRequest *done = NULL;
+
+    pthread_mutex_lock(&streamer->mutex);
+
+    TextureStreamRequest *prev = NULL;
+    TextureStreamRequest **link = &streamer->first;
+    while(*link)
+    {
+        TextureStreamRequest *request = *link;
+
+        if(request->finished)
+        {
+            *link = request->next;
+            if(streamer->last == request)
+            {
+                streamer->last = prev;
+            }
+            streamer->pending--;
+
+            request->next = done;
+            done = request;
+        }
+        else
+        {
+            prev = request;
+            link = &request->next;
+        }
+    }
+
+    pthread_mutex_unlock(&streamer->mutex);
+
+    while(done)
+    {
+        next = done->next;
+        freeRequestInternal(done);
+        done = next;
+    }
+}
+
+void dgnTextureStreamerSetBudget(DgnTextureStreamer *streamer, uint32_t frame_upload_budget)
+{
+    pthread_mutex_lock(&streamer->mutex);
+    streamer->budget = frame_upload_budget;
+    pthread_mutex_unlock(&streamer->mutex);
+}
+
+uint32_t dgnTextureStreamerGetPending(DgnTextureStreamer *streamer)
+{
+    pthread_mutex_lock(&streamer->mutex);
+    uint32_t pending = streamer->pending;
+    pthread_mutex_unlock(&streamer->mutex);
+
+    return pending;
+}
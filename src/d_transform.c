@@ -0,0 +1,373 @@
+#include "d_internal.h"
+#include "DgnEngine/DgnEngine.h"
+
+#include <MemLeaker/malloc.h>
+
+#include <string.h>
+
+// transforms per job, below this a level is updated on the calling thread
+#define UPDATE_BATCH 256
+
+#define FLAG_LOCAL_DIRTY 0x01
+#define FLAG_WORLD_DIRTY 0x02
+#define FLAG_CHANGED 0x04
+
+static uint8_t allocInternal(DgnTransforms *t, uint32_t capacity)
+{
+    t->pos = malloc(sizeof(Vec3) * capacity);
+    t->rot = malloc(sizeof(Quat) * capacity);
+    t->scale = malloc(sizeof(Vec3) * capacity);
+    t->local = malloc(sizeof(Mat4x4) * capacity);
+    t->world = malloc(sizeof(Mat4x4) * capacity);
+    t->parent_slot = malloc(sizeof(uint32_t) * capacity);
+    t->flags = malloc(capacity);
+    t->slot_handle = malloc(sizeof(uint32_t) * capacity);
+
+    t->handle_slot = malloc(sizeof(uint32_t) * capacity);
+    t->handle_parent = malloc(sizeof(uint32_t) * capacity);
+    t->level_start = malloc(sizeof(uint32_t) * (capacity + 1));
+    t->sort_depth = malloc(sizeof(uint32_t) * capacity);
+    t->sort_order = malloc(sizeof(uint32_t) * capacity);
+    t->sort_cursor = malloc(sizeof(uint32_t) * (capacity + 1));
+    t->scratch = malloc(sizeof(Mat4x4) * capacity);
+
+    return t->pos && t->rot && t->scale && t->local && t->world && t->parent_slot && t->flags && t->slot_handle &&
+           t->handle_slot && t->handle_parent && t->level_start && t->sort_depth && t->sort_order && t->sort_cursor &&
+           t->scratch;
+}
+
+DgnTransforms *dgnTransformsCreate(uint32_t capacity)
+{
+    if(capacity == 0)
+    {
+        logError("TRANSFORMS", "Capacity must not be 0");
+        return NULL;
+    }
+
+    DgnTransforms *res = malloc(sizeof(*res));
+
+    if(res == NULL)
+    {
+        return NULL;
+    }
+
+    memset(res, 0, sizeof(*res));
+    res->capacity = capacity;
+
+    if(!allocInternal(res, capacity))
+    {
+        logError("TRANSFORMS", "Could not allocate transform storage");
+        dgnTransformsDestroy(res);
+        return NULL;
+    }
+
+    return res;
+}
+
+void dgnTransformsDestroy(DgnTransforms *transforms)
+{
+    free(transforms->pos);
+    free(transforms->rot);
+    free(transforms->scale);
+    free(transforms->local);
+    free(transforms->world);
+    free(transforms->parent_slot);
+    free(transforms->flags);
+    free(transforms->slot_handle);
+    free(transforms->handle_slot);
+    free(transforms->handle_parent);
+    free(transforms->level_start);
+    free(transforms->sort_depth);
+    free(transforms->sort_order);
+    free(transforms->sort_cursor);
+    free(transforms->scratch);
+
+    free(transforms);
+}
+
+uint32_t dgnTransformsAdd(DgnTransforms *transforms, uint32_t parent)
+{
+    if(transforms->count >= transforms->capacity)
+    {
+        logError("TRANSFORMS", "Transform capacity reached");
+        return DGN_TRANSFORM_NONE;
+    }
+
+    if(parent != DGN_TRANSFORM_NONE && parent >= transforms->count)
+    {
+        logError("TRANSFORMS", "Parent transform does not exist");
+        return DGN_TRANSFORM_NONE;
+    }
+
+    // handles and slots only differ after a sort, new transforms always go at the end
+    uint32_t handle = transforms->count++;
+    uint32_t slot = handle;
+
+    transforms->pos[slot] = (Vec3){0.0f, 0.0f, 0.0f};
+    transforms->rot[slot] = (Quat){0.0f, 0.0f, 0.0f, 1.0f};
+    transforms->scale[slot] = (Vec3){1.0f, 1.0f, 1.0f};
+    transforms->parent_slot[slot] = parent == DGN_TRANSFORM_NONE ? DGN_TRANSFORM_NONE : transforms->handle_slot[parent];
+    transforms->flags[slot] = FLAG_LOCAL_DIRTY;
+    transforms->slot_handle[slot] = handle;
+
+    transforms->handle_slot[handle] = slot;
+    transforms->handle_parent[handle] = parent;
+
+    transforms->any_dirty = DGN_TRUE;
+    transforms->order_dirty = DGN_TRUE;
+
+    return handle;
+}
+
+uint8_t dgnTransformsSetParent(DgnTransforms *transforms, uint32_t handle, uint32_t parent)
+{
+    // walking up from the new parent must never reach the transform itself
+    for(uint32_t p = parent; p != DGN_TRANSFORM_NONE; p = transforms->handle_parent[p])
+    {
+        if(p == handle)
+        {
+            logError("TRANSFORMS", "A transform can not be parented to itself or its children");
+            return DGN_FALSE;
+        }
+    }
+
+    uint32_t slot = transforms->handle_slot[handle];
+
+    transforms->handle_parent[handle] = parent;
+    transforms->parent_slot[slot] = parent == DGN_TRANSFORM_NONE ? DGN_TRANSFORM_NONE : transforms->handle_slot[parent];
+    transforms->flags[slot] |= FLAG_WORLD_DIRTY;
+
+    transforms->any_dirty = DGN_TRUE;
+    transforms->order_dirty = DGN_TRUE;
+
+    return DGN_TRUE;
+}
+
+uint32_t dgnTransformsGetParent(DgnTransforms *transforms, uint32_t handle)
+{
+    return transforms->handle_parent[handle];
+}
+
+/** ---- Local TRS ---- **/
+
+static inline void markLocalInternal(DgnTransforms *transforms, uint32_t slot)
+{
+    transforms->flags[slot] |= FLAG_LOCAL_DIRTY;
+    transforms->any_dirty = DGN_TRUE;
+}
+
+void dgnTransformsSetPosition(DgnTransforms *transforms, uint32_t handle, Vec3 pos)
+{
+    uint32_t slot = transforms->handle_slot[handle];
+    transforms->pos[slot] = pos;
+    markLocalInternal(transforms, slot);
+}
+
+void dgnTransformsSetRotation(DgnTransforms *transforms, uint32_t handle, Quat rot)
+{
+    uint32_t slot = transforms->handle_slot[handle];
+    transforms->rot[slot] = rot;
+    markLocalInternal(transforms, slot);
+}
+
+void dgnTransformsSetScale(DgnTransforms *transforms, uint32_t handle, Vec3 scale)
+{
+    uint32_t slot = transforms->handle_slot[handle];
+    transforms->scale[slot] = scale;
+    markLocalInternal(transforms, slot);
+}
+
+Vec3 dgnTransformsGetPosition(DgnTransforms *transforms, uint32_t handle)
+{
+    return transforms->pos[transforms->handle_slot[handle]];
+}
+
+Quat dgnTransformsGetRotation(DgnTransforms *transforms, uint32_t handle)
+{
+    return transforms->rot[transforms->handle_slot[handle]];
+}
+
+Vec3 dgnTransformsGetScale(DgnTransforms *transforms, uint32_t handle)
+{
+    return transforms->scale[transforms->handle_slot[handle]];
+}
+
+/** ---- Ordering ---- **/
+
+static uint32_t depthInternal(DgnTransforms *transforms, uint32_t handle)
+{
+    uint32_t depth = 0;
+
+    for(uint32_t p = transforms->handle_parent[handle]; p != DGN_TRANSFORM_NONE; p = transforms->handle_parent[p])
+    {
+        depth++;
+    }
+
+    return depth;
+}
+
+#define PERMUTE_INTERNAL(array, type) \
+    for(uint32_t i = 0; i < n; i++) ((type*)transforms->scratch)[i] = transforms->array[order[i]]; \
+    memcpy(transforms->array, transforms->scratch, sizeof(type) * n)
+
+// stable counting sort by depth, parents end up before children and every level is one contiguous range
+static void sortInternal(DgnTransforms *transforms)
+{
+    uint32_t n = transforms->count;
+    uint32_t *level_start = transforms->level_start;
+    uint32_t *depth = transforms->sort_depth;
+    uint32_t *order = transforms->sort_order;
+    uint32_t *cursor = transforms->sort_cursor;
+    uint32_t level_count = 0;
+
+    memset(level_start, 0, sizeof(uint32_t) * (n + 1));
+
+    for(uint32_t s = 0; s < n; s++)
+    {
+        depth[s] = depthInternal(transforms, transforms->slot_handle[s]);
+        level_start[depth[s] + 1]++;
+
+        if(depth[s] + 1 > level_count) level_count = depth[s] + 1;
+    }
+
+    for(uint32_t d = 1; d <= level_count; d++)
+    {
+        level_start[d] += level_start[d - 1];
+    }
+
+    // order[new slot] = old slot
+    memcpy(cursor, level_start, sizeof(uint32_t) * level_count);
+    for(uint32_t s = 0; s < n; s++)
+    {
+        order[cursor[depth[s]]++] = s;
+    }
+
+    PERMUTE_INTERNAL(pos, Vec3);
+    PERMUTE_INTERNAL(rot, Quat);
+    PERMUTE_INTERNAL(scale, Vec3);
+    PERMUTE_INTERNAL(local, Mat4x4);
+    PERMUTE_INTERNAL(world, Mat4x4);
+    PERMUTE_INTERNAL(flags, uint8_t);
+    PERMUTE_INTERNAL(slot_handle, uint32_t);
+
+    for(uint32_t s = 0; s < n; s++)
+    {
+        transforms->handle_slot[transforms->slot_handle[s]] = s;
+    }
+
+    for(uint32_t s = 0; s < n; s++)
+    {
+        uint32_t parent = transforms->handle_parent[transforms->slot_handle[s]];
+        transforms->parent_slot[s] = parent == DGN_TRANSFORM_NONE ? DGN_TRANSFORM_NONE : transforms->handle_slot[parent];
+    }
+
+    transforms->level_count = level_count;
+    transforms->order_dirty = DGN_FALSE;
+}
+
+/** ---- Update ---- **/
+
+static void updateRangeJobInternal(uint32_t begin, uint32_t end, void *user_data)
+{
+    DgnTransforms *t = user_data;
+    uint32_t offset = t->update_offset;
+    begin += offset;
+    end += offset;
+
+    for(uint32_t s = begin; s < end; s++)
+    {
+        if(!(t->flags[s] & (FLAG_LOCAL_DIRTY | FLAG_WORLD_DIRTY)))
+        {
+            continue;
+        }
+
+        // runs of changed locals are rebuilt in one batch
+        uint32_t run_end = s;
+        while(run_end < end && (t->flags[run_end] & FLAG_LOCAL_DIRTY)) run_end++;
+
+        if(run_end > s)
+        {
+            dgnMathQuatToMat4x4N(t->rot + s, t->pos + s, t->scale + s, t->local + s, run_end - s);
+        }
+
+        uint32_t last = run_end > s ? run_end : s + 1;
+        for(uint32_t i = s; i < last; i++)
+        {
+            uint32_t parent = t->parent_slot[i];
+
+            if(parent == DGN_TRANSFORM_NONE)
+            {
+                t->world[i] = t->local[i];
+            }
+            else
+            {
+                dgnMathMulMat4x4N(&t->world[parent], &t->local[i], &t->world[i], 1);
+            }
+
+            t->flags[i] = FLAG_CHANGED;
+        }
+
+        s = last - 1;
+    }
+}
+
+void dgnTransformsUpdate(DgnTransforms *transforms)
+{
+    uint32_t n = transforms->count;
+
+    for(uint32_t s = 0; s < n; s++)
+    {
+        transforms->flags[s] &= ~FLAG_CHANGED;
+    }
+
+    if(!transforms->any_dirty)
+    {
+        return;
+    }
+
+    if(transforms->order_dirty)
+    {
+        sortInternal(transforms);
+    }
+
+    // parents come first, so one pass carries dirtiness down every subtree
+    for(uint32_t s = 0; s < n; s++)
+    {
+        uint32_t parent = transforms->parent_slot[s];
+
+        if(parent != DGN_TRANSFORM_NONE && (transforms->flags[parent] & (FLAG_LOCAL_DIRTY | FLAG_WORLD_DIRTY)))
+        {
+            transforms->flags[s] |= FLAG_WORLD_DIRTY;
+        }
+    }
+
+    // a level only reads the one above it, so each level is split across the job threads
+    for(uint32_t d = 0; d < transforms->level_count; d++)
+    {
+        transforms->update_offset = transforms->level_start[d];
+        dgnJobsParallelFor_internal(transforms->level_start[d + 1] - transforms->level_start[d], UPDATE_BATCH,
+                                    updateRangeJobInternal, transforms);
+    }
+
+    transforms->any_dirty = DGN_FALSE;
+}
+
+const Mat4x4 *dgnTransformsGetWorld(DgnTransforms *transforms, uint32_t handle)
+{
+    return &transforms->world[transforms->handle_slot[handle]];
+}
+
+const Mat4x4 *dgnTransformsGetLocal(DgnTransforms *transforms, uint32_t handle)
+{
+    return &transforms->local[transforms->handle_slot[handle]];
+}
+
+uint8_t dgnTransformsChanged(DgnTransforms *transforms, uint32_t handle)
+{
+    return (transforms->flags[transforms->handle_slot[handle]] & FLAG_CHANGED) != 0;
+}
+
+uint32_t dgnTransformsGetCount(DgnTransforms *transforms)
+{
+    return transforms->count;
+}
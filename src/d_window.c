@@ -4,9 +4,50 @@
 #include "d_defines.h"
 
 #include <stdio.h>
+#include <string.h>
 
 #include <MemLeaker/malloc.h>
 
+#include "lodepng.h"
+
+#ifdef DGN_USE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif // DGN_USE_EGL
+
+// set while an EGL context is current, so GL functions are loaded through EGL
+static uint8_t s_egl_current = DGN_FALSE;
+
+static DgnWindow *allocWindowInternal(GLFWwindow *native_window, uint16_t width, uint16_t height, const char* title)
+{
+    DgnInput* new_input = malloc(sizeof(*new_input));
+
+    DgnWindow *res = malloc(sizeof(*res));
+
+    res->native_window  = native_window;
+    res->width          = width;
+    res->height         = height;
+    res->title          = title;
+    res->frame_count    = 0;
+    res->input          = new_input;
+    res->time_1         = clockSeconds_internal();
+    res->delta          = 0.0;
+    res->frame_times    = NULL;
+    res->cpu_times      = NULL;
+    res->swap_times     = NULL;
+    res->stats_scratch  = NULL;
+    res->frame_budget   = 0.0f;
+    res->headless       = DGN_FALSE;
+    res->should_close   = DGN_FALSE;
+    res->egl_display    = NULL;
+    res->egl_surface    = NULL;
+    res->egl_context    = NULL;
+
+    dgnWindowSetStatsCapacity(res, FRAME_STATS_DEFAULT_CAPACITY_INTERNAL);
+
+    return res;
+}
+
 uint8_t dgnWindowCreate(DgnWindow **out_window, uint16_t width, uint16_t height, const char* title)
 {
     if(glfwInit() == GLFW_FALSE)
@@ -17,6 +58,10 @@ uint8_t dgnWindowCreate(DgnWindow **out_window, uint16_t width, uint16_t height,
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __DEBUG
+    // some drivers only send debug output to debug contexts
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
+#endif // __DEBUG
 
     GLFWwindow *window = glfwCreateWindow(width, height, title, NULL, NULL);
     if(window == NULL)
@@ -24,71 +69,304 @@ uint8_t dgnWindowCreate(DgnWindow **out_window, uint16_t width, uint16_t height,
         return DGN_FALSE;
     }
 
-    DgnInput* new_input = malloc(sizeof(*new_input));
-    new_input->keys = malloc(sizeof(*new_input->keys) * DGN_KEY_LAST);
-    new_input->keys_l = malloc(sizeof(*new_input->keys_l) * DGN_KEY_LAST);
-    new_input->m_buttons = malloc(sizeof(*new_input->m_buttons) * DGN_MOUSE_BUTTON_LAST);
-    new_input->m_buttons_l = malloc(sizeof(*new_input->m_buttons_l) * DGN_MOUSE_BUTTON_LAST);
-    new_input->gp_states = malloc(sizeof(*new_input->gp_states) * DGN_GAMEPAD_LAST);
+    *out_window = allocWindowInternal(window, width, height, title);
+
+    glfwSetKeyCallback(window, key_callback_internal);
+    glfwSetMouseButtonCallback(window, mouse_button_callback_internal);
+    glfwSetCursorPosCallback(window, cursor_position_callback_internal);
+    glfwSetScrollCallback(window, scroll_callback_internal);
+    glfwSetJoystickCallback(joystick_callback_internal);
+
+    return DGN_TRUE;
+}
 
-    for(int i = 0; i < DGN_GAMEPAD_LAST; i++)
+/** ---- Headless ---- **/
+
+#ifdef DGN_USE_EGL
+static uint8_t createEglContextInternal(DgnWindow *window)
+{
+    EGLDisplay display = EGL_NO_DISPLAY;
+
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    // needs no display server or gpu, mesa falls back to llvmpipe
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if(get_platform_display)
     {
-        int jid = GLFW_JOYSTICK_1 + i;
-        if (glfwJoystickIsGamepad(jid))
-        {
-            logMessage("%s Connected to port %u\n", glfwGetGamepadName(jid), jid);
-        }
+        display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
     }
+#endif // EGL_PLATFORM_SURFACELESS_MESA
 
-    *out_window = malloc(sizeof(**out_window));
+    if(display == EGL_NO_DISPLAY)
+    {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
 
-    (*out_window)->native_window  = window;
-    (*out_window)->width          = width;
-    (*out_window)->height         = height;
-    (*out_window)->title          = title;
-    (*out_window)->frame_count    = 0;
-    (*out_window)->input          = new_input;
-    (*out_window)->time_1         = glfwGetTime();
+    if(display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL))
+    {
+        return DGN_FALSE;
+    }
 
-    glfwSetKeyCallback(window, key_callback_internal);
-    glfwSetMouseButtonCallback(window, mouse_button_callback_internal);
-    glfwSetCursorPosCallback(window, cursor_position_callback_internal);
-    glfwSetScrollCallback(window, scroll_callback_internal);
+    const EGLint config_attribs[] =
+    {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+        EGL_DEPTH_SIZE, 24, EGL_STENCIL_SIZE, 8,
+        EGL_NONE
+    };
+    const EGLint surface_attribs[] =
+    {
+        EGL_WIDTH, window->width,
+        EGL_HEIGHT, window->height,
+        EGL_NONE
+    };
+    const EGLint context_attribs[] =
+    {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+#ifdef __DEBUG
+        EGL_CONTEXT_OPENGL_DEBUG, EGL_TRUE,
+#endif // __DEBUG
+        EGL_NONE
+    };
+
+    EGLConfig config;
+    EGLint config_count = 0;
+    EGLSurface surface = EGL_NO_SURFACE;
+    EGLContext context = EGL_NO_CONTEXT;
+
+    if(eglBindAPI(EGL_OPENGL_API) &&
+       eglChooseConfig(display, config_attribs, &config, 1, &config_count) && config_count > 0)
+    {
+        // the pbuffer stands in for the window's default framebuffer
+        surface = eglCreatePbufferSurface(display, config, surface_attribs);
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attribs);
+    }
+
+    if(surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT)
+    {
+        if(surface != EGL_NO_SURFACE) eglDestroySurface(display, surface);
+        if(context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+        eglTerminate(display);
+        return DGN_FALSE;
+    }
+
+    window->egl_display = display;
+    window->egl_surface = surface;
+    window->egl_context = context;
 
     return DGN_TRUE;
 }
+#endif // DGN_USE_EGL
+
+uint8_t dgnWindowCreateHeadless(DgnWindow **out_window, uint16_t width, uint16_t height, const char* title)
+{
+    // fails without a display, only the hidden window fallback needs it
+    uint8_t has_glfw = glfwInit() == GLFW_TRUE;
+
+    *out_window = allocWindowInternal(NULL, width, height, title);
+    (*out_window)->headless = DGN_TRUE;
+
+#ifdef DGN_USE_EGL
+    if(createEglContextInternal(*out_window))
+    {
+        return DGN_TRUE;
+    }
+    logMessage("%s\n", "EGL context could not be created, falling back to a hidden window");
+#endif // DGN_USE_EGL
+
+    GLFWwindow *window = NULL;
+
+    if(has_glfw)
+    {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef __DEBUG
+        glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
+#endif // __DEBUG
+
+        window = glfwCreateWindow(width, height, title, NULL, NULL);
+
+        glfwDefaultWindowHints();
+    }
+
+    if(window == NULL)
+    {
+        logError("HEADLESS", "No EGL context and no display for a hidden window");
+        dgnWindowDestroy(*out_window);
+        *out_window = NULL;
+        return DGN_FALSE;
+    }
+
+    (*out_window)->native_window = window;
+
+    return DGN_TRUE;
+}
+
+void *windowGetProcAddress_internal(const char *name)
+{
+#ifdef DGN_USE_EGL
+    if(s_egl_current)
+    {
+        return (void*)eglGetProcAddress(name);
+    }
+#endif // DGN_USE_EGL
+
+    return (void*)glfwGetProcAddress(name);
+}
+
+uint8_t dgnWindowIsHeadless(DgnWindow *window)
+{
+    return window->headless;
+}
+
+uint8_t dgnWindowReadPixels(DgnWindow *window, uint8_t *out_rgba)
+{
+    GLint read_fb;
+    glCall(glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &read_fb));
+
+    glStatCall(DGN_RENDER_STAT_FRAMEBUFFER_BINDS, 1, glBindFramebuffer(GL_READ_FRAMEBUFFER, 0));
+    glCall(glPixelStorei(GL_PACK_ALIGNMENT, 1));
+    glCall(glReadPixels(0, 0, window->width, window->height, GL_RGBA, GL_UNSIGNED_BYTE, out_rgba));
+    glStatCall(DGN_RENDER_STAT_FRAMEBUFFER_BINDS, 1, glBindFramebuffer(GL_READ_FRAMEBUFFER, read_fb));
+
+    return glGetError() == GL_NO_ERROR;
+}
+
+uint8_t dgnWindowSaveFrame(DgnWindow *window, const char *filepath)
+{
+    size_t row = (size_t)window->width * 4;
+    uint8_t *pixels = malloc(row * window->height);
+    uint8_t *flipped = malloc(row * window->height);
+    uint8_t res = DGN_FALSE;
+
+    if(pixels && flipped && dgnWindowReadPixels(window, pixels))
+    {
+        // gl rows start at the bottom, png rows at the top
+        for(uint16_t y = 0; y < window->height; y++)
+        {
+            memcpy(flipped + row * y, pixels + row * (window->height - 1 - y), row);
+        }
+
+        res = lodepng_encode32_file(filepath, flipped, window->width, window->height) == 0;
+    }
+
+    if(!res)
+    {
+        logError("SAVE FRAME", filepath);
+    }
+
+    free(pixels);
+    free(flipped);
+
+    return res;
+}
+
+/*****************************************************************/
 
 void dgnWindowDestroy(DgnWindow *window)
 {
-    glfwDestroyWindow(window->native_window);
+#ifdef DGN_USE_EGL
+    if(window->egl_display)
+    {
+        eglMakeCurrent(window->egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(window->egl_display, window->egl_context);
+        eglDestroySurface(window->egl_display, window->egl_surface);
+        eglTerminate(window->egl_display);
+        s_egl_current = DGN_FALSE;
+    }
+#endif // DGN_USE_EGL
+
+    if(window->native_window)
+    {
+        glfwDestroyWindow(window->native_window);
+    }
 
-    free(window->input->keys);
-    free(window->input->keys_l);
-    free(window->input->m_buttons);
-    free(window->input->m_buttons_l);
-    free(window->input->gp_states);
     free(window->input);
+    frameStatsFree_internal(window);
 
     free(window);
 }
 
+void windowBindContext_internal(DgnWindow *window, uint8_t bind)
+{
+#ifdef DGN_USE_EGL
+    if(window->egl_display)
+    {
+        // the bound api is per thread
+        eglBindAPI(EGL_OPENGL_API);
+        if(bind)
+        {
+            eglMakeCurrent(window->egl_display, window->egl_surface, window->egl_surface, window->egl_context);
+        }
+        else
+        {
+            eglMakeCurrent(window->egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        }
+        s_egl_current = bind;
+        return;
+    }
+    s_egl_current = DGN_FALSE;
+#endif // DGN_USE_EGL
+
+    glfwMakeContextCurrent(bind ? window->native_window : NULL);
+}
+
+void windowPresent_internal(DgnWindow *window)
+{
+    renderStatsEndFrame_internal();
+
+#ifdef DGN_USE_EGL
+    if(window->egl_display)
+    {
+        eglSwapBuffers(window->egl_display, window->egl_surface);
+        return;
+    }
+#endif // DGN_USE_EGL
+
+    glfwSwapBuffers(window->native_window);
+}
+
 void dgnWindowMakeCurrent(DgnWindow *window)
 {
-    glfwMakeContextCurrent(window->native_window);
+    windowBindContext_internal(window, DGN_TRUE);
     set_input_holder_internal(window->input);
 }
 
 uint8_t dgnWindowShouldClose(DgnWindow *window)
 {
+    if(window->native_window == NULL)
+    {
+        return window->should_close;
+    }
+
     return glfwWindowShouldClose(window->native_window);
 }
 
+void dgnWindowClose(DgnWindow *window)
+{
+    window->should_close = DGN_TRUE;
+
+    if(window->native_window)
+    {
+        glfwSetWindowShouldClose(window->native_window, GLFW_TRUE);
+    }
+}
+
 void dgnWindowSwapBuffers(DgnWindow *window)
 {
-    glfwSwapBuffers(window->native_window);
+    double swap_start = clockSeconds_internal();
+    windowPresent_internal(window);
     window->frame_count++;
-    double time = glfwGetTime();
+    double time = clockSeconds_internal();
     window->delta = time - window->time_1;
+
+    // cpu time is everything between the end of the last swap and the start of this one
+    frameStatsPush_internal(window, (float)window->delta, (float)(swap_start - window->time_1), (float)(time - swap_start));
     window->time_1 = time;
 }
 
@@ -114,11 +392,21 @@ uint64_t dgnWindowGetFrameCount(DgnWindow *window)
 
 double dgnWindowGetDelta(DgnWindow *window)
 {
+    double delta;
+
+    // replays step by the recorded or fixed frame time instead of the wall clock
+    if(inputReplayDelta_internal(&delta))
+    {
+        return delta;
+    }
+
     return window->delta;
 }
 
 void dgnWindowSetRawCursorMode(DgnWindow *window, uint8_t enabled)
 {
+    if(window->native_window == NULL) return;
+
     if (glfwRawMouseMotionSupported())
     {
         glfwSetInputMode(window->native_window, GLFW_RAW_MOUSE_MOTION, enabled);
@@ -127,6 +415,8 @@ void dgnWindowSetRawCursorMode(DgnWindow *window, uint8_t enabled)
 
 void dgnWindowSetCursorMode(DgnWindow *window, uint32_t cursor_mode)
 {
+    if(window->native_window == NULL) return;
+
     glfwSetInputMode(window->native_window, GLFW_CURSOR, cursor_mode);
 }
 
@@ -138,12 +428,14 @@ void dgnWindowSetVsync(uint8_t sync)
 void dgnWindowSetWidth(DgnWindow *window, uint16_t new_width)
 {
     window->width = new_width;
+    if(window->native_window == NULL) return;
     glfwSetWindowSize(window->native_window, new_width, window->height);
 }
 
 void dgnWindowSetHeight(DgnWindow *window, uint16_t new_height)
 {
     window->height = new_height;
+    if(window->native_window == NULL) return;
     glfwSetWindowSize(window->native_window, window->width, new_height);
 }
 
@@ -151,12 +443,14 @@ void dgnWindowSetSize(DgnWindow* window, uint16_t new_width, uint16_t new_height
 {
     window->width = new_width;
     window->height = new_height;
+    if(window->native_window == NULL) return;
     glfwSetWindowSize(window->native_window, new_width, new_height);
 }
 
 void dgnWindowSetTitle(DgnWindow *window, const char* new_title)
 {
     window->title = new_title;
+    if(window->native_window == NULL) return;
     glfwSetWindowTitle(window->native_window, new_title);
 }
 
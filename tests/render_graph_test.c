@@ -0,0 +1,272 @@
+// Render graph ordering, culling and aliasing checks, on the null backend so no gl context is needed.
+//
+// Built like the game, from the engine sources in src/ with this file in place of main.c.
+// Exits with 1 if any check fails.
+
+#include "../src/DGNEngine/DGNEngine.h"
+
+#include <stdio.h>
+
+static int s_failures;
+
+#define CHECK(cond) \
+    if(!(cond)) \
+    { \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        s_failures++; \
+    }
+
+static void checkOrderInternal(DgnRenderGraph *graph, const uint16_t *expected, uint16_t count, int line)
+{
+    uint16_t order[64];
+    uint16_t order_count = dgnRenderGraphGetExecutionOrder(graph, order);
+
+    uint8_t same = order_count == count;
+    for(uint16_t i = 0; i < count && same; i++)
+    {
+        same = order[i] == expected[i];
+    }
+
+    if(!same)
+    {
+        printf("%s:%d: execution order was", __FILE__, line);
+        for(uint16_t i = 0; i < order_count; i++)
+        {
+            printf(" %u", order[i]);
+        }
+        printf("\n");
+        s_failures++;
+    }
+}
+
+#define CHECK_ORDER(graph, ...) \
+    { \
+        const uint16_t expected[] = {__VA_ARGS__}; \
+        checkOrderInternal(graph, expected, sizeof(expected) / sizeof(*expected), __LINE__); \
+    }
+
+static DgnRenderGraphTextureDesc descInternal()
+{
+    DgnRenderGraphTextureDesc desc;
+    desc.width = 64;
+    desc.height = 64;
+    desc.storage_type = DGN_TEX_STORAGE_RGBA;
+    desc.internal_type = DGN_TEX_STORAGE_RGBA;
+    desc.data_type = DGN_DATA_TYPE_UBYTE;
+    desc.filtering = DGN_TEX_FILTER_NEAREST;
+    return desc;
+}
+
+// write, read, write again: the reader sees the first version and has to run before it is overwritten
+static void writeReadWriteInternal(DgnRenderGraph *graph)
+{
+    dgnRenderGraphReset(graph);
+
+    uint16_t t = dgnRenderGraphCreateTexture(graph, "t", descInternal());
+    uint16_t out1 = dgnRenderGraphImportTexture(graph, "out1", NULL);
+    uint16_t out2 = dgnRenderGraphImportTexture(graph, "out2", NULL);
+
+    uint16_t a = dgnRenderGraphAddPass(graph, "write t", NULL, NULL);
+    dgnRenderGraphPassWrite(graph, a, t);
+
+    uint16_t b = dgnRenderGraphAddPass(graph, "read t", NULL, NULL);
+    dgnRenderGraphPassRead(graph, b, t);
+    dgnRenderGraphPassWrite(graph, b, out1);
+
+    uint16_t c = dgnRenderGraphAddPass(graph, "overwrite t", NULL, NULL);
+    dgnRenderGraphPassWrite(graph, c, t);
+
+    uint16_t d = dgnRenderGraphAddPass(graph, "read t again", NULL, NULL);
+    dgnRenderGraphPassRead(graph, d, t);
+    dgnRenderGraphPassWrite(graph, d, out2);
+
+    CHECK(dgnRenderGraphCompile(graph));
+    CHECK(!dgnRenderGraphIsPassCulled(graph, a));
+    CHECK(!dgnRenderGraphIsPassCulled(graph, b));
+    CHECK(!dgnRenderGraphIsPassCulled(graph, c));
+    CHECK(!dgnRenderGraphIsPassCulled(graph, d));
+    CHECK_ORDER(graph, a, b, c, d);
+}
+
+// a later write nobody reads is culled, the reader only needs the writer before it
+static void unreadOverwriteInternal(DgnRenderGraph *graph)
+{
+    dgnRenderGraphReset(graph);
+
+    uint16_t t = dgnRenderGraphCreateTexture(graph, "t", descInternal());
+
+    uint16_t a = dgnRenderGraphAddPass(graph, "write t", NULL, NULL);
+    dgnRenderGraphPassWrite(graph, a, t);
+
+    uint16_t b = dgnRenderGraphAddPass(graph, "present t", NULL, NULL);
+    dgnRenderGraphPassRead(graph, b, t);
+    dgnRenderGraphPassSetSideEffect(graph, b);
+
+    uint16_t c = dgnRenderGraphAddPass(graph, "overwrite t", NULL, NULL);
+    dgnRenderGraphPassWrite(graph, c, t);
+
+    CHECK(dgnRenderGraphCompile(graph));
+    CHECK(!dgnRenderGraphIsPassCulled(graph, a));
+    CHECK(!dgnRenderGraphIsPassCulled(graph, b));
+    CHECK(dgnRenderGraphIsPassCulled(graph, c));
+    CHECK_ORDER(graph, a, b);
+}
+
+// a reader nobody needs is culled, even though a later writer has to wait for it when it runs
+static void unneededReaderInternal(DgnRenderGraph *graph)
+{
+    dgnRenderGraphReset(graph);
+
+    uint16_t t = dgnRenderGraphCreateTexture(graph, "t", descInternal());
+    uint16_t u = dgnRenderGraphCreateTexture(graph, "u", descInternal());
+    uint16_t out = dgnRenderGraphImportTexture(graph, "out", NULL);
+
+    uint16_t a = dgnRenderGraphAddPass(graph, "write t", NULL, NULL);
+    dgnRenderGraphPassWrite(graph, a, t);
+
+    uint16_t b = dgnRenderGraphAddPass(graph, "read t into u", NULL, NULL);
+    dgnRenderGraphPassRead(graph, b, t);
+    dgnRenderGraphPassWrite(graph, b, u);
+
+    uint16_t c = dgnRenderGraphAddPass(graph, "overwrite t", NULL, NULL);
+    dgnRenderGraphPassWrite(graph, c, t);
+
+    uint16_t d = dgnRenderGraphAddPass(graph, "read t", NULL, NULL);
+    dgnRenderGraphPassRead(graph, d, t);
+    dgnRenderGraphPassWrite(graph, d, out);
+
+    CHECK(dgnRenderGraphCompile(graph));
+    CHECK(dgnRenderGraphIsPassCulled(graph, b));
+    CHECK(!dgnRenderGraphIsPassCulled(graph, c));
+    CHECK(!dgnRenderGraphIsPassCulled(graph, d));
+    CHECK_ORDER(graph, a, c, d);
+}
+
+// matches POOL_TRIM_FRAMES in d_render_graph.c
+#define TEST_POOL_TRIM_FRAMES 4
+
+// a transient written then read, into an imported output so the passes are needed
+static void transientInternal(DgnRenderGraph *graph, const char *name, DgnRenderGraphTextureDesc desc)
+{
+    uint16_t t = dgnRenderGraphCreateTexture(graph, name, desc);
+    uint16_t out = dgnRenderGraphImportTexture(graph, "out", NULL);
+
+    uint16_t a = dgnRenderGraphAddPass(graph, "write", NULL, NULL);
+    dgnRenderGraphPassWrite(graph, a, t);
+
+    uint16_t b = dgnRenderGraphAddPass(graph, "read", NULL, NULL);
+    dgnRenderGraphPassRead(graph, b, t);
+    dgnRenderGraphPassWrite(graph, b, out);
+}
+
+// the same desc with disjoint lifetimes lands on one physical texture
+static void disjointLifetimesInternal()
+{
+    DgnRenderGraph *graph = dgnRenderGraphCreate(DGN_RENDER_GRAPH_BACKEND_NULL);
+
+    transientInternal(graph, "t", descInternal());
+    transientInternal(graph, "u", descInternal());
+
+    CHECK(dgnRenderGraphCompile(graph));
+    CHECK(dgnRenderGraphGetPhysicalTextureCount(graph) == 1);
+    CHECK(dgnRenderGraphGetTransientMemory(graph) == 64 * 64 * 4);
+
+    dgnRenderGraphDestroy(graph);
+}
+
+// both textures are alive while the last pass reads them, so they can't share
+static void overlappingLifetimesInternal()
+{
+    DgnRenderGraph *graph = dgnRenderGraphCreate(DGN_RENDER_GRAPH_BACKEND_NULL);
+
+    uint16_t t = dgnRenderGraphCreateTexture(graph, "t", descInternal());
+    uint16_t u = dgnRenderGraphCreateTexture(graph, "u", descInternal());
+    uint16_t out = dgnRenderGraphImportTexture(graph, "out", NULL);
+
+    uint16_t a = dgnRenderGraphAddPass(graph, "write t", NULL, NULL);
+    dgnRenderGraphPassWrite(graph, a, t);
+
+    uint16_t b = dgnRenderGraphAddPass(graph, "write u", NULL, NULL);
+    dgnRenderGraphPassWrite(graph, b, u);
+
+    uint16_t c = dgnRenderGraphAddPass(graph, "read t and u", NULL, NULL);
+    dgnRenderGraphPassRead(graph, c, t);
+    dgnRenderGraphPassRead(graph, c, u);
+    dgnRenderGraphPassWrite(graph, c, out);
+
+    CHECK(dgnRenderGraphCompile(graph));
+    CHECK(dgnRenderGraphGetPhysicalTextureCount(graph) == 2);
+    CHECK(dgnRenderGraphGetTransientMemory(graph) == 2 * 64 * 64 * 4);
+
+    dgnRenderGraphDestroy(graph);
+}
+
+// disjoint lifetimes still need their own texture when the desc differs
+static void differentDescInternal()
+{
+    DgnRenderGraph *graph = dgnRenderGraphCreate(DGN_RENDER_GRAPH_BACKEND_NULL);
+
+    DgnRenderGraphTextureDesc half = descInternal();
+    half.width = 32;
+    half.height = 32;
+
+    transientInternal(graph, "t", descInternal());
+    transientInternal(graph, "u", half);
+
+    CHECK(dgnRenderGraphCompile(graph));
+    CHECK(dgnRenderGraphGetPhysicalTextureCount(graph) == 2);
+    CHECK(dgnRenderGraphGetTransientMemory(graph) == 64 * 64 * 4 + 32 * 32 * 4);
+
+    dgnRenderGraphDestroy(graph);
+}
+
+// the pool outlives a reset, and a texture is only released after POOL_TRIM_FRAMES frames without a user
+static void poolTrimInternal()
+{
+    DgnRenderGraph *graph = dgnRenderGraphCreate(DGN_RENDER_GRAPH_BACKEND_NULL);
+
+    transientInternal(graph, "t", descInternal());
+    CHECK(dgnRenderGraphCompile(graph));
+    CHECK(dgnRenderGraphGetPhysicalTextureCount(graph) == 1);
+
+    for(int frame = 1; frame <= TEST_POOL_TRIM_FRAMES + 1; frame++)
+    {
+        dgnRenderGraphReset(graph);
+
+        uint16_t out = dgnRenderGraphImportTexture(graph, "out", NULL);
+        uint16_t a = dgnRenderGraphAddPass(graph, "write out", NULL, NULL);
+        dgnRenderGraphPassWrite(graph, a, out);
+
+        CHECK(dgnRenderGraphCompile(graph));
+        CHECK(dgnRenderGraphGetPhysicalTextureCount(graph) == (frame <= TEST_POOL_TRIM_FRAMES ? 1 : 0));
+    }
+
+    CHECK(dgnRenderGraphGetTransientMemory(graph) == 0);
+
+    dgnRenderGraphDestroy(graph);
+}
+
+int main()
+{
+    DgnRenderGraph *graph = dgnRenderGraphCreate(DGN_RENDER_GRAPH_BACKEND_NULL);
+
+    writeReadWriteInternal(graph);
+    unreadOverwriteInternal(graph);
+    unneededReaderInternal(graph);
+
+    dgnRenderGraphDestroy(graph);
+
+    disjointLifetimesInternal();
+    overlappingLifetimesInternal();
+    differentDescInternal();
+    poolTrimInternal();
+
+    if(s_failures)
+    {
+        printf("%d render graph checks failed\n", s_failures);
+        return 1;
+    }
+
+    printf("render graph checks passed\n");
+    return 0;
+}